@@ -116,6 +116,8 @@ public class RestoreBackUp {
             if (FileHelper.getFileExt(file).toLowerCase().equals("sgb")) {
                 String name = FileHelper.getFileWithoutExt(file);
                 FileHelper.copy(PathManager.LocalCacheFolder + "/" + name + ".sgb", PathManager.LocalProjectFolder + "/" + newName + ".sgb");
+                if (FileHelper.checkValidFilePath(PathManager.LocalCacheFolder + "/" + name + ".sgp"))
+                    FileHelper.copy(PathManager.LocalCacheFolder + "/" + name + ".sgp", PathManager.LocalProjectFolder + "/" + newName + ".sgp");
                 FileHelper.copy(PathManager.LocalCacheFolder + "/" + name + ".png", PathManager.LocalScenesFolder + "/" + newName + ".png");
                 file.delete();
                 new File(PathManager.LocalCacheFolder + "/" + name + ".png").delete();
@@ -39,6 +39,14 @@ public class ZipManager {
             files.add(PathManager.LocalCacheFolder + "/index.sgb");
         else
             files.add(PathManager.LocalProjectFolder + "/" + ((EditorView) mContext).projectNameHash + ".sgb");
+        String physicsCache = PathManager.LocalProjectFolder + "/" + ((EditorView) mContext).projectNameHash + ".sgp";
+        if (FileHelper.checkValidFilePath(physicsCache)) {
+            if (!forBackUp) {
+                FileHelper.copy(physicsCache, PathManager.LocalCacheFolder + "/index.sgp");
+                files.add(PathManager.LocalCacheFolder + "/index.sgp");
+            } else
+                files.add(physicsCache);
+        }
         for (int i = 2; i < GL2JNILib.getNodeCount(); i++) {
 //    TODO        if (GL2JNILib.getNodeType(i) == Constants.NODE_SGM || GL2JNILib.getNodeType(i) == Constants.NODE_RIG || GL2JNILib.getNodeType(i) == Constants.NODE_OBJ) {
 //                if (!isStoreAsset(GL2JNILib.getAssetIdWithNodeId(i))) {
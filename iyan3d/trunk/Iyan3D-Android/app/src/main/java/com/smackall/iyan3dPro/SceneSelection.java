@@ -267,8 +267,11 @@ public class SceneSelection extends AppCompatActivity implements ServiceConnecti
         File image = new File(PathManager.LocalScenesFolder + "/" + sceneDBs.get(position).getImage() + ".png");
         File projectFile = new File(PathManager.LocalProjectFolder + "/" + sceneDBs.get(position).getImage() + ".sgb");
         File backUpFile = new File(PathManager.LocalProjectFolder + "/" + sceneDBs.get(position).getImage() + ".i3d");
+        File physicsFile = new File(PathManager.LocalProjectFolder + "/" + sceneDBs.get(position).getImage() + ".sgp");
         if (projectFile.exists())
             projectFile.delete();
+        if (physicsFile.exists())
+            physicsFile.delete();
         if (image.exists())
             image.delete();
         if (backUpFile.exists())
@@ -289,10 +292,14 @@ public class SceneSelection extends AppCompatActivity implements ServiceConnecti
 
         File projectFrom = new File(PathManager.LocalProjectFolder + "/" + sceneDBs.get(position).getImage() + ".sgb");
         File projectTo = new File(PathManager.LocalProjectFolder + "/" + FileHelper.md5(sceneName) + ".sgb");
+        File physicsFrom = new File(PathManager.LocalProjectFolder + "/" + sceneDBs.get(position).getImage() + ".sgp");
+        File physicsTo = new File(PathManager.LocalProjectFolder + "/" + FileHelper.md5(sceneName) + ".sgp");
         if (thumpnailFrom.exists())
             FileHelper.copy(thumpnailFrom, thumpnailTo);
         if (projectFrom.exists())
             FileHelper.copy(projectFrom, projectTo);
+        if (physicsFrom.exists())
+            FileHelper.copy(physicsFrom, physicsTo);
         db.addNewScene(new SceneDB(sceneName, FileHelper.md5(sceneName), date));
         this.sceneAdapter.sceneDBs = db.getAllScenes();
         this.sceneAdapter.notifyDataSetChanged();
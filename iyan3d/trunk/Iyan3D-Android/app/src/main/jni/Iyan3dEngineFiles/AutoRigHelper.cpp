@@ -1,9 +1,10 @@
 #include "HeaderFiles/AutoRigHelper.h"
+#include <thread>
 
 vector< set<int> > adjacentVertices;
 std::map<int, Mat4> envelopeMatrices;
 
-void initAdjacencyMatrix(int verticesCount, int indicesCount, unsigned short* indices) {
+void initAdjacencyMatrix(int verticesCount, int indicesCount, vector<unsigned int> &indices) {
     adjacentVertices.clear();
     set<int> emptySet;
     emptySet.clear();
@@ -22,8 +23,7 @@ void initAdjacencyMatrix(int verticesCount, int indicesCount, unsigned short* in
 
 void initUnmatchedWeights(int verticesCount,std::map<int,bool> &isWeighted, std::map<int, vector<InfluencedObject> > &influencedVertices, std::map<int, vector<InfluencedObject> > &influencedJoints) {
     queue < pair<int, int> > unmatchedVertices;
-    bool isVisited[verticesCount+5];
-    memset(isVisited, false, sizeof(isVisited));
+    vector<bool> isVisited(verticesCount + 5, false);
     
     //marking all weighted vertices as visited
     for(std::map<int,bool> :: iterator it = isWeighted.begin(); it!=isWeighted.end(); it++)
@@ -180,6 +180,132 @@ float getWeight(Vector3 &vertexGlobalPosition, int jointId, std::map<int, RigKey
     return weight;
 }
 
+// Uniform grid over the weighted vertices, cells are sized for a couple of vertices each
+struct WeightedVertexGrid {
+    Vector3 origin;
+    float cellSize;
+    int dims[3];
+    vector<int> cellStarts;
+    vector<int> cellVertices;
+    vector<Vector3> positions;
+    
+    void build(const vector<Vector3> &points) {
+        positions = points;
+        Vector3 bMin = points[0], bMax = points[0];
+        for(int i = 1; i < points.size(); i++) {
+            bMin = Vector3(min(bMin.x, points[i].x), min(bMin.y, points[i].y), min(bMin.z, points[i].z));
+            bMax = Vector3(max(bMax.x, points[i].x), max(bMax.y, points[i].y), max(bMax.z, points[i].z));
+        }
+        
+        Vector3 extent = bMax - bMin;
+        int resolution = max(1, (int)ceil(cbrt(points.size() / 2.0)));
+        cellSize = max(extent.x, max(extent.y, extent.z)) / resolution;
+        if(cellSize <= 0.0)
+            cellSize = 1.0;
+        origin = bMin;
+        dims[0] = min(resolution, (int)(extent.x / cellSize)) + 1;
+        dims[1] = min(resolution, (int)(extent.y / cellSize)) + 1;
+        dims[2] = min(resolution, (int)(extent.z / cellSize)) + 1;
+        
+        vector<int> cells(points.size());
+        cellStarts.assign(dims[0] * dims[1] * dims[2] + 1, 0);
+        for(int i = 0; i < points.size(); i++) {
+            int c[3];
+            getCell(points[i], c);
+            cells[i] = (c[2] * dims[1] + c[1]) * dims[0] + c[0];
+            cellStarts[cells[i] + 1]++;
+        }
+        for(int i = 1; i < cellStarts.size(); i++)
+            cellStarts[i] += cellStarts[i - 1];
+        
+        vector<int> fill(cellStarts.begin(), cellStarts.end() - 1);
+        cellVertices.resize(points.size());
+        for(int i = 0; i < points.size(); i++)
+            cellVertices[fill[cells[i]]++] = i;
+    }
+    
+    void getCell(Vector3 point, int c[3]) const {
+        float values[3] = { point.x - origin.x, point.y - origin.y, point.z - origin.z };
+        for(int a = 0; a < 3; a++)
+            c[a] = max(0, min(dims[a] - 1, (int)floor(values[a] / cellSize)));
+    }
+    
+    // Visits rings of cells around the point until no closer vertex can remain
+    void findNearest(Vector3 point, int count, vector< pair<float, int> > &nearest) const {
+        nearest.clear();
+        int c[3];
+        getCell(point, c);
+        int maxRing = max(dims[0], max(dims[1], dims[2]));
+        
+        for(int r = 0; r <= maxRing; r++) {
+            for(int dx = -r; dx <= r; dx++) {
+                int x = c[0] + dx;
+                if(x < 0 || x >= dims[0])
+                    continue;
+                for(int dy = -r; dy <= r; dy++) {
+                    int y = c[1] + dy;
+                    if(y < 0 || y >= dims[1])
+                        continue;
+                    bool onEdge = (abs(dx) == r || abs(dy) == r);
+                    for(int dz = -r; dz <= r; dz += (onEdge ? 1 : 2 * r)) {
+                        int z = c[2] + dz;
+                        if(z < 0 || z >= dims[2])
+                            continue;
+                        int cell = (z * dims[1] + y) * dims[0] + x;
+                        for(int i = cellStarts[cell]; i < cellStarts[cell + 1]; i++) {
+                            int vertex = cellVertices[i];
+                            Vector3 offset = positions[vertex] - point;
+                            float distanceSQ = offset.dotProduct(offset);
+                            if(nearest.size() == count && distanceSQ >= nearest.back().first)
+                                continue;
+                            if(nearest.size() == count)
+                                nearest.pop_back();
+                            vector< pair<float, int> >::iterator it = nearest.begin();
+                            while(it != nearest.end() && it->first <= distanceSQ)
+                                it++;
+                            nearest.insert(it, make_pair(distanceSQ, vertex));
+                        }
+                    }
+                }
+            }
+            float ringDistance = r * cellSize;
+            if(nearest.size() == count && nearest.back().first <= ringDistance * ringDistance)
+                break;
+        }
+    }
+};
+
+// Blends the influences of the nearest weighted vertices by inverse squared distance
+void transferNearestWeights(const WeightedVertexGrid &grid, const vector< vector<InfluencedObject> > &weightedInfluences, const vector<Vector3> &queryPositions, vector< vector<InfluencedObject> > &results, int start, int end) {
+    vector< pair<float, int> > nearest;
+    for(int i = start; i < end; i++) {
+        grid.findNearest(queryPositions[i], AUTORIG_NEAREST_VERTEX_COUNT, nearest);
+        if(nearest[0].first <= 0.0) {
+            results[i] = weightedInfluences[nearest[0].second];
+            continue;
+        }
+        
+        std::map<int, float> jointWeights;
+        float totalWeight = 0.0;
+        for(int n = 0; n < nearest.size(); n++) {
+            float blend = 1.0 / nearest[n].first;
+            const vector<InfluencedObject> &influences = weightedInfluences[nearest[n].second];
+            for(int k = 0; k < influences.size(); k++) {
+                jointWeights[influences[k].id] += influences[k].weight * blend;
+                totalWeight += influences[k].weight * blend;
+            }
+        }
+        
+        results[i].clear();
+        for(std::map<int, float>::iterator it = jointWeights.begin(); it != jointWeights.end(); it++) {
+            InfluencedObject influencedJoint;
+            influencedJoint.id = it->first;
+            influencedJoint.weight = it->second / totalWeight;
+            results[i].push_back(influencedJoint);
+        }
+    }
+}
+
 void AutoRigHelper::initWeights(shared_ptr<MeshNode> meshSceneNode, std::map<int, RigKey> &rigKeys, std::map<int, vector<InfluencedObject> > &influencedVertices, std::map<int, vector<InfluencedObject> > &influencedJoints) {
     
     influencedJoints.clear();
@@ -196,13 +322,14 @@ void AutoRigHelper::initWeights(shared_ptr<MeshNode> meshSceneNode, std::map<int
     initEnvelopeMatrices(rigKeys);
     
     int verticesCount = mesh->getVerticesCountInMeshBuffer(0);
-    vertexData* vertices = (vertexData*)mesh->getLiteVerticesForMeshBuffer(0, 0);
+    Mat4 transform = meshSceneNode->getAbsoluteTransformation();
+    vector<Vector3> globalPositions(verticesCount);
+    for(int j=0; j < verticesCount; j++)
+        globalPositions[j] = getVertexGlobalPosition(mesh->getLiteVerticesForMeshBuffer(0, j)->vertPosition, transform);
     
     for(int j=0; j < verticesCount; j++){
-        vertexData* vertex = mesh->getLiteVerticesForMeshBuffer(0, j);
         float totalWeight = 0.0;
-        //printf("\n vertexPositionBefore %f %f %f ",vertex.Pos.x,vertex.Pos.y,vertex.Pos.z);
-        Vector3 vertexPosition = getVertexGlobalPosition(vertex->vertPosition,meshSceneNode);
+        Vector3 &vertexPosition = globalPositions[j];
         for(std::map<int, RigKey>::iterator it=rigKeys.begin();it!=rigKeys.end();it++){
             float weight = getWeight(vertexPosition, it->first, rigKeys);
             if(weight > 0.0){
@@ -228,38 +355,53 @@ void AutoRigHelper::initWeights(shared_ptr<MeshNode> meshSceneNode, std::map<int
             isWeighted[j]=true;
     }
     int indicesCount =  mesh->getIndicesCount(0);
-    unsigned short* indices =  mesh->getIndicesArray(0);
+    vector<unsigned int> indices =  mesh->getIndices32ArrayAtMeshBufferIndex(0);
     initAdjacencyMatrix(verticesCount, indicesCount, indices);
     initUnmatchedWeights(verticesCount,isWeighted, influencedVertices, influencedJoints);
     int weightedCount = (int)isWeighted.size();
     int unweightedCount = verticesCount - weightedCount;
     
-    if(weightedCount !=0 && (long long)weightedCount*(long long)unweightedCount < (long long)5e7){
-        //assign vertices to nearest weighted vertex
-        vector<int> weightedVertices;
+    if(weightedCount !=0){
+        //assign vertices the blended weights of their nearest weighted vertices
         vector<int> unweightedVertices;
-        float dist;
+        vector<Vector3> weightedPositions, unweightedPositions;
+        vector< vector<InfluencedObject> > weightedInfluences;
         for(int i=0; i < verticesCount; i++){
-            if(isWeighted[i])
-                weightedVertices.push_back(i);
-            else{
+            if(isWeighted[i]){
+                weightedPositions.push_back(globalPositions[i]);
+                weightedInfluences.push_back(influencedJoints[i]);
+            } else {
                 unweightedVertices.push_back(i);
+                unweightedPositions.push_back(globalPositions[i]);
                 isWeighted.erase(i);
             }
         }
-        for(int i=0; i < unweightedCount; i++){
-            int unweightedVertex = unweightedVertices[i];
-            int closestVertex = -1;
-            float shortestDistance = 1e9;
-            for(int j=0; j < weightedCount; j++){
-                dist = getVertexGlobalPosition(vertices[unweightedVertex].vertPosition, meshSceneNode).getDistanceFrom(getVertexGlobalPosition(vertices[weightedVertices[j]].vertPosition, meshSceneNode));
-                if(shortestDistance > dist){
-                    shortestDistance = dist;
-                    closestVertex = weightedVertices[j];
-                }
+        
+        WeightedVertexGrid grid;
+        grid.build(weightedPositions);
+        vector< vector<InfluencedObject> > results(unweightedCount);
+        
+        int chunks = (unweightedCount + AUTORIG_QUERY_CHUNK_SIZE - 1) / AUTORIG_QUERY_CHUNK_SIZE;
+        int threadsCount = min(max((int)std::thread::hardware_concurrency(), 1), chunks);
+        if(threadsCount <= 1) {
+            transferNearestWeights(grid, weightedInfluences, unweightedPositions, results, 0, unweightedCount);
+        } else {
+            int verticesPerThread = (unweightedCount + threadsCount - 1) / threadsCount;
+            vector<std::thread> workers;
+            for (int i = 1; i < threadsCount; i++) {
+                int start = i * verticesPerThread;
+                int end = min(start + verticesPerThread, unweightedCount);
+                workers.push_back(std::thread(transferNearestWeights, std::cref(grid), std::cref(weightedInfluences), std::cref(unweightedPositions), std::ref(results), start, end));
             }
+            transferNearestWeights(grid, weightedInfluences, unweightedPositions, results, 0, min(verticesPerThread, unweightedCount));
             
-            influencedJoints[unweightedVertex] = influencedJoints[closestVertex];
+            for (int i = 0; i < (int)workers.size(); i++)
+                workers[i].join();
+        }
+        
+        for(int i=0; i < unweightedCount; i++){
+            int unweightedVertex = unweightedVertices[i];
+            influencedJoints[unweightedVertex] = results[i];
             for(int k=0; k<influencedJoints[unweightedVertex].size(); k++){
                 InfluencedObject influencedVertex;
                 influencedVertex.id = unweightedVertex;
@@ -290,10 +432,10 @@ void AutoRigHelper::initWeights(shared_ptr<MeshNode> meshSceneNode, std::map<int
 }
 
 Vector3 AutoRigHelper::getVertexGlobalPosition(Vector3 vertexPos,shared_ptr<MeshNode> meshSceneNode) {
-    Mat4 vertexMat;
-    vertexMat.translate(vertexPos);
-    vertexMat = meshSceneNode->getAbsoluteTransformation() * vertexMat;
-    //meshSceneNode.reset();
-    
-    return vertexMat.getTranslation();
+    return getVertexGlobalPosition(vertexPos, meshSceneNode->getAbsoluteTransformation());
+}
+
+Vector3 AutoRigHelper::getVertexGlobalPosition(Vector3 vertexPos, const Mat4 &transform) {
+    Vector4 position = transform * Vector4(vertexPos, 1.0);
+    return Vector3(position.x, position.y, position.z);
 }
\ No newline at end of file
@@ -10,6 +10,9 @@
 #include <vector>
 using namespace std;
 
+#define AUTORIG_NEAREST_VERTEX_COUNT 4
+#define AUTORIG_QUERY_CHUNK_SIZE 2048
+
 struct InfluencedObject{
     int id;
     float weight;
@@ -26,6 +29,7 @@ public:
     static void updateOBJVertexColors(shared_ptr<MeshNode> mesh, std::map<int, SGNode*> &envelopes, std::map<int, RigKey> &rigKeys,int selectedJointId = NOT_EXISTS, int mirrorJointId = NOT_EXISTS);
     static void initWeights(shared_ptr<MeshNode> meshSceneNode, std::map<int, RigKey> &rigKeys, std::map<int, vector<InfluencedObject> > &influencedVertices, std::map<int, vector<InfluencedObject> > &influencedJoints);
     static Vector3 getVertexGlobalPosition(Vector3 vertexPos,shared_ptr<MeshNode> meshSceneNode);
+    static Vector3 getVertexGlobalPosition(Vector3 vertexPos, const Mat4 &transform);
 };
 
 #endif
\ No newline at end of file
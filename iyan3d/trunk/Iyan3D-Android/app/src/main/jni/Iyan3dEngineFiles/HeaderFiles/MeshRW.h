@@ -10,10 +10,24 @@
 #define MeshRW_h
 
 #include "Constants.h"
+#include "../../SGEngine2/Utilities/MappedFile.h"
+
+// Sizes of the vertex records as they are laid out in the file
+#define MESH_LITE_VERTEX_SIZE (18 * sizeof(float))
+#define MESH_HEAVY_VERTEX_SIZE (34 * sizeof(float))
 
 class MeshRW
 {
+    static MappedFile* sourceFile;
+    
+    static Mesh* readMappedMeshData(size_t &offset);
+    static Mesh* readMappedSkinMeshData(size_t &offset);
+    static void skipTo(ifstream *filePointer, size_t offset);
+    
 public:
+    // Meshes are read from the mapped file when it is the one behind the stream
+    static void setSourceFile(MappedFile* file);
+    
     static void writeMeshData(ofstream *filePointer, Mesh* mesh);
     static void writeSkinMeshData(ofstream *filePointer, SkinMesh* skinnedMesh, shared_ptr< AnimatedMeshNode > aNode);
     
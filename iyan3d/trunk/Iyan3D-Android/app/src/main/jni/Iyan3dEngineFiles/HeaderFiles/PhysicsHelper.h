@@ -17,6 +17,13 @@
 
 #include "btBulletDynamicsCommon.h"
 #include "SGNode.h"
+#include "../../SGEngine2/Utilities/VertexWelder.h"
+
+#define PHYSICS_CACHE_VERSION 1
+#define PHYSICS_CACHE_EXTENSION ".sgp"
+#define PHYSICS_TRANSFORM_FLOATS 7
+#define PHYSICS_BOUNDS_FLOATS 6
+#define SOFT_BODY_WELD_EPSILON 0.0
 
 struct PhysicsReference {
     void* nodeReference;
@@ -24,9 +31,20 @@ struct PhysicsReference {
     int jointIndex;
 };
 
+// Results of one simulated frame: position and rotation of every rigid body
+// followed by every soft body, then soft body node positions quantized to
+// 16 bits inside each body's bounds (min and step per axis)
+struct PhysicsCacheFrame {
+    vector<float> transforms;
+    vector<float> bounds;
+    vector<u16> positions;
+};
+
 class PhysicsHelper
 {
-    int previousFrame;
+    int previousFrame, simulatedFrame;
+    uint64_t stateSignature, meshSignature;
+    vector < PhysicsCacheFrame > cachedFrames;
     
     btSoftBodyWorldInfo  m_softBodyWorldInfo;
     btBroadphaseInterface* broadphase;
@@ -39,6 +57,12 @@ class PhysicsHelper
     vector < btSoftBody* > sBodies;
     vector < btTypedConstraint* > constraints;
 
+    uint64_t getSceneSignature(bool includeMeshes);
+    void clearCache();
+    void cacheFrame();
+    void applyCachedFrame(int frame);
+    void resetMeshCache(SGNode* sgNode);
+
 public:
     
     PhysicsHelper(void *scene);
@@ -46,7 +70,11 @@ public:
     void syncPhysicsWorld();
     void calculateAndSetPropsOfObject(SGNode* sgNode, int pType);
     void updatePhysicsUpToFrame(int frame);
-    void updateMeshCache(SGNode* sgNode);
+    void updateMeshCache(SGNode* sgNode, const u16* positions, const float* bounds);
+    int getCachedFrameCount();
+    bool writeCache(string filePath);
+    bool readCache(string filePath);
+    static string getCachePath(string sceneFilePath);
     btCollisionShape* getShapeForNode(SGNode* sgNode);
     
     void addRigidBody(SGNode* sgNode, btDiscreteDynamicsWorld* world, vector < btRigidBody* > &rBodies);
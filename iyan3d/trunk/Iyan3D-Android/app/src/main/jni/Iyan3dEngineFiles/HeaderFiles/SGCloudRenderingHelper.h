@@ -18,19 +18,29 @@
 //#include "ShaderManager.h"
 //#include "SGRotationKey.h"
 #include "SGEditorScene.h"
+#include "SGFrameData.h"
 #include "../../SGEngine2/Utilities/Logger.h"
+#include "../../SGEngine2/Utilities/WorkerPool.h"
 
-struct TriangleData
+struct SGFDNodeData
 {
-    Vector3 Pos1;
-    Vector3 Pos2;
-    Vector3 Pos3;
-    Vector3 Normal1;
-    Vector3 Normal2;
-    Vector3 Normal3;
-    Vector2 UV1;
-    Vector2 UV2;
-    Vector2 UV3;
+    SGFDNodeEntry entry;
+    SGFDMaterial material;
+    vector<float> positions;
+    vector<float> normals;
+    vector<float> uvs;
+    vector<unsigned int> indices;
+};
+
+// Skinned vertices of the last exported frame for one node, reused while
+// the source vertices, the model matrix and every joint matrix are unchanged
+struct SGSkinningCache
+{
+    int frameId;
+    uint64_t signature;
+    Mat4 model;
+    vector<Mat4> jointPalette;
+    vector<vertexData> vertices;
 };
 
 
@@ -41,12 +51,24 @@ class SGCloudRenderingHelper
 public:
     SGCloudRenderingHelper();
     static bool writeFrameData(SGEditorScene *scene , SceneManager *smgr, int frameId);
-    void writeNodeData(SGEditorScene *scene, int nodeId, int frameId, ofstream *frameFilePtr, int particleIndex = 0, Vector4 pColor = Vector4(1.0));
-    vector<TriangleData> calculateTriangleDataForNode(SGNode * sgNode);
-    vector<TriangleData> calculateTriangleDataForParticleNode(SGNode *sgNode, int index);
-    vertexData calculateFinalVertexData(shared_ptr<Node> node , void * vertex);
+    static void writeNodeData(ofstream *frameFilePtr, SGFDNodeData &nodeData);
+    void collectNodeData(SGEditorScene *scene, int nodeId, int frameId, vector<SGFDNodeData> &nodesData, int particleIndex = 0, Vector4 pColor = Vector4(1.0));
+    void setNodeGeometry(SGFDNodeData &nodeData, vector<vertexData> &verticesData, vector<unsigned int> &indices);
+    void calculateVertexDataForNode(SGNode * sgNode, vector<vertexData> &verticesData, vector<unsigned int> &indices);
+    void calculateVertexDataForParticleNode(SGNode *sgNode, int index, vector<vertexData> &verticesData, vector<unsigned int> &indices);
+    static vector<Mat4> calculateJointPalette(SkinMesh *sMesh);
+    static void transformVertices(Mesh *mesh, const Mat4 &model, const vector<Mat4> &jointPalette, vector<vertexData> &verticesData);
+    static void transformVertexRange(Mesh *mesh, const Mat4 &model, const vector<Mat4> &jointPalette, vector<vertexData> &verticesData, unsigned int start, unsigned int end);
+    static vertexData calculateFinalVertexData(Mesh *mesh, void * vertex, const Mat4 &model, const vector<Mat4> &jointPalette);
     vertexData calculateFinalVertexDataForParticle(shared_ptr<Node> node , void * vertex, int index, Vector4 position, Vector4 rotation);
-    void calculateJointTransforms(vertexDataHeavy *vertex , vector<Mat4> jointTransforms , Vector3 &position , Vector3 &normal);
+    static void calculateJointTransforms(vertexDataHeavy *vertex , const vector<Mat4> &jointTransforms , Vector3 &position , Vector3 &normal);
+    static uint64_t getMeshSignature(Mesh *mesh);
+    static void clearSkinningCache(int frameId = -1);
+    
+private:
+    static map<int, SGSkinningCache> skinningCache;
+    static SGEditorScene* skinningScene;
+    static int currentFrameId;
     void copyMat(float* pointer,Mat4& mat);
 };
 
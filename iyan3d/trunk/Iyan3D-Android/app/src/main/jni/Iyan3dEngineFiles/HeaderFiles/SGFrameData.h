@@ -0,0 +1,121 @@
+//
+//  SGFrameData.h
+//  Iyan3D
+//
+//  Layout of the .sgfd frame files sent to the cloud renderer. Shared by
+//  SGCloudRenderingHelper (writer) and the SGRenderer server (reader), so
+//  it only depends on the C standard headers.
+//
+//  Copyright (c) 2015 Smackall Games. All rights reserved.
+//
+
+#ifndef Iyan3D_SGFrameData_h
+#define Iyan3D_SGFrameData_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SGFD_MAGIC 0x44464753 // "SGFD"
+#define SGFD_VERSION 3
+#define SGFD_ALIGNMENT 16
+#define SGFD_TEXTURE_NAME_LENGTH 128
+
+// File layout, all values little endian:
+//   SGFDHeader
+//   SGFDNodeEntry[nodeCount]
+//   per node, at SGFDNodeEntry::offset:
+//     SGFDMaterial
+//     float positions[vertexCount][4]
+//     uint32_t indices[indexCount]
+//     float normals[vertexCount][3]
+//     float uvs[vertexCount][2]
+// Every block starts on an SGFD_ALIGNMENT boundary, see getSGFDNodeLayout.
+// Positions and normals are stored in renderer space (x mirrored) so the
+// reader can hand the mapped arrays to the ray tracer without copying.
+// Camera values are stored as the editor reports them.
+
+enum SGFDNodeFlags {
+    SGFD_NODE_HAS_TEXTURE = 1,
+    SGFD_NODE_HAS_LIGHTING = 2,
+    SGFD_NODE_SMOOTH_TEXTURE = 4
+};
+
+struct SGFDHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t frameId;
+    int32_t nodeCount;
+    float cameraPosition[3];
+    float cameraTarget[3];
+    float cameraRotation[3];
+    float cameraFov;
+    uint32_t reserved[2];
+};
+
+struct SGFDNodeEntry {
+    uint64_t offset;
+    uint64_t geometryHash;
+    int32_t vertexCount;
+    int32_t indexCount;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct SGFDMaterial {
+    float emission;
+    int32_t lightType;
+    float emissionColor[3];
+    float shadowDarkness;
+    float diffuse[3];
+    float lightDirection[3];
+    float reflection;
+    float refraction;
+    float transparency;
+    char textureName[SGFD_TEXTURE_NAME_LENGTH];
+};
+
+struct SGFDNodeLayout {
+    uint64_t positions;
+    uint64_t indices;
+    uint64_t normals;
+    uint64_t uvs;
+    uint64_t size;
+};
+
+inline uint64_t alignSGFD(uint64_t size)
+{
+    return (size + SGFD_ALIGNMENT - 1) & ~(uint64_t)(SGFD_ALIGNMENT - 1);
+}
+
+inline uint64_t getSGFDNodeTableEnd(int nodeCount)
+{
+    return alignSGFD(sizeof(SGFDHeader) + nodeCount * sizeof(SGFDNodeEntry));
+}
+
+// Offsets are relative to SGFDNodeEntry::offset.
+inline SGFDNodeLayout getSGFDNodeLayout(int vertexCount, int indexCount)
+{
+    SGFDNodeLayout layout;
+    layout.positions = alignSGFD(sizeof(SGFDMaterial));
+    layout.indices = alignSGFD(layout.positions + (uint64_t)vertexCount * 4 * sizeof(float));
+    layout.normals = alignSGFD(layout.indices + (uint64_t)indexCount * sizeof(uint32_t));
+    layout.uvs = alignSGFD(layout.normals + (uint64_t)vertexCount * 3 * sizeof(float));
+    layout.size = alignSGFD(layout.uvs + (uint64_t)vertexCount * 2 * sizeof(float));
+    return layout;
+}
+
+// 64 bit FNV-1a, chained over the geometry arrays of a node so a reader can
+// tell whether a mesh changed since the frame it already has loaded. The
+// reader skips the update on a match, 64 bits keep that from happening by
+// accident on long animations.
+inline uint64_t getSGFDHash(const void* data, size_t size, uint64_t hash = 14695981039346656037ull)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+#endif
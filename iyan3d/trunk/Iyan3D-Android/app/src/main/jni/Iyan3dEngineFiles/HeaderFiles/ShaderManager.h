@@ -18,6 +18,12 @@
 // Functio Name Should be Shader Material Name With Parameter of the Node Index in SMGR.
 
 class ShaderManager {
+private:
+    int uniformNodeIndex;
+    vector<float> jointData;
+    
+    int getNodeIndex(SGNode *sgNode);
+    
 public:
     Mat4 ortho2d_oc(float left,float right,float bottom,float top,float near,float far);
     static bool isRenderingDepthPass,isRendering , renderingPreview, sceneLighting;
@@ -64,7 +70,7 @@ public:
     void setUVScaleValue(SGNode *sgNode, u16 paramIndex, int materialIndex);
     void setModelMatrix(SGNode *node, u16 paramIndex);
     void setProjectionMatrix(SGNode *node, u16 paramIndex);
-    void setTextureForNode(SGNode* sgNode, Texture* texture, string textureName, int paramIndex, int userValue, int materialIndex, bool smoothTexture);
+    void setTextureForNode(SGNode* sgNode, Texture* texture, u16 textureUniform, int paramIndex, int userValue, int materialIndex, bool smoothTexture);
     void setLightViewProjMatrix(SGNode *node, u16 paramIndex);
     void setVertexColorUniforms(SGNode *node, u16 paramIndex);
     void setTexturesUniforms(SGNode *node, u16 paramIndex, int materialIndex);
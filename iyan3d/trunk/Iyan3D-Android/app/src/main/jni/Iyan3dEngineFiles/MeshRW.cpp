@@ -9,6 +9,13 @@
 #include "MeshRW.h"
 #include "FileHelper.h"
 
+MappedFile* MeshRW::sourceFile = NULL;
+
+void MeshRW::setSourceFile(MappedFile* file)
+{
+    sourceFile = file;
+}
+
 void MeshRW::writeMeshData(ofstream *filePointer, Mesh *mesh)
 {
     int meshBufferCount = mesh->getMeshBufferCount();
@@ -18,7 +25,6 @@ void MeshRW::writeMeshData(ofstream *filePointer, Mesh *mesh)
     for(int i = 0; i < meshBufferCount; i++) {
         
         vector< vertexData > vertices = mesh->getLiteVerticesArray(i);
-        unsigned short* indices = mesh->getIndicesArray(i);
         int verticesCount = (int)vertices.size();
         unsigned int indicesCount = mesh->getIndicesCount(i);
         
@@ -39,7 +45,7 @@ void MeshRW::writeMeshData(ofstream *filePointer, Mesh *mesh)
         FileHelper::writeUnsignedInt(filePointer, indicesCount);
         
         for(unsigned int j = 0; j < indicesCount; j++) {
-            FileHelper::writeInt(filePointer, indices[j]);
+            FileHelper::writeInt(filePointer, mesh->getIndex(i, j));
         }
     }
 }
@@ -53,7 +59,7 @@ void MeshRW::writeSkinMeshData(ofstream *filePointer, SkinMesh* skinnedMesh, sha
     for(int i = 0; i < meshBufferCount; i++) {
         
         vector< vertexDataHeavy > vertices = skinnedMesh->getHeavyVerticesArray(i);
-        vector< unsigned short > indicesArr = skinnedMesh->getIndicesArrayAtMeshBufferIndex(i);
+        unsigned int indicesCount = skinnedMesh->getIndicesCount(i);
         int verticesCount = (int)vertices.size();
                 
         FileHelper::writeInt(filePointer, skinnedMesh->getMeshBufferMaterialIndices(i));
@@ -74,10 +80,10 @@ void MeshRW::writeSkinMeshData(ofstream *filePointer, SkinMesh* skinnedMesh, sha
             FileHelper::writeVector4(filePointer, v.optionalData4);
         }
         
-        FileHelper::writeUnsignedInt(filePointer, indicesArr.size());
+        FileHelper::writeUnsignedInt(filePointer, indicesCount);
         
-        for(unsigned int j = 0; j < indicesArr.size(); j++) {
-            FileHelper::writeInt(filePointer, indicesArr[j]);
+        for(unsigned int j = 0; j < indicesCount; j++) {
+            FileHelper::writeInt(filePointer, skinnedMesh->getIndex(i, j));
         }
     }
     
@@ -95,10 +101,10 @@ void MeshRW::writeSkinMeshData(ofstream *filePointer, SkinMesh* skinnedMesh, sha
         for(int k = 0; k < 16; k ++)
             FileHelper::writeFloat(filePointer, origMatrix[k]);
         
-        unsigned short boneWeightCount = (*skinnedMesh->joints)[j]->PaintedVertices->size();
+        unsigned int boneWeightCount = (unsigned int)(*skinnedMesh->joints)[j]->PaintedVertices->size();
         FileHelper::writeInt(filePointer, boneWeightCount);
         
-        for(int w = 0; w < boneWeightCount; w++) {
+        for(unsigned int w = 0; w < boneWeightCount; w++) {
             unsigned int vertexIndex = (*(*skinnedMesh->joints)[j]->PaintedVertices)[w]->vertexId;
             unsigned short strength = (*(*skinnedMesh->joints)[j]->PaintedVertices)[w]->weight * 255.0;
             unsigned short meshBufferIndex = (*(*skinnedMesh->joints)[j]->PaintedVertices)[w]->meshBufferIndex;
@@ -116,8 +122,121 @@ void MeshRW::writeSkinMeshData(ofstream *filePointer, SkinMesh* skinnedMesh, sha
     }
 }
 
+template <typename VertexType>
+static bool readMappedMeshBuffers(MappedFile* file, size_t &offset, Mesh* mesh, size_t vertexSize)
+{
+    int meshBufferCount;
+    if(sizeof(VertexType) != vertexSize || !file->read(offset, &meshBufferCount, sizeof(int)) || meshBufferCount < 0)
+        return false;
+    
+    for(int i = 0; i < meshBufferCount; i++) {
+        int materialIndex, verticesCount;
+        unsigned int indicesCount;
+        if(!file->read(offset, &materialIndex, sizeof(int)) || !file->read(offset, &verticesCount, sizeof(int)) || verticesCount < 0)
+            return false;
+        
+        // Vertex records match the in memory layout, so the block is copied as a whole
+        vector<VertexType> mbvd(verticesCount);
+        if(verticesCount > 0 && !file->read(offset, mbvd.data(), verticesCount * vertexSize))
+            return false;
+        
+        // Indices are stored as 32 bit ints, the mesh narrows them when the buffer fits 16 bits
+        if(!file->read(offset, &indicesCount, sizeof(unsigned int)))
+            return false;
+        vector<unsigned int> mbi(indicesCount);
+        if(indicesCount > 0 && !file->read(offset, mbi.data(), (size_t)indicesCount * sizeof(int)))
+            return false;
+        
+        mesh->addMeshBuffer(std::move(mbvd), std::move(mbi), materialIndex);
+    }
+    return true;
+}
+
+void MeshRW::skipTo(ifstream *filePointer, size_t offset)
+{
+    FileHelper::seekPosition += (int)(offset - (size_t)filePointer->tellg());
+    filePointer->seekg(offset);
+}
+
+Mesh* MeshRW::readMappedMeshData(size_t &offset)
+{
+    Mesh* mesh = new Mesh();
+    if(!readMappedMeshBuffers<vertexData>(sourceFile, offset, mesh, MESH_LITE_VERTEX_SIZE)) {
+        delete mesh;
+        return NULL;
+    }
+    return mesh;
+}
+
+Mesh* MeshRW::readMappedSkinMeshData(size_t &offset)
+{
+    SkinMesh* mesh = new SkinMesh();
+    mesh->meshType = MESH_TYPE_HEAVY;
+    
+    int boneCount = 0;
+    bool status = readMappedMeshBuffers<vertexDataHeavy>(sourceFile, offset, mesh, MESH_HEAVY_VERTEX_SIZE);
+    status = status && sourceFile->read(offset, &boneCount, sizeof(int));
+    
+    for(int i = 0; status && i < boneCount; i++) {
+        int boneParentId, boneWeightCount;
+        float boneMatrix[16];
+        status = sourceFile->read(offset, &boneParentId, sizeof(int)) && boneParentId < i &&
+            sourceFile->read(offset, boneMatrix, sizeof(boneMatrix)) && sourceFile->read(offset, &boneWeightCount, sizeof(int));
+        
+        // Each weight is a vertex index, a strength and a mesh buffer index
+        const size_t weightSize = 2 * sizeof(int) + sizeof(short);
+        const unsigned char* weights = status ? sourceFile->getRange(offset, (size_t)max(boneWeightCount, 0) * weightSize) : NULL;
+        if(!weights) {
+            status = false;
+            break;
+        }
+        offset += (size_t)max(boneWeightCount, 0) * weightSize;
+        
+        Joint* ibone = mesh->addJoint((boneParentId >= 0) ? (*mesh->joints)[boneParentId] : NULL);
+        ibone->LocalAnimatedMatrix = Mat4(boneMatrix);
+        ibone->originalJointMatrix = ibone->LocalAnimatedMatrix;
+        
+        for(int j = 0; j < boneWeightCount; j++) {
+            int vertexIndex, vertWeight;
+            short meshBufferIndex;
+            const unsigned char* weight = weights + j * weightSize;
+            memcpy(&vertexIndex, weight, sizeof(int));
+            memcpy(&vertWeight, weight + sizeof(int), sizeof(int));
+            memcpy(&meshBufferIndex, weight + 2 * sizeof(int), sizeof(short));
+            
+            shared_ptr<PaintedVertex> PaintedVertexInfo = make_shared<PaintedVertex>();
+            PaintedVertexInfo->vertexId = vertexIndex;
+            PaintedVertexInfo->weight = ((float)vertWeight) / 255.0f;
+            PaintedVertexInfo->meshBufferIndex = meshBufferIndex;
+            ibone->PaintedVertices->push_back(PaintedVertexInfo);
+        }
+        
+        float radii[2];
+        status = sourceFile->read(offset, radii, sizeof(radii));
+        ibone->envelopeRadius = radii[0];
+        ibone->sphereRadius = radii[1];
+    }
+    
+    if(!status) {
+        delete mesh;
+        return NULL;
+    }
+    
+    mesh->finalize();
+    return mesh;
+}
+
 Mesh* MeshRW::readMeshData(ifstream* filePointer)
 {
+    if(sourceFile) {
+        size_t offset = (size_t)filePointer->tellg();
+        Mesh* mesh = readMappedMeshData(offset);
+        if(mesh) {
+            skipTo(filePointer, offset);
+            return mesh;
+        }
+    }
+    
     Mesh* mesh = new Mesh();
     
     int meshBufferCount = FileHelper::readInt(filePointer);
@@ -125,7 +244,7 @@ Mesh* MeshRW::readMeshData(ifstream* filePointer)
     for(int i = 0; i < meshBufferCount; i++) {
         
         vector<vertexData> mbvd;
-        vector<unsigned short> mbi;
+        vector<unsigned int> mbi;
         
         int materialIndex = FileHelper::readInt(filePointer);
         int verticesCount = FileHelper::readInt(filePointer);
@@ -144,7 +263,7 @@ Mesh* MeshRW::readMeshData(ifstream* filePointer)
         unsigned int indicesCount = FileHelper::readUnsignedInt(filePointer);
 
         for(unsigned int j = 0; j < indicesCount; j++) {
-            unsigned short index = FileHelper::readInt(filePointer);
+            unsigned int index = FileHelper::readInt(filePointer);
             mbi.push_back(index);
         }
         
@@ -156,6 +275,14 @@ Mesh* MeshRW::readMeshData(ifstream* filePointer)
 
 Mesh* MeshRW::readSkinMeshData(ifstream *filePointer)
 {
+    if(sourceFile) {
+        size_t offset = (size_t)filePointer->tellg();
+        Mesh* mesh = readMappedSkinMeshData(offset);
+        if(mesh) {
+            skipTo(filePointer, offset);
+            return mesh;
+        }
+    }
     
     SkinMesh* mesh = new SkinMesh();
     mesh->meshType = MESH_TYPE_HEAVY;
@@ -165,7 +292,7 @@ Mesh* MeshRW::readSkinMeshData(ifstream *filePointer)
     for(int i = 0; i < meshBufferCount; i++) {
         
         vector<vertexDataHeavy> mbvd;
-        vector<unsigned short> mbi;
+        vector<unsigned int> mbi;
 
         int materialIndex = FileHelper::readInt(filePointer);
         int verticesCount = FileHelper::readInt(filePointer);
@@ -189,7 +316,7 @@ Mesh* MeshRW::readSkinMeshData(ifstream *filePointer)
         unsigned int indicesCount = FileHelper::readUnsignedInt(filePointer);
         
         for(unsigned int j = 0; j < indicesCount; j++) {
-            unsigned short index = FileHelper::readInt(filePointer);
+            unsigned int index = FileHelper::readInt(filePointer);
             mbi.push_back(index);
         }
         
@@ -8,13 +8,15 @@
 
 #include "HeaderFiles/PhysicsHelper.h"
 #include "HeaderFiles/SGEditorScene.h"
+#include <zlib.h>
 
 
 SGEditorScene *scene;
 
 PhysicsHelper::PhysicsHelper(void *currentScene)
 {
-    previousFrame = 0;
+    previousFrame = simulatedFrame = 0;
+    stateSignature = meshSignature = 0;
     scene = (SGEditorScene*)currentScene;
     
     btVector3 worldAabbMin(-10000,-10000,-10000);
@@ -133,75 +135,213 @@ void PhysicsHelper::syncPhysicsWorld()
                 addRigidBody(scene->nodes[i], world, rBodies);
             } else {
                 addSoftBody(scene->nodes[i], world, sBodies);
-                if(dynamic_pointer_cast<MeshNode>(scene->nodes[i]->node)->meshCache) {
-                    delete dynamic_pointer_cast<MeshNode>(scene->nodes[i]->node)->meshCache;
-                    dynamic_pointer_cast<MeshNode>(scene->nodes[i]->node)->meshCache = NULL;
-                    scene->nodes[i]->node->memtype = NODE_GPUMEM_TYPE_STATIC;
-                }
-                scene->nodes[i]->node->shouldUpdateMesh = true;
+                resetMeshCache(scene->nodes[i]);
             }
         }
     }
+    
+    // The world starts over from frame 0, cached frames stay valid until the physics inputs change
+    simulatedFrame = 0;
+    stateSignature = getSceneSignature(false);
+    uint64_t signature = getSceneSignature(true);
+    if(signature != meshSignature) {
+        clearCache();
+        meshSignature = signature;
+    }
+}
+
+void PhysicsHelper::resetMeshCache(SGNode* sgNode)
+{
+    shared_ptr<MeshNode> n = dynamic_pointer_cast<MeshNode>(sgNode->node);
+    if(n->meshCache) {
+        delete n->meshCache;
+        n->meshCache = NULL;
+        sgNode->node->memtype = NODE_GPUMEM_TYPE_STATIC;
+    }
+    sgNode->node->shouldUpdateMesh = true;
+}
+
+static uint64_t hashPhysicsData(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return hash;
+}
+
+uint64_t PhysicsHelper::getSceneSignature(bool includeMeshes)
+{
+    uint64_t hash = 14695981039346656037ull;
+    
+    for (int i = 2; i < scene->nodes.size(); i++) {
+        SGNode* sgNode = scene->nodes[i];
+        if(!sgNode->getProperty(HAS_PHYSICS).value.x)
+            continue;
+        
+        std::map<PROP_INDEX, Property> physicsProps = sgNode->getProperty(HAS_PHYSICS).subProps;
+        ActionKey key = sgNode->getKeyForFrame(0);
+        Vector4 fDir = physicsProps[FORCE_DIRECTION].value;
+        float values[] = { key.position.x, key.position.y, key.position.z,
+            key.rotation.x, key.rotation.y, key.rotation.z, key.rotation.w,
+            key.scale.x, key.scale.y, key.scale.z,
+            physicsProps[WEIGHT].value.x, physicsProps[PHYSICS_KIND].value.x, physicsProps[IS_SOFT].value.x,
+            physicsProps[FORCE_MAGNITUDE].value.x, fDir.x, fDir.y, fDir.z };
+        int ids[] = { i, sgNode->assetId, (int)sgNode->joints.size() };
+        hash = hashPhysicsData(hash, values, sizeof(values));
+        hash = hashPhysicsData(hash, ids, sizeof(ids));
+        
+        shared_ptr<MeshNode> n = dynamic_pointer_cast<MeshNode>(sgNode->node);
+        if(!includeMeshes || !n || !n->mesh)
+            continue;
+        
+        Mesh* mesh = n->mesh;
+        for (int mbi = 0; mbi < mesh->getMeshBufferCount(); mbi++) {
+            int counts[] = { (int)mesh->getVerticesCountInMeshBuffer(mbi), (int)mesh->getIndicesCount(mbi) };
+            hash = hashPhysicsData(hash, counts, sizeof(counts));
+            for (int v = 0; v < counts[0]; v++) {
+                Vector3 vpos;
+                if(mesh->meshType == MESH_TYPE_LITE)
+                    vpos = mesh->getLiteVerticesForMeshBuffer(mbi, v)->vertPosition;
+                else
+                    vpos = mesh->getHeavyVerticesForMeshBuffer(mbi, v)->vertPosition;
+                float position[] = { vpos.x, vpos.y, vpos.z };
+                hash = hashPhysicsData(hash, position, sizeof(position));
+            }
+            hash = hashPhysicsData(hash, mesh->getIndicesData(mbi), counts[1] * mesh->getIndexSize(mbi));
+        }
+    }
+    return hash;
+}
+
+void PhysicsHelper::clearCache()
+{
+    cachedFrames.clear();
+}
+
+int PhysicsHelper::getCachedFrameCount()
+{
+    return (int)cachedFrames.size();
 }
 
 void PhysicsHelper::updatePhysicsUpToFrame(int frame)
 {
+    if(rBodies.size() == 0 && sBodies.size() == 0)
+        return;
+    
+    // Frame 0 keys are only edited while the scene sits at frame 0, so the inputs are
+    // rehashed once when a bake leaves it or seeks back, not for every played frame
+    bool bakeStarts = (previousFrame == 0 || frame <= previousFrame);
+    previousFrame = frame;
+    if(bakeStarts && getSceneSignature(false) != stateSignature)
+        syncPhysicsWorld();
     
-    if(rBodies.size() > 0 || sBodies.size() > 0) {
-        if(frame < previousFrame) {
-            previousFrame = 0;
-            syncPhysicsWorld();
+    // Frames already simulated are replayed from the cache, the world only steps past the last cached frame
+    if(frame > (int)cachedFrames.size()) {
+        for(int i = simulatedFrame + 1; i <= frame; i++) {
+            world->stepSimulation(1.0/24.0, 10.0, 1.0/60.0);
+            if(i > (int)cachedFrames.size())
+                cacheFrame();
         }
+        simulatedFrame = frame;
+    }
+    
+    if(frame > 0) {
+        applyCachedFrame(frame);
+    } else {
+        for(int k = 0; k < sBodies.size(); k++) {
+            PhysicsReference* pr = (PhysicsReference*)sBodies[k]->getUserPointer();
+            resetMeshCache((SGNode*)pr->nodeReference);
+        }
+    }
+}
+
+void PhysicsHelper::cacheFrame()
+{
+    PhysicsCacheFrame cached;
+    int bodyCount = (int)(rBodies.size() + sBodies.size());
+    cached.transforms.reserve(bodyCount * PHYSICS_TRANSFORM_FLOATS);
+    cached.bounds.reserve(sBodies.size() * PHYSICS_BOUNDS_FLOATS);
+    
+    for(int j = 0; j < bodyCount; j++) {
+        btCollisionObject* body = (j < rBodies.size()) ? (btCollisionObject*)rBodies[j] : (btCollisionObject*)sBodies[j - rBodies.size()];
+        btTransform transform = body->getWorldTransform();
+        btVector3 p = transform.getOrigin();
+        btQuaternion r = transform.getRotation();
+        float values[PHYSICS_TRANSFORM_FLOATS] = { (float)p.x(), (float)p.y(), (float)p.z(), (float)r.x(), (float)r.y(), (float)r.z(), (float)r.w() };
+        cached.transforms.insert(cached.transforms.end(), values, values + PHYSICS_TRANSFORM_FLOATS);
+    }
+    
+    for(int k = 0; k < sBodies.size(); k++) {
+        PhysicsReference* pr = (PhysicsReference*)sBodies[k]->getUserPointer();
+        shared_ptr<MeshNode> n = dynamic_pointer_cast<MeshNode>(((SGNode*)pr->nodeReference)->node);
         
-        for(int i = previousFrame+1; i <= frame; i++) {
-            world->stepSimulation(1.0/24.0, 10.0, 1.0/60.0);
+        btVector3 bMin(0.0, 0.0, 0.0), bMax(0.0, 0.0, 0.0);
+        for(std::map<int, btSoftBody::Node*>::iterator it = n->m_vertices.begin(); it != n->m_vertices.end(); it++) {
+            if(it == n->m_vertices.begin()) {
+                bMin = bMax = it->second->m_x;
+            } else {
+                bMin.setMin(it->second->m_x);
+                bMax.setMax(it->second->m_x);
+            }
         }
         
-        if(frame > 0) {
-            for(int j = 0; j < rBodies.size(); j++) {
-                btTransform transform = rBodies[j]->getWorldTransform();
-                btVector3 p = transform.getOrigin();
-                btQuaternion r = transform.getRotation();
-                Vector3 nodePos = Vector3(p.x(), p.y(), p.z());
-                Quaternion nodeRot = Quaternion(r.x(), r.y(), r.z(), r.w());
-                
-                PhysicsReference* pr = (PhysicsReference*)rBodies[j]->getUserPointer();
-                SGNode* sgNode = (SGNode*)pr->nodeReference;
-
-                if(!pr->isJoint) {
-                    sgNode->setPosition(nodePos, frame);
-                    sgNode->setRotation(nodeRot, frame);
-                    sgNode->setScale(sgNode->scaleKeys[0].scale, frame);
-                } else {
-                    sgNode->joints[pr->jointIndex]->removeAnimationInCurrentFrame(frame);
-                    shared_ptr<JointNode> parent = dynamic_pointer_cast<JointNode>(sgNode->joints[pr->jointIndex]->jointNode->getParent());
-                    if(parent)
-                        sgNode->CCD(sgNode->joints[pr->jointIndex]->jointNode, nodePos, 0, frame);
-                    else
-                        sgNode->setPosition(nodePos, frame);
-                }
+        btVector3 step = (bMax - bMin) / 65535.0;
+        float bounds[PHYSICS_BOUNDS_FLOATS] = { (float)bMin.x(), (float)bMin.y(), (float)bMin.z(), (float)step.x(), (float)step.y(), (float)step.z() };
+        cached.bounds.insert(cached.bounds.end(), bounds, bounds + PHYSICS_BOUNDS_FLOATS);
+        
+        for(std::map<int, btSoftBody::Node*>::iterator it = n->m_vertices.begin(); it != n->m_vertices.end(); it++) {
+            for(int a = 0; a < 3; a++) {
+                float q = (bounds[3 + a] > 0.0) ? (it->second->m_x[a] - bounds[a]) / bounds[3 + a] + 0.5 : 0.0;
+                cached.positions.push_back((u16)max(0.0f, min(q, 65535.0f)));
             }
-            
-            for(int k = 0; k < sBodies.size(); k++) {
-                btTransform transform = sBodies[k]->getWorldTransform();
-                btVector3 p = transform.getOrigin();
-                btQuaternion r = transform.getRotation();
-                Vector3 nodePos = Vector3(p.x(), p.y(), p.z());
-                Quaternion nodeRot = Quaternion(r.x(), r.y(), r.z(), r.w());
-                
-                PhysicsReference* pr = (PhysicsReference*)sBodies[k]->getUserPointer();
-                SGNode* sgNode = (SGNode*)pr->nodeReference;
+        }
+    }
+    cachedFrames.push_back(cached);
+}
+
+void PhysicsHelper::applyCachedFrame(int frame)
+{
+    PhysicsCacheFrame &cached = cachedFrames[frame - 1];
+    
+    for(int j = 0; j < rBodies.size(); j++) {
+        const float* t = cached.transforms.data() + j * PHYSICS_TRANSFORM_FLOATS;
+        Vector3 nodePos = Vector3(t[0], t[1], t[2]);
+        Quaternion nodeRot = Quaternion(t[3], t[4], t[5], t[6]);
+        
+        PhysicsReference* pr = (PhysicsReference*)rBodies[j]->getUserPointer();
+        SGNode* sgNode = (SGNode*)pr->nodeReference;
+        
+        if(!pr->isJoint) {
+            sgNode->setPosition(nodePos, frame);
+            sgNode->setRotation(nodeRot, frame);
+            sgNode->setScale(sgNode->scaleKeys[0].scale, frame);
+        } else {
+            sgNode->joints[pr->jointIndex]->removeAnimationInCurrentFrame(frame);
+            shared_ptr<JointNode> parent = dynamic_pointer_cast<JointNode>(sgNode->joints[pr->jointIndex]->jointNode->getParent());
+            if(parent)
+                sgNode->CCD(sgNode->joints[pr->jointIndex]->jointNode, nodePos, 0, frame);
+            else
                 sgNode->setPosition(nodePos, frame);
-                sgNode->setRotation(nodeRot, frame);
-                sgNode->setScale(Vector3(1.0), frame);
-                updateMeshCache(sgNode);
-            }
         }
-        previousFrame = frame;
+    }
+    
+    int positionOffset = 0;
+    for(int k = 0; k < sBodies.size(); k++) {
+        const float* t = cached.transforms.data() + (rBodies.size() + k) * PHYSICS_TRANSFORM_FLOATS;
+        Vector3 nodePos = Vector3(t[0], t[1], t[2]);
+        Quaternion nodeRot = Quaternion(t[3], t[4], t[5], t[6]);
+        
+        PhysicsReference* pr = (PhysicsReference*)sBodies[k]->getUserPointer();
+        SGNode* sgNode = (SGNode*)pr->nodeReference;
+        sgNode->setPosition(nodePos, frame);
+        sgNode->setRotation(nodeRot, frame);
+        sgNode->setScale(Vector3(1.0), frame);
+        updateMeshCache(sgNode, cached.positions.data() + positionOffset, cached.bounds.data() + k * PHYSICS_BOUNDS_FLOATS);
+        positionOffset += dynamic_pointer_cast<MeshNode>(sgNode->node)->m_vertices.size() * 3;
     }
 }
 
-void PhysicsHelper::updateMeshCache(SGNode* sgNode)
+void PhysicsHelper::updateMeshCache(SGNode* sgNode, const u16* positions, const float* bounds)
 {
     shared_ptr<MeshNode> n = dynamic_pointer_cast<MeshNode>(sgNode->node);
 
@@ -210,20 +350,143 @@ void PhysicsHelper::updateMeshCache(SGNode* sgNode)
         sgNode->node->memtype = NODE_GPUMEM_TYPE_DYNAMIC;
     }
 
+    int nodeCount = (int)n->m_vertices.size();
     for (int i = 0; i < n->meshCache->getVerticesCountInMeshBuffer(0); i++) {
+        std::map<int, int>::iterator it = n->MeshMap.find(i);
+        if(it == n->MeshMap.end() || it->second >= nodeCount)
+            continue;
+        
         vertexData *v = n->meshCache->getLiteVerticesForMeshBuffer(0, i);
-        int index = n->MeshMap.find(i)->second;
-        if(n->m_vertices.find(index) != n->m_vertices.end()) {
-            btSoftBody::Node* node = n->m_vertices.find(index)->second;
-            v->vertPosition.x = node->m_x.x();
-            v->vertPosition.y = node->m_x.y();
-            v->vertPosition.z = node->m_x.z();
-        }
+        const u16* p = positions + it->second * 3;
+        v->vertPosition.x = bounds[0] + p[0] * bounds[3];
+        v->vertPosition.y = bounds[1] + p[1] * bounds[4];
+        v->vertPosition.z = bounds[2] + p[2] * bounds[5];
     }
     
     sgNode->node->shouldUpdateMesh = true;
 }
 
+string PhysicsHelper::getCachePath(string sceneFilePath)
+{
+    size_t dot = sceneFilePath.find_last_of('.');
+    size_t slash = sceneFilePath.find_last_of('/');
+    if(dot == string::npos || (slash != string::npos && dot < slash))
+        return sceneFilePath + PHYSICS_CACHE_EXTENSION;
+    return sceneFilePath.substr(0, dot) + PHYSICS_CACHE_EXTENSION;
+}
+
+bool PhysicsHelper::writeCache(string filePath)
+{
+    if(cachedFrames.size() == 0) {
+        remove(filePath.c_str());
+        return false;
+    }
+    
+    // Positions are stored as deltas from the previous frame so slow moving bodies compress well
+    int positionCount = (int)cachedFrames[0].positions.size();
+    vector<Bytef> data;
+    vector<u16> deltas(positionCount);
+    for(int f = 0; f < cachedFrames.size(); f++) {
+        PhysicsCacheFrame &cached = cachedFrames[f];
+        for(int i = 0; i < positionCount; i++)
+            deltas[i] = cached.positions[i] - ((f > 0) ? cachedFrames[f - 1].positions[i] : 0);
+        
+        data.insert(data.end(), (Bytef*)cached.transforms.data(), (Bytef*)(cached.transforms.data() + cached.transforms.size()));
+        data.insert(data.end(), (Bytef*)cached.bounds.data(), (Bytef*)(cached.bounds.data() + cached.bounds.size()));
+        data.insert(data.end(), (Bytef*)deltas.data(), (Bytef*)(deltas.data() + deltas.size()));
+    }
+    
+    uLongf compressedSize = compressBound(data.size());
+    vector<Bytef> compressed(compressedSize);
+    if(compress2(compressed.data(), &compressedSize, data.data(), data.size(), Z_BEST_SPEED) != Z_OK) {
+        Logger::log(ERROR, "PhysicsHelper::writeCache", "Compressing physics cache failed");
+        return false;
+    }
+    
+    ofstream outputFile(filePath, ios::out | ios::binary);
+    if(!outputFile.is_open())
+        return false;
+    
+    FileHelper::writeInt(&outputFile, PHYSICS_CACHE_VERSION);
+    FileHelper::writeUnsignedInt(&outputFile, (unsigned int)(meshSignature >> 32));
+    FileHelper::writeUnsignedInt(&outputFile, (unsigned int)meshSignature);
+    FileHelper::writeInt(&outputFile, (int)rBodies.size());
+    FileHelper::writeInt(&outputFile, (int)sBodies.size());
+    FileHelper::writeInt(&outputFile, positionCount);
+    FileHelper::writeInt(&outputFile, (int)cachedFrames.size());
+    FileHelper::writeUnsignedInt(&outputFile, (unsigned int)data.size());
+    FileHelper::writeUnsignedInt(&outputFile, (unsigned int)compressedSize);
+    outputFile.write((char*)compressed.data(), compressedSize);
+    outputFile.close();
+    return true;
+}
+
+bool PhysicsHelper::readCache(string filePath)
+{
+    ifstream inputFile(filePath, ios::in | ios::binary);
+    if(!inputFile.is_open())
+        return false;
+    
+    if(FileHelper::readInt(&inputFile) != PHYSICS_CACHE_VERSION)
+        return false;
+    
+    uint64_t signature = (uint64_t)FileHelper::readUnsignedInt(&inputFile) << 32;
+    signature |= FileHelper::readUnsignedInt(&inputFile);
+    int rBodyCount = FileHelper::readInt(&inputFile);
+    int sBodyCount = FileHelper::readInt(&inputFile);
+    int positionCount = FileHelper::readInt(&inputFile);
+    int frameCount = FileHelper::readInt(&inputFile);
+    uLongf dataSize = FileHelper::readUnsignedInt(&inputFile);
+    uLong compressedSize = FileHelper::readUnsignedInt(&inputFile);
+    
+    int expectedPositions = 0;
+    for(int k = 0; k < sBodies.size(); k++) {
+        PhysicsReference* pr = (PhysicsReference*)sBodies[k]->getUserPointer();
+        expectedPositions += dynamic_pointer_cast<MeshNode>(((SGNode*)pr->nodeReference)->node)->m_vertices.size() * 3;
+    }
+    
+    // Baked results only apply to the scene they were simulated for
+    int transformCount = (rBodyCount + sBodyCount) * PHYSICS_TRANSFORM_FLOATS;
+    int boundsCount = sBodyCount * PHYSICS_BOUNDS_FLOATS;
+    size_t frameSize = (transformCount + boundsCount) * sizeof(float) + positionCount * sizeof(u16);
+    if(!inputFile || signature != meshSignature || rBodyCount != rBodies.size() || sBodyCount != sBodies.size() || positionCount != expectedPositions ||
+       frameCount <= (int)cachedFrames.size() || dataSize != frameSize * frameCount)
+        return false;
+    
+    vector<Bytef> compressed(compressedSize);
+    inputFile.read((char*)compressed.data(), compressedSize);
+    if(inputFile.gcount() != compressedSize)
+        return false;
+    inputFile.close();
+    
+    vector<Bytef> data(dataSize);
+    uLongf uncompressedSize = dataSize;
+    if(uncompress(data.data(), &uncompressedSize, compressed.data(), compressedSize) != Z_OK || uncompressedSize != dataSize) {
+        Logger::log(ERROR, "PhysicsHelper::readCache", "Corrupt physics cache " + filePath);
+        return false;
+    }
+    
+    vector<PhysicsCacheFrame> frames(frameCount);
+    const Bytef* read = data.data();
+    for(int f = 0; f < frameCount; f++) {
+        PhysicsCacheFrame &cached = frames[f];
+        cached.transforms.assign((const float*)read, (const float*)read + transformCount);
+        read += transformCount * sizeof(float);
+        cached.bounds.assign((const float*)read, (const float*)read + boundsCount);
+        read += boundsCount * sizeof(float);
+        cached.positions.assign((const u16*)read, (const u16*)read + positionCount);
+        read += positionCount * sizeof(u16);
+        
+        if(f > 0) {
+            for(int i = 0; i < positionCount; i++)
+                cached.positions[i] += frames[f - 1].positions[i];
+        }
+    }
+    
+    cachedFrames.swap(frames);
+    return true;
+}
+
 void PhysicsHelper::addRigidBody(SGNode* sgNode, btDiscreteDynamicsWorld* world, vector < btRigidBody* > &rBodies)
 {
     std::map<PROP_INDEX, Property> physicsProps = sgNode->getProperty(HAS_PHYSICS).subProps;
@@ -366,58 +629,28 @@ void PhysicsHelper::addSoftBody(SGNode* sgNode, btDiscreteDynamicsWorld* world,
     n->MeshMap.clear();
     n->m_vertices.clear();
 
-    std::map<int, int> index_map;
-    std::map<int, int> bullet_map;
-    std::map<int, Vector3> vertex_map;
-    int count = 0;
-
     int indicesCount = n->mesh->getIndicesCount(0);
-    unsigned short *indicesArray = n->mesh->getIndicesArray(0);
-   
     int vtxCount = n->mesh->getVerticesCountInMeshBuffer(0);
     vertexData *vertexArray = n->mesh->getLiteVerticesForMeshBuffer(0, 0);
     
-    for( int i = 0; i < indicesCount; i++) {
-        int iIndex = indicesArray[i];
-        Vector3 v1 = vertexArray[iIndex].vertPosition;
-        bool isFirst = true;
-        for (int j = 0; j < i; j++) {
-            int jIndex = indicesArray[j];
-            Vector3 v2 = vertexArray[jIndex].vertPosition;
-            
-            if(v1 == v2) {
-                index_map.insert(make_pair(i, j));
-                isFirst = false;
-                break;
-            }
-        }
-        
-        if(isFirst) {
-            index_map.insert(std::make_pair(i, i));
-            bullet_map.insert(std::make_pair(i, count));
-            Vector3 v3 = vertexArray[iIndex].vertPosition;
-            vertex_map.insert(std::make_pair(count, v3));
-            count++;
-        }
-    }
-
+    // Corners sharing a position become one Bullet node, numbered in order of first use
+    VertexWelder welder(SOFT_BODY_WELD_EPSILON, vtxCount);
     int *indices = new int[indicesCount];
-    for(int i = 0; i < indicesCount; i++) {
-        int index1 = index_map.find(i)->second;
-        int index2 = bullet_map.find(index1)->second;
-        indices[i]   = index2;
-    }
+    for(int i = 0; i < indicesCount; i++)
+        indices[i] = welder.add(vertexArray[n->mesh->getIndex(0, i)].vertPosition);
 
-    int vertexCount = (int)vertex_map.size();
+    int vertexCount = welder.size();
     btScalar *vertices = new btScalar[vertexCount*3];
     
     for(int i = 0; i < vertexCount; i++) {
-        vertices[3*i] =   vertex_map[i].x;
-        vertices[3*i+1] = vertex_map[i].y;
-        vertices[3*i+2] = vertex_map[i].z;
+        vertices[3*i] =   welder.positions[i].x;
+        vertices[3*i+1] = welder.positions[i].y;
+        vertices[3*i+2] = welder.positions[i].z;
     }
 
     btSoftBody* sBody = btSoftBodyHelpers::CreateFromTriMesh(m_softBodyWorldInfo, vertices, indices, indicesCount/3);
+    delete [] indices;
+    delete [] vertices;
 
     std::map<btSoftBody::Node*, int> node_map;
 
@@ -429,21 +662,17 @@ void PhysicsHelper::addSoftBody(SGNode* sgNode, btDiscreteDynamicsWorld* world,
                 node_map.insert(std::make_pair(face.m_n[j], node_map.size()));
     }
 
-    for(auto& node_iter : std::move(node_map))
+    vector<int> nodeIndices(sBody->m_nodes.size(), NOT_EXISTS);
+    for(auto& node_iter : node_map) {
         n->m_vertices.insert(std::make_pair(node_iter.second, node_iter.first));
+        nodeIndices[node_iter.first - &sBody->m_nodes[0]] = node_iter.second;
+    }
     
+    // Render vertices map to the node welded from their position, unused vertices find theirs the same way
     for(u32 i = 0; i < vtxCount; i++) {
-        for(auto& it : std::move(n->m_vertices)) {
-            int v_index = it.first;
-            auto node = it.second;
-            Vector3 v1 = vertexArray[i].vertPosition;
-            if(node->m_x.x() == v1.x &&
-               node->m_x.y() == v1.y &&
-               node->m_x.z() == v1.z) {
-                n->MeshMap.insert(std::make_pair(i, v_index));
-                break;
-            }
-        }
+        int welded = welder.find(vertexArray[i].vertPosition);
+        if(welded != NOT_EXISTS && nodeIndices[welded] != NOT_EXISTS)
+            n->MeshMap.insert(std::make_pair(i, nodeIndices[welded]));
     }
 
     ActionKey key = sgNode->getKeyForFrame(0);
@@ -502,9 +731,9 @@ btCollisionShape* PhysicsHelper::getShapeForNode(SGNode* sgNode)
         
         for (int mbi = 0; mbi < mesh->getMeshBufferCount(); mbi++) {
 
-            unsigned short* indices = mesh->getIndicesArray(mbi);
+            vector<unsigned int> indices = mesh->getIndices32ArrayAtMeshBufferIndex(mbi);
 
-            for (int i = 0; i < mesh->getIndicesCount(mbi); i += 3) {
+            for (int i = 0; i < indices.size(); i += 3) {
                 Vector3 vpos1, vpos2, vpos3;
                 
                 if(mesh->meshType == MESH_TYPE_LITE) {
@@ -9,6 +9,12 @@
 #include "../SGEngine2/Core/Nodes/ParticleManager.h"
 #include "HeaderFiles/SGCloudRenderingHelper.h"
 
+#define SKINNING_CHUNK_SIZE 4096
+
+map<int, SGSkinningCache> SGCloudRenderingHelper::skinningCache;
+SGEditorScene* SGCloudRenderingHelper::skinningScene = NULL;
+int SGCloudRenderingHelper::currentFrameId = -1;
+
 SGCloudRenderingHelper::SGCloudRenderingHelper()
 {
 
@@ -19,45 +25,43 @@ bool SGCloudRenderingHelper::writeFrameData(SGEditorScene *scene , SceneManager
     string outputFileName =  FileHelper::getDocumentsDirectory() + to_string(frameId) + ".sgfd";
     ofstream frameFilePtr(outputFileName , ios::binary);
     scene->renHelper->setRenderCameraOrientation();
+
+    SGFDHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SGFD_MAGIC;
+    header.version = SGFD_VERSION;
+    header.frameId = frameId;
+
     Vector3 camPos = scene->renderCamera->getAbsolutePosition();
+    header.cameraPosition[0] = camPos.x;
+    header.cameraPosition[1] = camPos.y;
+    header.cameraPosition[2] = camPos.z;
 
-    FileHelper::writeFloat(&frameFilePtr, camPos.x);
-    FileHelper::writeFloat(&frameFilePtr, camPos.y);
-    FileHelper::writeFloat(&frameFilePtr, camPos.z);
     Vector3 camTarget = scene->renderCamera->getTarget();
-    
-    FileHelper::writeFloat(&frameFilePtr, camTarget.x);
-    FileHelper::writeFloat(&frameFilePtr, camTarget.y);
-    FileHelper::writeFloat(&frameFilePtr, camTarget.z);
+    header.cameraTarget[0] = camTarget.x;
+    header.cameraTarget[1] = camTarget.y;
+    header.cameraTarget[2] = camTarget.z;
     
     Vector3 camRotation = Vector3();//scene->nodes[NODE_CAMERA]->node->getRotation();
     camRotation += 180.0f;
-    
-    FileHelper::writeFloat(&frameFilePtr, camRotation.x);
-    FileHelper::writeFloat(&frameFilePtr, camRotation.y);
-    FileHelper::writeFloat(&frameFilePtr, camRotation.z);
-    
-    FileHelper::writeFloat(&frameFilePtr, scene->nodes[NODE_CAMERA]->getProperty(FOV).value.x);  // Camera FOV
-
-    short nodesCount = (short)scene->nodes.size()-1;
-    for (int i = 0; i < (int)scene->nodes.size(); i++) {
-        if (!scene->nodes[i]->getProperty(VISIBILITY).value.x) {
-            nodesCount--;
-        } else if(scene->nodes[i]->getProperty(VISIBILITY).value.x && scene->nodes[i]->getType() == NODE_PARTICLES) {
-        	shared_ptr< ParticleManager > pNode = dynamic_pointer_cast<ParticleManager>(scene->nodes[i]->node);
-			nodesCount += pNode->getParticlesCount() - 1;
-        }
+    header.cameraRotation[0] = camRotation.x;
+    header.cameraRotation[1] = camRotation.y;
+    header.cameraRotation[2] = camRotation.z;
+
+    header.cameraFov = scene->nodes[NODE_CAMERA]->getProperty(FOV).value.x;
+    currentFrameId = frameId;
+    if(scene != skinningScene) {
+        clearSkinningCache();
+        skinningScene = scene;
     }
 
-    FileHelper::writeShort(&frameFilePtr, nodesCount); // Nodes Count
-    
+    vector<SGFDNodeData> nodesData;
     for (int nodeId = 1; nodeId < (int)scene->nodes.size(); nodeId++) {
         SGCloudRenderingHelper *renderHelper = new SGCloudRenderingHelper();
         if(scene->nodes[nodeId]->getType() == NODE_PARTICLES) {
         	shared_ptr< ParticleManager > pNode = dynamic_pointer_cast<ParticleManager>(scene->nodes[nodeId]->node);
             for(int i = 0; i < 48; i++) {
                 pNode->update();
-//                pNode->sortParticles(scene->renderCamera->getAbsolutePosition());
                 pNode->updateParticles(true, scene->renderCamera->getAbsolutePosition());
             }
 
@@ -78,38 +82,82 @@ bool SGCloudRenderingHelper::writeFrameData(SGEditorScene *scene , SceneManager
 
         	    Vector4 color = s * (1 - age) + e * age;
 
-        		renderHelper->writeNodeData(scene, nodeId, frameId, &frameFilePtr, i, color);
+        		renderHelper->collectNodeData(scene, nodeId, frameId, nodesData, i, color);
         	}
         } else
-        	renderHelper->writeNodeData(scene, nodeId, frameId, &frameFilePtr);
+        	renderHelper->collectNodeData(scene, nodeId, frameId, nodesData);
 
         if(renderHelper)
             delete renderHelper;
      }
 
+    header.nodeCount = (int)nodesData.size();
+    uint64_t offset = getSGFDNodeTableEnd(header.nodeCount);
+    for (int i = 0; i < (int)nodesData.size(); i++) {
+        nodesData[i].entry.offset = offset;
+        offset += getSGFDNodeLayout(nodesData[i].entry.vertexCount, nodesData[i].entry.indexCount).size;
+    }
+
+    frameFilePtr.write((char*)&header, sizeof(header));
+    for (int i = 0; i < (int)nodesData.size(); i++)
+        frameFilePtr.write((char*)&nodesData[i].entry, sizeof(SGFDNodeEntry));
+    
+    for (int i = 0; i < (int)nodesData.size(); i++) {
+        frameFilePtr.seekp(nodesData[i].entry.offset);
+        writeNodeData(&frameFilePtr, nodesData[i]);
+    }
+
     frameFilePtr.close();
+    clearSkinningCache(frameId);
     smgr->setActiveCamera(scene->viewCamera);
 
     return true;
 }
 
-void SGCloudRenderingHelper::writeNodeData(SGEditorScene *scene, int nodeId, int frameId, ofstream *frameFilePtr, int particleIndex, Vector4 pColor)
+void SGCloudRenderingHelper::writeNodeData(ofstream *frameFilePtr, SGFDNodeData &nodeData)
+{
+    SGFDNodeLayout layout = getSGFDNodeLayout(nodeData.entry.vertexCount, nodeData.entry.indexCount);
+    uint64_t offset = nodeData.entry.offset;
+
+    frameFilePtr->write((char*)&nodeData.material, sizeof(SGFDMaterial));
+    frameFilePtr->seekp(offset + layout.positions);
+    frameFilePtr->write((char*)nodeData.positions.data(), nodeData.positions.size() * sizeof(float));
+    frameFilePtr->seekp(offset + layout.indices);
+    frameFilePtr->write((char*)nodeData.indices.data(), nodeData.indices.size() * sizeof(unsigned int));
+    frameFilePtr->seekp(offset + layout.normals);
+    frameFilePtr->write((char*)nodeData.normals.data(), nodeData.normals.size() * sizeof(float));
+    frameFilePtr->seekp(offset + layout.uvs);
+    frameFilePtr->write((char*)nodeData.uvs.data(), nodeData.uvs.size() * sizeof(float));
+
+    // Pad the node so the next one starts aligned even when it is the last
+    uint64_t end = offset + layout.uvs + nodeData.uvs.size() * sizeof(float);
+    for (; end < offset + layout.size; end++)
+        frameFilePtr->put(0);
+}
+
+void SGCloudRenderingHelper::collectNodeData(SGEditorScene *scene, int nodeId, int frameId, vector<SGFDNodeData> &nodesData, int particleIndex, Vector4 pColor)
 {
     NODE_TYPE nodeType = scene->nodes[nodeId]->getType();
      SGNode *thisNode = scene->nodes[nodeId];
 
      if(thisNode->getProperty(VISIBILITY).value.x) {
+         nodesData.push_back(SGFDNodeData());
+         SGFDNodeData &nodeData = nodesData.back();
+         memset(&nodeData.entry, 0, sizeof(SGFDNodeEntry));
+         memset(&nodeData.material, 0, sizeof(SGFDMaterial));
+         SGFDMaterial &material = nodeData.material;
+
          Vector4 vertColor = thisNode->getProperty(VERTEX_COLOR).value;
 
          Vector3 lightDir = Vector3(0.0, -1.0, 0.0);
          if(nodeType == NODE_ADDITIONAL_LIGHT) {
-             FileHelper::writeFloat(frameFilePtr, thisNode->getProperty(SPECIFIC_FLOAT).value.x/DEFAULT_FADE_DISTANCE); // Emission
+             material.emission = thisNode->getProperty(SPECIFIC_FLOAT).value.x/DEFAULT_FADE_DISTANCE; // Emission
          } else
-             FileHelper::writeFloat(frameFilePtr, (nodeType == NODE_LIGHT) ? 1.0 : 0.0); // Emission
+             material.emission = (nodeType == NODE_LIGHT) ? 1.0 : 0.0; // Emission
 
          Vector3 lightColor = Vector3(0.0);
          if(nodeType == NODE_ADDITIONAL_LIGHT || nodeType == NODE_LIGHT) {
-             FileHelper::writeInt(frameFilePtr, thisNode->getProperty(LIGHT_TYPE).value.x);
+             material.lightType = thisNode->getProperty(LIGHT_TYPE).value.x;
              Quaternion lightRot = KeyHelper::getKeyInterpolationForFrame<int, SGRotationKey, Quaternion>(frameId, scene->nodes[nodeId]->rotationKeys);
              Mat4 rotMat;
              rotMat.setRotation(lightRot);
@@ -117,28 +165,29 @@ void SGCloudRenderingHelper::writeNodeData(SGEditorScene *scene, int nodeId, int
              lightColor = KeyHelper::getKeyInterpolationForFrame<int, SGScaleKey, Vector3>(frameId, scene->nodes[nodeId]->scaleKeys);
          }
 
-         FileHelper::writeFloat(frameFilePtr, lightColor.x); //Emission Color r
-         FileHelper::writeFloat(frameFilePtr, lightColor.y); //Emission Color g
-         FileHelper::writeFloat(frameFilePtr, lightColor.z); //Emission Color b
-         FileHelper::writeFloat(frameFilePtr, 0.5); //Emission Radius
+         material.emissionColor[0] = lightColor.x;
+         material.emissionColor[1] = lightColor.y;
+         material.emissionColor[2] = lightColor.z;
+         material.shadowDarkness = 0.5; //Emission Radius
          if(nodeType == NODE_PARTICLES) {
-             FileHelper::writeFloat(frameFilePtr, pColor.x); // Diffusion Color r
-             FileHelper::writeFloat(frameFilePtr, pColor.y); // Diffusion Color g
-             FileHelper::writeFloat(frameFilePtr, pColor.z); // Diffusion Color b
+             material.diffuse[0] = pColor.x;
+             material.diffuse[1] = pColor.y;
+             material.diffuse[2] = pColor.z;
          } else {
-             FileHelper::writeFloat(frameFilePtr, vertColor.x); // Diffusion Color r
-             FileHelper::writeFloat(frameFilePtr, vertColor.y); // Diffusion Color g
-             FileHelper::writeFloat(frameFilePtr, vertColor.z); // Diffusion Color b
+             material.diffuse[0] = vertColor.x;
+             material.diffuse[1] = vertColor.y;
+             material.diffuse[2] = vertColor.z;
          }
          
          if (nodeType == NODE_LIGHT || nodeType == NODE_ADDITIONAL_LIGHT) {
-             FileHelper::writeFloat(frameFilePtr, lightDir.x); // LightDir
-             FileHelper::writeFloat(frameFilePtr, lightDir.y);
-             FileHelper::writeFloat(frameFilePtr, lightDir.z);
+             material.lightDirection[0] = lightDir.x;
+             material.lightDirection[1] = lightDir.y;
+             material.lightDirection[2] = lightDir.z;
          }
          
          bool hasTexture = (nodeType == NODE_LIGHT || nodeType == NODE_ADDITIONAL_LIGHT || thisNode->getProperty(TEXTURE).fileName == "-1" || thisNode->getProperty(TEXTURE).fileName == "") ? false : true;
-         FileHelper::writeBool(frameFilePtr, hasTexture); // Has Texture
+         if(hasTexture)
+             nodeData.entry.flags |= SGFD_NODE_HAS_TEXTURE;
 
          unsigned long lastSlashPos  = (thisNode->getProperty(TEXTURE).fileName).find_last_of("\\/");
          string textureFileName;
@@ -147,198 +196,186 @@ void SGCloudRenderingHelper::writeNodeData(SGEditorScene *scene, int nodeId, int
          else
          	textureFileName = thisNode->getProperty(TEXTURE).fileName + ".png";
 
-         FileHelper::writeString(frameFilePtr, textureFileName); // Texture File Name with extension
-         FileHelper::writeFloat(frameFilePtr, scene->nodes[nodeId]->getProperty(REFLECTION).value.x);
-         FileHelper::writeFloat(frameFilePtr, scene->nodes[nodeId]->getProperty(REFRACTION).value.x);
-         FileHelper::writeFloat(frameFilePtr, scene->nodes[nodeId]->getProperty(TRANSPARENCY).value.x);
-         FileHelper::writeBool(frameFilePtr, (nodeType == NODE_PARTICLES) ? false : scene->nodes[nodeId]->getProperty(LIGHTING).value.x); // node lighting
-         FileHelper::writeBool(frameFilePtr, scene->nodes[nodeId]->smoothTexture);
-
-         vector<TriangleData> trianglesData;
+         strncpy(material.textureName, textureFileName.c_str(), SGFD_TEXTURE_NAME_LENGTH - 1); // Texture File Name with extension
+         material.reflection = scene->nodes[nodeId]->getProperty(REFLECTION).value.x;
+         material.refraction = scene->nodes[nodeId]->getProperty(REFRACTION).value.x;
+         material.transparency = scene->nodes[nodeId]->getProperty(TRANSPARENCY).value.x;
+         if(nodeType != NODE_PARTICLES && scene->nodes[nodeId]->getProperty(LIGHTING).value.x)
+             nodeData.entry.flags |= SGFD_NODE_HAS_LIGHTING;
+         if(scene->nodes[nodeId]->smoothTexture)
+             nodeData.entry.flags |= SGFD_NODE_SMOOTH_TEXTURE;
+
+         vector<vertexData> verticesData;
+         vector<unsigned int> indices;
          if(nodeType == NODE_PARTICLES)
-        	 trianglesData = calculateTriangleDataForParticleNode(thisNode, particleIndex);
+        	 calculateVertexDataForParticleNode(thisNode, particleIndex, verticesData, indices);
          else
-        	 trianglesData = calculateTriangleDataForNode(thisNode);
-
-         FileHelper::writeInt(frameFilePtr, (int)trianglesData.size());
-
-         for (int index = 0; index < (int)trianglesData.size(); index++) {
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Pos1.x);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Pos1.y);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Pos1.z);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Pos2.x);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Pos2.y);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Pos2.z);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Pos3.x);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Pos3.y);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Pos3.z);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Normal1.x);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Normal1.y);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Normal1.z);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Normal2.x);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Normal2.y);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Normal2.z);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Normal3.x);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Normal3.y);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].Normal3.z);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].UV1.x);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].UV1.y);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].UV2.x);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].UV2.y);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].UV3.x);
-             FileHelper::writeFloat(frameFilePtr, trianglesData[index].UV3.y);
-         }
+        	 calculateVertexDataForNode(thisNode, verticesData, indices);
+
+         setNodeGeometry(nodeData, verticesData, indices);
      }
 }
 
-vector<TriangleData> SGCloudRenderingHelper::calculateTriangleDataForNode(SGNode *sgNode)
+void SGCloudRenderingHelper::setNodeGeometry(SGFDNodeData &nodeData, vector<vertexData> &verticesData, vector<unsigned int> &indices)
+{
+    int vertexCount = (int)verticesData.size();
+    nodeData.positions.resize(vertexCount * 4);
+    nodeData.normals.resize(vertexCount * 3);
+    nodeData.uvs.resize(vertexCount * 2);
+    nodeData.indices = indices;
+
+    for (int i = 0; i < vertexCount; i++) {
+        nodeData.positions[i * 4 + 0] = -verticesData[i].vertPosition.x;
+        nodeData.positions[i * 4 + 1] = verticesData[i].vertPosition.y;
+        nodeData.positions[i * 4 + 2] = verticesData[i].vertPosition.z;
+        nodeData.positions[i * 4 + 3] = 0.0;
+        nodeData.normals[i * 3 + 0] = -verticesData[i].vertNormal.x;
+        nodeData.normals[i * 3 + 1] = verticesData[i].vertNormal.y;
+        nodeData.normals[i * 3 + 2] = verticesData[i].vertNormal.z;
+        nodeData.uvs[i * 2 + 0] = verticesData[i].texCoord1.x;
+        nodeData.uvs[i * 2 + 1] = verticesData[i].texCoord1.y;
+    }
+
+    nodeData.entry.vertexCount = vertexCount;
+    nodeData.entry.indexCount = (int)indices.size();
+
+    uint64_t hash = getSGFDHash(nodeData.positions.data(), nodeData.positions.size() * sizeof(float));
+    hash = getSGFDHash(nodeData.indices.data(), nodeData.indices.size() * sizeof(unsigned int), hash);
+    hash = getSGFDHash(nodeData.normals.data(), nodeData.normals.size() * sizeof(float), hash);
+    nodeData.entry.geometryHash = getSGFDHash(nodeData.uvs.data(), nodeData.uvs.size() * sizeof(float), hash);
+}
+
+void SGCloudRenderingHelper::calculateVertexDataForNode(SGNode *sgNode, vector<vertexData> &verticesData, vector<unsigned int> &indices)
 {
-    vector<TriangleData> trianglesData;
-    
-    vector<vertexData> allverticesData;
-    
-    vector<unsigned int> highPolyIndices;
-    
     //TODO Write according to new meshbuffer implementation
     
+    Mesh * currentMesh = NULL;
     if (sgNode->getType() == NODE_TEXT_SKIN || sgNode->getType() == NODE_RIG) {
-        unsigned int verticesCount = dynamic_pointer_cast<AnimatedMeshNode>(sgNode->node)->getMesh()->getVerticesCount();
         sgNode->node->updateAbsoluteTransformation();
         sgNode->node->updateAbsoluteTransformationOfChildren();
         dynamic_pointer_cast<AnimatedMeshNode>(sgNode->node)->update();
-        Mesh * currentMesh = dynamic_pointer_cast<AnimatedMeshNode>(sgNode->node)->getMesh();
-        
-        unsigned int indicesCount = currentMesh->getTotalIndicesCount();
-        
-        highPolyIndices = currentMesh->getTotalIndicesArray();
-        
-        if(currentMesh->meshType == MESH_TYPE_HEAVY) {
-            for (unsigned int index = 0; index < verticesCount; index++) {
-                vertexDataHeavy *currentVertex = currentMesh->getHeavyVertexByIndex(index);
-                allverticesData.push_back(calculateFinalVertexData(sgNode->node, currentVertex));
-            }
-        } else {
-            for (unsigned int index = 0; index < verticesCount; index++) {
-                vertexData *currentVertex = currentMesh->getLiteVertexByIndex(index);
-                allverticesData.push_back(calculateFinalVertexData(sgNode->node, currentVertex));
-            }
-        }
-        
-        for(unsigned int i = 0; i < indicesCount; i+=3) {
-            TriangleData tData;
-            tData.Pos1 = allverticesData[highPolyIndices[i]].vertPosition;
-            tData.Pos2 = allverticesData[highPolyIndices[i+1]].vertPosition;
-            tData.Pos3 = allverticesData[highPolyIndices[i+2]].vertPosition;
-            tData.Normal1 = allverticesData[highPolyIndices[i]].vertNormal;
-            tData.Normal2 = allverticesData[highPolyIndices[i+1]].vertNormal;
-            tData.Normal3 = allverticesData[highPolyIndices[i+2]].vertNormal;
-            tData.UV1 = allverticesData[highPolyIndices[i]].texCoord1;
-            tData.UV2 = allverticesData[highPolyIndices[i+1]].texCoord1;
-            tData.UV3 = allverticesData[highPolyIndices[i+2]].texCoord1;
-            trianglesData.push_back(tData);
-        }
+        currentMesh = dynamic_pointer_cast<AnimatedMeshNode>(sgNode->node)->getMesh();
     } else {
-        unsigned int verticesCount = dynamic_pointer_cast<MeshNode>(sgNode->node)->getMesh()->getVerticesCount();
-        Mesh * currentMesh = dynamic_pointer_cast<MeshNode>(sgNode->node)->getMesh();
-        
-        unsigned int indicesCount = currentMesh->getTotalIndicesCount();
-        
-        highPolyIndices = currentMesh->getTotalIndicesArray();
-        
-        if(currentMesh->meshType == MESH_TYPE_HEAVY) {
-            for (unsigned int index = 0; index < verticesCount; index++) {
-                vertexDataHeavy *currentVertex = currentMesh->getHeavyVertexByIndex(index);
-                allverticesData.push_back(calculateFinalVertexData(sgNode->node, currentVertex));
-            }
-        } else {
-            for (unsigned int index = 0; index < verticesCount; index++) {
-                vertexData *currentVertex = currentMesh->getLiteVertexByIndex(index);
-                allverticesData.push_back(calculateFinalVertexData(sgNode->node, currentVertex));
-            }
-        }
-        for(unsigned int i = 0; i < indicesCount; i+=3) {
-            TriangleData tData;
-            tData.Pos1 = allverticesData[highPolyIndices[i]].vertPosition;
-            tData.Pos2 = allverticesData[highPolyIndices[i+1]].vertPosition;
-            tData.Pos3 = allverticesData[highPolyIndices[i+2]].vertPosition;
-            tData.Normal1 = allverticesData[highPolyIndices[i]].vertNormal;
-            tData.Normal2 = allverticesData[highPolyIndices[i+1]].vertNormal;
-            tData.Normal3 = allverticesData[highPolyIndices[i+2]].vertNormal;
-            tData.UV1 = allverticesData[highPolyIndices[i]].texCoord1;
-            tData.UV2 = allverticesData[highPolyIndices[i+1]].texCoord1;
-            tData.UV3 = allverticesData[highPolyIndices[i+2]].texCoord1;
-            trianglesData.push_back(tData);
-        }
+        currentMesh = dynamic_pointer_cast<MeshNode>(sgNode->node)->getMesh();
     }
-    
-    return trianglesData;
+
+    unsigned int verticesCount = currentMesh->getVerticesCount();
+    indices = currentMesh->getTotalIndicesArray();
+    indices.resize(currentMesh->getTotalIndicesCount());
+
+    Mat4 model = sgNode->node->getModelMatrix();
+    vector<Mat4> jointPalette;
+    if(currentMesh->meshType == MESH_TYPE_HEAVY)
+        jointPalette = calculateJointPalette((SkinMesh*)currentMesh);
+
+    uint64_t signature = getMeshSignature(currentMesh);
+    SGSkinningCache &cache = skinningCache[sgNode->node->getID()];
+    cache.frameId = currentFrameId;
+    if(cache.vertices.size() == verticesCount && cache.signature == signature && cache.model == model && cache.jointPalette == jointPalette) {
+        verticesData = cache.vertices;
+        return;
+    }
+
+    verticesData.resize(verticesCount);
+    transformVertices(currentMesh, model, jointPalette, verticesData);
+
+    cache.signature = signature;
+    cache.model = model;
+    cache.jointPalette = jointPalette;
+    cache.vertices = verticesData;
+}
+
+vector<Mat4> SGCloudRenderingHelper::calculateJointPalette(SkinMesh *sMesh)
+{
+    vector<Mat4> jointTransforms;
+    jointTransforms.reserve(sMesh->joints->size());
+    for(int i = 0; i < (int)sMesh->joints->size(); ++i){
+        Mat4 JointVertexPull;
+        JointVertexPull.setbyproduct((*sMesh->joints)[i]->GlobalAnimatedMatrix, (*sMesh->joints)[i]->GlobalInversedMatrix);
+        jointTransforms.push_back(JointVertexPull);
+    }
+    return jointTransforms;
+}
+
+void SGCloudRenderingHelper::transformVertices(Mesh *mesh, const Mat4 &model, const vector<Mat4> &jointPalette, vector<vertexData> &verticesData)
+{
+    WorkerPool::getShared()->parallelFor((int)verticesData.size(), SKINNING_CHUNK_SIZE, [&](int start, int end) {
+        transformVertexRange(mesh, model, jointPalette, verticesData, start, end);
+    });
+}
+
+void SGCloudRenderingHelper::transformVertexRange(Mesh *mesh, const Mat4 &model, const vector<Mat4> &jointPalette, vector<vertexData> &verticesData, unsigned int start, unsigned int end)
+{
+    if(mesh->meshType == MESH_TYPE_HEAVY) {
+        for (unsigned int index = start; index < end; index++)
+            verticesData[index] = calculateFinalVertexData(mesh, mesh->getHeavyVertexByIndex(index), model, jointPalette);
+    } else {
+        for (unsigned int index = start; index < end; index++)
+            verticesData[index] = calculateFinalVertexData(mesh, mesh->getLiteVertexByIndex(index), model, jointPalette);
+    }
+}
+
+// Hash of the unskinned vertices, so a node whose mesh was replaced or edited
+// under the same ID is skinned again
+uint64_t SGCloudRenderingHelper::getMeshSignature(Mesh *mesh)
+{
+    uint64_t signature = getSGFDHash(&mesh->meshType, sizeof(mesh->meshType));
+    for (int i = 0; i < mesh->getMeshBufferCount(); i++) {
+        unsigned int count = mesh->getVerticesCountInMeshBuffer(i);
+        if(count == 0)
+            continue;
+        if(mesh->meshType == MESH_TYPE_HEAVY)
+            signature = getSGFDHash(mesh->getHeavyVerticesForMeshBuffer(i, 0), count * sizeof(vertexDataHeavy), signature);
+        else
+            signature = getSGFDHash(mesh->getLiteVerticesForMeshBuffer(i, 0), count * sizeof(vertexData), signature);
+    }
+    return signature;
 }
 
-vector<TriangleData> SGCloudRenderingHelper::calculateTriangleDataForParticleNode(SGNode *sgNode, int index)
+void SGCloudRenderingHelper::clearSkinningCache(int frameId)
 {
-    vector<TriangleData> trianglesData;
-    vector<unsigned int> highPolyIndices;
+    for (map<int, SGSkinningCache>::iterator it = skinningCache.begin(); it != skinningCache.end(); ) {
+        if(frameId < 0 || it->second.frameId != frameId)
+            skinningCache.erase(it++);
+        else
+            ++it;
+    }
+}
 
-    unsigned int verticesCount = dynamic_pointer_cast<MeshNode>(sgNode->node)->getMesh()->getVerticesCount();
+void SGCloudRenderingHelper::calculateVertexDataForParticleNode(SGNode *sgNode, int index, vector<vertexData> &verticesData, vector<unsigned int> &indices)
+{
     Mesh * currentMesh = dynamic_pointer_cast<MeshNode>(sgNode->node)->getMesh();
+    unsigned int verticesCount = currentMesh->getVerticesCount();
     
-    unsigned int indicesCount = currentMesh->getTotalIndicesCount();
-    highPolyIndices = currentMesh->getTotalIndicesArray();
+    indices = currentMesh->getTotalIndicesArray();
+    indices.resize(currentMesh->getTotalIndicesCount());
     
     shared_ptr< ParticleManager > pNode = dynamic_pointer_cast<ParticleManager>(sgNode->node);
-    
-    highPolyIndices = currentMesh->getTotalIndicesArray();
-    
     Vector4* positions = pNode->getPositions();
     Vector4* rotations = pNode->getRotations();
 
-        vector<vertexData> allverticesData;
-        for (unsigned int i = 0; i < verticesCount; i++) {
-            vertexData *currentVertex = currentMesh->getLiteVertexByIndex(i);
-            allverticesData.push_back(calculateFinalVertexDataForParticle(sgNode->node, currentVertex, index, positions[index], rotations[index]));
-        }
-        for(unsigned int i = 0; i < indicesCount; i+=3) {
-            TriangleData tData;
-            tData.Pos1 = allverticesData[highPolyIndices[i]].vertPosition;
-            tData.Pos2 = allverticesData[highPolyIndices[i+1]].vertPosition;
-            tData.Pos3 = allverticesData[highPolyIndices[i+2]].vertPosition;
-            tData.Normal1 = allverticesData[highPolyIndices[i]].vertNormal;
-            tData.Normal2 = allverticesData[highPolyIndices[i+1]].vertNormal;
-            tData.Normal3 = allverticesData[highPolyIndices[i+2]].vertNormal;
-            tData.UV1 = allverticesData[highPolyIndices[i]].texCoord1;
-            tData.UV2 = allverticesData[highPolyIndices[i+1]].texCoord1;
-            tData.UV3 = allverticesData[highPolyIndices[i+2]].texCoord1;
-            trianglesData.push_back(tData);
-        }
-        printf("\n Particles %d updated ", index);
-        allverticesData.clear();
-
-        return trianglesData;
+    verticesData.reserve(verticesCount);
+    for (unsigned int i = 0; i < verticesCount; i++) {
+        vertexData *currentVertex = currentMesh->getLiteVertexByIndex(i);
+        verticesData.push_back(calculateFinalVertexDataForParticle(sgNode->node, currentVertex, index, positions[index], rotations[index]));
+    }
+    printf("\n Particles %d updated ", index);
 }
 
-vertexData SGCloudRenderingHelper::calculateFinalVertexData(shared_ptr<Node> node , void * vertex)
+vertexData SGCloudRenderingHelper::calculateFinalVertexData(Mesh *mesh, void * vertex, const Mat4 &model, const vector<Mat4> &jointPalette)
 {
     vertexData finalVertData;
     
-    Mesh * mesh = dynamic_pointer_cast<MeshNode>(node)->getMesh();
-    
     if (mesh->meshType == MESH_TYPE_HEAVY) {
         
         finalVertData.vertPosition = ((vertexDataHeavy*)vertex)->vertPosition;
         finalVertData.vertNormal = ((vertexDataHeavy*)vertex)->vertNormal;
         finalVertData.texCoord1 = ((vertexDataHeavy*)vertex)->texCoord1;
         
-        SkinMesh *sMesh = (SkinMesh*)mesh;
-        vector<Mat4> jointTransforms;
-        for(int i = 0; i < (int)sMesh->joints->size(); ++i){
-            Mat4 JointVertexPull;
-            JointVertexPull.setbyproduct((*sMesh->joints)[i]->GlobalAnimatedMatrix, (*sMesh->joints)[i]->GlobalInversedMatrix);
-            jointTransforms.push_back(JointVertexPull);
-        }
-        calculateJointTransforms(((vertexDataHeavy*)vertex), jointTransforms, finalVertData.vertPosition, finalVertData.vertNormal);
+        calculateJointTransforms(((vertexDataHeavy*)vertex), jointPalette, finalVertData.vertPosition, finalVertData.vertNormal);
         
-        Vector4 finalPos = node->getModelMatrix() * Vector4(finalVertData.vertPosition , 1.0);
-        Vector4 finalNorm = (node->getModelMatrix() * Vector4(finalVertData.vertNormal , 0.0).normalize()).normalize();
+        Vector4 finalPos = model * Vector4(finalVertData.vertPosition , 1.0);
+        Vector4 finalNorm = (model * Vector4(finalVertData.vertNormal , 0.0).normalize()).normalize();
         
         finalVertData.vertPosition = Vector3(finalPos.x , finalPos.y ,finalPos.z);
         finalVertData.vertNormal = Vector3(finalNorm.x , finalNorm.y , finalNorm.z);
@@ -350,9 +387,6 @@ vertexData SGCloudRenderingHelper::calculateFinalVertexData(shared_ptr<Node> nod
         finalVertData.vertNormal = ((vertexData*)vertex)->vertNormal;
         finalVertData.texCoord1 = ((vertexData*)vertex)->texCoord1;
         
-        Mat4 model = node->getModelMatrix();
-//        printf("\n Translation %f %f %f ", model[12],model[13],model[14]);
-
         Vector4 finalPos = model * Vector4(finalVertData.vertPosition , 1.0);
         Vector4 finalNorm = (model * Vector4(finalVertData.vertNormal , 0.0).normalize()).normalize();
 
@@ -415,7 +449,7 @@ vertexData SGCloudRenderingHelper::calculateFinalVertexDataForParticle(shared_pt
 }
 
 
-void SGCloudRenderingHelper::calculateJointTransforms(vertexDataHeavy *vertex , vector<Mat4> jointTransforms , Vector3 &vertPosition, Vector3 &vertNormal)
+void SGCloudRenderingHelper::calculateJointTransforms(vertexDataHeavy *vertex , const vector<Mat4> &jointTransforms , Vector3 &vertPosition, Vector3 &vertNormal)
 {
     Vector4 pos = Vector4(0.0);
     Vector4 nor = Vector4(0.0);
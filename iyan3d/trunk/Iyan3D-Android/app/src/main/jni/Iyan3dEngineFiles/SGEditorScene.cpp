@@ -274,15 +274,14 @@ void SGEditorScene::setPropsOfObject(SGNode *sgNode, int pType)
 
 void SGEditorScene::syncSceneWithPhysicsWorld()
 {
-#ifndef UBUNTU
     if(physicsHelper)
         physicsHelper->syncPhysicsWorld();
-#endif
 }
 
 void SGEditorScene::updatePhysics(int frame)
 {
-    physicsHelper->updatePhysicsUpToFrame(frame);
+    if(physicsHelper)
+        physicsHelper->updatePhysicsUpToFrame(frame);
 }
 
 void SGEditorScene::enableDirectionIndicator()
@@ -9,6 +9,7 @@
 #include "HeaderFiles/SGSceneLoader.h"
 #include "HeaderFiles/SGEditorScene.h"
 #include "SceneImporter.h"
+#include "HeaderFiles/MeshRW.h"
 
 SGEditorScene *currentScene;
 
@@ -30,11 +31,20 @@ bool SGSceneLoader::loadSceneData(std::string *filePath)
 
     ifstream inputSGBFile(*filePath,ios::in | ios::binary );
     FileHelper::resetSeekPosition();
-    if(!readScene(&inputSGBFile)){
-        inputSGBFile.close();
-        return false;
-    }
+    
+    // Embedded meshes are copied straight out of the mapped file
+    MappedFile mappedSGBFile;
+    if(mappedSGBFile.open(*filePath))
+        MeshRW::setSourceFile(&mappedSGBFile);
+    
+    bool status = readScene(&inputSGBFile);
+    MeshRW::setSourceFile(NULL);
     inputSGBFile.close();
+    if(!status)
+        return false;
+    
+    if(currentScene->physicsHelper)
+        currentScene->physicsHelper->readCache(PhysicsHelper::getCachePath(*filePath));
     return true;
 }
 
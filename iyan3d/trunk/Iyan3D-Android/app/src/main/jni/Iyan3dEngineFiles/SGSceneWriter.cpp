@@ -30,6 +30,9 @@ void SGSceneWriter::saveSceneData(std::string *filePath)
     FileHelper::resetSeekPosition();
     writeScene(&outputFile);
     outputFile.close();
+    
+    if(writingScene->physicsHelper)
+        writingScene->physicsHelper->writeCache(PhysicsHelper::getCachePath(*filePath));
 }
 void SGSceneWriter::writeScene(ofstream *filePointer)
 {
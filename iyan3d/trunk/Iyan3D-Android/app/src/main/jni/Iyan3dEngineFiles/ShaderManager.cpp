@@ -32,6 +32,36 @@ int ShaderManager::maxIntsances = 100;
 int ShaderManager::maxJoints = 1;
 float ShaderManager::ambientLight = 0.0f;
 
+// Uniform names are looked up once, draws pass the IDs and materials index their slot tables with them
+static const u16 ambientLightUniform = Material::getUniformId("ambientLight");
+static const u16 endColorUniform = Material::getUniformId("endColor");
+static const u16 eyePosUniform = Material::getUniformId("eyePos");
+static const u16 fadeEndDistanceUniform = Material::getUniformId("fadeEndDistance");
+static const u16 hasLightingUniform = Material::getUniformId("hasLighting");
+static const u16 hasMeshColorUniform = Material::getUniformId("hasMeshColor");
+static const u16 hasNormalMapUniform = Material::getUniformId("hasNormalMap");
+static const u16 hasReflectionMapUniform = Material::getUniformId("hasReflectionMap");
+static const u16 jointTransformsUniform = Material::getUniformId("jointTransforms");
+static const u16 lightColorUniform = Material::getUniformId("lightColor");
+static const u16 lightCountUniform = Material::getUniformId("lightCount");
+static const u16 lightPosUniform = Material::getUniformId("lightPos");
+static const u16 lightTypesUniform = Material::getUniformId("lightTypes");
+static const u16 lvpUniform = Material::getUniformId("lvp");
+static const u16 meshColorUniform = Material::getUniformId("meshColor");
+static const u16 midColorUniform = Material::getUniformId("midColor");
+static const u16 modelUniform = Material::getUniformId("model");
+static const u16 mvpUniform = Material::getUniformId("mvp");
+static const u16 numberOfLightsUniform = Material::getUniformId("numberOfLights");
+static const u16 propsUniform = Material::getUniformId("props");
+static const u16 reflectionValueUniform = Material::getUniformId("reflectionValue");
+static const u16 samplerTypeUniform = Material::getUniformId("samplerType");
+static const u16 shadowDarknessUniform = Material::getUniformId("shadowDarkness");
+static const u16 startColorUniform = Material::getUniformId("startColor");
+static const u16 transparencyValueUniform = Material::getUniformId("transparencyValue");
+static const u16 uvScaleValueUniform = Material::getUniformId("uvScaleValue");
+static const u16 vpUniform = Material::getUniformId("vp");
+static const u16 textureUniforms[] = {Material::getUniformId("colorMap"), Material::getUniformId("normalMap"), Material::getUniformId("shadowMap"), Material::getUniformId("reflectionMap")};
+
 ShaderManager::ShaderManager(SceneManager *smgr,DEVICE_TYPE deviceType, int maxUniforms, int maxJoints)
 {
     isRenderingDepthPass = false;
@@ -39,6 +69,7 @@ ShaderManager::ShaderManager(SceneManager *smgr,DEVICE_TYPE deviceType, int maxU
     shadowTextureSize = 2048.0;
     camPos = Vector3(0.0);
     this->smgr = smgr;
+    uniformNodeIndex = NOT_EXISTS;
     ShaderManager::BundlePath = constants::BundlePath;
     ShaderManager::deviceType = deviceType;
 #ifndef UBUNTU
@@ -191,7 +222,7 @@ void ShaderManager::setUniforms(SGNode *sgNode, string matName, int materialInde
         setShadowDakness(sgNode, SHADER_MESH_shadowDarkness);
         setHasMeshColor(sgNode, sgNode->getProperty(IS_VERTEX_COLOR, materialIndex).value.x, SHADER_MESH_hasMeshColor, false, materialIndex);
         Vector4 meshColor = sgNode->getProperty(VERTEX_COLOR, materialIndex).value;
-        setVertexColorUniform(sgNode, meshColor, SHADER_MESH_meshColor, smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex);
+        setVertexColorUniform(sgNode, meshColor, SHADER_MESH_meshColor, getNodeIndex(sgNode), materialIndex);
         setReflectionValue(sgNode, SHADER_MESH_reflectionValue, materialIndex);
         setNodeTransparency(sgNode, SHADER_MESH_transparency, materialIndex);
         setNodeLighting(sgNode, SHADER_MESH_hasLighting, materialIndex);
@@ -206,7 +237,7 @@ void ShaderManager::setUniforms(SGNode *sgNode, string matName, int materialInde
         setEyePos(sgNode, SHADER_COMMON_SKIN_eyePos);
         setShadowDakness(sgNode, SHADER_COMMON_SKIN_shadowDarkness);
         setHasMeshColor(sgNode, sgNode->getProperty(IS_VERTEX_COLOR, materialIndex).value.x, SHADER_COMMON_SKIN_hasMeshColor, false, materialIndex);
-        setVertexColorUniform(sgNode, sgNode->getProperty(VERTEX_COLOR, materialIndex).value, SHADER_COMMON_SKIN_meshColor, smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex);
+        setVertexColorUniform(sgNode, sgNode->getProperty(VERTEX_COLOR, materialIndex).value, SHADER_COMMON_SKIN_meshColor, getNodeIndex(sgNode), materialIndex);
         setReflectionValue(sgNode, SHADER_COMMON_SKIN_reflectionValue, materialIndex);
         setNodeTransparency(sgNode, SHADER_COMMON_SKIN_transparency, materialIndex);
         setNodeLighting(sgNode, SHADER_COMMON_SKIN_hasLighting, materialIndex);
@@ -216,12 +247,12 @@ void ShaderManager::setUniforms(SGNode *sgNode, string matName, int materialInde
     } else if(matName == "SHADER_COLOR") {
         setModelViewProjMatrix(sgNode, SHADER_COLOR_mvp);
         Vector4 vertexColor = sgNode->getProperty(SELECTED).value.x ? Vector4(0.0, 1.0, 0.0, 0) : sgNode->getProperty(VERTEX_COLOR).value;
-        setVertexColorUniform(sgNode, vertexColor, SHADER_COLOR_vertexColor, smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex);
+        setVertexColorUniform(sgNode, vertexColor, SHADER_COLOR_vertexColor, getNodeIndex(sgNode), materialIndex);
         setNodeTransparency(sgNode,SHADER_COLOR_transparency, materialIndex);
     } else if(matName == "SHADER_COLOR_SKIN") {
         setModelViewProjMatrix(sgNode,SHADER_COLOR_SKIN_mvp);
         Vector4 vertexColor = sgNode->getProperty(SELECTED).value.x ? Vector4(0.0, 1.0, 0.0, 0) : sgNode->getProperty(VERTEX_COLOR).value;
-        setVertexColorUniform(sgNode, vertexColor, SHADER_COLOR_SKIN_vertexColor, smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex);
+        setVertexColorUniform(sgNode, vertexColor, SHADER_COLOR_SKIN_vertexColor, getNodeIndex(sgNode), materialIndex);
         setNodeTransparency(sgNode,SHADER_COLOR_SKIN_transparency, materialIndex);
         setJointTransform(sgNode,SHADER_COLOR_SKIN_jointData,smgr);
     } else if(matName == "SHADER_2D_PLANE") {
@@ -278,7 +309,7 @@ void ShaderManager::setVertexColorUniform(SGNode *sgNode, Vector4 color, int par
     }
     
     Material * material = sgNode->node->material;
-    smgr->setPropertyValue(material, "meshColor", vertColor, DATA_FLOAT_VEC3, ((endIndex - startIndex)+1) * 3, false, paramIndex, nodeIndex, materialIndex);
+    smgr->setPropertyValue(material, meshColorUniform, vertColor, DATA_FLOAT_VEC3, ((endIndex - startIndex)+1) * 3, false, paramIndex, nodeIndex, materialIndex);
     delete [] vertColor;
 }
 
@@ -299,14 +330,14 @@ void ShaderManager::setHasMeshColor(SGNode *sgNode, bool status, int paramIndex,
         i++;
     }
     
-    smgr->setPropertyValue(sgNode->node->material, "hasMeshColor", hasMeshColor, DATA_FLOAT, (endIndex - startIndex)+1, isFragmentData, paramIndex, smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex);
+    smgr->setPropertyValue(sgNode->node->material, hasMeshColorUniform, hasMeshColor, DATA_FLOAT, (endIndex - startIndex)+1, isFragmentData, paramIndex, getNodeIndex(sgNode), materialIndex);
     delete [] hasMeshColor;
 }
 
 void ShaderManager::setNumberOfLights(SGNode *sgNode, int paramIndex)
 {
     float lights = (float)ShaderManager::lightPosition.size();
-    smgr->setPropertyValue(sgNode->node->material, "numberOfLights", &lights, DATA_FLOAT,1,true,paramIndex,smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, numberOfLightsUniform, &lights, DATA_FLOAT,1,true,paramIndex,getNodeIndex(sgNode));
 }
 
 void ShaderManager::setLightsProperties(SGNode *sgNode, int param1, int param2, int param3, int param4, int param5)
@@ -330,13 +361,13 @@ void ShaderManager::setLightsProperties(SGNode *sgNode, int param1, int param2,
     
     ambientLight = getProperty(AMBIENT_LIGHT).value.x;
     
-    smgr->setPropertyValue(sgNode->node->material, "fadeEndDistance", fadeEndDistance, DATA_FLOAT, lightsCount, true ,SHADER_COMMON_lightFadeDistance,smgr->getNodeIndexByID(sgNode->node->getID()));
-    smgr->setPropertyValue(sgNode->node->material, "lightTypes", lightType, DATA_FLOAT, lightsCount, true ,param3,smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, fadeEndDistanceUniform, fadeEndDistance, DATA_FLOAT, lightsCount, true ,SHADER_COMMON_lightFadeDistance,getNodeIndex(sgNode));
+    smgr->setPropertyValue(sgNode->node->material, lightTypesUniform, lightType, DATA_FLOAT, lightsCount, true ,param3,getNodeIndex(sgNode));
     
-    smgr->setPropertyValue(sgNode->node->material, "ambientLight", &ambientLight, DATA_FLOAT, 1, true, param4, smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, ambientLightUniform, &ambientLight, DATA_FLOAT, 1, true, param4, getNodeIndex(sgNode));
     
     float lCount = lightsCount;
-    smgr->setPropertyValue(sgNode->node->material, "lightCount", &lCount, DATA_FLOAT, 1, true, param5, smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, lightCountUniform, &lCount, DATA_FLOAT, 1, true, param5, getNodeIndex(sgNode));
     lightChanged = false;
     delete [] fadeEndDistance;
     delete [] lightType;
@@ -345,14 +376,14 @@ void ShaderManager::setLightsProperties(SGNode *sgNode, int param1, int param2,
 void ShaderManager::setLightsPosition(SGNode *sgNode, float *lightPositions, int paramIndex)
 {
     int lightsCount = (int)ShaderManager::lightPosition.size();
-    smgr->setPropertyValue(sgNode->node->material, "lightPos", lightPositions, DATA_FLOAT_VEC3, lightsCount * 3, true, paramIndex,smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, lightPosUniform, lightPositions, DATA_FLOAT_VEC3, lightsCount * 3, true, paramIndex,getNodeIndex(sgNode));
     delete(lightPositions);
 }
 
 void ShaderManager::setLightsColors(SGNode *sgNode, float *lightColors, int paramIndex)
 {
     int lightsCount = (int)ShaderManager::lightPosition.size();
-    smgr->setPropertyValue(sgNode->node->material, "lightColor", lightColors, DATA_FLOAT_VEC3, lightsCount * 3, true, paramIndex,smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, lightColorUniform, lightColors, DATA_FLOAT_VEC3, lightsCount * 3, true, paramIndex,getNodeIndex(sgNode));
     delete(lightColors);
 }
 
@@ -375,7 +406,7 @@ void ShaderManager::setNodeLighting(SGNode *sgNode, int paramIndex, int material
         i++;
     }
     
-    smgr->setPropertyValue(sgNode->node->material, "hasLighting", lighting, DATA_FLOAT, (endIndex - startIndex)+1, false, paramIndex, smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex);
+    smgr->setPropertyValue(sgNode->node->material, hasLightingUniform, lighting, DATA_FLOAT, (endIndex - startIndex)+1, false, paramIndex, getNodeIndex(sgNode), materialIndex);
     
     delete [] lighting;
 }
@@ -383,7 +414,7 @@ void ShaderManager::setNodeLighting(SGNode *sgNode, int paramIndex, int material
 void ShaderManager::setShadowDakness(SGNode *sgNode, int paramIndex)
 {
     float finalShadow = (shadowsOff || sgNode->getProperty(SELECTED).value.x) ? 0.0 : shadowDensity;
-    smgr->setPropertyValue(sgNode->node->material, "shadowDarkness", &finalShadow, DATA_FLOAT, 1, false, paramIndex,smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, shadowDarknessUniform, &finalShadow, DATA_FLOAT, 1, false, paramIndex,getNodeIndex(sgNode));
 }
 
 void ShaderManager::setReflectionValue(SGNode *sgNode, int paramIndex, int materialIndex)
@@ -403,7 +434,7 @@ void ShaderManager::setReflectionValue(SGNode *sgNode, int paramIndex, int mater
         i++;
     }
     
-    smgr->setPropertyValue(sgNode->node->material, "reflectionValue", value, DATA_FLOAT, (endIndex - startIndex)+1, false, paramIndex,smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex);
+    smgr->setPropertyValue(sgNode->node->material, reflectionValueUniform, value, DATA_FLOAT, (endIndex - startIndex)+1, false, paramIndex,getNodeIndex(sgNode), materialIndex);
     
     delete [] value;
     
@@ -416,7 +447,7 @@ void ShaderManager::setEyePos(SGNode *sgNode,int paramIndex)
     campos[0] = camposVec.x;
     campos[1] = camposVec.y;
     campos[2] = camposVec.z;
-    smgr->setPropertyValue(sgNode->node->material, "eyePos", campos, DATA_FLOAT_VEC3, 3, false, paramIndex,smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, eyePosUniform, campos, DATA_FLOAT_VEC3, 3, false, paramIndex,getNodeIndex(sgNode));
     delete[] campos;
 }
 
@@ -424,13 +455,11 @@ void ShaderManager::setLightViewProjMatrix(SGNode *sgNode,int paramIndex)
 {
     Mat4 lvp = lighCamProjMatrix * lighCamViewMatrix;
     
-    smgr->setPropertyValue(sgNode->node->material, "lvp", lvp.pointer(), DATA_FLOAT_MAT4, 16, false, paramIndex,smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, lvpUniform, lvp.pointer(), DATA_FLOAT_MAT4, 16, false, paramIndex,getNodeIndex(sgNode));
 }
 
 void ShaderManager::setTexturesUniforms(SGNode *sgNode, u16 paramIndex, int materialIndex)
 {
-    string textureNames[] = {"colorMap", "normalMap", "shadowMap", "reflectionMap"};
-    
     for (int i = NODE_TEXTURE_TYPE_COLORMAP; i <= NODE_TEXTURE_TYPE_REFLECTIONMAP; i++) {
         Texture* texture = sgNode->materialProps[materialIndex]->getTextureOfType((node_texture_type)i);
         bool smoothTexture = false;
@@ -442,17 +471,17 @@ void ShaderManager::setTexturesUniforms(SGNode *sgNode, u16 paramIndex, int mate
             
             setSamplerType(sgNode, SHADER_COMMON_samplerType, smoothTexture);
         }
-        setTextureForNode(sgNode, texture, textureNames[i], paramIndex, i, materialIndex, smoothTexture);
+        setTextureForNode(sgNode, texture, textureUniforms[i], paramIndex, i, materialIndex, smoothTexture);
     }
     
     float hasReflectionMap = (environmentTex) ? 1.0 : 0.0;
-    smgr->setPropertyValue(sgNode->node->material, "hasReflectionMap", &hasReflectionMap, DATA_FLOAT, 1, true, SHADER_COMMON_hasReflectionMap, smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex);
+    smgr->setPropertyValue(sgNode->node->material, hasReflectionMapUniform, &hasReflectionMap, DATA_FLOAT, 1, true, SHADER_COMMON_hasReflectionMap, getNodeIndex(sgNode), materialIndex);
     
     float hasNormalMap = (sgNode->materialProps[materialIndex]->getTextureOfType(NODE_TEXTURE_TYPE_NORMALMAP)) ? 1.0 : 0.0;
-    smgr->setPropertyValue(sgNode->node->material, "hasNormalMap", &hasNormalMap, DATA_FLOAT, 1, true, SHADER_COMMON_hasNormalMap, smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex);
+    smgr->setPropertyValue(sgNode->node->material, hasNormalMapUniform, &hasNormalMap, DATA_FLOAT, 1, true, SHADER_COMMON_hasNormalMap, getNodeIndex(sgNode), materialIndex);
 }
 
-void ShaderManager::setTextureForNode(SGNode* sgNode, Texture* texture, string textureName, int paramIndex, int userValue, int materialIndex, bool smoothTexture)
+void ShaderManager::setTextureForNode(SGNode* sgNode, Texture* texture, u16 textureUniform, int paramIndex, int userValue, int materialIndex, bool smoothTexture)
 {
     if(texture == NULL)
         return;
@@ -462,17 +491,17 @@ void ShaderManager::setTextureForNode(SGNode* sgNode, Texture* texture, string t
     if(deviceType == OPENGLES2) {
         OGLTexture* tex = (OGLTexture*)texture;
         textureValue = tex->OGLTextureName;
-        smgr->setPropertyValue(sgNode->node->material, textureName, &textureValue, DATA_TEXTURE_2D, 1, true, paramIndex + userValue, smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex, tex, userValue);
+        smgr->setPropertyValue(sgNode->node->material, textureUniform, &textureValue, DATA_TEXTURE_2D, 1, true, paramIndex + userValue, getNodeIndex(sgNode), materialIndex, tex, userValue);
     } else if(deviceType == METAL) {
         textureValue =  userValue;
-        smgr->setPropertyValue(sgNode->node->material, textureName, &textureValue, DATA_TEXTURE_2D, 1, true, paramIndex + userValue, smgr->getNodeIndexByID(sgNode->node->getID()), materialIndex, texture, 1, smoothTexture);
+        smgr->setPropertyValue(sgNode->node->material, textureUniform, &textureValue, DATA_TEXTURE_2D, 1, true, paramIndex + userValue, getNodeIndex(sgNode), materialIndex, texture, 1, smoothTexture);
     }
 }
 
 void ShaderManager::setSamplerType(SGNode *sgNode, u16 paramIndex, bool smoothTexture)
 {
     float samplerType = smoothTexture ? 0.0 : 1.0;
-    smgr->setPropertyValue(sgNode->node->material, "samplerType", &samplerType, DATA_FLOAT, 1, true , SHADER_COMMON_samplerType, smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, samplerTypeUniform, &samplerType, DATA_FLOAT, 1, true , SHADER_COMMON_samplerType, getNodeIndex(sgNode));
 }
 
 void ShaderManager::setNodeTransparency(SGNode *sgNode, u16 paramIndex, int materialIndex)
@@ -494,7 +523,7 @@ void ShaderManager::setNodeTransparency(SGNode *sgNode, u16 paramIndex, int mate
     }
     
     Material * material = sgNode->node->material;
-    smgr->setPropertyValue(material, "transparencyValue", transparency, DATA_FLOAT, (endIndex - startIndex)+1, false, paramIndex, smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(material, transparencyValueUniform, transparency, DATA_FLOAT, (endIndex - startIndex)+1, false, paramIndex, getNodeIndex(sgNode));
     
     delete [] transparency;
     
@@ -520,7 +549,7 @@ void ShaderManager::setUVScaleValue(SGNode *sgNode, u16 paramIndex, int material
     }
     
     Material * material = sgNode->node->material;
-    smgr->setPropertyValue(material, "uvScaleValue", uvScale, DATA_FLOAT, (endIndex - startIndex)+1, false, paramIndex, smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(material, uvScaleValueUniform, uvScale, DATA_FLOAT, (endIndex - startIndex)+1, false, paramIndex, getNodeIndex(sgNode));
     
     delete [] uvScale;
 }
@@ -532,15 +561,15 @@ void ShaderManager::setModelViewProjMatrix(SGNode *sgNode, u16 paramIndex, bool
     Mat4 viewMat = (isDepthPass) ? lighCamViewMatrix : smgr->getActiveCamera()->getViewMatrix();
     
     Mat4 mvp;
-    std::string uniformName = "mvp";
+    u16 uniform = mvpUniform;
 
     if(sgNode->node->getID() == GREEN_LINES_ID || sgNode->node->getID() == BLUE_LINES_ID || sgNode->node->getID() == RED_LINES_ID || sgNode->node->material->name == "SHADER_MESH") {
-        uniformName = (sgNode->node->drawMode == DRAW_MODE_LINES) ? "mvp" : "vp";
+        uniform = (sgNode->node->drawMode == DRAW_MODE_LINES) ? mvpUniform : vpUniform;
         mvp = projMat * viewMat;
     } else
         mvp = projMat * viewMat * sgNode->node->getModelMatrix();
     
-    smgr->setPropertyValue(sgNode->node->material, uniformName, mvp.pointer(), DATA_FLOAT_MAT4, 16, false, paramIndex, smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, uniform, mvp.pointer(), DATA_FLOAT_MAT4, 16, false, paramIndex, getNodeIndex(sgNode));
 }
 
 void ShaderManager::setMVPForParticles(SGNode *sgNode, u16 paramIndex)
@@ -594,13 +623,13 @@ void ShaderManager::setMVPForParticles(SGNode *sgNode, u16 paramIndex)
     eColor[2] = pNode->endColor.z;
     eColor[3] = pNode->endColor.w;
     
-    smgr->setPropertyValue(sgNode->node->material, "props", particleProps, DATA_FLOAT_VEC4, 4, false, SHADER_PARTICLE_props, smgr->getNodeIndexByID(sgNode->node->getID()));
-    smgr->setPropertyValue(sgNode->node->material, "startColor", sColor, DATA_FLOAT_VEC4, 4, false, SHADER_PARTICLE_sColor, smgr->getNodeIndexByID(sgNode->node->getID()));
-    smgr->setPropertyValue(sgNode->node->material, "midColor", mColor, DATA_FLOAT_VEC4, 4, false, SHADER_PARTICLE_mColor, smgr->getNodeIndexByID(sgNode->node->getID()));
-    smgr->setPropertyValue(sgNode->node->material, "endColor", eColor, DATA_FLOAT_VEC4, 4, false, SHADER_PARTICLE_eColor, smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, propsUniform, particleProps, DATA_FLOAT_VEC4, 4, false, SHADER_PARTICLE_props, getNodeIndex(sgNode));
+    smgr->setPropertyValue(sgNode->node->material, startColorUniform, sColor, DATA_FLOAT_VEC4, 4, false, SHADER_PARTICLE_sColor, getNodeIndex(sgNode));
+    smgr->setPropertyValue(sgNode->node->material, midColorUniform, mColor, DATA_FLOAT_VEC4, 4, false, SHADER_PARTICLE_mColor, getNodeIndex(sgNode));
+    smgr->setPropertyValue(sgNode->node->material, endColorUniform, eColor, DATA_FLOAT_VEC4, 4, false, SHADER_PARTICLE_eColor, getNodeIndex(sgNode));
     
-    smgr->setPropertyValue(sgNode->node->material, "vp", vp.pointer(), DATA_FLOAT_MAT4, 16, false, SHADER_PARTICLE_vp, smgr->getNodeIndexByID(sgNode->node->getID()));
-    smgr->setPropertyValue(sgNode->node->material, "model", model.pointer(), DATA_FLOAT_MAT4, 16, false, SHADER_PARTICLE_world, smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, vpUniform, vp.pointer(), DATA_FLOAT_MAT4, 16, false, SHADER_PARTICLE_vp, getNodeIndex(sgNode));
+    smgr->setPropertyValue(sgNode->node->material, modelUniform, model.pointer(), DATA_FLOAT_MAT4, 16, false, SHADER_PARTICLE_world, getNodeIndex(sgNode));
     
     delete [] particleProps;
     delete [] sColor;
@@ -629,7 +658,7 @@ void ShaderManager::setModelMatrix(SGNode *sgNode, u16 paramIndex)
         copyIncrement += 16;
     }
     
-    smgr->setPropertyValue(sgNode->node->material, "model", modelArray, DATA_FLOAT_MAT4, ((endIndex - startIndex)+1) * 16, false, paramIndex, smgr->getNodeIndexByID(sgNode->node->getID()));
+    smgr->setPropertyValue(sgNode->node->material, modelUniform, modelArray, DATA_FLOAT_MAT4, ((endIndex - startIndex)+1) * 16, false, paramIndex, getNodeIndex(sgNode));
     
     delete [] modelArray;
 }
@@ -643,17 +672,23 @@ void ShaderManager::copyMat(float* pointer,Mat4& mat)
 void ShaderManager::setJointTransform(SGNode *sgNode, int paramIndex, SceneManager *smgr)
 {
     SkinMesh *sMesh = (SkinMesh*)(dynamic_pointer_cast<AnimatedMeshNode>(sgNode->node))->getMesh();
-    float* JointArray = new float[sMesh->joints->size() * 16];
-    int copyIncrement = 0;
+    jointData.resize(sMesh->joints->size() * 16);
     
     for(int i = 0; i < sMesh->joints->size(); ++i){
         Mat4 JointVertexPull;
         JointVertexPull.setbyproduct((*sMesh->joints)[i]->GlobalAnimatedMatrix, (*sMesh->joints)[i]->GlobalInversedMatrix);
-        copyMat(JointArray + copyIncrement, JointVertexPull);
-        copyIncrement += 16;
+        copyMat(&jointData[i * 16], JointVertexPull);
     }
-    smgr->setPropertyValue(sgNode->node->material, "jointTransforms", JointArray, DATA_FLOAT_MAT4, sMesh->joints->size() * 16, false, paramIndex, smgr->getNodeIndexByID(sgNode->node->getID()));
-    delete [] JointArray;
+    if(jointData.size())
+        smgr->setPropertyValue(sgNode->node->material, jointTransformsUniform, &jointData[0], DATA_FLOAT_MAT4, jointData.size(), false, paramIndex, getNodeIndex(sgNode));
+}
+
+int ShaderManager::getNodeIndex(SGNode *sgNode)
+{
+    // Every setter of a draw asks for the same node, so the last index is checked before searching
+    if(uniformNodeIndex < 0 || uniformNodeIndex >= smgr->nodes.size() || smgr->nodes[uniformNodeIndex] != sgNode->node)
+        uniformNodeIndex = smgr->getNodeIndexByID(sgNode->node->getID());
+    return uniformNodeIndex;
 }
 
 Mat4 ShaderManager::ortho2d_oc(float left, float right, float bottom, float top, float near, float far)
@@ -45,9 +45,8 @@ bool exportSGR::writeSGR(std::string filePath,shared_ptr<AnimatedMeshNode> node)
     unsigned int indicesCount = mesh->getIndicesCount(0);
     FileHelper::writeInt(&filePointer, indicesCount); // write IndexCount
     
-    unsigned short *indicesArr = mesh->getIndicesArray(0);
     for(int k = 0; k < indicesCount; k++) {
-        unsigned int index = indicesArr[k];
+        unsigned int index = mesh->getIndex(0, k);
         FileHelper::writeInt(&filePointer, index);	// write Vertex Index
     }
     
@@ -106,9 +105,8 @@ bool exportSGR::createSGR(std::string filePath,shared_ptr<MeshNode> node, std::m
     unsigned int indicesCount = mesh->getIndicesCount(0);
 	FileHelper::writeInt(&filePointer,indicesCount); // write IndexCount
 	
-    unsigned short *indicesArr = mesh->getIndicesArray(0);
     for(int k = 0; k < indicesCount; k++){
-        unsigned int index = indicesArr[k];
+        unsigned int index = mesh->getIndex(0, k);
 		FileHelper::writeInt(&filePointer,index);	// write Vertex Index
     }
 	short boneCount = rigKeys.size();
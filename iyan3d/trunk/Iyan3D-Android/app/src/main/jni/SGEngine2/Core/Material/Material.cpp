@@ -14,3 +14,43 @@ Material::Material(){
 Material::~Material(){
     
 }
+
+// Function statics, so IDs can be looked up while other files initialize their statics
+static std::map<string, u16>& getUniformIds()
+{
+    static std::map<string, u16> uniformIds;
+    return uniformIds;
+}
+
+static vector<string>& getUniformNames()
+{
+    static vector<string> uniformNames;
+    return uniformNames;
+}
+
+u16 Material::getUniformId(string name)
+{
+    std::map<string, u16>::iterator it = getUniformIds().find(name);
+    if(it != getUniformIds().end())
+        return it->second;
+    
+    u16 uniformId = getUniformNames().size();
+    getUniformIds()[name] = uniformId;
+    getUniformNames().push_back(name);
+    return uniformId;
+}
+
+string Material::getUniformName(u16 uniformId)
+{
+    return (uniformId < getUniformNames().size()) ? getUniformNames()[uniformId] : "";
+}
+
+short Material::setPropertyValue(u16 uniformId, float *values, DATA_TYPE type, u16 count, u16 paramIndex, int nodeIndex, int materialIndex, int rTTIndex)
+{
+    return setPropertyValue(getUniformName(uniformId), values, type, count, paramIndex, nodeIndex, materialIndex, rTTIndex);
+}
+
+short Material::setPropertyValue(u16 uniformId, int *values, DATA_TYPE type, u16 count, u16 paramIndex, int nodeIndex, int materialIndex, int rTTIndex)
+{
+    return setPropertyValue(getUniformName(uniformId), values, type, count, paramIndex, nodeIndex, materialIndex, rTTIndex);
+}
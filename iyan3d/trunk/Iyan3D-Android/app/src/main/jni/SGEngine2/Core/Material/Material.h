@@ -10,6 +10,7 @@
 #define __SGEngine2__Material__
 
 #include <iostream>
+#include <map>
 #include "../common/common.h"
 
 class Material {
@@ -21,8 +22,16 @@ public:
     Material();
     virtual ~Material();
     
+    // Uniform names map to process wide IDs, so callers can look a name up
+    // once and materials can index their uniforms by ID on every draw
+    static u16 getUniformId(string name);
+    static string getUniformName(u16 uniformId);
+    
     virtual short setPropertyValue(string name, float *values, DATA_TYPE type, u16 count, u16 paramIndex = 0, int nodeIndex = NOT_EXISTS, int materialIndex = NOT_EXISTS, int rTTIndex = NOT_EXISTS) = 0;
     virtual short setPropertyValue(string name, int *values, DATA_TYPE type, u16 count, u16 paramIndex = 0, int nodeIndex = NOT_EXISTS, int materialIndex = NOT_EXISTS, int rTTIndex = NOT_EXISTS) = 0;
+    // By default these forward to the name versions
+    virtual short setPropertyValue(u16 uniformId, float *values, DATA_TYPE type, u16 count, u16 paramIndex = 0, int nodeIndex = NOT_EXISTS, int materialIndex = NOT_EXISTS, int rTTIndex = NOT_EXISTS);
+    virtual short setPropertyValue(u16 uniformId, int *values, DATA_TYPE type, u16 count, u16 paramIndex = 0, int nodeIndex = NOT_EXISTS, int materialIndex = NOT_EXISTS, int rTTIndex = NOT_EXISTS);
 };
 
 #endif /* defined(__SGEngine2__Material__) */
@@ -18,7 +18,11 @@
 
 OGLMaterial::OGLMaterial()
 {
-    
+    shaderProgram = 0;
+    for(int i = 0; i < MAX_VERTEX_DATA; i++)
+        attributeSlots[i] = NOT_EXISTS;
+    for(int i = 0; i < MAX_VERTEX_DATA_SKINNED; i++)
+        skinnedAttributeSlots[i] = NOT_EXISTS;
 }
 
 OGLMaterial::~OGLMaterial()
@@ -33,7 +37,12 @@ OGLMaterial::~OGLMaterial()
         glDeleteProgram(shaderProgram);
         shaderProgram = 0;
     }
+    for(int i = 0; i < uniforms.size(); i++) {
+        if(uniforms[i].values)
+            delete [] (unsigned char*)uniforms[i].values;
+    }
     uniforms.clear();
+    uniformSlots.clear();
     attributes.clear();
 }
 
@@ -56,77 +65,65 @@ void OGLMaterial::AddProperty(string propertyName, DATA_TYPE type, u16 paramInde
     uni.nodeIndex = nodeIndex;
     uni.values = NULL;
     uni.isUpdated = true;
+    setUniformSlot(getUniformId(propertyName), uniforms.size());
     uniforms.push_back(uni);
 }
 
-short OGLMaterial::setPropertyValue(string name, int *values, DATA_TYPE type, u16 count, u16 paramIndex, int nodeIndex, int materialIndex, int renderTargetIndex)
+void OGLMaterial::setUniformSlot(u16 uniformId, short slot)
 {
-    short uniformNodeIndex = NOT_EXISTS;
-    for(int i = 0; i < uniforms.size(); i++) {
-        OGLUniform* uniform = &uniforms[i];
-        if(uniform->name == name) {
-            if(uniform->values == NULL || uniform->count != count)
-                uniform->values = new int[count];
-            
-            if(uniform->count != count || memcmp(uniform->values, values, count * sizeof(int)) != 0) {
-                memcpy(uniform->values, values, count * sizeof(int));
-                uniform->count = count;
-                uniform->isUpdated = true;
-            }
+    if(uniformId >= uniformSlots.size())
+        uniformSlots.resize(uniformId + 1, NOT_EXISTS);
+    uniformSlots[uniformId] = slot;
+}
 
-            uniformNodeIndex = i;
-            break;
-        }
-    }
-    
-    if(uniformNodeIndex == NOT_EXISTS) {
-        uint location = glGetUniformLocation(shaderProgram, name.c_str());
-        AddProperty(name, type, 0, count, location, nodeIndex);
-        uniformNodeIndex = uniforms.size()-1;
-        uniforms[uniformNodeIndex].values = new int[count];
-        memcpy(uniforms[uniformNodeIndex].values, values, count * sizeof(int));
-        uniforms[uniformNodeIndex].count = count;
-        uniforms[uniformNodeIndex].isUpdated = true;
-    }
+short OGLMaterial::getUniformSlot(u16 uniformId, DATA_TYPE type, int nodeIndex)
+{
+    if(uniformId < uniformSlots.size() && uniformSlots[uniformId] != NOT_EXISTS)
+        return uniformSlots[uniformId];
     
-    if(uniformNodeIndex == NOT_EXISTS) {
-        Logger::log(ERROR, "OGLMaterial", "Error in setting" + name + "Property");
+    // Not active in the program, the location is -1 and uploads are ignored by GL
+    string name = getUniformName(uniformId);
+    AddProperty(name, type, 0, 0, glGetUniformLocation(shaderProgram, name.c_str()), nodeIndex);
+    return uniforms.size() - 1;
+}
+
+void OGLMaterial::setUniformValues(OGLUniform &uniform, void *values, size_t valueSize, DATA_TYPE type, u16 count)
+{
+    if(uniform.values == NULL || uniform.count != count) {
+        if(uniform.values)
+            delete [] (unsigned char*)uniform.values;
+        uniform.values = new unsigned char[count * valueSize];
+        memcpy(uniform.values, values, count * valueSize);
+        uniform.count = count;
+        uniform.isUpdated = true;
+    } else if(memcmp(uniform.values, values, count * valueSize) != 0) {
+        memcpy(uniform.values, values, count * valueSize);
+        uniform.isUpdated = true;
     }
-    return uniformNodeIndex;
+    uniform.type = type;
+}
+
+short OGLMaterial::setPropertyValue(string name, int *values, DATA_TYPE type, u16 count, u16 paramIndex, int nodeIndex, int materialIndex, int renderTargetIndex)
+{
+    return setPropertyValue(getUniformId(name), values, type, count, paramIndex, nodeIndex, materialIndex, renderTargetIndex);
 }
 
 short OGLMaterial::setPropertyValue(string name, float *values, DATA_TYPE type, u16 count, u16 paramIndex, int nodeIndex, int materialIndex, int renderTargetIndex)
 {
-    short uniformNodeIndex = NOT_EXISTS;
-    for(int i = 0; i < uniforms.size(); i++) {
-        OGLUniform* uniform = &uniforms[i];
-        if(uniform->name == name) {
-            if(uniform->values == NULL || uniform->count != count)
-                uniform->values = new float[count];
+    return setPropertyValue(getUniformId(name), values, type, count, paramIndex, nodeIndex, materialIndex, renderTargetIndex);
+}
 
-            if(uniform->count != count || memcmp(uniform->values, values, count * sizeof(float)) != 0) {
-                memcpy(uniform->values, values, count * sizeof(float));
-                uniform->count = count;
-                uniform->isUpdated = true;
-            }
-            uniformNodeIndex = i;
-            break;
-        }
-    }
-    
-    if(uniformNodeIndex == NOT_EXISTS) {
-        uint location = glGetUniformLocation(shaderProgram, name.c_str());
-        AddProperty(name, type, 0, count, location, nodeIndex);
-        uniformNodeIndex = uniforms.size()-1;
-        uniforms[uniformNodeIndex].values = new float[count];
-        memcpy(uniforms[uniformNodeIndex].values, values, count * sizeof(float));
-        uniforms[uniformNodeIndex].count = count;
-        uniforms[uniformNodeIndex].isUpdated = true;
-    }
-    
-    if(uniformNodeIndex == NOT_EXISTS)
-        Logger::log(ERROR, "OGLMaterial", "Error in setting" + name + "Property");
+short OGLMaterial::setPropertyValue(u16 uniformId, int *values, DATA_TYPE type, u16 count, u16 paramIndex, int nodeIndex, int materialIndex, int renderTargetIndex)
+{
+    short uniformNodeIndex = getUniformSlot(uniformId, type, nodeIndex);
+    setUniformValues(uniforms[uniformNodeIndex], values, sizeof(int), type, count);
+    return uniformNodeIndex;
+}
 
+short OGLMaterial::setPropertyValue(u16 uniformId, float *values, DATA_TYPE type, u16 count, u16 paramIndex, int nodeIndex, int materialIndex, int renderTargetIndex)
+{
+    short uniformNodeIndex = getUniformSlot(uniformId, type, nodeIndex);
+    setUniformValues(uniforms[uniformNodeIndex], values, sizeof(float), type, count);
     return uniformNodeIndex;
 }
 
@@ -136,24 +133,63 @@ bool OGLMaterial::LoadShaders(string vShaderName, string fShaderName, std::map<
     GLuint fShaderHandle = CompileShader(fShaderName, GL_FRAGMENT_SHADER, shadersStr);
     shaderProgram = LinkShaders(vShaderHandle, fShaderHandle);
     glUseProgram(shaderProgram);
+    ReflectAttributes();
+    ReflectUniforms();
+
+    if(vShaderHandle == -1 || fShaderHandle == -1 || shaderProgram == -1)
+            return false;
+    
+    return true;
+}
+
+void OGLMaterial::ReflectAttributes()
+{
     GLint maxNameLength = 0;
     glGetProgramiv(shaderProgram, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxNameLength);
     int maxAttrib = NOT_EXISTS;
     glGetProgramiv(shaderProgram, GL_ACTIVE_ATTRIBUTES, &maxAttrib);
     
+    vector<char> attribName(max(maxNameLength, 1));
     for(int i = 0; i < maxAttrib; i++) {
         GLint length = 0, size = 0;
-        GLenum type; char attribName[maxNameLength];
-        glGetActiveAttrib(shaderProgram, i, maxNameLength, &length, &size, &type, attribName);
-        attribName[length] = '\0';
-        string attribNameStr = string(attribName);
+        GLenum type;
+        glGetActiveAttrib(shaderProgram, i, attribName.size(), &length, &size, &type, &attribName[0]);
+        string attribNameStr = string(&attribName[0], length);
         AddAttributes(attribNameStr, Helper::getSGEngineDataType(type), CreateAttribute(shaderProgram, attribNameStr), 0);
     }
+    
+    // Vertex layouts are fixed, so the attribute of every layout slot is resolved once here
+    for(int i = 0; i < MAX_VERTEX_DATA; i++)
+        attributeSlots[i] = getMaterialAttribIndexByName(attributesName[i]);
+    for(int i = 0; i < MAX_VERTEX_DATA_SKINNED; i++)
+        skinnedAttributeSlots[i] = getMaterialAttribIndexByName(attributesNameSkinned[i]);
+}
 
-    if(vShaderHandle == -1 || fShaderHandle == -1 || shaderProgram == -1)
-            return false;
+void OGLMaterial::ReflectUniforms()
+{
+    GLint maxNameLength = 0;
+    glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    int maxUniforms = 0;
+    glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &maxUniforms);
+    if(maxNameLength <= 0)
+        return;
     
-    return true;
+    vector<char> uniformName(maxNameLength);
+    for(int i = 0; i < maxUniforms; i++) {
+        GLint length = 0, size = 0;
+        GLenum type;
+        glGetActiveUniform(shaderProgram, i, uniformName.size(), &length, &size, &type, &uniformName[0]);
+        
+        // Arrays are reported as name[0], the engine sets them by their base name
+        string uniformNameStr = string(&uniformName[0], length);
+        size_t arrayPos = uniformNameStr.find('[');
+        if(arrayPos != string::npos)
+            uniformNameStr = uniformNameStr.substr(0, arrayPos);
+        
+        u16 uniformId = getUniformId(uniformNameStr);
+        if(uniformId >= uniformSlots.size() || uniformSlots[uniformId] == NOT_EXISTS)
+            AddProperty(uniformNameStr, DATA_FLOAT, 0, 0, CreateUniform(shaderProgram, uniformNameStr));
+    }
 }
 
 string OGLMaterial::getShaderAttributeNameByIndex(int i)
@@ -169,12 +205,10 @@ string OGLMaterial::getShaderAttributeNameByIndex(int i)
 
     GLint length = 0, size = 0;
     GLenum type;
-    char attribName[maxNameLength];
-    
-    glGetActiveAttrib(shaderProgram,i,maxNameLength,&length,&size,&type,attribName);
-    attribName[length] = '\0';
+    vector<char> attribName(max(maxNameLength, 1));
     
-    return string(attribName);
+    glGetActiveAttrib(shaderProgram,i,attribName.size(),&length,&size,&type,&attribName[0]);
+    return string(&attribName[0], length);
 }
 
 int OGLMaterial::getMaterialAttribIndexByName(string name)
@@ -43,9 +43,21 @@ struct attribute{
 
 class OGLMaterial : public Material{
     
+private:
+    // Index into uniforms for every Material uniform ID, NOT_EXISTS until the name is first used
+    vector<short> uniformSlots;
+    
+    short getUniformSlot(u16 uniformId, DATA_TYPE type, int nodeIndex);
+    void setUniformSlot(u16 uniformId, short slot);
+    void setUniformValues(OGLUniform &uniform, void *values, size_t valueSize, DATA_TYPE type, u16 count);
+    void ReflectUniforms();
+    void ReflectAttributes();
+    
 public:
     vector<OGLUniform> uniforms;
     vector<attribute> attributes;
+    short attributeSlots[MAX_VERTEX_DATA];
+    short skinnedAttributeSlots[MAX_VERTEX_DATA_SKINNED];
     uint32_t shaderProgram;
     
     OGLMaterial();
@@ -54,6 +66,8 @@ public:
     void AddProperty(string propertyName, DATA_TYPE type,u16 paramIndex = 0,u16 count = 1,uint32_t location = 0,short nodeIndex = NOT_EXISTS);
     virtual short setPropertyValue(string name,float *values,DATA_TYPE type,u16 count,u16 paramIndex = 0,int nodeIndex = NOT_EXISTS, int materialIndex = NOT_EXISTS, int renderTargetIndex = NOT_EXISTS);
     virtual short setPropertyValue(string name,int *values,DATA_TYPE type,u16 count,u16 paramIndex = 0,int nodeIndex = NOT_EXISTS, int materialIndex = NOT_EXISTS, int renderTargetIndex = NOT_EXISTS);
+    virtual short setPropertyValue(u16 uniformId,float *values,DATA_TYPE type,u16 count,u16 paramIndex = 0,int nodeIndex = NOT_EXISTS, int materialIndex = NOT_EXISTS, int renderTargetIndex = NOT_EXISTS);
+    virtual short setPropertyValue(u16 uniformId,int *values,DATA_TYPE type,u16 count,u16 paramIndex = 0,int nodeIndex = NOT_EXISTS, int materialIndex = NOT_EXISTS, int renderTargetIndex = NOT_EXISTS);
     bool LoadShaders(string vShaderName,string fShaderName, std::map< string, string > shadersStr);
     GLuint CompileShader(string shaderName,GLenum shaderType, std::map< string, string > shadersStr);
     GLuint LinkShaders(GLuint vShaderHandle,GLuint fShaderHandle);
@@ -14,6 +14,7 @@ Mesh::Mesh()
     clearVerticesArray();
     clearIndicesArray();
     instanceCount = 0;
+    hasSplitMeshBuffers = false;
 }
 
 Mesh::~Mesh()
@@ -27,6 +28,7 @@ void Mesh::addMeshBuffer(vector<vertexData> mbvd, vector<unsigned short> mbi, un
 {
     meshBufferVerticesData.push_back(mbvd);
     meshBufferIndices.push_back(mbi);
+    meshBufferIndices32.push_back(vector<unsigned int>());
     meshBufferMaterialIndices.push_back(materialIndex);
     
     if(updateBB) {
@@ -43,6 +45,7 @@ void Mesh::addMeshBuffer(vector<vertexDataHeavy> mbvd, vector<unsigned short> mb
 {
     meshBufferVerticesDataHeavy.push_back(mbvd);
     meshBufferIndices.push_back(mbi);
+    meshBufferIndices32.push_back(vector<unsigned int>());
     meshBufferMaterialIndices.push_back(materialIndex);
     
     if(updateBB) {
@@ -55,19 +58,99 @@ void Mesh::addMeshBuffer(vector<vertexDataHeavy> mbvd, vector<unsigned short> mb
     BBox.calculateEdges();
 }
 
+void Mesh::addMeshBuffer(vector<vertexData> mbvd, vector<unsigned int> mbi, unsigned short materialIndex, bool updateBB)
+{
+    if(addSplitMeshBuffer(mbvd, mbi, materialIndex, updateBB))
+        return;
+    unsigned int verticesCount = (unsigned int)mbvd.size();
+    addMeshBuffer(mbvd, vector<unsigned short>(), materialIndex, updateBB);
+    addIndices(mbi, verticesCount);
+}
+
+void Mesh::addMeshBuffer(vector<vertexDataHeavy> mbvd, vector<unsigned int> mbi, unsigned short materialIndex, bool updateBB)
+{
+    if(addSplitMeshBuffer(mbvd, mbi, materialIndex, updateBB))
+        return;
+    unsigned int verticesCount = (unsigned int)mbvd.size();
+    addMeshBuffer(mbvd, vector<unsigned short>(), materialIndex, updateBB);
+    addIndices(mbi, verticesCount);
+}
+
+template <typename VertexType>
+bool Mesh::addSplitMeshBuffer(vector<VertexType> &mbvd, vector<unsigned int> &mbi, unsigned short materialIndex, bool updateBB)
+{
+    LoadedMeshBuffer loaded;
+    loaded.firstMeshBuffer = getMeshBufferCount();
+    if(mbvd.size() <= MAX_VERTICES_COUNT || common::supportsIndex32) {
+        loadedMeshBuffers.push_back(loaded);
+        return false;
+    }
+    
+    // Without 32 bit indices the triangles are spread over buffers of at most MAX_VERTICES_COUNT
+    // vertices, vertices shared across buffers are copied into each of them
+    const unsigned int notAdded = (unsigned int)NOT_EXISTS;
+    vector<unsigned int> newIndexOf(mbvd.size(), notAdded);
+    vector<unsigned int> added;
+    vector<VertexType> splitVertices;
+    vector<unsigned short> splitIndices;
+    loaded.vertexCopies.resize(mbvd.size());
+    
+    for(size_t t = 0; t + 2 < mbi.size(); t += 3) {
+        if(mbi[t] >= mbvd.size() || mbi[t + 1] >= mbvd.size() || mbi[t + 2] >= mbvd.size())
+            continue;
+        
+        if(splitVertices.size() + 3 > MAX_VERTICES_COUNT) {
+            addMeshBuffer(splitVertices, splitIndices, materialIndex, updateBB);
+            splitVertices.clear();
+            splitIndices.clear();
+            for(size_t i = 0; i < added.size(); i++)
+                newIndexOf[added[i]] = notAdded;
+            added.clear();
+        }
+        
+        for(int c = 0; c < 3; c++) {
+            unsigned int index = mbi[t + c];
+            if(newIndexOf[index] == notAdded) {
+                newIndexOf[index] = (unsigned int)splitVertices.size();
+                splitVertices.push_back(mbvd[index]);
+                added.push_back(index);
+                SplitVertex copy = { getMeshBufferCount(), newIndexOf[index] };
+                loaded.vertexCopies[index].push_back(copy);
+            }
+            splitIndices.push_back(newIndexOf[index]);
+        }
+    }
+    if(splitIndices.size())
+        addMeshBuffer(splitVertices, splitIndices, materialIndex, updateBB);
+    
+    loadedMeshBuffers.push_back(loaded);
+    hasSplitMeshBuffers = true;
+    return true;
+}
+
+void Mesh::addIndices(vector<unsigned int> &mbi, unsigned int verticesCount)
+{
+    // Buffers that fit in 16 bits keep the smaller index type, only larger ones pay for 32 bit indices
+    int mbIndex = (int)meshBufferIndices.size() - 1;
+    if(verticesCount > MAX_VERTICES_COUNT)
+        meshBufferIndices32[mbIndex].swap(mbi);
+    else
+        meshBufferIndices[mbIndex].assign(mbi.begin(), mbi.end());
+}
+
 void Mesh::copyDataFromMesh(Mesh* otherMesh)
 {
     if(otherMesh->meshType == MESH_TYPE_LITE) {
         for( int i = 0; i < otherMesh->getMeshBufferCount(); i++) {
             vector< vertexData > mbvd = otherMesh->getLiteVerticesArray(i);
-            vector< unsigned short > mbi = otherMesh->getIndicesArrayAtMeshBufferIndex(i);
+            vector< unsigned int > mbi = otherMesh->getIndices32ArrayAtMeshBufferIndex(i);
             unsigned short materialIndex = otherMesh->getMeshBufferMaterialIndices(i);
             addMeshBuffer(mbvd, mbi, materialIndex);
         }
     } else {
         for( int i = 0; i < otherMesh->getMeshBufferCount(); i++) {
             vector< vertexDataHeavy > mbhvd = otherMesh->getHeavyVerticesArray(i);
-            vector< unsigned short > mbi = otherMesh->getIndicesArrayAtMeshBufferIndex(i);
+            vector< unsigned int > mbi = otherMesh->getIndices32ArrayAtMeshBufferIndex(i);
             unsigned short materialIndex = otherMesh->getMeshBufferMaterialIndices(i);
             addMeshBuffer(mbhvd, mbi, materialIndex);
         }
@@ -84,11 +167,11 @@ void Mesh::copyInstanceToMeshCache(Mesh *originalMesh, int instanceIndex)
         
         unsigned int verticesCount = originalMesh->getVerticesCountInMeshBuffer(0);
         vector < vertexData > newVertices;
-        vector< unsigned short > newIndices;
+        vector< unsigned int > newIndices;
         
         int mbCount = getMeshBufferCount();
         int lastMBSize = (mbCount > 0) ? meshBufferVerticesData[mbCount - 1].size() : 0;
-        bool insertInLastMeshBuffer = (mbCount > 0) ? ((lastMBSize + verticesCount) < MAX_VERTICES_COUNT) : false;
+        bool insertInLastMeshBuffer = (mbCount > 0) ? (!isIndex32(mbCount - 1) && (lastMBSize + verticesCount) < MAX_VERTICES_COUNT) : false;
 
         for( int i = 0; i < verticesCount; i++) {
             vertexData *v1 = originalMesh->getLiteVerticesForMeshBuffer(0, i);
@@ -109,7 +192,7 @@ void Mesh::copyInstanceToMeshCache(Mesh *originalMesh, int instanceIndex)
         
         
         for(int i = 0; i < originalMesh->getIndicesCount(0); i++) {
-            unsigned short index = originalMesh->getIndicesArrayAtMeshBufferIndex(0)[i];
+            unsigned int index = originalMesh->getIndex(0, i);
             if(insertInLastMeshBuffer) {
                 meshBufferIndices[mbCount - 1].push_back(lastMBSize + index);
             } else {
@@ -137,15 +220,20 @@ void Mesh::removeVerticesOfAnInstance(int verticesCount, int indicesCount)
     
     meshBufferVerticesData[lastMBIndex].erase(beginIt, endIt);
     
-    std::vector< unsigned short >::iterator beginIndIt;
-    std::vector< unsigned short >::iterator endIndIt;
     lastMBIndex = meshBufferIndices.size() - 1;
-    lastMBSize = meshBufferIndices[lastMBIndex].size();
-
-    beginIndIt = (lastMBSize > indicesCount) ? (meshBufferIndices[lastMBIndex].begin() + (lastMBSize - indicesCount)) : meshBufferIndices[lastMBIndex].begin();
-    endIndIt = meshBufferIndices[lastMBIndex].end();
+    lastMBSize = getIndicesCount(lastMBIndex);
     
-    meshBufferIndices[lastMBIndex].erase(beginIndIt, endIndIt);
+    if(isIndex32(lastMBIndex)) {
+        meshBufferIndices32[lastMBIndex].resize((lastMBSize > indicesCount) ? lastMBSize - indicesCount : 0);
+    } else {
+        std::vector< unsigned short >::iterator beginIndIt;
+        std::vector< unsigned short >::iterator endIndIt;
+        
+        beginIndIt = (lastMBSize > indicesCount) ? (meshBufferIndices[lastMBIndex].begin() + (lastMBSize - indicesCount)) : meshBufferIndices[lastMBIndex].begin();
+        endIndIt = meshBufferIndices[lastMBIndex].end();
+        
+        meshBufferIndices[lastMBIndex].erase(beginIndIt, endIndIt);
+    }
     
     instanceCount--;
 }
@@ -155,6 +243,7 @@ Mesh* Mesh::clone()
     Mesh *m = new Mesh();
     m->meshType = meshType;
     m->meshBufferIndices = meshBufferIndices;
+    m->meshBufferIndices32 = meshBufferIndices32;
     m->meshBufferVerticesData = meshBufferVerticesData;
     m->meshBufferVerticesDataHeavy = meshBufferVerticesDataHeavy;
     m->meshBufferMaterialIndices = meshBufferMaterialIndices;
@@ -167,11 +256,12 @@ Mesh* Mesh::convert2Lite()
     Mesh *m = new Mesh();
     m->meshType = MESH_TYPE_LITE;
     m->meshBufferIndices.clear();
+    m->meshBufferIndices32.clear();
     m->meshBufferVerticesData.clear();
     
     for( int i = 0; i < getMeshBufferCount(); i++) {
         vector< vertexData > mbvd;
-        vector< unsigned short > mbi = getIndicesArrayAtMeshBufferIndex(i);
+        vector< unsigned int > mbi = getIndices32ArrayAtMeshBufferIndex(i);
         int materialIndex = getMeshBufferMaterialIndices(i);
         
         for( int j = 0; j < meshBufferVerticesDataHeavy[i].size(); j++){
@@ -210,6 +300,8 @@ void Mesh::clearIndicesArray()
         meshBufferIndices[i].clear();
     }
     meshBufferIndices.clear();
+    meshBufferIndices32.clear();
+    loadedMeshBuffers.clear();
 }
 
 vector<vertexData> Mesh::getLiteVerticesArray(int meshBufferIndex)
@@ -242,6 +334,57 @@ unsigned int Mesh::getVerticesCountInMeshBuffer(int meshBufferIndex)
     return 0;
 }
 
+vector< unsigned int > Mesh::getTotalIndicesArray()
+{
+    vector< unsigned int > indices;
+    indices.reserve(getTotalIndicesCount());
+    
+    unsigned int vertexOffset = 0;
+    for(int i = 0; i < getMeshBufferCount(); i++) {
+        unsigned int indicesCount = getIndicesCount(i);
+        for(unsigned int j = 0; j < indicesCount; j++)
+            indices.push_back(vertexOffset + getIndex(i, j));
+        vertexOffset += getVerticesCountInMeshBuffer(i);
+    }
+    return indices;
+}
+
+unsigned int Mesh::getTotalIndicesCount()
+{
+    unsigned int indicesCount = 0;
+    for(int i = 0; i < getMeshBufferCount(); i++)
+        indicesCount += getIndicesCount(i);
+    return indicesCount;
+}
+
+unsigned int Mesh::getVerticesCount()
+{
+    unsigned int verticesCount = 0;
+    for(int i = 0; i < getMeshBufferCount(); i++)
+        verticesCount += getVerticesCountInMeshBuffer(i);
+    return verticesCount;
+}
+
+vertexData* Mesh::getLiteVertexByIndex(unsigned int vertexIndex)
+{
+    for(int i = 0; i < meshBufferVerticesData.size(); i++) {
+        if(vertexIndex < meshBufferVerticesData[i].size())
+            return &meshBufferVerticesData[i][vertexIndex];
+        vertexIndex -= meshBufferVerticesData[i].size();
+    }
+    return NULL;
+}
+
+vertexDataHeavy* Mesh::getHeavyVertexByIndex(unsigned int vertexIndex)
+{
+    for(int i = 0; i < meshBufferVerticesDataHeavy.size(); i++) {
+        if(vertexIndex < meshBufferVerticesDataHeavy[i].size())
+            return &meshBufferVerticesDataHeavy[i][vertexIndex];
+        vertexIndex -= meshBufferVerticesDataHeavy[i].size();
+    }
+    return NULL;
+}
+
 BoundingBox* Mesh::getBoundingBox()
 {
     return &BBox;
@@ -252,13 +395,52 @@ vector< unsigned short > Mesh::getIndicesArrayAtMeshBufferIndex(int meshBufferIn
     return meshBufferIndices[meshBufferIndex];
 }
 
+vector< unsigned int > Mesh::getIndices32ArrayAtMeshBufferIndex(int meshBufferIndex)
+{
+    if(isIndex32(meshBufferIndex))
+        return meshBufferIndices32[meshBufferIndex];
+    
+    return vector< unsigned int >(meshBufferIndices[meshBufferIndex].begin(), meshBufferIndices[meshBufferIndex].end());
+}
+
 unsigned short* Mesh::getIndicesArray(int meshBufferIndex)
 {
     return &(meshBufferIndices[meshBufferIndex][0]);
 }
 
+unsigned int* Mesh::getIndices32Array(int meshBufferIndex)
+{
+    return &(meshBufferIndices32[meshBufferIndex][0]);
+}
+
+void* Mesh::getIndicesData(int meshBufferIndex)
+{
+    if(isIndex32(meshBufferIndex))
+        return meshBufferIndices32[meshBufferIndex].data();
+    return meshBufferIndices[meshBufferIndex].data();
+}
+
+unsigned int Mesh::getIndex(int meshBufferIndex, unsigned int index)
+{
+    if(isIndex32(meshBufferIndex))
+        return meshBufferIndices32[meshBufferIndex][index];
+    return meshBufferIndices[meshBufferIndex][index];
+}
+
+bool Mesh::isIndex32(int meshBufferIndex)
+{
+    return !meshBufferIndices32[meshBufferIndex].empty();
+}
+
+unsigned int Mesh::getIndexSize(int meshBufferIndex)
+{
+    return isIndex32(meshBufferIndex) ? sizeof(unsigned int) : sizeof(unsigned short);
+}
+
 unsigned int Mesh::getIndicesCount(int meshBufferIndex)
 {
+    if(isIndex32(meshBufferIndex))
+        return (unsigned int)(meshBufferIndices32[meshBufferIndex]).size();
     return (unsigned int )(meshBufferIndices[meshBufferIndex]).size();
 }
 
@@ -292,5 +474,7 @@ void Mesh::clearIndices()
         meshBufferIndices[i].clear();
     }
     meshBufferIndices.clear();
+    meshBufferIndices32.clear();
+    loadedMeshBuffers.clear();
 }
 
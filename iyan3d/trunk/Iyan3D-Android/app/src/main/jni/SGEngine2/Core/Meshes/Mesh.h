@@ -60,6 +60,18 @@ struct vertexCompare
     }
 };
 
+// Where a vertex of a buffer split for 16 bit indices was copied to
+struct SplitVertex {
+    int meshBufferIndex;
+    unsigned int vertexIndex;
+};
+
+// A buffer as it was passed to the 32 bit addMeshBuffer, vertexCopies is empty unless it was split
+struct LoadedMeshBuffer {
+    int firstMeshBuffer;
+    vector< vector<SplitVertex> > vertexCopies;
+};
+
 class Mesh {
 private:
     BoundingBox BBox;
@@ -68,8 +80,18 @@ private:
     vector< vector<vertexData> > meshBufferVerticesData;
     vector< vector<vertexDataHeavy> > meshBufferVerticesDataHeavy;
     vector< vector<unsigned short> > meshBufferIndices;
+    vector< vector<unsigned int> > meshBufferIndices32; // Used instead of meshBufferIndices by buffers past MAX_VERTICES_COUNT
     vector< unsigned short > meshBufferMaterialIndices;
 
+    void addIndices(vector<unsigned int> &mbi, unsigned int verticesCount);
+    template <typename VertexType>
+    bool addSplitMeshBuffer(vector<VertexType> &mbvd, vector<unsigned int> &mbi, unsigned short materialIndex, bool updateBB);
+
+protected:
+    // Lets data addressed by loaded buffer and vertex, like joint weights, follow the split buffers
+    vector<LoadedMeshBuffer> loadedMeshBuffers;
+    bool hasSplitMeshBuffers;
+
 public:
     MESH_TYPE meshType;
 
@@ -78,6 +100,8 @@ public:
     
     void addMeshBuffer(vector<vertexData> mbvd, vector<unsigned short> mbi, unsigned short materialIndex, bool updateBB = true);
     void addMeshBuffer(vector<vertexDataHeavy> mbvd, vector<unsigned short> mbi, unsigned short materialIndex, bool updateBB = true);
+    void addMeshBuffer(vector<vertexData> mbvd, vector<unsigned int> mbi, unsigned short materialIndex, bool updateBB = true);
+    void addMeshBuffer(vector<vertexDataHeavy> mbvd, vector<unsigned int> mbi, unsigned short materialIndex, bool updateBB = true);
     
     void copyDataFromMesh(Mesh* otherMesh);
     void copyInstanceToMeshCache(Mesh *originalMesh, int instanceIndex);
@@ -93,9 +117,22 @@ public:
     vertexData* getLiteVerticesForMeshBuffer(int meshBufferIndex, int vertexIndex);
 
     vector< unsigned short > getIndicesArrayAtMeshBufferIndex(int meshBufferIndex);
-    unsigned short* getIndicesArray(int meshBufferIndex);
+    vector< unsigned int > getIndices32ArrayAtMeshBufferIndex(int meshBufferIndex);
+    unsigned short* getIndicesArray(int meshBufferIndex); // 16 bit buffers only
+    unsigned int* getIndices32Array(int meshBufferIndex); // 32 bit buffers only
+    void* getIndicesData(int meshBufferIndex);
+    unsigned int getIndex(int meshBufferIndex, unsigned int index);
+    bool isIndex32(int meshBufferIndex);
+    unsigned int getIndexSize(int meshBufferIndex);
     unsigned int getIndicesCount(int meshBufferIndex);
     unsigned int getVerticesCountInMeshBuffer(int meshBufferIndex);
+    
+    // Whole mesh views, buffers are concatenated and indices offset into one 32 bit range
+    vector< unsigned int > getTotalIndicesArray();
+    unsigned int getTotalIndicesCount();
+    unsigned int getVerticesCount();
+    vertexData* getLiteVertexByIndex(unsigned int vertexIndex);
+    vertexDataHeavy* getHeavyVertexByIndex(unsigned int vertexIndex);
     int getMeshBufferCount();
     int getMeshBufferMaterialIndices(int meshBufferIndex);
 
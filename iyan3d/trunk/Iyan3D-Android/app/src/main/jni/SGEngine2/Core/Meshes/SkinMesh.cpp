@@ -127,8 +127,42 @@ Joint* SkinMesh::addJoint(Joint *parent)
     return joint;
 }
 
+void SkinMesh::moveWeightsToSplitBuffers()
+{
+    // Weights were read against the buffers as loaded, a vertex copied into several split buffers is weighted in each
+    for(int i = 0; i < joints->size(); i++) {
+        vector< shared_ptr<PaintedVertex> > *paintedVertices = (*joints)[i]->PaintedVertices.get();
+        vector< shared_ptr<PaintedVertex> > movedVertices;
+        for(int j = 0; j < paintedVertices->size(); j++) {
+            shared_ptr<PaintedVertex> pv = (*paintedVertices)[j];
+            if(pv->meshBufferIndex < 0 || pv->meshBufferIndex >= loadedMeshBuffers.size())
+                continue;
+            
+            LoadedMeshBuffer &loaded = loadedMeshBuffers[pv->meshBufferIndex];
+            if(loaded.vertexCopies.empty()) {
+                pv->meshBufferIndex = loaded.firstMeshBuffer;
+                movedVertices.push_back(pv);
+            } else if(pv->vertexId >= 0 && pv->vertexId < loaded.vertexCopies.size()) {
+                for(int c = 0; c < loaded.vertexCopies[pv->vertexId].size(); c++) {
+                    shared_ptr<PaintedVertex> copy = make_shared<PaintedVertex>();
+                    copy->vertexId = loaded.vertexCopies[pv->vertexId][c].vertexIndex;
+                    copy->weight = pv->weight;
+                    copy->meshBufferIndex = loaded.vertexCopies[pv->vertexId][c].meshBufferIndex;
+                    movedVertices.push_back(copy);
+                }
+            }
+        }
+        paintedVertices->swap(movedVertices);
+    }
+    hasSplitMeshBuffers = false;
+}
+
 void SkinMesh::finalize()
 {
+    if(hasSplitMeshBuffers)
+        moveWeightsToSplitBuffers();
+    loadedMeshBuffers.clear();
+    
     vector< Joint* > *reOrderedBones = new vector< Joint* >();
     
     for(int i = 0; i < joints->size(); i++) {
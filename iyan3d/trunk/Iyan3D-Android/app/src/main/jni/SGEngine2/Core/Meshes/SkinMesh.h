@@ -14,6 +14,9 @@
 #include "../Nodes/JointNode.h"
 
 class SkinMesh:public Mesh {
+private:
+    void moveWeightsToSplitBuffers();
+    
 public:
     int versionId;
     
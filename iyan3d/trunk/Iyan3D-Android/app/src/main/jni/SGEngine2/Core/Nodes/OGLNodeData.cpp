@@ -22,6 +22,9 @@ void initialiseDeleteVAOFunc()
 OGLNodeData::OGLNodeData()
 {
     VAOCreated = false;
+    boundTexture = 0;
+    backVertexBuffer = 0;
+    streamBufferSize = 0;
     IndexBufLocations.clear();
     vertexBufLocations.clear();
     vertexArrayLocations.clear();
@@ -37,6 +40,8 @@ OGLNodeData::~OGLNodeData()
 
     for(int i = 0; i < vertexBufLocations.size();i++)
         glDeleteBuffers(1,&vertexBufLocations[i]);
+    if(backVertexBuffer)
+        glDeleteBuffers(1, &backVertexBuffer);
     
     for(int i = 0; i < IndexBufLocations.size();i++)
         glDeleteBuffers(1,&IndexBufLocations[i]);
@@ -54,4 +59,9 @@ void OGLNodeData::removeVertexBuffers()
     for(int i = 0; i < vertexBufLocations.size();i++)
         glDeleteBuffers(1,&vertexBufLocations[i]);
     vertexBufLocations.clear();
+    
+    if(backVertexBuffer)
+        glDeleteBuffers(1, &backVertexBuffer);
+    backVertexBuffer = 0;
+    streamBufferSize = 0;
 }
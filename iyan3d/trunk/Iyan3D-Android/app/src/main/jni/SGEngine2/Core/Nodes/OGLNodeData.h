@@ -17,6 +17,9 @@
 class OGLNodeData: public APIData{
 public:
     bool VAOCreated;
+    u_int32_t boundTexture;
+    u_int32_t backVertexBuffer;
+    size_t streamBufferSize;
     std::vector<u_int32_t> vertexArrayLocations;
     std::vector<u_int32_t> vertexBufLocations;
     std::vector<u_int32_t> IndexBufLocations;
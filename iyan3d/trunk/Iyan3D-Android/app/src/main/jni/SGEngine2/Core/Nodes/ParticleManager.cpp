@@ -8,6 +8,8 @@
 
 #include "ParticleManager.h"
 
+static uint32_t emitterCount = 0;
+
 ParticleManager::ParticleManager()
 {
     type = NODE_TYPE_PARTICLES;
@@ -25,14 +27,23 @@ ParticleManager::ParticleManager()
     deltaScale = 0.001;
     isSelected = false;
     drawMode = DRAW_MODE_POINTS;
+    maxParticleCount = 0;
+    pool = NULL;
+    // Every emitter gets its own non zero xorshift seed
+    randomState = 0x9E3779B9u * ++emitterCount;
 }
 
 void ParticleManager::setDataFromJson(int count, Vector4 sColor, Vector4 mColor, Vector4 eColor, double gravity, float startSpreadAngle, float startMagnitude, float magnitudeRand, int emissionSpeed, int maxLife, int maxLifeRandPercent, float startScale, float deltaScale)
 {
     maxParticleCount = count;
+    if(pool)
+        delete pool;
     pool = new ParticlePool(count);
-    positions = (Vector4*)malloc(sizeof(Vector4) * count);
-    rotations = (Vector4*)malloc(sizeof(Vector4) * count);
+    positions.assign(count, Vector4(0.0));
+    rotations.assign(count, Vector4(0.0));
+    drawOrder.resize(count);
+    for (int i = 0; i < count; i++)
+        drawOrder[i] = i;
     startColor = sColor;
     midColor = mColor;
     endColor = eColor;
@@ -45,6 +56,11 @@ void ParticleManager::setDataFromJson(int count, Vector4 sColor, Vector4 mColor,
     this->maxLifeRandPercent = maxLifeRandPercent;
     this->startScale = startScale + getScale().x;
     this->deltaScale = deltaScale;
+    
+    if(meshCache) {
+        delete meshCache;
+        meshCache = NULL;
+    }
 }
 
 ParticleManager::~ParticleManager()
@@ -55,16 +71,6 @@ ParticleManager::~ParticleManager()
         delete pool;
         pool = NULL;
     }
-    
-    if(positions) {
-        delete positions;
-        positions = NULL;
-    }
-    
-    if(rotations) {
-        delete rotations;
-        rotations = NULL;
-    }
 }
 
 void ParticleManager::update()
@@ -73,84 +79,96 @@ void ParticleManager::update()
     
 }
 
-bool ParticleManager::updateParticles(bool isSelected, Vector3 camPos)
+float ParticleManager::getRandom()
 {
-    for (int i = 0; i < emissionSpeed/2; ++i) {
-        Particle *p = pool->reuseDeadParticle();
-        if(p) {
-            p->isLive = true;
-            p->age = maxLife * maxLifeRandPercent * 0.01f * rand()/(float)RAND_MAX;
-            p->position = getAbsoluteTransformation().getTranslation();
-            Vector3 direction = Vector3(0, 1, 0);
-            Mat4 rotMatix;
-            Quaternion rot = getRotation() * Vector3(- 0.5 + rand()/(float)RAND_MAX, 0.0, - 0.5 + rand()/(float)RAND_MAX) * startVelocitySpreadAngle * DEGTORAD;
-            rotMatix.setRotation(rot);
-            rotMatix.rotateVect(direction);
-            p->velocity = direction * (startVelocityMagnitude + rand()/RAND_MAX *  startVelocityMagnitudeRand);
-        } else break;
-    }
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return (randomState >> 8) / 16777216.0f;
+}
+
+void ParticleManager::emitParticles()
+{
+    Vector3 nodePos = getAbsoluteTransformation().getTranslation();
+    Quaternion nodeRotation = getRotation();
     
-    pool->resetIteration();
-    Particle* p = pool->getNextLiveParticle();
-    while(p != NULL) {
-        p->age++;
-        p->position += p->velocity;
-        
-        if(p->age > maxLife)
-            p->isLive = false;
+    for (int i = 0; i < emissionSpeed/2; ++i) {
+        int index = pool->emit();
+        if(index == NOT_EXISTS)
+            break;
         
-        p->velocity.y += gravity;
+        Vector3 direction = Vector3(0, 1, 0);
+        Mat4 rotMatix;
+        Quaternion rot = nodeRotation * Vector3(- 0.5 + getRandom(), 0.0, - 0.5 + getRandom()) * startVelocitySpreadAngle * DEGTORAD;
+        rotMatix.setRotation(rot);
+        rotMatix.rotateVect(direction);
+        Vector3 velocity = direction * (startVelocityMagnitude + getRandom() * startVelocityMagnitudeRand);
         
-        p = pool->getNextLiveParticle();
+        pool->live[index] = 1.0f;
+        pool->ages[index] = (int)(maxLife * maxLifeRandPercent * 0.01f * getRandom());
+        pool->positionX[index] = nodePos.x;
+        pool->positionY[index] = nodePos.y;
+        pool->positionZ[index] = nodePos.z;
+        pool->velocityX[index] = velocity.x;
+        pool->velocityY[index] = velocity.y;
+        pool->velocityZ[index] = velocity.z;
     }
+}
 
-    bool meshCacheCreated = false;
+void ParticleManager::createMeshCache()
+{
+    // Created once with a vertex per particle, later frames only rewrite the vertices in place
+    vector< vertexData > mbvd(maxParticleCount);
+    vector< unsigned short > mbi(maxParticleCount);
+    for (int i = 0; i < maxParticleCount; i++)
+        mbi[i] = i;
+    
+    this->meshCache = new Mesh();
+    this->meshCache->addMeshBuffer(mbvd, mbi, 0, false);
+}
+
+bool ParticleManager::updateParticles(bool isSelected, Vector3 camPos)
+{
+    if(!pool)
+        return false;
     
-    if(this->meshCache == NULL) {
-        this->meshCache = new Mesh();
-    } else
-        meshCacheCreated = true;
+    emitParticles();
+    pool->step(gravity, maxLife);
     
-    this->meshCache->clearVertices();
-    //if(!meshCacheCreated)
-        this->meshCache->clearIndices();
-    this->meshCache->getBoundingBox()->clearPoints();
+    this->isSelected = isSelected;
+    if(!isSelected)
+        pool->killAll();
+    sortParticles(camPos);
+    
+    bool meshCacheCreated = (this->meshCache != NULL);
+    if(!meshCacheCreated)
+        createMeshCache();
     
-    vector< vertexData > mbvd;
-    vector< unsigned short > mbi;
+    Vector3 nodePos = getAbsoluteTransformation().getTranslation();
+    Vector3 minEdge = nodePos, maxEdge = nodePos;
+    Vector4 rotation = Vector4(particleRotation.x, particleRotation.y, particleRotation.z, 0.0);
     
     for (int i = 0; i < maxParticleCount; i++) {
-        Particle* p = pool->getParticleByIndex(i);
-        this->isSelected = isSelected;
-        Vector3 nodePos = getAbsoluteTransformation().getTranslation();
-        
-        vertexData v;
-        
-        Vector4 finalPos;
-        if(!isSelected) {
-            finalPos = Vector4(nodePos.x, nodePos.y, nodePos.z, p->age);
-            p->isLive = false;
+        int index = drawOrder[i];
+        float age = pool->ages[index];
+        Vector3 position = nodePos;
+        if(pool->live[index] != 0.0f) {
+            position = Vector3(pool->positionX[index], pool->positionY[index], pool->positionZ[index]);
+            minEdge = Vector3(min(minEdge.x, position.x), min(minEdge.y, position.y), min(minEdge.z, position.z));
+            maxEdge = Vector3(max(maxEdge.x, position.x), max(maxEdge.y, position.y), max(maxEdge.z, position.z));
         }
         
-        if(p->isLive) {
-            if(isSelected)
-                finalPos = Vector4(p->position.x, p->position.y, p->position.z, p->age);
-        } else
-            finalPos = Vector4(nodePos.x, nodePos.y, nodePos.z, p->age);
-        
-        v.vertPosition = Vector3(finalPos.x, finalPos.y, finalPos.z);
-        v.vertNormal.x = finalPos.w;
-        v.vertNormal.y = finalPos.w;
-        v.vertNormal.z = finalPos.w;
-        
+        vertexData *v = this->meshCache->getLiteVerticesForMeshBuffer(0, i);
+        v->vertPosition = position;
+        v->vertNormal = Vector3(age);
         
-        mbvd.push_back(v);
-        //if(!meshCacheCreated) {
-            mbi.push_back(i);
-        //}
+        positions[i] = Vector4(position.x, position.y, position.z, age);
+        rotations[i] = rotation;
     }
     
-    this->meshCache->addMeshBuffer(mbvd, mbi, 0);
+    this->meshCache->getBoundingBox()->clearPoints();
+    this->meshCache->getBoundingBox()->addPointsToCalculateBoundingBox(minEdge);
+    this->meshCache->getBoundingBox()->addPointsToCalculateBoundingBox(maxEdge);
     this->shouldUpdateMesh = true;
     
     return meshCacheCreated;
@@ -171,25 +189,37 @@ Quaternion ParticleManager::rotationBetweenVectors(Vector3 targetDirection, Vect
 
 void ParticleManager::sortParticles(Vector3 position)
 {
+    if(!pool)
+        return;
+    
     for (int i = 0; i < maxParticleCount; i++) {
-        Particle* p = pool->getParticleByIndex(i);
-        if(p->isLive) {
-            p->distance = p->position.getDistanceFrom(position);
-        } else {
-            p->distance = 99999.99;
+        if(pool->live[i] != 0.0f)
+            pool->distances[i] = Vector3(pool->positionX[i], pool->positionY[i], pool->positionZ[i]).getDistanceFrom(position);
+        else
+            pool->distances[i] = 99999.99;
+    }
+    
+    // Farthest first, the order barely changes between frames so insertion sort stays close to linear
+    for (int i = 1; i < maxParticleCount; i++) {
+        int index = drawOrder[i];
+        float distance = pool->distances[index];
+        int j = i - 1;
+        while(j >= 0 && pool->distances[drawOrder[j]] < distance) {
+            drawOrder[j + 1] = drawOrder[j];
+            j--;
         }
+        drawOrder[j + 1] = index;
     }
-    pool->sortByDistance();
 }
 
 Vector4* ParticleManager::getPositions()
 {
-    return positions;
+    return (positions.size()) ? &positions[0] : NULL;
 }
 
 Vector4* ParticleManager::getRotations()
 {
-    return rotations;
+    return (rotations.size()) ? &rotations[0] : NULL;
 }
 
 Vector4 ParticleManager::getParticleProps()
@@ -31,8 +31,14 @@ private:
     double startScale;
     bool isSelected;
     
-    Vector4* positions;
-    Vector4* rotations;
+    uint32_t randomState;
+    vector<int> drawOrder;
+    vector<Vector4> positions;
+    vector<Vector4> rotations;
+    
+    float getRandom();
+    void emitParticles();
+    void createMeshCache();
 public:
     
     double deltaScale;
@@ -7,79 +7,70 @@
 //
 
 #include "../Nodes/ParticlePool.h"
+#include "../../Utilities/WorkerPool.h"
 #include <algorithm>
 
 ParticlePool::ParticlePool(int count)
 {
-    maxParticleCount = count;
-    for (int i = 0; i < count; i++) {
-        Particle* p = new Particle();
-        p->isLive = false;
-        particles.push_back(p);
-    }
+    maxParticleCount = max(count, 0);
+    nextParticle = 0;
+    positionX.assign(maxParticleCount, 0.0f);
+    positionY.assign(maxParticleCount, 0.0f);
+    positionZ.assign(maxParticleCount, 0.0f);
+    velocityX.assign(maxParticleCount, 0.0f);
+    velocityY.assign(maxParticleCount, 0.0f);
+    velocityZ.assign(maxParticleCount, 0.0f);
+    ages.assign(maxParticleCount, 0.0f);
+    distances.assign(maxParticleCount, 0.0f);
+    live.assign(maxParticleCount, 0.0f);
 }
 
 ParticlePool::~ParticlePool()
 {
-    for(int i = 0; i < particles.size(); i++) {
-        if(particles[i]) {
-            delete particles[i];
-            particles[i] = NULL;
-        }
-    }
-    particles.clear();
 }
 
-Particle* ParticlePool::reuseDeadParticle()
+int ParticlePool::emit()
 {
-    int stopIteration = deadIterator;
-    
-    while (particles[deadIterator]->isLive) {
-        deadIterator++;
-        if(deadIterator >= maxParticleCount)
-            deadIterator = 0;
-        if(deadIterator == stopIteration)
-            return NULL;
+    // Particles live for different spans, so look past the ring head for the next dead slot
+    for (int i = 0; i < maxParticleCount; i++) {
+        int index = nextParticle;
+        nextParticle = (nextParticle + 1) % maxParticleCount;
+        if(live[index] == 0.0f)
+            return index;
     }
-    
-    return particles[deadIterator];
+    return NOT_EXISTS;
 }
 
-Particle* ParticlePool::getNextLiveParticle()
+void ParticlePool::stepRange(int start, int end, float gravity, float maxLife)
 {
-    if(iterator >= maxParticleCount)
-        return NULL;
-    else {
-        while (!particles[iterator]->isLive) {
-            iterator++;
-            if(iterator >= maxParticleCount)
-                return NULL;
-        }
-        return particles[iterator++];
+    float *px = &positionX[0], *py = &positionY[0], *pz = &positionZ[0];
+    float *vx = &velocityX[0], *vy = &velocityY[0], *vz = &velocityZ[0];
+    float *age = &ages[0], *alive = &live[0];
+    
+    for (int i = start; i < end; i++) {
+        float l = alive[i];
+        age[i] += l;
+        px[i] += vx[i] * l;
+        py[i] += vy[i] * l;
+        pz[i] += vz[i] * l;
+        vy[i] += gravity * l;
+        alive[i] = (age[i] > maxLife) ? 0.0f : l;
     }
 }
 
-Particle* ParticlePool::getParticleByIndex(int index)
+void ParticlePool::step(float gravity, int maxLife)
 {
-    return particles[index];
+    WorkerPool::getShared()->parallelFor(maxParticleCount, PARTICLE_CHUNK_SIZE, [=](int start, int end) {
+        stepRange(start, end, gravity, (float)maxLife);
+    });
 }
 
-void ParticlePool::resetIteration()
+void ParticlePool::killAll()
 {
-    iterator = 0;
+    std::fill(live.begin(), live.end(), 0.0f);
 }
 
-bool checkOrder(Particle *A, Particle *B)
+int ParticlePool::getCount()
 {
-    return A->distance > B->distance;
+    return maxParticleCount;
 }
-
-void ParticlePool::sortByDistance()
-{
-#ifdef UBUNTU
-    std::sort(particles.begin(), particles.end(), checkOrder);
-#else
-    std::sort(particles.begin(), particles.end(), checkOrder);
-#endif
-}
-
@@ -2,23 +2,32 @@
 #ifndef __SGEngine2__ParticlePool_h__
 #define __SGEngine2__ParticlePool_h__
 
-#include "../Nodes/Particle.h"
+#include "../common/common.h"
 
+#define PARTICLE_CHUNK_SIZE 4096
+
+// Fixed capacity pool of particles stored as separate arrays, so the update loops run over plain floats
 class ParticlePool {
-	vector< Particle* > particles;
-	int iterator;
-	int maxParticleCount;
-	int deadIterator = 0;
+    int maxParticleCount;
+    int nextParticle;
+    
+    void stepRange(int start, int end, float gravity, float maxLife);
     
 public:
+    
+    vector<float> positionX, positionY, positionZ;
+    vector<float> velocityX, velocityY, velocityZ;
+    vector<float> ages;
+    vector<float> distances;
+    // 1.0 for live particles, kept as float so the update needs no branches
+    vector<float> live;
 
     ParticlePool(int count);
     ~ParticlePool();
-    Particle* reuseDeadParticle();
-    Particle* getNextLiveParticle();
-    Particle* getParticleByIndex(int index);
-    void sortByDistance();
-    void resetIteration();
+    int emit();
+    void step(float gravity, int maxLife);
+    void killAll();
+    int getCount();
 };
 
 #endif
@@ -60,6 +60,23 @@ void Frustum::constructWithProjViewMatrix(Mat4 ProjViewMat)
     }
 }
 
+FRUSTUM_INTERSECTION Frustum::classifyBox(Vector3 minEdge, Vector3 maxEdge)
+{
+    // Plane normals point out of the frustum, so a point is inside a plane when its distance is <= 0.
+    FRUSTUM_INTERSECTION result = FRUSTUM_INSIDE;
+    for (int i = 0; i != F_PLANE_COUNT; ++i) {
+        Vector3 n = planes[i].normal;
+        Vector3 nearest = Vector3((n.x > 0.0) ? minEdge.x : maxEdge.x, (n.y > 0.0) ? minEdge.y : maxEdge.y, (n.z > 0.0) ? minEdge.z : maxEdge.z);
+        if(n.dotProduct(nearest) + planes[i].distanceFromOrigin > 0.0)
+            return FRUSTUM_OUTSIDE;
+
+        Vector3 farthest = Vector3((n.x > 0.0) ? maxEdge.x : minEdge.x, (n.y > 0.0) ? maxEdge.y : minEdge.y, (n.z > 0.0) ? maxEdge.z : minEdge.z);
+        if(n.dotProduct(farthest) + planes[i].distanceFromOrigin > 0.0)
+            result = FRUSTUM_INTERSECTS;
+    }
+    return result;
+}
+
 Vector3 Frustum::getFarLeftUp()
 {
     Vector3 p;
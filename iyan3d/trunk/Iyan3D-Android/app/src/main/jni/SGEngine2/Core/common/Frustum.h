@@ -22,6 +22,7 @@ public:
     Frustum();
     ~Frustum();
     void constructWithProjViewMatrix(Mat4 ProjViewMat);
+    FRUSTUM_INTERSECTION classifyBox(Vector3 minEdge, Vector3 maxEdge);
     Vector3 getFarLeftUp();
     Vector3 getFarLeftDown();
     Vector3 getFarRightUp();
@@ -97,6 +97,12 @@ enum FPLANES {
     F_PLANE_COUNT = 6
 };
 
+enum FRUSTUM_INTERSECTION {
+    FRUSTUM_OUTSIDE,
+    FRUSTUM_INTERSECTS,
+    FRUSTUM_INSIDE
+};
+
 enum METAL_DEPTH_FUNCTION {
     CompareFunctionNever = 0,
     CompareFunctionLess = 1,
@@ -127,6 +133,7 @@ static const u_int32_t attributesTotalValuesSkinned[MAX_VERTEX_DATA_SKINNED] = {
 class common {
 public:
     static DEVICE_TYPE deviceType;
+    static bool supportsIndex32; // 32 bit element indices, OES_element_index_uint on OpenGL ES 2
 };
 
 #endif
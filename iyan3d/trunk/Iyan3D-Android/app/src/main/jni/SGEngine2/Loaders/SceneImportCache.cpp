@@ -0,0 +1,473 @@
+//
+//  SceneImportCache.cpp
+//  SGEngine2
+//
+//  Copyright (c) 2014 Smackall Games Pvt Ltd. All rights reserved.
+//
+
+#include "SceneImportCache.h"
+#include "../Utilities/MappedFile.h"
+#include "../Utilities/Logger.h"
+
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "assimp/material.h"
+
+#define SCENE_IMPORT_CACHE_MAGIC 0x49474753 // "SGGI"
+
+enum SCENE_IMPORT_CACHE_ATTRIBUTES {
+    CACHE_HAS_NORMALS = 1,
+    CACHE_HAS_TANGENTS = 2,
+    CACHE_HAS_BITANGENTS = 4,
+    CACHE_HAS_COLORS = 8,
+    CACHE_HAS_TEXCOORDS = 16
+};
+
+static uint64_t hashImportData(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    return hash;
+}
+
+// Writers, every block is a count followed by the raw array
+
+static void writeData(std::ofstream &file, const void* data, size_t size)
+{
+    if(size > 0)
+        file.write((const char*)data, size);
+}
+
+static void writeUInt(std::ofstream &file, unsigned int value)
+{
+    writeData(file, &value, sizeof(unsigned int));
+}
+
+static void writeString(std::ofstream &file, const aiString &value)
+{
+    writeUInt(file, value.length);
+    writeData(file, value.data, value.length);
+}
+
+static void writeNode(std::ofstream &file, const aiNode* node)
+{
+    writeString(file, node->mName);
+    writeData(file, &node->mTransformation, sizeof(aiMatrix4x4));
+    writeUInt(file, node->mNumMeshes);
+    writeData(file, node->mMeshes, node->mNumMeshes * sizeof(unsigned int));
+    writeUInt(file, node->mNumChildren);
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+        writeNode(file, node->mChildren[i]);
+}
+
+static void writeMesh(std::ofstream &file, const aiMesh* mesh)
+{
+    unsigned int attributes = (mesh->mNormals ? CACHE_HAS_NORMALS : 0) | (mesh->mTangents ? CACHE_HAS_TANGENTS : 0) | (mesh->mBitangents ? CACHE_HAS_BITANGENTS : 0) |
+        (mesh->mColors[0] ? CACHE_HAS_COLORS : 0) | (mesh->mTextureCoords[0] ? CACHE_HAS_TEXCOORDS : 0);
+
+    writeUInt(file, mesh->mPrimitiveTypes);
+    writeUInt(file, mesh->mMaterialIndex);
+    writeUInt(file, attributes);
+    writeUInt(file, mesh->mNumVertices);
+
+    size_t vectorsSize = mesh->mNumVertices * sizeof(aiVector3D);
+    writeData(file, mesh->mVertices, vectorsSize);
+    if(attributes & CACHE_HAS_NORMALS)
+        writeData(file, mesh->mNormals, vectorsSize);
+    if(attributes & CACHE_HAS_TANGENTS)
+        writeData(file, mesh->mTangents, vectorsSize);
+    if(attributes & CACHE_HAS_BITANGENTS)
+        writeData(file, mesh->mBitangents, vectorsSize);
+    if(attributes & CACHE_HAS_COLORS)
+        writeData(file, mesh->mColors[0], mesh->mNumVertices * sizeof(aiColor4D));
+    if(attributes & CACHE_HAS_TEXCOORDS)
+        writeData(file, mesh->mTextureCoords[0], vectorsSize);
+
+    writeUInt(file, mesh->mNumFaces);
+    for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+        writeUInt(file, mesh->mFaces[i].mNumIndices);
+        writeData(file, mesh->mFaces[i].mIndices, mesh->mFaces[i].mNumIndices * sizeof(unsigned int));
+    }
+
+    writeUInt(file, mesh->mNumBones);
+    for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+        const aiBone* bone = mesh->mBones[i];
+        writeString(file, bone->mName);
+        writeData(file, &bone->mOffsetMatrix, sizeof(aiMatrix4x4));
+        writeUInt(file, bone->mNumWeights);
+        writeData(file, bone->mWeights, bone->mNumWeights * sizeof(aiVertexWeight));
+    }
+}
+
+static void writeMaterial(std::ofstream &file, const aiMaterial* material)
+{
+    aiColor4D color;
+    unsigned int hasColor = (aiGetMaterialColor(material, AI_MATKEY_COLOR_DIFFUSE, &color) == AI_SUCCESS);
+    writeUInt(file, hasColor);
+    if(hasColor)
+        writeData(file, &color, sizeof(aiColor4D));
+
+    aiString diffusePath, normalsPath;
+    if(material->GetTextureCount(aiTextureType_DIFFUSE) > 0)
+        material->GetTexture(aiTextureType_DIFFUSE, 0, &diffusePath);
+    if(material->GetTextureCount(aiTextureType_NORMALS) > 0)
+        material->GetTexture(aiTextureType_NORMALS, 0, &normalsPath);
+    writeString(file, diffusePath);
+    writeString(file, normalsPath);
+}
+
+static void writeAnimation(std::ofstream &file, const aiAnimation* animation)
+{
+    writeUInt(file, animation->mNumChannels);
+    for (unsigned int i = 0; i < animation->mNumChannels; i++) {
+        const aiNodeAnim* channel = animation->mChannels[i];
+        writeString(file, channel->mNodeName);
+        writeUInt(file, channel->mNumPositionKeys);
+        writeData(file, channel->mPositionKeys, channel->mNumPositionKeys * sizeof(aiVectorKey));
+        writeUInt(file, channel->mNumRotationKeys);
+        writeData(file, channel->mRotationKeys, channel->mNumRotationKeys * sizeof(aiQuatKey));
+        writeUInt(file, channel->mNumScalingKeys);
+        writeData(file, channel->mScalingKeys, channel->mNumScalingKeys * sizeof(aiVectorKey));
+    }
+}
+
+// Readers, a failed read leaves the scene consistent so it can simply be deleted
+
+// Counts are checked against the bytes left before anything is allocated for them
+static bool hasRecords(MappedFile &file, size_t offset, unsigned int count, size_t recordSize)
+{
+    return file.getRange(offset, (size_t)count * recordSize) != NULL;
+}
+
+template <typename T>
+static bool readArray(MappedFile &file, size_t &offset, T* &array, unsigned int count)
+{
+    if(!hasRecords(file, offset, count, sizeof(T)))
+        return false;
+    array = new T[count];
+    return count == 0 || file.read(offset, array, count * sizeof(T));
+}
+
+static bool readUInt(MappedFile &file, size_t &offset, unsigned int &value)
+{
+    return file.read(offset, &value, sizeof(unsigned int));
+}
+
+static bool readString(MappedFile &file, size_t &offset, aiString &value)
+{
+    unsigned int length;
+    if(!readUInt(file, offset, length) || length >= MAXLEN)
+        return false;
+
+    const unsigned char* data = file.getRange(offset, length);
+    if(!data)
+        return false;
+    offset += length;
+
+    value.length = length;
+    memcpy(value.data, data, length);
+    value.data[length] = '\0';
+    return true;
+}
+
+static bool readNode(MappedFile &file, size_t &offset, aiNode* node, unsigned int meshesCount, int depth)
+{
+    unsigned int meshes, children;
+    if(depth > 1024 || !readString(file, offset, node->mName) || !file.read(offset, &node->mTransformation, sizeof(aiMatrix4x4)) || !readUInt(file, offset, meshes))
+        return false;
+
+    node->mNumMeshes = meshes;
+    if(!readArray(file, offset, node->mMeshes, meshes))
+        return false;
+    for (unsigned int i = 0; i < meshes; i++) {
+        if(node->mMeshes[i] >= meshesCount)
+            return false;
+    }
+
+    if(!readUInt(file, offset, children) || !hasRecords(file, offset, children, sizeof(unsigned int)))
+        return false;
+
+    node->mChildren = new aiNode*[children]();
+    node->mNumChildren = children;
+    for (unsigned int i = 0; i < children; i++) {
+        node->mChildren[i] = new aiNode();
+        node->mChildren[i]->mParent = node;
+        if(!readNode(file, offset, node->mChildren[i], meshesCount, depth + 1))
+            return false;
+    }
+    return true;
+}
+
+static bool readMesh(MappedFile &file, size_t &offset, aiMesh* mesh)
+{
+    unsigned int attributes, vertices, faces, bones;
+    if(!readUInt(file, offset, mesh->mPrimitiveTypes) || !readUInt(file, offset, mesh->mMaterialIndex) || !readUInt(file, offset, attributes) || !readUInt(file, offset, vertices))
+        return false;
+
+    mesh->mNumVertices = vertices;
+    if(!readArray(file, offset, mesh->mVertices, vertices))
+        return false;
+    if((attributes & CACHE_HAS_NORMALS) && !readArray(file, offset, mesh->mNormals, vertices))
+        return false;
+    if((attributes & CACHE_HAS_TANGENTS) && !readArray(file, offset, mesh->mTangents, vertices))
+        return false;
+    if((attributes & CACHE_HAS_BITANGENTS) && !readArray(file, offset, mesh->mBitangents, vertices))
+        return false;
+    if((attributes & CACHE_HAS_COLORS) && !readArray(file, offset, mesh->mColors[0], vertices))
+        return false;
+    if(attributes & CACHE_HAS_TEXCOORDS) {
+        if(!readArray(file, offset, mesh->mTextureCoords[0], vertices))
+            return false;
+        mesh->mNumUVComponents[0] = 2;
+    }
+
+    if(!readUInt(file, offset, faces) || !hasRecords(file, offset, faces, sizeof(unsigned int)))
+        return false;
+    mesh->mFaces = new aiFace[faces];
+    mesh->mNumFaces = faces;
+    for (unsigned int i = 0; i < faces; i++) {
+        aiFace &face = mesh->mFaces[i];
+        if(!readUInt(file, offset, face.mNumIndices) || face.mNumIndices != 3)
+            return false;
+        if(!readArray(file, offset, face.mIndices, face.mNumIndices))
+            return false;
+        for (unsigned int j = 0; j < face.mNumIndices; j++) {
+            if(face.mIndices[j] >= vertices)
+                return false;
+        }
+    }
+
+    if(!readUInt(file, offset, bones) || !hasRecords(file, offset, bones, sizeof(unsigned int)))
+        return false;
+    mesh->mBones = new aiBone*[bones]();
+    mesh->mNumBones = bones;
+    for (unsigned int i = 0; i < bones; i++) {
+        aiBone* bone = mesh->mBones[i] = new aiBone();
+        unsigned int weights;
+        if(!readString(file, offset, bone->mName) || !file.read(offset, &bone->mOffsetMatrix, sizeof(aiMatrix4x4)) || !readUInt(file, offset, weights))
+            return false;
+        bone->mNumWeights = weights;
+        if(!readArray(file, offset, bone->mWeights, weights))
+            return false;
+        for (unsigned int j = 0; j < weights; j++) {
+            if(bone->mWeights[j].mVertexId >= vertices)
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool readMaterial(MappedFile &file, size_t &offset, aiMaterial* material)
+{
+    unsigned int hasColor;
+    if(!readUInt(file, offset, hasColor))
+        return false;
+
+    if(hasColor) {
+        aiColor4D color;
+        if(!file.read(offset, &color, sizeof(aiColor4D)))
+            return false;
+        material->AddProperty(&color, 1, AI_MATKEY_COLOR_DIFFUSE);
+    }
+
+    aiString diffusePath, normalsPath;
+    if(!readString(file, offset, diffusePath) || !readString(file, offset, normalsPath))
+        return false;
+    if(diffusePath.length > 0)
+        material->AddProperty(&diffusePath, AI_MATKEY_TEXTURE_DIFFUSE(0));
+    if(normalsPath.length > 0)
+        material->AddProperty(&normalsPath, AI_MATKEY_TEXTURE_NORMALS(0));
+    return true;
+}
+
+static bool readAnimation(MappedFile &file, size_t &offset, aiAnimation* animation)
+{
+    unsigned int channels;
+    if(!readUInt(file, offset, channels) || !hasRecords(file, offset, channels, sizeof(unsigned int)))
+        return false;
+
+    animation->mChannels = new aiNodeAnim*[channels]();
+    animation->mNumChannels = channels;
+    for (unsigned int i = 0; i < channels; i++) {
+        aiNodeAnim* channel = animation->mChannels[i] = new aiNodeAnim();
+        if(!readString(file, offset, channel->mNodeName) ||
+           !readUInt(file, offset, channel->mNumPositionKeys) || !readArray(file, offset, channel->mPositionKeys, channel->mNumPositionKeys) ||
+           !readUInt(file, offset, channel->mNumRotationKeys) || !readArray(file, offset, channel->mRotationKeys, channel->mNumRotationKeys) ||
+           !readUInt(file, offset, channel->mNumScalingKeys) || !readArray(file, offset, channel->mScalingKeys, channel->mNumScalingKeys))
+            return false;
+    }
+    return true;
+}
+
+static uint64_t hashReferencedFile(uint64_t hash, std::string filePath)
+{
+    MappedFile file;
+    size_t size = file.open(filePath) ? file.getSize() : (size_t)-1;
+    hash = hashImportData(hash, &size, sizeof(size_t));
+    return file.isOpen() ? hashImportData(hash, file.getRange(0, size), size) : hash;
+}
+
+// OBJ is the one format SceneImporter reads whose scene depends on other files, every
+// mtllib line is resolved the way assimp does including its <name>.mtl fallback
+static uint64_t hashMaterialLibraries(uint64_t hash, std::string filePath, MappedFile &source)
+{
+    size_t separator = filePath.find_last_of('/');
+    std::string directory = (separator == std::string::npos) ? "" : filePath.substr(0, separator + 1);
+    std::string fallbackPath = filePath.substr(0, filePath.length() - 3) + "mtl";
+
+    const char* data = (const char*)source.getRange(0, source.getSize());
+    size_t size = source.getSize();
+    for (size_t line = 0; line < size; ) {
+        size_t end = line;
+        while(end < size && data[end] != '\n' && data[end] != '\r' && data[end] != '\f' && data[end] != '\0')
+            end++;
+
+        size_t start = line;
+        while(start < end && (data[start] == ' ' || data[start] == '\t'))
+            start++;
+        if(end - start > 6 && strncmp(data + start, "mtllib", 6) == 0 && (data[start + 6] == ' ' || data[start + 6] == '\t')) {
+            start += 6;
+            while(start < end && (data[start] == ' ' || data[start] == '\t'))
+                start++;
+            std::string libraryPath = directory + std::string(data + start, end - start);
+            hash = hashReferencedFile(hash, libraryPath);
+            if(access(libraryPath.c_str(), R_OK) != 0)
+                hash = hashReferencedFile(hash, fallbackPath);
+        }
+        line = end + 1;
+    }
+    return hash;
+}
+
+uint64_t SceneImportCache::getImportKey(std::string filePath, unsigned int flags, int vertexLimit, int maxBoneWeights)
+{
+    MappedFile source;
+    if(!source.open(filePath))
+        return 0;
+
+    // Record sizes are part of the key, the arrays are stored in their in memory layout
+    unsigned int settings[] = { SCENE_IMPORT_CACHE_VERSION, flags, (unsigned int)vertexLimit, (unsigned int)maxBoneWeights,
+        (unsigned int)sizeof(aiVector3D), (unsigned int)sizeof(aiVectorKey), (unsigned int)sizeof(aiQuatKey), (unsigned int)sizeof(aiVertexWeight) };
+    uint64_t hash = hashImportData(14695981039346656037ULL, settings, sizeof(settings));
+
+    size_t size = source.getSize();
+    hash = hashImportData(hash, &size, sizeof(size_t));
+    hash = hashImportData(hash, source.getRange(0, size), size);
+
+    std::string extension = filePath.substr(filePath.find_last_of('.') + 1);
+    for (size_t i = 0; i < extension.length(); i++)
+        extension[i] = tolower(extension[i]);
+    return (extension == "obj") ? hashMaterialLibraries(hash, filePath, source) : hash;
+}
+
+std::string SceneImportCache::getCachePath(std::string filePath)
+{
+    return filePath + SCENE_IMPORT_CACHE_EXTENSION;
+}
+
+aiScene* SceneImportCache::read(std::string filePath, uint64_t importKey)
+{
+    MappedFile file;
+    if(!importKey || !file.open(getCachePath(filePath)))
+        return NULL;
+
+    size_t offset = 0;
+    unsigned int magic, meshes, materials, animations;
+    uint64_t key;
+    if(!readUInt(file, offset, magic) || magic != SCENE_IMPORT_CACHE_MAGIC || !file.read(offset, &key, sizeof(uint64_t)) || key != importKey)
+        return NULL;
+
+    aiScene* scene = new aiScene();
+    bool status = readUInt(file, offset, meshes) && hasRecords(file, offset, meshes, sizeof(unsigned int));
+    if(status) {
+        scene->mMeshes = new aiMesh*[meshes]();
+        scene->mNumMeshes = meshes;
+    }
+    for (unsigned int i = 0; status && i < scene->mNumMeshes; i++) {
+        scene->mMeshes[i] = new aiMesh();
+        status = readMesh(file, offset, scene->mMeshes[i]);
+    }
+
+    status = status && readUInt(file, offset, materials) && hasRecords(file, offset, materials, sizeof(unsigned int));
+    if(status) {
+        scene->mMaterials = new aiMaterial*[materials]();
+        scene->mNumMaterials = materials;
+    }
+    for (unsigned int i = 0; status && i < scene->mNumMaterials; i++) {
+        scene->mMaterials[i] = new aiMaterial();
+        status = readMaterial(file, offset, scene->mMaterials[i]);
+    }
+    for (unsigned int i = 0; status && i < scene->mNumMeshes; i++)
+        status = scene->mMeshes[i]->mMaterialIndex < scene->mNumMaterials;
+
+    status = status && readUInt(file, offset, animations) && hasRecords(file, offset, animations, sizeof(unsigned int));
+    if(status) {
+        scene->mAnimations = new aiAnimation*[animations]();
+        scene->mNumAnimations = animations;
+    }
+    for (unsigned int i = 0; status && i < scene->mNumAnimations; i++) {
+        scene->mAnimations[i] = new aiAnimation();
+        status = readAnimation(file, offset, scene->mAnimations[i]);
+    }
+
+    if(status) {
+        scene->mRootNode = new aiNode();
+        status = readNode(file, offset, scene->mRootNode, scene->mNumMeshes, 0);
+    }
+
+    if(!status) {
+        Logger::log(ERROR, "SceneImportCache::read", "Ignoring damaged import cache " + getCachePath(filePath));
+        delete scene;
+        return NULL;
+    }
+    return scene;
+}
+
+bool SceneImportCache::write(std::string filePath, uint64_t importKey, const aiScene* scene)
+{
+    if(!importKey || !scene || !scene->mRootNode)
+        return false;
+
+    // SceneImporter only reads triangles, anything else is left to assimp every time
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        for (unsigned int j = 0; j < scene->mMeshes[i]->mNumFaces; j++) {
+            if(scene->mMeshes[i]->mFaces[j].mNumIndices != 3)
+                return false;
+        }
+    }
+
+    // Written to a temporary file first so an interrupted write never leaves a cache that matches the key
+    std::string cachePath = getCachePath(filePath);
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream file(tempPath, std::ios::out | std::ios::binary);
+    if(!file.is_open())
+        return false;
+
+    writeUInt(file, SCENE_IMPORT_CACHE_MAGIC);
+    writeData(file, &importKey, sizeof(uint64_t));
+
+    writeUInt(file, scene->mNumMeshes);
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++)
+        writeMesh(file, scene->mMeshes[i]);
+    writeUInt(file, scene->mNumMaterials);
+    for (unsigned int i = 0; i < scene->mNumMaterials; i++)
+        writeMaterial(file, scene->mMaterials[i]);
+    writeUInt(file, scene->mNumAnimations);
+    for (unsigned int i = 0; i < scene->mNumAnimations; i++)
+        writeAnimation(file, scene->mAnimations[i]);
+    writeNode(file, scene->mRootNode);
+
+    bool status = file.good();
+    file.close();
+
+    if(!status || rename(tempPath.c_str(), cachePath.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
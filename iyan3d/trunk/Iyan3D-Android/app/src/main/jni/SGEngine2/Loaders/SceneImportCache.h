@@ -0,0 +1,35 @@
+//
+//  SceneImportCache.h
+//  SGEngine2
+//
+//  Copyright (c) 2014 Smackall Games Pvt Ltd. All rights reserved.
+//
+
+#ifndef __SGEngine2__SceneImportCache__
+#define __SGEngine2__SceneImportCache__
+
+#include <string>
+#include <stdint.h>
+
+#include "assimp/scene.h"
+
+#define SCENE_IMPORT_CACHE_VERSION 1
+#define SCENE_IMPORT_CACHE_EXTENSION ".sgi"
+
+// Binary sidecar holding the post processed assimp scene of an imported model, so
+// importing the same file again skips parsing and post processing. Only the parts
+// SceneImporter reads are kept: node tree, triangle data, bones, diffuse and normal
+// map materials and animation channels. The key covers the source file contents,
+// the material libraries an OBJ file names and the import settings, a cache written
+// with other settings is ignored. Scenes with faces other than triangles aren't cached.
+class SceneImportCache {
+
+public:
+    static uint64_t getImportKey(std::string filePath, unsigned int flags, int vertexLimit, int maxBoneWeights);
+    static std::string getCachePath(std::string filePath);
+
+    static aiScene* read(std::string filePath, uint64_t importKey);
+    static bool write(std::string filePath, uint64_t importKey, const aiScene* scene);
+};
+
+#endif /* defined(__SGEngine2__SceneImportCache__) */
@@ -7,7 +7,10 @@
 //
 
 #include "SceneImporter.h"
+#include "SceneImportCache.h"
 #include <fstream>
+#include <string.h>
+#include <thread>
 
 SceneImporter::SceneImporter()
 {
@@ -27,6 +30,12 @@ SceneImporter::~SceneImporter()
         delete scene;
 }
 
+static int getVertexLimit()
+{
+    // Meshes are only split for 16 bit indices when the device cannot draw 32 bit ones
+    return common::supportsIndex32 ? AI_SLM_DEFAULT_MAX_VERTICES : MAX_VERTICES_COUNT;
+}
+
 string getFileExtention(const string& s)
 {
     char sep = '.';
@@ -124,7 +133,7 @@ void SceneImporter::import3DText(SGEditorScene *sgScene, wstring text, string fo
     sgScene->freezeRendering = true;
     
     Assimp::Importer *importer = new Assimp::Importer();
-    importer->SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, MAX_VERTICES_COUNT);
+    importer->SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, getVertexLimit());
     importer->SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 65);
     
     importer->SetPropertyWString("TEXT3D_TEXT", text);
@@ -141,6 +150,8 @@ void SceneImporter::import3DText(SGEditorScene *sgScene, wstring text, string fo
     
     if(!scene) {
         printf("Error in Loading: %s\n", importer->GetErrorString());
+        delete importer;
+        sgScene->freezeRendering = false;
         return;
     }
 
@@ -151,11 +162,16 @@ void SceneImporter::import3DText(SGEditorScene *sgScene, wstring text, string fo
     this->ext = "text";
     this->folderPath = "";
     
+    convertMeshes();
+    indexAnimationChannels();
     importNode(scene->mRootNode, aiMatrix4x4());
     
     if(rigNode)
         loadDetails2Node(rigNode, rigMesh, aiMatrix4x4());
     
+    clearConvertedMeshes();
+    animationChannels.clear();
+    
     sgScene->selectMan->removeChildren(sgScene->getParentNode());
     sgScene->updater->setDataForFrame(sgScene->currentFrame);
     sgScene->selectMan->updateParentPosition();
@@ -177,17 +193,31 @@ bool SceneImporter::importNodesFromFile(SGEditorScene *sgScene, string name, str
     transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
     
     if(ext == "sgm" || ext == "sgr" || ext == "obj" || ext == "fbx" || ext == "dae" || ext == "3ds") {
-        Assimp::Importer *importer = new Assimp::Importer();
-        importer->SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, MAX_VERTICES_COUNT);
-        importer->SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, 8);
-        
         unsigned int pFlags = aiProcessPreset_TargetRealtime_Quality | aiProcess_FindInstances | aiProcess_OptimizeMeshes | aiProcess_MakeLeftHanded | aiProcess_FlipWindingOrder | aiProcess_FlipUVs | aiProcess_OptimizeGraph;
         
-        scene = importer->ReadFile(filePath, pFlags);
+        // A file imported before with the same settings is loaded from its sidecar, skipping assimp entirely
+        uint64_t importKey = SceneImportCache::getImportKey(filePath, pFlags, getVertexLimit(), IMPORT_MAX_BONE_WEIGHTS);
+        aiScene *cachedScene = SceneImportCache::read(filePath, importKey);
+        Assimp::Importer *importer = NULL;
+        
+        if(cachedScene) {
+            scene = cachedScene;
+        } else {
+            importer = new Assimp::Importer();
+            importer->SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, getVertexLimit());
+            importer->SetPropertyInteger(AI_CONFIG_PP_LBW_MAX_WEIGHTS, IMPORT_MAX_BONE_WEIGHTS);
+            
+            scene = importer->ReadFile(filePath, pFlags);
+            if(scene && scene->mNumMeshes > 0)
+                SceneImportCache::write(filePath, importKey, scene);
+        }
         
         if(!scene || scene->mNumMeshes == 0) {
-            printf("Error in Loading: %s\n", importer->GetErrorString());
-            (*error) = string(importer->GetErrorString());
+            (*error) = importer ? string(importer->GetErrorString()) : "";
+            printf("Error in Loading: %s\n", error->c_str());
+            delete importer;
+            delete cachedScene;
+            scene = NULL;
             sgScene->freezeRendering = false;
             return false;
         } else {
@@ -199,6 +229,8 @@ bool SceneImporter::importNodesFromFile(SGEditorScene *sgScene, string name, str
             this->folderPath = fileLocation;
             this->nodeName = name;
 
+            convertMeshes();
+            indexAnimationChannels();
             importNode(scene->mRootNode, scene->mRootNode->mTransformation);
             
             if(rigNode) {
@@ -206,6 +238,9 @@ bool SceneImporter::importNodesFromFile(SGEditorScene *sgScene, string name, str
                 printf("Bone Count: %lu\n", rigNode->joints.size());
             }
             
+            clearConvertedMeshes();
+            animationChannels.clear();
+            
             sgScene->selectMan->removeChildren(sgScene->getParentNode());
             sgScene->updater->setDataForFrame(sgScene->currentFrame);
             sgScene->selectMan->updateParentPosition();
@@ -213,6 +248,7 @@ bool SceneImporter::importNodesFromFile(SGEditorScene *sgScene, string name, str
         }
         
         delete importer;
+        delete cachedScene;
         scene = NULL;
     }
     
@@ -274,6 +310,7 @@ void SceneImporter::importNodeFromMesh(SGEditorScene *sgScene, SGNode* sceneNode
 Mesh* SceneImporter::loadMeshFromFile(string filePath)
 {
     Assimp::Importer *importer = new Assimp::Importer();
+    importer->SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, getVertexLimit());
     scene = importer->ReadFile(filePath, aiProcessPreset_TargetRealtime_Quality | aiProcess_FindInstances | aiProcess_OptimizeMeshes);
     
     if(!scene) {
@@ -287,7 +324,7 @@ Mesh* SceneImporter::loadMeshFromFile(string filePath)
         
         if(aiM && aiM->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
             vector< vertexData > mbvd;
-            vector< unsigned short > mbi;
+            vector< unsigned int > mbi;
             getMeshFrom(mbvd, mbi, aiM);
             
             mesh->addMeshBuffer(mbvd, mbi, 0);
@@ -302,7 +339,7 @@ Mesh* SceneImporter::loadMeshFromFile(string filePath)
 SkinMesh* SceneImporter::loadSkinMeshFromFile(string filePath)
 {
     Assimp::Importer *importer = new Assimp::Importer();
-    importer->SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, MAX_VERTICES_COUNT);
+    importer->SetPropertyInteger(AI_CONFIG_PP_SLM_VERTEX_LIMIT, getVertexLimit());
     scene = importer->ReadFile(filePath, aiProcessPreset_TargetRealtime_Quality | aiProcess_FindInstances | aiProcess_OptimizeMeshes);
     
     if(!scene) {
@@ -316,7 +353,7 @@ SkinMesh* SceneImporter::loadSkinMeshFromFile(string filePath)
         
         if(aiM && aiM->mPrimitiveTypes == aiPrimitiveType_TRIANGLE) {
             vector< vertexDataHeavy > mbvd;
-            vector< unsigned short > mbi;
+            vector< unsigned int > mbi;
             getSkinMeshFrom(mbvd, mbi, aiM);
             
             mesh->addMeshBuffer(mbvd, mbi, 0);
@@ -402,32 +439,30 @@ int SceneImporter::loadMaterial2Node(SGNode *sceneNode, int materialIndex, bool
 void SceneImporter::loadAnimationKeys(SGJoint *joint)
 {
     int maxFrames = 0;
-    for (int i = 0; i < scene->mNumAnimations; i++) {
-        for (int j = 0; j < scene->mAnimations[i]->mNumChannels; j++) {
-            string name(scene->mAnimations[i]->mChannels[j]->mNodeName.C_Str());
-            if(joint->jointNode->name == name) {
-                aiNodeAnim* channel = scene->mAnimations[i]->mChannels[j];
-                for (int k = 0; k < channel->mNumPositionKeys; k++) {
-                    int frame = (int)(24.0 * channel->mPositionKeys[k].mTime);
-                    Vector3 p = Vector3(channel->mPositionKeys[k].mValue.x, channel->mPositionKeys[k].mValue.y, channel->mPositionKeys[k].mValue.z);
-                    joint->setPosition(p, frame);
-                    if(frame > maxFrames)
-                        maxFrames = frame;
-                }
-                for (int k = 0; k < channel->mNumScalingKeys; k++) {
-                    int frame = (int)(24.0 * channel->mScalingKeys[k].mTime);
-                    Vector3 s = Vector3(channel->mScalingKeys[k].mValue.x, channel->mScalingKeys[k].mValue.y, channel->mScalingKeys[k].mValue.z);
-                    joint->setScale(s, frame);
-                    if(frame > maxFrames)
-                        maxFrames = frame;
-                }
-                for (int k = 0; k < channel->mNumRotationKeys; k++) {
-                    int frame = (int)(24.0 * channel->mRotationKeys[k].mTime);
-                    Quaternion r = Quaternion(channel->mRotationKeys[k].mValue.x, channel->mRotationKeys[k].mValue.y, channel->mRotationKeys[k].mValue.z, channel->mRotationKeys[k].mValue.w);
-                    joint->setRotation(r, frame);
-                    if(frame > maxFrames)
-                        maxFrames = frame;
-                }
+    map< string, vector<aiNodeAnim*> >::iterator channels = animationChannels.find(joint->jointNode->name);
+    if(channels != animationChannels.end()) {
+        for (int j = 0; j < channels->second.size(); j++) {
+            aiNodeAnim* channel = channels->second[j];
+            for (int k = 0; k < channel->mNumPositionKeys; k++) {
+                int frame = (int)(24.0 * channel->mPositionKeys[k].mTime);
+                Vector3 p = Vector3(channel->mPositionKeys[k].mValue.x, channel->mPositionKeys[k].mValue.y, channel->mPositionKeys[k].mValue.z);
+                joint->setPosition(p, frame);
+                if(frame > maxFrames)
+                    maxFrames = frame;
+            }
+            for (int k = 0; k < channel->mNumScalingKeys; k++) {
+                int frame = (int)(24.0 * channel->mScalingKeys[k].mTime);
+                Vector3 s = Vector3(channel->mScalingKeys[k].mValue.x, channel->mScalingKeys[k].mValue.y, channel->mScalingKeys[k].mValue.z);
+                joint->setScale(s, frame);
+                if(frame > maxFrames)
+                    maxFrames = frame;
+            }
+            for (int k = 0; k < channel->mNumRotationKeys; k++) {
+                int frame = (int)(24.0 * channel->mRotationKeys[k].mTime);
+                Quaternion r = Quaternion(channel->mRotationKeys[k].mValue.x, channel->mRotationKeys[k].mValue.y, channel->mRotationKeys[k].mValue.z, channel->mRotationKeys[k].mValue.w);
+                joint->setRotation(r, frame);
+                if(frame > maxFrames)
+                    maxFrames = frame;
             }
         }
     }
@@ -440,37 +475,33 @@ void SceneImporter::loadAnimationKeys(SGNode *node)
 {
     Mat4 m = getDeltaMatrix(ext, node->getType() == NODE_RIG);
     int maxFrames = 0;
-    for (int i = 0; i < scene->mNumAnimations; i++) {
-        for (int j = 0; j < scene->mAnimations[i]->mNumChannels; j++) {
-            string name(scene->mAnimations[i]->mChannels[j]->mNodeName.C_Str());
-            string nodeName = ConversionHelper::getStringForWString(node->name);
-          
-            if(nodeName == name) {
-                aiNodeAnim* channel = scene->mAnimations[i]->mChannels[j];
-                for (int k = 0; k < channel->mNumPositionKeys; k++) {
-                    int frame = (int)(24.0 * channel->mPositionKeys[k].mTime);
-                    Vector3 p = Vector3(channel->mPositionKeys[k].mValue.x, channel->mPositionKeys[k].mValue.y, channel->mPositionKeys[k].mValue.z);
-                    Vector4 p4 = m * Vector4(p, 0.0);
-                    p = Vector3(p4.x, p4.y, p4.z);
-                    node->setPosition(p, frame);
-                    if(frame > maxFrames)
-                        maxFrames = frame;
-                }
-                for (int k = 0; k < channel->mNumScalingKeys; k++) {
-                    int frame = (int)(24.0 * channel->mScalingKeys[k].mTime);
-                    Vector3 s = Vector3(channel->mScalingKeys[k].mValue.x, channel->mScalingKeys[k].mValue.y, channel->mScalingKeys[k].mValue.z);
-                    node->setScale(s, frame);
-                    if(frame > maxFrames)
-                        maxFrames = frame;
-                }
-                for (int k = 0; k < channel->mNumRotationKeys; k++) {
-                    int frame = (int)(24.0 * channel->mRotationKeys[k].mTime);
-                    Quaternion r = Quaternion(channel->mRotationKeys[k].mValue.x, channel->mRotationKeys[k].mValue.y, channel->mRotationKeys[k].mValue.z, channel->mRotationKeys[k].mValue.w);
-                    r = m * r.getMatrix();
-                    node->setRotation(r, frame);
-                    if(frame > maxFrames)
-                        maxFrames = frame;
-                }
+    map< string, vector<aiNodeAnim*> >::iterator channels = animationChannels.find(ConversionHelper::getStringForWString(node->name));
+    if(channels != animationChannels.end()) {
+        for (int j = 0; j < channels->second.size(); j++) {
+            aiNodeAnim* channel = channels->second[j];
+            for (int k = 0; k < channel->mNumPositionKeys; k++) {
+                int frame = (int)(24.0 * channel->mPositionKeys[k].mTime);
+                Vector3 p = Vector3(channel->mPositionKeys[k].mValue.x, channel->mPositionKeys[k].mValue.y, channel->mPositionKeys[k].mValue.z);
+                Vector4 p4 = m * Vector4(p, 0.0);
+                p = Vector3(p4.x, p4.y, p4.z);
+                node->setPosition(p, frame);
+                if(frame > maxFrames)
+                    maxFrames = frame;
+            }
+            for (int k = 0; k < channel->mNumScalingKeys; k++) {
+                int frame = (int)(24.0 * channel->mScalingKeys[k].mTime);
+                Vector3 s = Vector3(channel->mScalingKeys[k].mValue.x, channel->mScalingKeys[k].mValue.y, channel->mScalingKeys[k].mValue.z);
+                node->setScale(s, frame);
+                if(frame > maxFrames)
+                    maxFrames = frame;
+            }
+            for (int k = 0; k < channel->mNumRotationKeys; k++) {
+                int frame = (int)(24.0 * channel->mRotationKeys[k].mTime);
+                Quaternion r = Quaternion(channel->mRotationKeys[k].mValue.x, channel->mRotationKeys[k].mValue.y, channel->mRotationKeys[k].mValue.z, channel->mRotationKeys[k].mValue.w);
+                r = m * r.getMatrix();
+                node->setRotation(r, frame);
+                if(frame > maxFrames)
+                    maxFrames = frame;
             }
         }
     }
@@ -612,21 +643,22 @@ void SceneImporter::importNode(aiNode *node, aiMatrix4x4 parentTransform)
             unsigned short materialIndex = aiM->mMaterialIndex;
             int nodeMaterialIndex = loadMaterial2Node(sceneNode, materialIndex, hasBones);
 
+            // Buffers were converted up front by convertMeshes, a mesh used by one node gives its data away
+            int meshIndex = node->mMeshes[i];
+            bool isLastUse = (--meshReferences[meshIndex] == 0);
+            vector< unsigned int > mbi = isLastUse ? std::move(convertedIndices[meshIndex]) : convertedIndices[meshIndex];
+            
             if(hasBones) {
                 
-                vector< vertexDataHeavy > mbvd;
-                vector< unsigned short > mbi;
-                getSkinMeshFrom(mbvd, mbi, aiM);
-                mesh->addMeshBuffer(mbvd, mbi, nodeMaterialIndex);
+                vector< vertexDataHeavy > &mbvd = convertedSkinVertices[meshIndex];
+                mesh->addMeshBuffer(isLastUse ? std::move(mbvd) : mbvd, std::move(mbi), nodeMaterialIndex);
                 
                 if(aiM->HasBones())
                     loadBonesFromMesh(aiM, (SkinMesh*)mesh, bones);
             } else {
                 
-                vector< vertexData > mbvd;
-                vector< unsigned short > mbi;
-                getMeshFrom(mbvd, mbi, aiM);
-                mesh->addMeshBuffer(mbvd, mbi, nodeMaterialIndex);
+                vector< vertexData > &mbvd = convertedVertices[meshIndex];
+                mesh->addMeshBuffer(isLastUse ? std::move(mbvd) : mbvd, std::move(mbi), nodeMaterialIndex);
             }
             
             Property &px = sceneNode->getProperty(VERTEX_COLOR, nodeMaterialIndex);
@@ -642,51 +674,6 @@ void SceneImporter::importNode(aiNode *node, aiMatrix4x4 parentTransform)
         importNode(node->mChildren[i], transform);
 }
 
-void SceneImporter::getSkinMeshFrom(vector<vertexDataHeavy> &mbvd, vector<unsigned short> &mbi, aiMesh *aiM)
-{
-    for (int j = 0; j < aiM->mNumVertices; j++) {
-        vertexDataHeavy vd;
-        vd.vertPosition = Vector3(aiM->mVertices[j].x, aiM->mVertices[j].y, aiM->mVertices[j].z);
-        
-        if(aiM->mNormals)
-            vd.vertNormal = Vector3(aiM->mNormals[j].x, aiM->mNormals[j].y, aiM->mNormals[j].z);
-        else
-            vd.vertNormal = Vector3(0.0);
-        
-        if(aiM->mTangents)
-            vd.vertTangent = Vector3(aiM->mTangents[j].x, aiM->mTangents[j].y, aiM->mTangents[j].z);
-        else
-            vd.vertTangent = Vector3(0.0);
-        
-        if(aiM->mBitangents)
-            vd.vertBitangent = Vector3(aiM->mBitangents[j].x, aiM->mBitangents[j].y, aiM->mBitangents[j].z);
-        else
-            vd.vertBitangent = Vector3(0.0);
-        
-        if(aiM->mColors[0])
-            vd.vertColor = Vector4(aiM->mColors[0][j].r, aiM->mColors[0][j].g, aiM->mColors[0][j].b, 0.0);
-        else
-            vd.vertColor = Vector4(0.0);
-        
-        if(aiM->mTextureCoords[0])
-            vd.texCoord1 = Vector2(aiM->mTextureCoords[0][j].x, aiM->mTextureCoords[0][j].y);
-        else
-            vd.texCoord1 = Vector2(0.0, 0.0);
-
-        vd.optionalData1 = vd.optionalData2 = vd.optionalData3 = vd.optionalData4 = Vector4(0.0);
-
-        mbvd.push_back(vd);
-    }
-    
-    for (int j = 0; j < aiM->mNumFaces; j++) {
-        aiFace face = aiM->mFaces[j];
-        
-        for (int k = 0; k < face.mNumIndices; k++) {
-            mbi.push_back(face.mIndices[k]);
-        }
-    }
-}
-
 void SceneImporter::loadBoneHierarcy(SkinMesh *m, map< string, Joint*> *bones)
 {
     typedef map< string, Joint* >::iterator it_type;
@@ -771,46 +758,157 @@ void SceneImporter::loadBonesFromMesh(aiMesh *aiM, SkinMesh *m, map< string, Joi
     }
 }
 
-void SceneImporter::getMeshFrom(vector<vertexData> &mbvd, vector<unsigned short> &mbi, aiMesh *aiM)
+template <typename VertexType>
+static void getVerticesFrom(VertexType *vertices, aiMesh *aiM, unsigned int start, unsigned int end)
 {
-    for (int j = 0; j < aiM->mNumVertices; j++) {
-        vertexData vd;
+    for (unsigned int j = start; j < end; j++) {
+        VertexType &vd = vertices[j];
         vd.vertPosition = Vector3(aiM->mVertices[j].x, aiM->mVertices[j].y, aiM->mVertices[j].z);
         
         if(aiM->mNormals)
             vd.vertNormal = Vector3(aiM->mNormals[j].x, aiM->mNormals[j].y, aiM->mNormals[j].z);
-        else
-            vd.vertNormal = Vector3(0.0);
-
+        
         if(aiM->mTangents)
             vd.vertTangent = Vector3(aiM->mTangents[j].x, aiM->mTangents[j].y, aiM->mTangents[j].z);
-        else
-            vd.vertTangent = Vector3(0.0);
-
+        
         if(aiM->mBitangents)
             vd.vertBitangent = Vector3(aiM->mBitangents[j].x, aiM->mBitangents[j].y, aiM->mBitangents[j].z);
-        else
-            vd.vertBitangent = Vector3(0.0);
-
+        
         if(aiM->mColors[0])
             vd.vertColor = Vector4(aiM->mColors[0][j].r, aiM->mColors[0][j].g, aiM->mColors[0][j].b, 0.0);
-        else
-            vd.vertColor = Vector4(0.0);
         
         if(aiM->mTextureCoords[0])
             vd.texCoord1 = Vector2(aiM->mTextureCoords[0][j].x, aiM->mTextureCoords[0][j].y);
-        else
-            vd.texCoord1 = Vector2(0.0, 0.0);
+    }
+}
+
+static void getIndicesFrom(unsigned int *indices, aiMesh *aiM, unsigned int start, unsigned int end)
+{
+    // Only triangle meshes are converted, so every face writes three indices
+    for (unsigned int j = start; j < end; j++)
+        memcpy(indices + j * 3, aiM->mFaces[j].mIndices, 3 * sizeof(unsigned int));
+}
+
+void SceneImporter::getSkinMeshFrom(vector<vertexDataHeavy> &mbvd, vector<unsigned int> &mbi, aiMesh *aiM)
+{
+    // Vertices start zeroed, attributes the mesh lacks stay that way
+    mbvd.resize(aiM->mNumVertices);
+    mbi.resize(aiM->mNumFaces * 3);
+    getVerticesFrom(mbvd.data(), aiM, 0, aiM->mNumVertices);
+    getIndicesFrom(mbi.data(), aiM, 0, aiM->mNumFaces);
+}
+
+void SceneImporter::getMeshFrom(vector<vertexData> &mbvd, vector<unsigned int> &mbi, aiMesh *aiM)
+{
+    mbvd.resize(aiM->mNumVertices);
+    mbi.resize(aiM->mNumFaces * 3);
+    getVerticesFrom(mbvd.data(), aiM, 0, aiM->mNumVertices);
+    getIndicesFrom(mbi.data(), aiM, 0, aiM->mNumFaces);
+}
+
+void SceneImporter::findMeshTypes(aiNode *node, vector<bool> &needsLite, vector<bool> &needsHeavy)
+{
+    bool hasBones = false;
+    for (int i = 0; i < node->mNumMeshes; i++)
+        hasBones = hasBones || scene->mMeshes[node->mMeshes[i]]->HasBones();
+    
+    for (int i = 0; i < node->mNumMeshes; i++) {
+        int meshIndex = node->mMeshes[i];
+        if(scene->mMeshes[meshIndex]->mPrimitiveTypes != aiPrimitiveType_TRIANGLE)
+            continue;
         
-        mbvd.push_back(vd);
+        if(hasBones)
+            needsHeavy[meshIndex] = true;
+        else
+            needsLite[meshIndex] = true;
+        meshReferences[meshIndex]++;
     }
     
-    for (int j = 0; j < aiM->mNumFaces; j++) {
-        aiFace face = aiM->mFaces[j];
+    for (int i = 0; i < node->mNumChildren; i++)
+        findMeshTypes(node->mChildren[i], needsLite, needsHeavy);
+}
+
+void SceneImporter::convertMeshes()
+{
+    convertedVertices.assign(scene->mNumMeshes, vector<vertexData>());
+    convertedSkinVertices.assign(scene->mNumMeshes, vector<vertexDataHeavy>());
+    convertedIndices.assign(scene->mNumMeshes, vector<unsigned int>());
+    meshReferences.assign(scene->mNumMeshes, 0);
+    
+    vector<bool> needsLite(scene->mNumMeshes, false), needsHeavy(scene->mNumMeshes, false);
+    findMeshTypes(scene->mRootNode, needsLite, needsHeavy);
+    
+    // Every mesh is cut into vertex and face chunks, so one large mesh still spreads over all cores
+    vector<MeshConversionJob> jobs;
+    for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+        aiMesh *aiM = scene->mMeshes[i];
+        if(!needsLite[i] && !needsHeavy[i])
+            continue;
+        
+        if(needsLite[i])
+            convertedVertices[i].resize(aiM->mNumVertices);
+        if(needsHeavy[i])
+            convertedSkinVertices[i].resize(aiM->mNumVertices);
+        convertedIndices[i].resize(aiM->mNumFaces * 3);
+        
+        for (unsigned int start = 0; start < aiM->mNumVertices; start += IMPORT_CHUNK_SIZE) {
+            MeshConversionJob job = { i, false, start, min(start + IMPORT_CHUNK_SIZE, aiM->mNumVertices) };
+            jobs.push_back(job);
+        }
+        for (unsigned int start = 0; start < aiM->mNumFaces; start += IMPORT_CHUNK_SIZE) {
+            MeshConversionJob job = { i, true, start, min(start + IMPORT_CHUNK_SIZE, aiM->mNumFaces) };
+            jobs.push_back(job);
+        }
+    }
+    
+    unsigned int threadsCount = min(max(std::thread::hardware_concurrency(), 1u), (unsigned int)jobs.size());
+    if(threadsCount <= 1) {
+        convertMeshJobs(jobs, 0, 1);
+        return;
+    }
+    
+    vector<std::thread> workers;
+    for (unsigned int i = 1; i < threadsCount; i++)
+        workers.push_back(std::thread(&SceneImporter::convertMeshJobs, this, std::cref(jobs), i, threadsCount));
+    convertMeshJobs(jobs, 0, threadsCount);
+    
+    for (int i = 0; i < (int)workers.size(); i++)
+        workers[i].join();
+}
+
+void SceneImporter::convertMeshJobs(const vector<MeshConversionJob> &jobs, unsigned int first, unsigned int stride)
+{
+    // Jobs are interleaved between threads, neighbouring chunks of a mesh land on different cores
+    for (unsigned int i = first; i < jobs.size(); i += stride) {
+        const MeshConversionJob &job = jobs[i];
+        aiMesh *aiM = scene->mMeshes[job.meshIndex];
         
-        for (int k = 0; k < face.mNumIndices; k++) {
-            mbi.push_back(face.mIndices[k]);
+        if(job.isFaces) {
+            getIndicesFrom(convertedIndices[job.meshIndex].data(), aiM, job.start, job.end);
+        } else {
+            if(!convertedVertices[job.meshIndex].empty())
+                getVerticesFrom(convertedVertices[job.meshIndex].data(), aiM, job.start, job.end);
+            if(!convertedSkinVertices[job.meshIndex].empty())
+                getVerticesFrom(convertedSkinVertices[job.meshIndex].data(), aiM, job.start, job.end);
         }
     }
 }
 
+void SceneImporter::clearConvertedMeshes()
+{
+    convertedVertices.clear();
+    convertedSkinVertices.clear();
+    convertedIndices.clear();
+    meshReferences.clear();
+}
+
+void SceneImporter::indexAnimationChannels()
+{
+    animationChannels.clear();
+    for (int i = 0; i < scene->mNumAnimations; i++) {
+        for (int j = 0; j < scene->mAnimations[i]->mNumChannels; j++) {
+            aiNodeAnim* channel = scene->mAnimations[i]->mChannels[j];
+            animationChannels[string(channel->mNodeName.C_Str())].push_back(channel);
+        }
+    }
+}
@@ -23,6 +23,15 @@
 #include "assimp/DefaultLogger.hpp"
 #include "assimp/LogStream.hpp"
 
+#define IMPORT_CHUNK_SIZE 16384u
+#define IMPORT_MAX_BONE_WEIGHTS 8
+
+struct MeshConversionJob {
+    unsigned int meshIndex;
+    bool isFaces;
+    unsigned int start, end;
+};
+
 class SceneImporter {
 public:
     
@@ -55,12 +64,24 @@ private:
     map< string, Joint* > *bones;
     string nodeName;
 
+    // Scene meshes converted ahead of importNode, indexed like scene->mMeshes
+    vector< vector<vertexData> > convertedVertices;
+    vector< vector<vertexDataHeavy> > convertedSkinVertices;
+    vector< vector<unsigned int> > convertedIndices;
+    vector<int> meshReferences;
+    map< string, vector<aiNodeAnim*> > animationChannels;
+
+    void findMeshTypes(aiNode *node, vector<bool> &needsLite, vector<bool> &needsHeavy);
+    void convertMeshes();
+    void convertMeshJobs(const vector<MeshConversionJob> &jobs, unsigned int first, unsigned int stride);
+    void clearConvertedMeshes();
+    void indexAnimationChannels();
 
     void loadBonesFromMesh(aiMesh *aiM, SkinMesh *m, map< string, Joint*> *bones);
     void loadBoneHierarcy(SkinMesh *m, map< string, Joint*> *bones);
 
-    void getSkinMeshFrom(vector<vertexDataHeavy> &mbvd, vector<unsigned short> &mbi, aiMesh *aiM);
-    void getMeshFrom(vector<vertexData> &mbvd, vector<unsigned short> &mbi, aiMesh *aiM);
+    void getSkinMeshFrom(vector<vertexDataHeavy> &mbvd, vector<unsigned int> &mbi, aiMesh *aiM);
+    void getMeshFrom(vector<vertexData> &mbvd, vector<unsigned int> &mbi, aiMesh *aiM);
 };
 
 #endif /* ObjectImporter_hpp */
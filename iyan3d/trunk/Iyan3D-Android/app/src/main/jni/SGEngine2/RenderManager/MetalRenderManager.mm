@@ -351,10 +351,9 @@ void MetalRenderManager::Render(shared_ptr<Node> node, bool isRTT, int nodeIndex
     else
         nodeMes = (dynamic_pointer_cast<MeshNode>(node))->getMesh();
     
-    MTLIndexType indexType = MTLIndexTypeUInt16;
-    
     if (node->type == NODE_TYPE_PARTICLES) {
         nodeMes = (dynamic_pointer_cast<MeshNode>(node))->meshCache;
+        MTLIndexType indexType = nodeMes->isIndex32(0) ? MTLIndexTypeUInt32 : MTLIndexTypeUInt16;
         unsigned int indicesCount = nodeMes->getIndicesCount(0);
         id<MTLBuffer> buf = [MTLNode->indexBuffers objectAtIndex:0];
 
@@ -367,6 +366,7 @@ void MetalRenderManager::Render(shared_ptr<Node> node, bool isRTT, int nodeIndex
             [RenderCMDBuffer setDepthStencilState:_generalDepthWriteEnableState];
 
     } else {
+        MTLIndexType indexType = nodeMes->isIndex32(meshBufferIndex) ? MTLIndexTypeUInt32 : MTLIndexTypeUInt16;
         unsigned int indicesCount = nodeMes->getIndicesCount(meshBufferIndex);
         id<MTLBuffer> buf = [MTLNode->indexBuffers objectAtIndex:meshBufferIndex];
 
@@ -678,8 +678,8 @@ void MetalRenderManager::createVertexAndIndexBuffers(shared_ptr<Node> node,MESH_
         createVertexBuffer(node,i,meshType);
         
         if(updateBothBuffers) {
-            unsigned int length = nodeMes->getIndicesCount(i) * sizeof(unsigned short);
-            [MTLNode->indexBuffers addObject:[device newBufferWithBytes:nodeMes->getIndicesArray(i) length:length options:MTLResourceCPUCacheModeWriteCombined]];
+            unsigned int length = nodeMes->getIndicesCount(i) * nodeMes->getIndexSize(i);
+            [MTLNode->indexBuffers addObject:[device newBufferWithBytes:nodeMes->getIndicesData(i) length:length options:MTLResourceCPUCacheModeWriteCombined]];
         }
     }
 }
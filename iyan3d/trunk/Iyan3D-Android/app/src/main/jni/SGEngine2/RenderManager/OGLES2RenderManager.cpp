@@ -42,6 +42,8 @@ OGLES2RenderManager::OGLES2RenderManager(float screenWidth,float screenHeight,fl
     this->screenHeight = screenHeight;
     this->screenScale = screenScale;
     supportsVAO = false;
+    currentBlendEnabled = false;
+    currentVertexArray = 0;
     depthBuffer = colorBuffer = frameBuffer = 0;
     shaderPrograms.clear();
     Initialize();
@@ -151,8 +153,8 @@ void OGLES2RenderManager::createVAO(shared_ptr<Node> node, short meshBufferIndex
         
         if(OGLNode->IndexBufLocations.size() > meshBufferIndex) {
             size_t indexCount = mesh->getIndicesCount(meshBufferIndex);
-            GLsizeiptr size = sizeof(unsigned short) * indexCount;
-            u_int32_t indexBuf = updateBuffer(GL_ELEMENT_ARRAY_BUFFER, size,  mesh->getIndicesArray(meshBufferIndex), node->memtype == NODE_GPUMEM_TYPE_STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW, OGLNode->IndexBufLocations[meshBufferIndex]);
+            GLsizeiptr size = mesh->getIndexSize(meshBufferIndex) * indexCount;
+            u_int32_t indexBuf = updateBuffer(GL_ELEMENT_ARRAY_BUFFER, size,  mesh->getIndicesData(meshBufferIndex), node->memtype == NODE_GPUMEM_TYPE_STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW, OGLNode->IndexBufLocations[meshBufferIndex]);
             std::replace(OGLNode->IndexBufLocations.begin(), OGLNode->IndexBufLocations.end(), OGLNode->IndexBufLocations[meshBufferIndex], indexBuf);
         } else
             OGLNode->IndexBufLocations.push_back(bindIndexBuffer(node,meshBufferIndex));
@@ -178,8 +180,8 @@ void OGLES2RenderManager::updateVAO(shared_ptr<Node> node, bool updateIndices, b
         if(updateIndices) {
             if(OGLNode->IndexBufLocations.size() > meshBufferIndex) {
                 size_t indexCount =  mesh->getIndicesCount(meshBufferIndex);
-                GLsizeiptr size = sizeof(unsigned short) * indexCount;
-                u_int32_t indexBuf = updateBuffer(GL_ELEMENT_ARRAY_BUFFER, size,  mesh->getIndicesArray(meshBufferIndex), node->memtype == NODE_GPUMEM_TYPE_STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW, OGLNode->IndexBufLocations[meshBufferIndex]);
+                GLsizeiptr size = mesh->getIndexSize(meshBufferIndex) * indexCount;
+                u_int32_t indexBuf = updateBuffer(GL_ELEMENT_ARRAY_BUFFER, size,  mesh->getIndicesData(meshBufferIndex), node->memtype == NODE_GPUMEM_TYPE_STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW, OGLNode->IndexBufLocations[meshBufferIndex]);
                 std::replace(OGLNode->IndexBufLocations.begin(), OGLNode->IndexBufLocations.end(), OGLNode->IndexBufLocations[meshBufferIndex], indexBuf);
             } else
                 OGLNode->IndexBufLocations.push_back(bindIndexBuffer(node,meshBufferIndex));
@@ -201,7 +203,8 @@ void OGLES2RenderManager::bindBufferAndAttributes(shared_ptr<Node> node, int mes
 
 void OGLES2RenderManager::endDisplay()
 {
-    
+    if(supportsVAO)
+        bindVertexArray(0);
 }
 
 void OGLES2RenderManager::Render(shared_ptr<Node> node, bool isRTT, int nodeIndex, int meshBufferIndex)
@@ -223,17 +226,19 @@ void OGLES2RenderManager::Render(shared_ptr<Node> node, bool isRTT, int nodeInde
     if(nodeMes == NULL)
         return;
     
+    int indicesBufferIndex = (node->type == NODE_TYPE_PARTICLES) ? 0 : meshBufferIndex;
+    // Without OES_element_index_uint meshes are split into 16 bit buffers when they are loaded
+    GLenum indicesDataType = nodeMes->isIndex32(indicesBufferIndex) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    
     if(supportsVAO)
         handleVAO(node, 2, meshBufferIndex);
     
-    GLenum indicesDataType = GL_UNSIGNED_SHORT;
     if (node->type == NODE_TYPE_PARTICLES) {
         if(!isRTT) {
             blendFunction(GL_ONE);
             setDepthMask(false);
         }
         unsigned int indicesSize = nodeMes->getIndicesCount(0);
-        shared_ptr<OGLNodeData> OGLNode = dynamic_pointer_cast<OGLNodeData>(node->nodeData);
         if(nodeMes)
             drawElements(getOGLDrawMode(DRAW_MODE_POINTS), (GLsizei)indicesSize, indicesDataType, 0, 0);
         
@@ -247,11 +252,11 @@ void OGLES2RenderManager::Render(shared_ptr<Node> node, bool isRTT, int nodeInde
         drawElements(getOGLDrawMode(node->drawMode), (GLsizei)nodeMes->getIndicesCount(meshBufferIndex), indicesDataType, 0, !supportsInstancing ? 0 : (GLsizei)instancingCount+1);
     }
     
-    if(supportsVAO)
-        handleVAO(node, 3);
-    else {
+    // The vertex array is left bound, the next draw binds its own and temporary buffers unbind it first
+    shared_ptr<OGLNodeData> OGLNode = dynamic_pointer_cast<OGLNodeData>(node->nodeData);
+    OGLNode->boundTexture = currentTextures[0];
+    if(!supportsVAO)
         UnBindAttributes(node->material);
-    }
 }
 
 void OGLES2RenderManager::drawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid *data, GLsizei instanceCount)
@@ -271,7 +276,7 @@ void OGLES2RenderManager::BindAttributes(Material *material, MESH_TYPE meshType)
     if (meshType == MESH_TYPE_LITE) {
         for(int i = 0; i < MAX_VERTEX_DATA;i++) {
             GLenum type = Helper::getOGLES2DataType(attributesType[i]);
-            int attributeIndex = mat->getMaterialAttribIndexByName(attributesName[i]);
+            int attributeIndex = mat->attributeSlots[i];
             if(attributeIndex != NOT_EXISTS) {
                 glVertexAttribPointer((GLuint)mat->attributes[attributeIndex].location, attributesTotalValues[i], type, GL_FALSE, sizeof(vertexData), (GLvoid*)valueIndex);
                 glEnableVertexAttribArray((GLuint)mat->attributes[attributeIndex].location);
@@ -281,7 +286,7 @@ void OGLES2RenderManager::BindAttributes(Material *material, MESH_TYPE meshType)
     } else {
         for(int i = 0; i < MAX_VERTEX_DATA_SKINNED;i++) {
             GLenum type = Helper::getOGLES2DataType(attributesTypeSkinned[i]);
-            int attributeIndex = mat->getMaterialAttribIndexByName(attributesNameSkinned[i]);
+            int attributeIndex = mat->skinnedAttributeSlots[i];
             if(attributeIndex != NOT_EXISTS){
                 glVertexAttribPointer((GLuint)mat->attributes[attributeIndex].location, attributesTotalValuesSkinned[i], type, GL_FALSE, sizeof(vertexDataHeavy), (GLvoid*)valueIndex);
                 glEnableVertexAttribArray((GLuint)mat->attributes[attributeIndex].location);
@@ -322,7 +327,7 @@ bool OGLES2RenderManager::bindTexture(int index, uint32_t texture)
 
 void OGLES2RenderManager::BindUniform(Material* mat, shared_ptr<Node> node, u16 uIndex, bool isFragmentData, int userValue, bool blurTex)
 {
-    OGLUniform uni = ((OGLMaterial*)mat)->uniforms[uIndex];
+    OGLUniform &uni = ((OGLMaterial*)mat)->uniforms[uIndex];
 
     if(uni.type != DATA_TEXTURE_2D && uni.type != DATA_TEXTURE_CUBE && !uni.isUpdated)
         return;
@@ -369,7 +374,7 @@ void OGLES2RenderManager::BindUniform(Material* mat, shared_ptr<Node> node, u16
 //    while((err = glGetError()) != GL_NO_ERROR)
 //        printf("GL Error on unfirm: %d\n", err);
 
-    ((OGLMaterial*)mat)->uniforms[uIndex].isUpdated = false;
+    uni.isUpdated = false;
 }
 
 void OGLES2RenderManager::bindDynamicUniform(Material *material,string name,void* values,DATA_TYPE type,unsigned short count,u16 paramIndex,int nodeIndex,Texture *tex, bool isFragmentData, bool blurTex)
@@ -396,11 +401,13 @@ void OGLES2RenderManager::clearDepthBuffer()
 void OGLES2RenderManager::setTransparencyBlending(bool enable)
 {
     if(enable) {
-        glEnable(GL_BLEND);
+        if(!currentBlendEnabled)
+            glEnable(GL_BLEND);
         blendFunction(GL_ONE_MINUS_SRC_ALPHA);
-    } else {
+    } else if(currentBlendEnabled) {
         glDisable(GL_BLEND);
     }
+    currentBlendEnabled = enable;
 }
 
 void OGLES2RenderManager::blendFunction(GLenum func)
@@ -440,6 +447,8 @@ void OGLES2RenderManager::draw2DImage(Texture *texture, Vector2 originCoord, Vec
         0,3,1,
         2,1,3
     };
+    if(supportsVAO)
+        bindVertexArray(0);
     u_int32_t _vertexBuffer = createAndBindBuffer(GL_ARRAY_BUFFER, (GLuint)(vertices.size() * sizeof(vertexData)), &vertices[0], GL_STATIC_DRAW);
     u_int32_t _indexBuffer = createAndBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (6 * sizeof(unsigned short)), &indices[0], GL_STATIC_DRAW);
     BindAttributes(material);
@@ -455,6 +464,8 @@ void OGLES2RenderManager::draw3DLine(Vector3 start,Vector3 end,Material *materia
     vertData[0].vertPosition = start;
     vertData[1].vertPosition = end;
     u16 indices[] = {0, 1};
+    if(supportsVAO)
+        bindVertexArray(0);
     
     u_int32_t _vertexBuffer = createAndBindBuffer(GL_ARRAY_BUFFER, (GLuint)(2 * sizeof(vertexData)), &vertData[0], GL_STATIC_DRAW);
     u_int32_t _indexBuffer = createAndBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (2 * sizeof(unsigned short)), &indices[0], GL_STATIC_DRAW);
@@ -476,6 +487,8 @@ void OGLES2RenderManager::draw3DLines(vector<Vector3> vPositions,Material *mater
         vertData.push_back(v);
         indices.push_back(i);
     }
+    if(supportsVAO)
+        bindVertexArray(0);
     
     u_int32_t _vertexBuffer = createAndBindBuffer(GL_ARRAY_BUFFER, (GLuint)((int)vPositions.size() *sizeof(vertexData)),&vertData[0], GL_STATIC_DRAW);
     u_int32_t _indexBuffer = createAndBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ((int)vPositions.size() * sizeof(unsigned short)) ,&indices[0], GL_STATIC_DRAW);
@@ -620,6 +633,8 @@ void OGLES2RenderManager::createVertexAndIndexBuffers(shared_ptr<Node> node,MESH
         return;
     
     shared_ptr<OGLNodeData> OGLNode = dynamic_pointer_cast<OGLNodeData>(node->nodeData);
+    if(supportsVAO)
+        bindVertexArray(0);
     
     u16 meshBufferCount = 1;
     if (node->instancedNodes.size() > 0 && !supportsInstancing)
@@ -634,8 +649,8 @@ void OGLES2RenderManager::createVertexAndIndexBuffers(shared_ptr<Node> node,MESH
             
             if(OGLNode->IndexBufLocations.size() > i) {
                 size_t indexCount =  mesh->getIndicesCount(i);
-                GLsizeiptr size = sizeof(unsigned short) * indexCount;
-                u_int32_t indexBuf = updateBuffer(GL_ELEMENT_ARRAY_BUFFER, size,  mesh->getIndicesArray(i), node->memtype == NODE_GPUMEM_TYPE_STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW, OGLNode->IndexBufLocations[i]);
+                GLsizeiptr size = mesh->getIndexSize(i) * indexCount;
+                u_int32_t indexBuf = updateBuffer(GL_ELEMENT_ARRAY_BUFFER, size,  mesh->getIndicesData(i), node->memtype == NODE_GPUMEM_TYPE_STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW, OGLNode->IndexBufLocations[i]);
                 std::replace(OGLNode->IndexBufLocations.begin(), OGLNode->IndexBufLocations.end(), OGLNode->IndexBufLocations[i], indexBuf);
             } else
                 OGLNode->IndexBufLocations.push_back(bindIndexBuffer(node,i));
@@ -650,6 +665,7 @@ void OGLES2RenderManager::handleVAO(shared_ptr<Node> node,int type, short meshBu
         uint32_t arrayToBind;
         glGenVertexArraysOES(1, &arrayToBind);
         glBindVertexArrayOES(arrayToBind);
+        currentVertexArray = arrayToBind;
         if(OGLNode->vertexArrayLocations.size() > meshBufferIndex) {
             std::replace(OGLNode->vertexArrayLocations.begin(), OGLNode->vertexArrayLocations.end(), OGLNode->vertexArrayLocations[meshBufferIndex], arrayToBind);
         } else
@@ -658,9 +674,17 @@ void OGLES2RenderManager::handleVAO(shared_ptr<Node> node,int type, short meshBu
         if(OGLNode->vertexArrayLocations.size() <= meshBufferIndex)
             handleVAO(node, 1, meshBufferIndex, meshType);
         else
-            glBindVertexArrayOES(OGLNode->vertexArrayLocations[meshBufferIndex]);
+            bindVertexArray(OGLNode->vertexArrayLocations[meshBufferIndex]);
     } else
-        glBindVertexArrayOES(0);
+        bindVertexArray(0);
+}
+
+void OGLES2RenderManager::bindVertexArray(uint32_t vertexArray)
+{
+    if(currentVertexArray != vertexArray) {
+        glBindVertexArrayOES(vertexArray);
+        currentVertexArray = vertexArray;
+    }
 }
 
 void OGLES2RenderManager::createVertexBuffer(shared_ptr<Node> node, short meshBufferIndex, MESH_TYPE meshType)
@@ -701,6 +725,38 @@ void OGLES2RenderManager::createVertexBuffer(shared_ptr<Node> node, short meshBu
     }
 }
 
+void OGLES2RenderManager::streamVertexBuffer(shared_ptr<Node> node)
+{
+    // Vertices rewritten every frame alternate between two buffers allocated once,
+    // the one drawn last frame is left alone while the other one is filled
+    shared_ptr<OGLNodeData> OGLNode = dynamic_pointer_cast<OGLNodeData>(node->nodeData);
+    Mesh *mesh = dynamic_pointer_cast<MeshNode>(node)->getMesh();
+    if(!mesh || mesh->getMeshBufferCount() == 0 || mesh->getVerticesCountInMeshBuffer(0) == 0)
+        return;
+    
+    if(supportsVAO)
+        bindVertexArray(0);
+    
+    size_t size = mesh->getVerticesCountInMeshBuffer(0) * sizeof(vertexData);
+    if(OGLNode->streamBufferSize != size) {
+        OGLNode->removeVertexBuffers();
+        OGLNode->vertexBufLocations.push_back(createAndBindBuffer(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW));
+        OGLNode->backVertexBuffer = createAndBindBuffer(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+        OGLNode->streamBufferSize = size;
+        
+        // Indices only change with the vertex count
+        u_int32_t indexBuf = bindIndexBuffer(node, 0);
+        if(OGLNode->IndexBufLocations.size())
+            OGLNode->IndexBufLocations[0] = indexBuf;
+        else
+            OGLNode->IndexBufLocations.push_back(indexBuf);
+    }
+    
+    std::swap(OGLNode->vertexBufLocations[0], OGLNode->backVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, OGLNode->vertexBufLocations[0]);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, mesh->getLiteVerticesForMeshBuffer(0, 0));
+}
+
 u_int32_t OGLES2RenderManager::bindIndexBuffer(shared_ptr<Node> node, int meshBufferIndex)
 {
     Mesh *nodeMes;
@@ -717,11 +773,11 @@ u_int32_t OGLES2RenderManager::bindIndexBuffer(shared_ptr<Node> node, int meshBu
     size_t indexCount =  nodeMes->getIndicesCount(meshBufferIndex);
     GLsizeiptr size;
     shared_ptr<OGLNodeData> nData = dynamic_pointer_cast<OGLNodeData>(node->nodeData);
-    size = sizeof(unsigned short) * indexCount;
+    size = nodeMes->getIndexSize(meshBufferIndex) * indexCount;
     if(nData->IndexBufLocations.size() > meshBufferIndex)
-        return updateBuffer(GL_ELEMENT_ARRAY_BUFFER, size, nodeMes->getIndicesArray(meshBufferIndex), node->memtype == NODE_GPUMEM_TYPE_STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW, nData->IndexBufLocations[meshBufferIndex]);
+        return updateBuffer(GL_ELEMENT_ARRAY_BUFFER, size, nodeMes->getIndicesData(meshBufferIndex), node->memtype == NODE_GPUMEM_TYPE_STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW, nData->IndexBufLocations[meshBufferIndex]);
     else
-        return createAndBindBuffer(GL_ELEMENT_ARRAY_BUFFER , size , nodeMes->getIndicesArray(meshBufferIndex), node->memtype == NODE_GPUMEM_TYPE_STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
+        return createAndBindBuffer(GL_ELEMENT_ARRAY_BUFFER , size , nodeMes->getIndicesData(meshBufferIndex), node->memtype == NODE_GPUMEM_TYPE_STATIC ? GL_STATIC_DRAW : GL_DYNAMIC_DRAW);
 }
 
 u_int32_t OGLES2RenderManager::createAndBindBuffer(GLenum target, GLsizeiptr size, GLvoid *data, GLenum usage)
@@ -33,6 +33,8 @@ private:
     int currentTextureIndex;
     bool currentDepthMask;
     GLenum currentDepthFunction, currentBlendFunction;
+    bool currentBlendEnabled;
+    uint32_t currentVertexArray;
     
     void deleteAndUnbindBuffer(GLenum target,GLsizei size,const GLuint *bufferToDelete);
     void resetToMainBuffers();
@@ -97,6 +99,7 @@ public:
     void createVertexAndIndexBuffers(shared_ptr<Node> node, MESH_TYPE meshType = MESH_TYPE_LITE, bool updateBothBuffers = true);
     void handleVAO(shared_ptr<Node> node, int type, short meshBufferIndex = 0, MESH_TYPE meshType = MESH_TYPE_LITE);
     void createVertexBuffer(shared_ptr<Node> node, short meshBufferIndex = 0, MESH_TYPE meshType = MESH_TYPE_LITE);
+    void streamVertexBuffer(shared_ptr<Node> node);
     
     void createVAO(shared_ptr<Node> node, short meshBufferIndex = 0);
     void updateVAO(shared_ptr<Node> node, bool updateIndices, bool updateAttr, short meshBufferIndex = 0);
@@ -104,6 +107,7 @@ public:
     void setDepthMask(bool enable);
     void setDepthFunction(GLenum func);
     void blendFunction(GLenum func);
+    void bindVertexArray(uint32_t vertexArray);
     
     void resetTextureCache();
 };
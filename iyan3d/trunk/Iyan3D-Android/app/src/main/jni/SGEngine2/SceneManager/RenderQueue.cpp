@@ -0,0 +1,126 @@
+//
+//  RenderQueue.cpp
+//  SGEngine2
+//
+//  Copyright (c) 2014 Smackall Games Pvt Ltd. All rights reserved.
+//
+
+#include "RenderQueue.h"
+
+RenderQueue::RenderQueue()
+{
+    clear();
+}
+
+RenderQueue::~RenderQueue()
+{
+    clear();
+}
+
+void RenderQueue::clear()
+{
+    items.clear();
+    shaderIds.clear();
+    materialIds.clear();
+    textureIds.clear();
+    vertexArrayIds.clear();
+}
+
+u16 RenderQueue::getStateId(std::map<uintptr_t, u16> &ids, uintptr_t value, int bits)
+{
+    std::map<uintptr_t, u16>::iterator it = ids.find(value);
+    if(it != ids.end())
+        return it->second;
+
+    // States past the field width share the last id, they still sort correctly by pass and depth
+    u16 id = (u16)min((int)ids.size(), (1 << bits) - 1);
+    ids.insert(std::pair<uintptr_t, u16>(value, id));
+    return id;
+}
+
+void RenderQueue::add(int nodeIndex, bool isTransparent, uintptr_t shader, uintptr_t material, uintptr_t texture, uintptr_t vertexArray, float depth)
+{
+    RenderQueueItem item;
+    item.key = 0;
+    item.nodeIndex = nodeIndex;
+    item.isTransparent = isTransparent;
+    item.shader = getStateId(shaderIds, shader, RENDER_KEY_STATE_BITS);
+    item.material = getStateId(materialIds, material, RENDER_KEY_STATE_BITS);
+    item.texture = getStateId(textureIds, texture, RENDER_KEY_STATE_BITS);
+    item.vertexArray = getStateId(vertexArrayIds, vertexArray, RENDER_KEY_VAO_BITS);
+    item.depth = max(depth, 0.0f);
+    items.push_back(item);
+}
+
+void RenderQueue::buildKeys(bool sortByState)
+{
+    float maxDepth = 0.0;
+    for (int i = 0; i < items.size(); i++)
+        maxDepth = max(maxDepth, items[i].depth);
+
+    for (int i = 0; i < items.size(); i++) {
+        RenderQueueItem &item = items[i];
+        item.key = (uint64_t)item.isTransparent << 63;
+        if(!sortByState)
+            continue;
+
+        uint64_t state = ((uint64_t)item.shader << (RENDER_KEY_STATE_BITS * 2)) | ((uint64_t)item.material << RENDER_KEY_STATE_BITS) | (uint64_t)item.texture;
+        float depth = (maxDepth > 0.0) ? item.depth / maxDepth : 0.0;
+        if(item.isTransparent) {
+            uint64_t depthBits = (uint64_t)((1.0 - depth) * ((1 << RENDER_KEY_TRANSPARENT_DEPTH_BITS) - 1));
+            item.key |= (depthBits << (RENDER_KEY_STATE_BITS * 3)) | state;
+        } else {
+            uint64_t depthBits = (uint64_t)(depth * ((1 << RENDER_KEY_DEPTH_BITS) - 1));
+            item.key |= (state << (RENDER_KEY_DEPTH_BITS + RENDER_KEY_VAO_BITS)) | (depthBits << RENDER_KEY_VAO_BITS) | (uint64_t)item.vertexArray;
+        }
+    }
+}
+
+void RenderQueue::radixSort()
+{
+    // Stable LSD radix sort on 8 bit digits, digits shared by every key are skipped
+    sortBuffer.resize(items.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        int counts[256];
+        memset(counts, 0, sizeof(counts));
+        for (int i = 0; i < items.size(); i++)
+            counts[(items[i].key >> shift) & 0xFF]++;
+
+        if(counts[(items[0].key >> shift) & 0xFF] == items.size())
+            continue;
+
+        int offset = 0;
+        for (int i = 0; i < 256; i++) {
+            int count = counts[i];
+            counts[i] = offset;
+            offset += count;
+        }
+        for (int i = 0; i < items.size(); i++)
+            sortBuffer[counts[(items[i].key >> shift) & 0xFF]++] = items[i];
+        items.swap(sortBuffer);
+    }
+}
+
+void RenderQueue::sort(bool sortByState)
+{
+    if(items.size() < 2)
+        return;
+
+    buildKeys(sortByState);
+    radixSort();
+}
+
+int RenderQueue::size()
+{
+    return (int)items.size();
+}
+
+int RenderQueue::getNodeIndex(int index)
+{
+    return items[index].nodeIndex;
+}
+
+bool RenderQueue::isTransparent(int index)
+{
+    return items[index].isTransparent;
+}
@@ -0,0 +1,53 @@
+//
+//  RenderQueue.h
+//  SGEngine2
+//
+//  Copyright (c) 2014 Smackall Games Pvt Ltd. All rights reserved.
+//
+
+#ifndef __SGEngine2__RenderQueue__
+#define __SGEngine2__RenderQueue__
+
+#include <map>
+#include <stdint.h>
+#include "../Core/common/common.h"
+
+// Opaque keys: pass | shader | material | texture | depth (front to back) | vertex array
+// Transparent keys: pass | depth (back to front) | shader | material | texture
+#define RENDER_KEY_STATE_BITS 12
+#define RENDER_KEY_DEPTH_BITS 16
+#define RENDER_KEY_VAO_BITS 11
+#define RENDER_KEY_TRANSPARENT_DEPTH_BITS 24
+
+struct RenderQueueItem {
+    uint64_t key;
+    int nodeIndex;
+    bool isTransparent;
+    u16 shader, material, texture, vertexArray;
+    float depth;
+};
+
+class RenderQueue {
+
+private:
+    vector<RenderQueueItem> items;
+    vector<RenderQueueItem> sortBuffer;
+    std::map<uintptr_t, u16> shaderIds, materialIds, textureIds, vertexArrayIds;
+
+    u16 getStateId(std::map<uintptr_t, u16> &ids, uintptr_t value, int bits);
+    void buildKeys(bool sortByState);
+    void radixSort();
+
+public:
+    RenderQueue();
+    ~RenderQueue();
+
+    void clear();
+    void add(int nodeIndex, bool isTransparent, uintptr_t shader, uintptr_t material, uintptr_t texture, uintptr_t vertexArray, float depth);
+    void sort(bool sortByState);
+    int size();
+    int getNodeIndex(int index);
+    bool isTransparent(int index);
+};
+
+#endif /* defined(__SGEngine2__RenderQueue__) */
@@ -15,6 +15,7 @@
 #endif
 
 DEVICE_TYPE common::deviceType = OPENGLES2;
+bool common::supportsIndex32 = true;
 
 SceneManager::SceneManager(float width, float height, float screenScale, DEVICE_TYPE type, string bundlePath, void *renderView)
 {
@@ -24,6 +25,10 @@ SceneManager::SceneManager(float width, float height, float screenScale, DEVICE_
     this->screenScale = screenScale;
     this->bundlePath = bundlePath;
     renderTargetIndex = 0;
+    frustumCulling = true;
+    stateSorting = true;
+    cullingFrustum = NULL;
+    memset(&cullingStats, 0, sizeof(cullingStats));
     #ifdef ANDROID
     renderMan = new OGLES2RenderManager(width, height, screenScale);
     common::deviceType = OPENGLES2;
@@ -51,6 +56,8 @@ SceneManager::SceneManager(float width, float height, float screenScale, DEVICE_
     } else
         renderMan->supportsInstancing = true;
 
+    common::supportsIndex32 = (device != OPENGLES2 || extensions.find("GL_OES_element_index_uint") != std::string::npos);
+
     mtlManger = new MaterialManager(type);
     
     if(device == METAL)
@@ -111,17 +118,18 @@ void SceneManager::AddNode(shared_ptr<Node> node, MESH_TYPE meshType)
 void SceneManager::updateVertexAndIndexBuffers(shared_ptr<Node> node, MESH_TYPE meshType)
 {
 #ifndef UBUNTU
-    if(device == METAL || !renderMan->supportsVAO)
-        renderMan->createVertexAndIndexBuffers(node,meshType, true);
-    
     if(device == OPENGLES2 && node->type == NODE_TYPE_PARTICLES) {
-        for( int i = 0; i < dynamic_pointer_cast<MeshNode>(node)->getMesh()->getMeshBufferCount(); i++) {
-            if(renderMan->supportsVAO)
-                ((OGLES2RenderManager*)renderMan)->updateVAO(node, true, false, i);
-            else
-                ((OGLES2RenderManager*)renderMan)->bindBufferAndAttributes(node, i, meshType);
-        }
+        // Particles only rewrite their vertices, the vertex array is pointed at the freshly filled buffer
+        ((OGLES2RenderManager*)renderMan)->streamVertexBuffer(node);
+        if(renderMan->supportsVAO)
+            ((OGLES2RenderManager*)renderMan)->updateVAO(node, false, true, 0);
+        else
+            ((OGLES2RenderManager*)renderMan)->bindBufferAndAttributes(node, 0, meshType);
+        return;
     }
+    
+    if(device == METAL || !renderMan->supportsVAO)
+        renderMan->createVertexAndIndexBuffers(node,meshType, true);
 #endif
 
 }
@@ -192,31 +200,198 @@ bool SceneManager::PrepareDisplay(int width, int height, bool clearColorBuf, boo
 
 void SceneManager::Render(bool isRTT)
 {
+    beginCulling();
     renderMan->setTransparencyBlending(false);
-    vector<int> nodeIndex;
+    
+    shared_ptr<CameraNode> camera = renderMan->getActiveCamera();
+    Vector3 cameraPosition = (camera) ? camera->getAbsolutePosition() : Vector3(0.0);
+    
+    renderQueue.clear();
     for (int i = 0; i < nodes.size(); i++) {
         if(nodes[i]->type <= NODE_TYPE_CAMERA || nodes[i]->getVisible() == false)
             continue;
         
-        if(isTransparentCallBack(nodes[i]->getID(), nodes[i]->callbackFuncName)) {
-            nodeIndex.push_back(i);
+        if(isNodeCulled(i))
+            continue;
+        
+        bool isTransparent = isTransparentCallBack(nodes[i]->getID(), nodes[i]->callbackFuncName);
+        if(isTransparent && ((nodes[i]->getID() >= 600000 && nodes[i]->getID() < 600010) || (nodes[i]->getID() >= 300000 && nodes[i]->getID() <= 301000)))
             continue;
+        
+        queueNode(i, isTransparent, cameraPosition);
+    }
+    
+    // Opaque nodes always come first, without state sorting both passes keep the scene order
+    renderQueue.sort(stateSorting);
+    bool blending = false;
+    for (int i = 0; i < renderQueue.size(); i++) {
+        if(renderQueue.isTransparent(i) && !blending) {
+            renderMan->setTransparencyBlending(true);
+            blending = true;
         }
-        RenderNode(isRTT, i);
+        RenderNode(isRTT, renderQueue.getNodeIndex(i));
+    }
+    renderQueue.clear();
+    cullingFrustum = NULL;
+}
+
+void SceneManager::queueNode(int index, bool isTransparent, Vector3 cameraPosition)
+{
+    uintptr_t shader = (uintptr_t)nodes[index]->material;
+    uintptr_t texture = 0, vertexArray = 0;
+    
+    if(device == OPENGLES2) {
+        if(nodes[index]->material)
+            shader = ((OGLMaterial*)nodes[index]->material)->shaderProgram;
+        
+        // Texture of the node's last draw, good enough to group nodes sharing a texture
+        shared_ptr<OGLNodeData> nodeData = dynamic_pointer_cast<OGLNodeData>(nodes[index]->nodeData);
+        if(nodeData) {
+            texture = nodeData->boundTexture;
+            if(nodeData->vertexArrayLocations.size())
+                vertexArray = nodeData->vertexArrayLocations[0];
+            else if(nodeData->vertexBufLocations.size())
+                vertexArray = nodeData->vertexBufLocations[0];
+        }
+    }
+    
+    float depth = (nodes[index]->getAbsolutePosition() - cameraPosition).getLength();
+    renderQueue.add(index, isTransparent, shader, (uintptr_t)nodes[index]->material, texture, vertexArray, depth);
+}
+
+void SceneManager::beginCulling()
+{
+    memset(&cullingStats, 0, sizeof(cullingStats));
+    cullingFrustum = NULL;
+    
+    shared_ptr<CameraNode> camera = renderMan->getActiveCamera();
+    if(!frustumCulling || !camera)
+        return;
+    
+    camera->update();
+    cullingFrustum = camera->getViewFrustum();
+    
+    nodeCullState.assign(nodes.size(), FRUSTUM_INTERSECTS);
+    subtreeBounds.assign(nodes.size(), BoundingBox());
+    subtreeBounded.assign(nodes.size(), true);
+    cullingNodeIndex.clear();
+    for (int i = 0; i < nodes.size(); i++)
+        cullingNodeIndex[nodes[i].get()] = i;
+    
+    // Bounds are gathered bottom up, then whole subtrees are accepted or rejected top down
+    for (int i = 0; i < nodes.size(); i++) {
+        if(!nodes[i]->Parent || cullingNodeIndex.find(nodes[i]->Parent.get()) == cullingNodeIndex.end())
+            calculateSubtreeBounds(i);
+    }
+    for (int i = 0; i < nodes.size(); i++) {
+        if(!nodes[i]->Parent || cullingNodeIndex.find(nodes[i]->Parent.get()) == cullingNodeIndex.end())
+            classifySubtree(i, FRUSTUM_INTERSECTS);
+    }
+}
+
+bool SceneManager::isNodeCulled(int index)
+{
+    if(!cullingFrustum || index >= nodeCullState.size() || nodeCullState[index] != FRUSTUM_OUTSIDE)
+        return false;
+    
+    cullingStats.nodesCulled++;
+    return true;
+}
+
+void SceneManager::addMeshBounds(Mesh *mesh, Mat4 transformation, BoundingBox &bounds)
+{
+    BoundingBox *meshBounds = mesh->getBoundingBox();
+    for (int i = 0; i < 8; i++) {
+        Vector3 edge = meshBounds->getEdgeByIndex(i);
+        Vector4 newEdge = transformation * Vector4(edge.x, edge.y, edge.z, 1.0);
+        bounds.addPointsToCalculateBoundingBox(Vector3(newEdge.x, newEdge.y, newEdge.z));
     }
+}
+
+bool SceneManager::getNodeBounds(shared_ptr<Node> node, BoundingBox &bounds)
+{
+    if(node->type <= NODE_TYPE_CAMERA || node->type == NODE_TYPE_INSTANCED)
+        return true;
+    
+    // Skinned, particle and line nodes rewrite their vertices every frame, so the mesh bounds can't be trusted
+    if(node->type != NODE_TYPE_MESH && node->type != NODE_TYPE_LIGHT)
+        return false;
+    if(node->drawMode == DRAW_MODE_LINES || node->memtype == NODE_GPUMEM_TYPE_DYNAMIC || node->shouldUpdateMesh)
+        return false;
+    
+    shared_ptr<MeshNode> meshNode = dynamic_pointer_cast<MeshNode>(node);
+    if(!meshNode || !meshNode->getMesh() || !meshNode->getMesh()->getBoundingBox()->isValid())
+        return false;
+    if(meshNode->meshCache && node->instancedNodes.size() == 0)
+        return false;
     
-    if(nodeIndex.size()) {
-        renderMan->setTransparencyBlending(true);
+    addMeshBounds(meshNode->getMesh(), node->getAbsoluteTransformation(), bounds);
+    for (int i = 0; i < node->instancedNodes.size(); i++)
+        addMeshBounds(meshNode->getMesh(), node->instancedNodes[i]->getAbsoluteTransformation(), bounds);
+    return true;
+}
+
+bool SceneManager::calculateSubtreeBounds(int index)
+{
+    BoundingBox bounds;
+    bool bounded = getNodeBounds(nodes[index], bounds);
     
-        for (int i = 0; i < nodeIndex.size(); i++) {
-            int nodeId = nodeIndex[i];
-            if((nodes[nodeId]->getID() >= 600000 && nodes[nodeId]->getID() < 600010) || (nodes[nodeId]->getID() >= 300000 && nodes[nodeId]->getID() <= 301000))
+    if(nodes[index]->Children) {
+        for (int i = 0; i < nodes[index]->Children->size(); i++) {
+            shared_ptr<Node> child = (*nodes[index]->Children)[i];
+            std::map<Node*, int>::iterator it = (child) ? cullingNodeIndex.find(child.get()) : cullingNodeIndex.end();
+            if(it == cullingNodeIndex.end())
                 continue;
             
-            RenderNode(isRTT, nodeId);
+            if(!calculateSubtreeBounds(it->second))
+                bounded = false;
+            else if(subtreeBounds[it->second].isValid()) {
+                bounds.addPointsToCalculateBoundingBox(subtreeBounds[it->second].getMinEdge());
+                bounds.addPointsToCalculateBoundingBox(subtreeBounds[it->second].getMaxEdge());
+            }
         }
-        nodeIndex.clear();
     }
+    
+    subtreeBounds[index] = bounds;
+    subtreeBounded[index] = bounded;
+    return bounded;
+}
+
+void SceneManager::classifySubtree(int index, FRUSTUM_INTERSECTION parentState)
+{
+    FRUSTUM_INTERSECTION state = parentState;
+    if(state == FRUSTUM_INTERSECTS && subtreeBounded[index] && subtreeBounds[index].isValid())
+        state = cullingFrustum->classifyBox(subtreeBounds[index].getMinEdge(), subtreeBounds[index].getMaxEdge());
+    nodeCullState[index] = state;
+    
+    if(!nodes[index]->Children)
+        return;
+    
+    for (int i = 0; i < nodes[index]->Children->size(); i++) {
+        shared_ptr<Node> child = (*nodes[index]->Children)[i];
+        std::map<Node*, int>::iterator it = (child) ? cullingNodeIndex.find(child.get()) : cullingNodeIndex.end();
+        if(it != cullingNodeIndex.end())
+            classifySubtree(it->second, state);
+    }
+}
+
+bool SceneManager::isInstanceChunkCulled(int index, int chunkStart)
+{
+    if(!cullingFrustum || !renderMan->supportsInstancing || index >= nodeCullState.size() || nodeCullState[index] != FRUSTUM_INTERSECTS || !subtreeBounded[index])
+        return false;
+    
+    Mesh *mesh = dynamic_pointer_cast<MeshNode>(nodes[index])->getMesh();
+    if(!mesh || !mesh->getBoundingBox()->isValid())
+        return false;
+    
+    // Every draw of the chunk includes the original node as instance 0
+    BoundingBox bounds;
+    addMeshBounds(mesh, nodes[index]->getAbsoluteTransformation(), bounds);
+    int chunkEnd = min(chunkStart + renderMan->maxInstances, (int)nodes[index]->instancedNodes.size());
+    for (int i = chunkStart; i < chunkEnd; i++)
+        addMeshBounds(mesh, nodes[index]->instancedNodes[i]->getAbsoluteTransformation(), bounds);
+    
+    return cullingFrustum->classifyBox(bounds.getMinEdge(), bounds.getMaxEdge()) == FRUSTUM_OUTSIDE;
 }
 
 void SceneManager::EndDisplay()
@@ -289,19 +464,42 @@ void SceneManager::RenderNode(bool isRTT, int index, bool clearDepthBuffer, META
     if(nodes[index]->drawMode == DRAW_MODE_LINES && isRTT)
         return;
     
+    vector<bool> chunkCulled;
+    if(nodes[index]->instancedNodes.size() > 0 && cullingFrustum) {
+        bool hasVisibleChunk = false;
+        for(int chunkStart = 0; chunkStart < nodes[index]->instancedNodes.size(); chunkStart += renderMan->maxInstances) {
+            chunkCulled.push_back(isInstanceChunkCulled(index, chunkStart));
+            if(chunkCulled.back())
+                cullingStats.instanceChunksCulled++;
+            else
+                cullingStats.instanceChunksDrawn++;
+            hasVisibleChunk = hasVisibleChunk || !chunkCulled.back();
+        }
+        
+        if(!hasVisibleChunk) {
+            cullingStats.nodesCulled++;
+            return;
+        }
+    }
+    
     for(int meshBufferIndex = 0; meshBufferIndex < meshToRender->getMeshBufferCount(); meshBufferIndex++) {
         if(!renderMan->PrepareNode(nodes[index], meshBufferIndex, isRTT, index))
             return;
         
         int materialIndex = dynamic_pointer_cast<MeshNode>(nodes[index])->getMesh()->getMeshBufferMaterialIndices(meshBufferIndex);
         if(nodes[index]->instancedNodes.size() > 0) {
+            bool isPrepared = true;
             for(nodes[index]->instancingRenderIt = 0; nodes[index]->instancingRenderIt < nodes[index]->instancedNodes.size(); nodes[index]->instancingRenderIt += renderMan->maxInstances) {
+                
+                if(chunkCulled.size() && chunkCulled[nodes[index]->instancingRenderIt / renderMan->maxInstances])
+                    continue;
 
-                if(!renderMan->supportsVAO && nodes[index]->instancingRenderIt > 0)
+                if(!renderMan->supportsVAO && !isPrepared)
                     renderMan->PrepareNode(nodes[index], meshBufferIndex, isRTT, index);
                 
                 ShaderCallBackForNode(nodes[index]->getID(), nodes[index]->material->name, materialIndex, nodes[index]->callbackFuncName);
                 renderMan->Render(nodes[index],isRTT, index,meshBufferIndex);
+                isPrepared = false;
             }
         } else {
             ShaderCallBackForNode(nodes[index]->getID(), nodes[index]->material->name, materialIndex, nodes[index]->callbackFuncName);
@@ -310,6 +508,8 @@ void SceneManager::RenderNode(bool isRTT, int index, bool clearDepthBuffer, META
         
     }
 
+    if(cullingFrustum)
+        cullingStats.nodesDrawn++;
     nodes[index]->shouldUpdateMesh = false;
 }
 
@@ -527,30 +727,40 @@ void SceneManager::draw3DLines(vector<Vector3> vPositions, Vector3 color, Materi
 }
 
 void SceneManager::setPropertyValue(Material *material, string name, float* values, DATA_TYPE type, unsigned short count, bool isFragmentData, u16 paramIndex, int nodeIndex, int materialIndex, Texture *tex, int userValue)
+{
+    setPropertyValue(material, Material::getUniformId(name), values, type, count, isFragmentData, paramIndex, nodeIndex, materialIndex, tex, userValue);
+}
+
+void SceneManager::setPropertyValue(Material *material, string name, int* values, DATA_TYPE type, unsigned short count, bool isFragmentData, u16 paramIndex, int nodeIndex, int materialIndex, Texture *tex, int userValue, bool blurTex)
+{
+    setPropertyValue(material, Material::getUniformId(name), values, type, count, isFragmentData, paramIndex, nodeIndex, materialIndex, tex, userValue, blurTex);
+}
+
+void SceneManager::setPropertyValue(Material *material, u16 uniformId, float* values, DATA_TYPE type, unsigned short count, bool isFragmentData, u16 paramIndex, int nodeIndex, int materialIndex, Texture *tex, int userValue)
 {
     shared_ptr<Node> nod;
     if(nodeIndex != NOT_EXISTS) nod = nodes[nodeIndex];
     
     if(nodeIndex == NOT_EXISTS && device == METAL) {
-        renderMan->bindDynamicUniform(material,name,values,type,count,paramIndex,nodeIndex,tex,isFragmentData);
+        renderMan->bindDynamicUniform(material,Material::getUniformName(uniformId),values,type,count,paramIndex,nodeIndex,tex,isFragmentData);
     } else {
-        short uIndex = material->setPropertyValue(name, values, type, count, paramIndex, nodeIndex, materialIndex, renderTargetIndex);
+        short uIndex = material->setPropertyValue(uniformId, values, type, count, paramIndex, nodeIndex, materialIndex, renderTargetIndex);
         renderMan->BindUniform(material, nod, uIndex, isFragmentData, userValue);
     }
 }
 
-void SceneManager::setPropertyValue(Material *material, string name, int* values, DATA_TYPE type, unsigned short count, bool isFragmentData, u16 paramIndex, int nodeIndex, int materialIndex, Texture *tex, int userValue, bool blurTex)
+void SceneManager::setPropertyValue(Material *material, u16 uniformId, int* values, DATA_TYPE type, unsigned short count, bool isFragmentData, u16 paramIndex, int nodeIndex, int materialIndex, Texture *tex, int userValue, bool blurTex)
 {
     shared_ptr<Node> nod;
     if(nodeIndex != NOT_EXISTS)
         nod = nodes[nodeIndex];
     
     if(nodeIndex == NOT_EXISTS && device == METAL) {
-        renderMan->bindDynamicUniform(material, name, values, type, count, paramIndex, nodeIndex, tex, isFragmentData, blurTex);
+        renderMan->bindDynamicUniform(material, Material::getUniformName(uniformId), values, type, count, paramIndex, nodeIndex, tex, isFragmentData, blurTex);
     } else {
-        short uIndex = material->setPropertyValue(name, values, type, count, paramIndex, nodeIndex, materialIndex, renderTargetIndex);
+        short uIndex = material->setPropertyValue(uniformId, values, type, count, paramIndex, nodeIndex, materialIndex, renderTargetIndex);
         if(device == METAL)
-            renderMan->bindDynamicUniform(material, name, values, type, count, paramIndex, nodeIndex, tex, isFragmentData, blurTex);
+            renderMan->bindDynamicUniform(material, Material::getUniformName(uniformId), values, type, count, paramIndex, nodeIndex, tex, isFragmentData, blurTex);
         else
             renderMan->BindUniform(material, nod, uIndex, isFragmentData, userValue, blurTex);
     }
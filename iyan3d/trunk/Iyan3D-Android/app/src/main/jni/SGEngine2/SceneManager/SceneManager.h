@@ -12,6 +12,7 @@
 #include "../RenderManager/RenderManager.h"
 #include "../RenderManager/OGLES2RenderManager.h"
 #include "../RenderManager/MetalWrapper.h"
+#include "RenderQueue.h"
 #include "../Core/Textures/Texture.h"
 #include "../Core/Textures/OGLTexture.h"
 #include "../Core/Nodes/AnimatedMeshNode.h"
@@ -27,12 +28,36 @@
 #include "../Core/Textures/DummyTexture.h"
 #endif
 
+struct CullingStats {
+    int nodesDrawn;
+    int nodesCulled;
+    int instanceChunksDrawn;
+    int instanceChunksCulled;
+};
+
 class SceneManager {
 private:
     int draw2DMatIndex;
     MaterialManager* mtlManger;
     void setShaderState(int nodeIndex);
     int renderTargetIndex;
+
+    Frustum *cullingFrustum;
+    vector<char> nodeCullState;
+    vector<BoundingBox> subtreeBounds;
+    vector<bool> subtreeBounded;
+    std::map<Node*, int> cullingNodeIndex;
+
+    void beginCulling();
+    bool isNodeCulled(int index);
+    bool getNodeBounds(shared_ptr<Node> node, BoundingBox &bounds);
+    void addMeshBounds(Mesh *mesh, Mat4 transformation, BoundingBox &bounds);
+    bool calculateSubtreeBounds(int index);
+    void classifySubtree(int index, FRUSTUM_INTERSECTION parentState);
+    bool isInstanceChunkCulled(int index, int chunkStart);
+
+    RenderQueue renderQueue;
+    void queueNode(int index, bool isTransparent, Vector3 cameraPosition);
     
 public:
     void AddNode(shared_ptr<Node> node,MESH_TYPE meshType = MESH_TYPE_LITE);
@@ -43,6 +68,9 @@ public:
     vector< shared_ptr<Node> > nodes;
     vector<Texture*> textures;
     float displayWidth,displayHeight,screenScale;
+    bool frustumCulling;
+    bool stateSorting;
+    CullingStats cullingStats;
 
     SceneManager(float width,float height,float screenScale,DEVICE_TYPE type,string bundlePath,void *renderView = NULL);
     ~SceneManager();
@@ -83,6 +111,8 @@ public:
 
     void setPropertyValue(Material *material, string name, float* values, DATA_TYPE type, unsigned short count, bool isFragmentData, u16 paramIndex = 0, int nodeIndex = -1, int materialIndex = -1, Texture *tex = NULL, int userValue = 0);
     void setPropertyValue(Material *material, string name, int* values, DATA_TYPE type, unsigned short count, bool isFragmentData, u16 paramIndex = 0, int nodeIndex = -1, int materialIndex = -1, Texture *tex = NULL, int userValue = 0, bool blurTex = true);
+    void setPropertyValue(Material *material, u16 uniformId, float* values, DATA_TYPE type, unsigned short count, bool isFragmentData, u16 paramIndex = 0, int nodeIndex = -1, int materialIndex = -1, Texture *tex = NULL, int userValue = 0);
+    void setPropertyValue(Material *material, u16 uniformId, int* values, DATA_TYPE type, unsigned short count, bool isFragmentData, u16 paramIndex = 0, int nodeIndex = -1, int materialIndex = -1, Texture *tex = NULL, int userValue = 0, bool blurTex = true);
     
     bool RemoveMaterialByIndex(u16 index);
     bool RemoveMaterial(Material *mat);
@@ -17,7 +17,7 @@ include $(call all-subdir-makefiles)
 LOCAL_PATH := $(TOP_LOCAL_PATH)  
 include $(CLEAR_VARS)
 
-LOCAL_SRC_FILES := Helper.cpp Logger.cpp Maths.cpp
+LOCAL_SRC_FILES := Helper.cpp Logger.cpp Maths.cpp VertexWelder.cpp MappedFile.cpp WorkerPool.cpp
 LOCAL_CFLAGS   	+= -std=c++11 -frtti -fexceptions -fpermissive
 LOCAL_LDLIBS	+= -llog -lGLESv2 -lEGL -landroid -lOpenSLES -lGLESv1_CM -lz
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/SGEngine2 \
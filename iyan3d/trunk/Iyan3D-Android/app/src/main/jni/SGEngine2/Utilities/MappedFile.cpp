@@ -0,0 +1,106 @@
+//
+//  MappedFile.cpp
+//  SGEngine2
+//
+//  Copyright (c) 2014 Smackall Games Pvt Ltd. All rights reserved.
+//
+
+#include "MappedFile.h"
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+MappedFile::MappedFile()
+{
+    data = NULL;
+    size = 0;
+    isMapped = false;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(std::string filePath)
+{
+    close();
+    
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if(fd < 0)
+        return false;
+    
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    size = (size_t)fileStat.st_size;
+    
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapping != MAP_FAILED) {
+        data = (unsigned char*)mapping;
+        isMapped = true;
+        madvise(mapping, size, MADV_SEQUENTIAL);
+    } else {
+        data = new unsigned char[size];
+        size_t offset = 0;
+        while(offset < size) {
+            ssize_t length = ::read(fd, data + offset, size - offset);
+            if(length <= 0)
+                break;
+            offset += length;
+        }
+        if(offset != size) {
+            ::close(fd);
+            close();
+            return false;
+        }
+    }
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if(data) {
+        if(isMapped)
+            munmap(data, size);
+        else
+            delete [] data;
+    }
+    data = NULL;
+    size = 0;
+    isMapped = false;
+}
+
+bool MappedFile::isOpen()
+{
+    return data != NULL;
+}
+
+size_t MappedFile::getSize()
+{
+    return size;
+}
+
+const unsigned char* MappedFile::getRange(size_t offset, size_t length)
+{
+    if(!data || offset > size || length > size - offset)
+        return NULL;
+    return data + offset;
+}
+
+bool MappedFile::read(size_t &offset, void* destination, size_t length)
+{
+    const unsigned char* range = getRange(offset, length);
+    if(!range)
+        return false;
+    
+    memcpy(destination, range, length);
+    offset += length;
+    return true;
+}
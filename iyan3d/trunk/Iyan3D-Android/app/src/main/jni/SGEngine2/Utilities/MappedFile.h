@@ -0,0 +1,37 @@
+//
+//  MappedFile.h
+//  SGEngine2
+//
+//  Copyright (c) 2014 Smackall Games Pvt Ltd. All rights reserved.
+//
+
+#ifndef __SGEngine2__MappedFile__
+#define __SGEngine2__MappedFile__
+
+#include <string>
+#include <stddef.h>
+
+// Read only view of a whole file, mapped into memory so blocks can be copied
+// or referenced in place. Files that can't be mapped are read in one go.
+class MappedFile {
+    
+private:
+    unsigned char* data;
+    size_t size;
+    bool isMapped;
+    
+public:
+    MappedFile();
+    ~MappedFile();
+    
+    bool open(std::string filePath);
+    void close();
+    bool isOpen();
+    size_t getSize();
+    
+    // Both return false or NULL when the range runs past the end of the file
+    const unsigned char* getRange(size_t offset, size_t length);
+    bool read(size_t &offset, void* destination, size_t length);
+};
+
+#endif /* defined(__SGEngine2__MappedFile__) */
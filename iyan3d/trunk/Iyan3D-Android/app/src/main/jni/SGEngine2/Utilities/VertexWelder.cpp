@@ -0,0 +1,118 @@
+//
+//  VertexWelder.cpp
+//  SGEngine2
+//
+//  Copyright (c) 2014 Smackall Games Pvt Ltd. All rights reserved.
+//
+
+#include "VertexWelder.h"
+
+VertexWelder::VertexWelder(float epsilon, int expectedCount)
+{
+    this->epsilon = max(epsilon, 0.0f);
+    positions.reserve(expectedCount);
+    nextInCell.reserve(expectedCount);
+    cellHeads.reserve(expectedCount);
+}
+
+VertexWelder::~VertexWelder()
+{
+    clear();
+}
+
+void VertexWelder::clear()
+{
+    cellHeads.clear();
+    nextInCell.clear();
+    positions.clear();
+}
+
+void VertexWelder::getCell(Vector3 position, int64_t cell[3])
+{
+    float values[3] = { position.x, position.y, position.z };
+    for (int i = 0; i < 3; i++) {
+        if(epsilon > 0.0) {
+            cell[i] = (int64_t)floor(values[i] / epsilon);
+        } else {
+            // Exact welding buckets by value, adding 0 folds -0 into 0
+            float value = values[i] + 0.0f;
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            cell[i] = bits;
+        }
+    }
+}
+
+uint64_t VertexWelder::getCellKey(int64_t x, int64_t y, int64_t z)
+{
+    uint64_t key = (uint64_t)x * 0x9E3779B97F4A7C15ull;
+    key ^= (uint64_t)y * 0xC2B2AE3D27D4EB4Full + (key << 6) + (key >> 2);
+    key ^= (uint64_t)z * 0x165667B19E3779F9ull + (key << 6) + (key >> 2);
+    return key;
+}
+
+int VertexWelder::findInCell(uint64_t key, Vector3 position)
+{
+    std::unordered_map<uint64_t, int>::iterator it = cellHeads.find(key);
+    if(it == cellHeads.end())
+        return NOT_EXISTS;
+    
+    // Cells sharing a key are told apart by the distance test, the lowest index wins
+    int found = NOT_EXISTS;
+    float epsilonSQ = epsilon * epsilon;
+    for (int i = it->second; i != NOT_EXISTS; i = nextInCell[i]) {
+        Vector3 offset = positions[i] - position;
+        bool matches = (epsilon > 0.0) ? offset.dotProduct(offset) <= epsilonSQ : positions[i] == position;
+        if(matches && (found == NOT_EXISTS || i < found))
+            found = i;
+    }
+    return found;
+}
+
+int VertexWelder::find(Vector3 position)
+{
+    int64_t cell[3];
+    getCell(position, cell);
+    if(epsilon == 0.0)
+        return findInCell(getCellKey(cell[0], cell[1], cell[2]), position);
+    
+    int found = NOT_EXISTS;
+    for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+            for (int z = -1; z <= 1; z++) {
+                int index = findInCell(getCellKey(cell[0] + x, cell[1] + y, cell[2] + z), position);
+                if(index != NOT_EXISTS && (found == NOT_EXISTS || index < found))
+                    found = index;
+            }
+        }
+    }
+    return found;
+}
+
+int VertexWelder::add(Vector3 position)
+{
+    int index = find(position);
+    if(index != NOT_EXISTS)
+        return index;
+    
+    int64_t cell[3];
+    getCell(position, cell);
+    uint64_t key = getCellKey(cell[0], cell[1], cell[2]);
+    
+    index = (int)positions.size();
+    positions.push_back(position);
+    std::unordered_map<uint64_t, int>::iterator it = cellHeads.find(key);
+    if(it == cellHeads.end()) {
+        nextInCell.push_back(NOT_EXISTS);
+        cellHeads.insert(std::pair<uint64_t, int>(key, index));
+    } else {
+        nextInCell.push_back(it->second);
+        it->second = index;
+    }
+    return index;
+}
+
+int VertexWelder::size()
+{
+    return (int)positions.size();
+}
@@ -0,0 +1,42 @@
+//
+//  VertexWelder.h
+//  SGEngine2
+//
+//  Copyright (c) 2014 Smackall Games Pvt Ltd. All rights reserved.
+//
+
+#ifndef __SGEngine2__VertexWelder__
+#define __SGEngine2__VertexWelder__
+
+#include <stdint.h>
+#include <unordered_map>
+#include "../Core/common/common.h"
+
+// Merges positions that lie within epsilon of each other in expected linear
+// time. Positions are bucketed into a spatial hash of epsilon sized cells so
+// a lookup only visits the neighbouring cells, an epsilon of 0 welds exact
+// matches only. Welded indices follow the order positions were first added.
+class VertexWelder {
+    
+private:
+    float epsilon;
+    std::unordered_map<uint64_t, int> cellHeads;
+    vector<int> nextInCell;
+    
+    void getCell(Vector3 position, int64_t cell[3]);
+    uint64_t getCellKey(int64_t x, int64_t y, int64_t z);
+    int findInCell(uint64_t key, Vector3 position);
+    
+public:
+    vector<Vector3> positions;
+    
+    VertexWelder(float epsilon = 0.0, int expectedCount = 0);
+    ~VertexWelder();
+    
+    void clear();
+    int add(Vector3 position);
+    int find(Vector3 position);
+    int size();
+};
+
+#endif /* defined(__SGEngine2__VertexWelder__) */
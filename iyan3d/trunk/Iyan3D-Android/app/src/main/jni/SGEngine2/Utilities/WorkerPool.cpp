@@ -0,0 +1,90 @@
+//
+//  WorkerPool.cpp
+//  SGEngine2
+//
+//  Copyright (c) 2014 Smackall Games Pvt Ltd. All rights reserved.
+//
+
+#include "WorkerPool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threadsCount)
+{
+    jobCount = rangeSize = nextRange = rangesCount = pendingRanges = 0;
+    stopping = false;
+    for (int i = 1; i < threadsCount; i++)
+        workers.push_back(std::thread(&WorkerPool::run, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (int i = 0; i < (int)workers.size(); i++)
+        workers[i].join();
+}
+
+WorkerPool* WorkerPool::getShared()
+{
+    static WorkerPool pool(std::max((int)std::thread::hardware_concurrency(), 1));
+    return &pool;
+}
+
+int WorkerPool::getThreadsCount()
+{
+    return (int)workers.size() + 1;
+}
+
+bool WorkerPool::runNextRange(std::unique_lock<std::mutex> &lock)
+{
+    if(nextRange >= rangesCount)
+        return false;
+    
+    int start = nextRange++ * rangeSize;
+    int end = std::min(start + rangeSize, jobCount);
+    lock.unlock();
+    job(start, end);
+    lock.lock();
+    if(--pendingRanges == 0)
+        jobDone.notify_all();
+    return true;
+}
+
+void WorkerPool::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        jobReady.wait(lock, [this] { return stopping || nextRange < rangesCount; });
+        if(stopping)
+            return;
+        runNextRange(lock);
+    }
+}
+
+void WorkerPool::parallelFor(int count, int rangeSize, const std::function<void(int, int)> &job)
+{
+    if(count <= 0)
+        return;
+    rangeSize = std::max(rangeSize, 1);
+    if(workers.empty() || count <= rangeSize) {
+        job(0, count);
+        return;
+    }
+    
+    std::lock_guard<std::mutex> submitLock(submitMutex);
+    std::unique_lock<std::mutex> lock(mutex);
+    this->job = job;
+    this->jobCount = count;
+    this->rangeSize = rangeSize;
+    nextRange = 0;
+    rangesCount = pendingRanges = (count + rangeSize - 1) / rangeSize;
+    jobReady.notify_all();
+    
+    while (runNextRange(lock))
+        ;
+    jobDone.wait(lock, [this] { return pendingRanges == 0; });
+    this->job = nullptr;
+}
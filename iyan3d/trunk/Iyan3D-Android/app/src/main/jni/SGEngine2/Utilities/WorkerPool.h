@@ -0,0 +1,51 @@
+//
+//  WorkerPool.h
+//  SGEngine2
+//
+//  Copyright (c) 2014 Smackall Games Pvt Ltd. All rights reserved.
+//
+
+#ifndef __SGEngine2__WorkerPool__
+#define __SGEngine2__WorkerPool__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// Threads started once and reused for data parallel loops, so per frame work
+// like skinning or particle updates doesn't pay for thread creation. The
+// calling thread runs ranges as well. Jobs must not call parallelFor again.
+class WorkerPool {
+    
+private:
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable jobDone;
+    std::function<void(int, int)> job;
+    int jobCount;
+    int rangeSize;
+    int nextRange;
+    int rangesCount;
+    int pendingRanges;
+    bool stopping;
+    
+    void run();
+    bool runNextRange(std::unique_lock<std::mutex> &lock);
+    
+public:
+    WorkerPool(int threadsCount);
+    ~WorkerPool();
+    
+    static WorkerPool* getShared();
+    
+    // Splits [0, count) into ranges of at most rangeSize and returns once
+    // job(start, end) has finished for all of them
+    void parallelFor(int count, int rangeSize, const std::function<void(int, int)> &job);
+    int getThreadsCount();
+};
+
+#endif /* defined(__SGEngine2__WorkerPool__) */
@@ -9,7 +9,7 @@
 class  SGRTMat4
 {
 public:
-    float c[16];
+    float c[16] __attribute__((aligned(16)));
 
     SGRTMat4()
     {
@@ -60,6 +60,22 @@ public:
     }
     SGRTMat4& operator*=(const SGRTMat4& m)
     {
+#ifndef SGRT_DOUBLE_PRECISION
+        __m128 col0 = _mm_load_ps(c);
+        __m128 col1 = _mm_load_ps(c + 4);
+        __m128 col2 = _mm_load_ps(c + 8);
+        __m128 col3 = _mm_load_ps(c + 12);
+        // Results are stored only after every element of m is read, m may be *this
+        __m128 r[4];
+        for (int i = 0; i < 4; i++) {
+            r[i] = _mm_mul_ps(col0, _mm_set1_ps(m.c[i * 4 + 0]));
+            r[i] = _mm_add_ps(r[i], _mm_mul_ps(col1, _mm_set1_ps(m.c[i * 4 + 1])));
+            r[i] = _mm_add_ps(r[i], _mm_mul_ps(col2, _mm_set1_ps(m.c[i * 4 + 2])));
+            r[i] = _mm_add_ps(r[i], _mm_mul_ps(col3, _mm_set1_ps(m.c[i * 4 + 3])));
+        }
+        for (int i = 0; i < 4; i++)
+            _mm_store_ps(c + i * 4, r[i]);
+#else
     	SGRTMat4 m3;
     	SGRTMat4 m2 = m;
     	SGRTMat4 m1 = (*this);
@@ -82,12 +98,16 @@ public:
         (*this)[13] = m1[1] * m2[12] + m1[5] * m2[13] + m1[9] * m2[14] + m1[13] * m2[15];
         (*this)[14] = m1[2] * m2[12] + m1[6] * m2[13] + m1[10] * m2[14] + m1[14] * m2[15];
         (*this)[15] = m1[3] * m2[12] + m1[7] * m2[13] + m1[11] * m2[14] + m1[15] * m2[15];
+#endif
 
         return *this;
     }
 
     Vec3fa operator*(const Vec3fa& v) const
     {
+#ifndef SGRT_DOUBLE_PRECISION
+        return transformDirection(v);
+#else
         Vec3fa result;
         SGRTMat4 ret = *this;
 
@@ -96,6 +116,7 @@ public:
         result.z = ret[2] * v.x + ret[6] * v.y + ret[10] * v.z;// + ret[14];
 
         return result;
+#endif
     }
 
     SGRTMat4 operator*(const SGRTMat4& m) const
@@ -358,12 +379,28 @@ public:
         return *this;
     }
 
+#ifndef SGRT_DOUBLE_PRECISION
+    Vec3fa transformDirection(const Vec3fa& v) const
+    {
+        __m128 r = _mm_mul_ps(_mm_load_ps(c), _mm_set1_ps(v.x));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(c + 4), _mm_set1_ps(v.y)));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(c + 8), _mm_set1_ps(v.z)));
+        Vec3fa result = Vec3fa(r);
+        result.a = 0.0f;
+        return result;
+    }
+#endif
+
     void rotateVect(Vec3fa& vect) const
     {
+#ifndef SGRT_DOUBLE_PRECISION
+        vect = transformDirection(vect);
+#else
         Vec3fa tmp = vect;
         vect.x = tmp.x * (*this)[0] + tmp.y * (*this)[4] + tmp.z * (*this)[8];
         vect.y = tmp.x * (*this)[1] + tmp.y * (*this)[5] + tmp.z * (*this)[9];
         vect.z = tmp.x * (*this)[2] + tmp.y * (*this)[6] + tmp.z * (*this)[10];
+#endif
     }
 
 };
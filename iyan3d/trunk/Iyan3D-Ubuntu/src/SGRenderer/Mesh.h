@@ -10,19 +10,158 @@ public:
 	SGRMaterial material;
 	
 	SGRTTexture* texture;
-	Vec3fa* uvs;
-	Vec3fa* normals;
+	Vertex* vertices;
+	unsigned int* indices;
+	float* normals;
+	float* uvs;
+
+	SGFDFile* frameFile;
+	uint64_t geometryHash;
 
 	Vec3fa center;
 	int numberOfTriangles;
+	int numberOfVertices;
 
 	Vec3fa minPoint, maxPoint;
 
+	vector<sgrtreal> triangleAreaCdf;
+	sgrtreal surfaceArea;
+
+	vector<float> texelScale;
+
 	SGRTMesh(RTCScene rtcScene, ifstream &data) {
-		center = Vec3fa(0.0f);
-		minPoint = Vec3fa(999.0f);
-		maxPoint = Vec3fa(-999.0f);
+		initialize();
+		readMaterial(data);
+
+		numberOfTriangles = readInt(data);
+		numberOfVertices = numberOfTriangles * 3;
+		vertices = (Vertex*) malloc(numberOfVertices*sizeof(Vertex));
+		indices = (unsigned int*) malloc(numberOfTriangles*3*sizeof(unsigned int));
+		normals = (float*) malloc(numberOfVertices*3*sizeof(float));
+		uvs = (float*) malloc(numberOfVertices*2*sizeof(float));
+		for (int i = 0; i < numberOfTriangles * 3; i++)
+			indices[i] = i;
+
+		readGeometry(data, vertices);
+		updateGeometryData();
+		createGeometry(rtcScene);
+	}
+
+	SGRTMesh(RTCScene rtcScene, SGFDFile *file, int node) {
+		initialize();
+		readMaterial(file, node);
+
+		const SGFDNodeEntry *entry = file->getNode(node);
+		numberOfTriangles = entry->indexCount / 3;
+		numberOfVertices = entry->vertexCount;
+		setFrameGeometry(file, node);
+		createGeometry(rtcScene);
+	}
+
+	void initialize() {
+		texture = NULL;
+		vertices = NULL;
+		indices = NULL;
+		normals = NULL;
+		uvs = NULL;
+		frameFile = NULL;
+		geometryHash = 0;
+		surfaceArea = 0.0;
+	}
+
+	void createGeometry(RTCScene rtcScene) {
+		id = rtcNewTriangleMesh(rtcScene, persistentRenderer ? RTC_GEOMETRY_DEFORMABLE : RTC_GEOMETRY_STATIC, numberOfTriangles, numberOfVertices);
+		rtcSetIntersectionFilterFunction(rtcScene, id, (RTCFilterFunc)&intersectFilterFunction);
+		rtcSetOcclusionFilterFunction(rtcScene, id, (RTCFilterFunc)&occludeFilterFunction);
+		if(rayPacketSize == 8) {
+			rtcSetIntersectionFilterFunction8(rtcScene, id, (RTCFilterFunc8)&intersectFilterFunctionN<RTCRay8, 8>);
+			rtcSetOcclusionFilterFunction8(rtcScene, id, (RTCFilterFunc8)&occludeFilterFunctionN<RTCRay8, 8>);
+		} else if(rayPacketSize == 16) {
+			rtcSetIntersectionFilterFunction16(rtcScene, id, (RTCFilterFunc16)&intersectFilterFunctionN<RTCRay16, 16>);
+			rtcSetOcclusionFilterFunction16(rtcScene, id, (RTCFilterFunc16)&occludeFilterFunctionN<RTCRay16, 16>);
+		}
+		rtcSetUserData(rtcScene, id, this);
+
+		updateMask(rtcScene);
+		setBuffers(rtcScene);
+	}
+
+	/// Embree reads the vertex and index arrays in place, whether they were
+	/// read from a v1 stream or point into a mapped SGFD frame.
+	void setBuffers(RTCScene rtcScene) {
+		rtcSetBuffer(rtcScene, id, RTC_VERTEX_BUFFER, vertices, 0, sizeof(Vertex));
+		rtcSetBuffer(rtcScene, id, RTC_INDEX_BUFFER, indices, 0, sizeof(Triangle));
+	}
+
+	bool updateMesh(RTCScene rtcScene, ifstream &data) {
+		if(frameFile)
+			return false;
+
+		bool wasEmissive = material.emission > 0.0;
+		readMaterial(data);
+
+		if(readInt(data) != numberOfTriangles)
+			return false;
+
+		if(wasEmissive != (material.emission > 0.0))
+			updateMask(rtcScene);
 
+		Vertex* newVertices = (Vertex*) malloc(numberOfVertices*sizeof(Vertex));
+		readGeometry(data, newVertices);
+
+		bool hasMoved = false;
+		for (int i = 0; i < numberOfVertices && !hasMoved; i++)
+			hasMoved = vertices[i].x != newVertices[i].x || vertices[i].y != newVertices[i].y || vertices[i].z != newVertices[i].z;
+		if(hasMoved)
+			memcpy(vertices, newVertices, numberOfVertices*sizeof(Vertex));
+		free(newVertices);
+		updateGeometryData();
+
+		if(hasMoved)
+			rtcUpdate(rtcScene, id);
+		return true;
+	}
+
+	/// Keeps reading from the frame the mesh was loaded from while the
+	/// geometry hash in the new frame's node table is unchanged.
+	bool updateMesh(RTCScene rtcScene, SGFDFile *file, int node) {
+		const SGFDNodeEntry *entry = file->getNode(node);
+		if(!frameFile || entry->vertexCount != numberOfVertices || entry->indexCount != numberOfTriangles * 3)
+			return false;
+
+		bool wasEmissive = material.emission > 0.0;
+		bool hadTexture = material.hasTexture;
+		readMaterial(file, node);
+
+		if(wasEmissive != (material.emission > 0.0))
+			updateMask(rtcScene);
+
+		if(entry->geometryHash != geometryHash) {
+			setFrameGeometry(file, node);
+			setBuffers(rtcScene);
+			rtcUpdate(rtcScene, id);
+		} else if(wasEmissive != (material.emission > 0.0) || hadTexture != material.hasTexture) {
+			updateGeometryData();
+		}
+		return true;
+	}
+
+	void setFrameGeometry(SGFDFile *file, int node) {
+		SGFDNodeLayout layout = getSGFDNodeLayout(numberOfVertices, numberOfTriangles * 3);
+		file->retain();
+		if(frameFile)
+			frameFile->release();
+		frameFile = file;
+		geometryHash = file->getNode(node)->geometryHash;
+
+		vertices = (Vertex*) file->getNodeData(node, layout.positions);
+		indices = (unsigned int*) file->getNodeData(node, layout.indices);
+		normals = (float*) file->getNodeData(node, layout.normals);
+		uvs = (float*) file->getNodeData(node, layout.uvs);
+		updateGeometryData();
+	}
+
+	void readMaterial(ifstream &data) {
 		material.emission = readFloat(data);
 		if (material.emission > 0) {
 			material.lightType = readInt(data);
@@ -41,10 +180,12 @@ public:
 
 		material.hasTexture = readBool(data);
 
-		const char *texFile = readString(data);
-		if(material.hasTexture) {
-			texture = new SGRTTexture(texFile);
-		}
+		char *texFile = readString(data);
+		if(material.hasTexture)
+			texture = getCachedTexture(texFile);
+		else
+			texture = NULL;
+		delete[] texFile;
 
 		material.reflection = readFloat(data);
 		material.refraction = readFloat(data);
@@ -53,25 +194,44 @@ public:
 		material.isSmoothTexture = readBool(data);
 
 		material.reflectionSharpness = 1.0;
+	}
 
-		numberOfTriangles = readInt(data);
+	void readMaterial(SGFDFile *file, int node) {
+		const SGFDNodeEntry *entry = file->getNode(node);
+		const SGFDMaterial *m = (const SGFDMaterial*) file->getNodeData(node, 0);
 
-		id = rtcNewTriangleMesh(rtcScene, RTC_GEOMETRY_STATIC, numberOfTriangles, numberOfTriangles * 3);
-		rtcSetIntersectionFilterFunction(rtcScene, id, (RTCFilterFunc)&intersectFilterFunction);
-		rtcSetOcclusionFilterFunction(rtcScene, id, (RTCFilterFunc)&occludeFilterFunction);
-		rtcSetUserData(rtcScene, id, this);
-		uvs = (Vec3fa*) malloc(numberOfTriangles*3*sizeof(Vec3fa));
-		normals = (Vec3fa*) malloc(numberOfTriangles*3*sizeof(Vec3fa));
+		material.emission = m->emission;
+		if (material.emission > 0) {
+			material.lightType = m->lightType;
+		}
 
-		if(material.emission > 0.0)
-			rtcSetMask(rtcScene, id, 0x0000FFFF);
-		else
-			rtcSetMask(rtcScene, id, 0xFFFF0000);
+		material.emissionColor = Vec3fa(m->emissionColor[0], m->emissionColor[1], m->emissionColor[2]);
+		material.shadowDarkness = m->shadowDarkness;
+		material.diffuse = Vec3fa(m->diffuse[0], m->diffuse[1], m->diffuse[2]).normalize();
 
-		Vertex* vs = (Vertex*) rtcMapBuffer(rtcScene, id, RTC_VERTEX_BUFFER); 
-		if(!vs) {
-			printf("Error: Vertex Array Initializing failed %d\n", numberOfTriangles);
+		if (material.emission == 0) {
+			material.emissionColor = Vec3fa();
+		} else {
+			material.lightDirection = Vec3fa(m->lightDirection[0], m->lightDirection[1], m->lightDirection[2]).normalize();
+			material.lightDirection.x = -material.lightDirection.x;
 		}
+
+		material.hasTexture = entry->flags & SGFD_NODE_HAS_TEXTURE;
+		if(material.hasTexture)
+			texture = getCachedTexture(string(m->textureName, strnlen(m->textureName, SGFD_TEXTURE_NAME_LENGTH)));
+		else
+			texture = NULL;
+
+		material.reflection = m->reflection;
+		material.refraction = m->refraction;
+		material.transparency = m->transparency;
+		material.hasLighting = entry->flags & SGFD_NODE_HAS_LIGHTING;
+		material.isSmoothTexture = entry->flags & SGFD_NODE_SMOOTH_TEXTURE;
+
+		material.reflectionSharpness = 1.0;
+	}
+
+	void readGeometry(ifstream &data, Vertex* vs) {
 		for (unsigned int i = 0; i < numberOfTriangles; i++) {
 			for(int j = 0; j < 3; j++) {
 				Vec3fa v = readVec3fa(data);
@@ -79,36 +239,95 @@ public:
 				vs[(i*3)+j].x = v.x;
 				vs[(i*3)+j].y = v.y;
 				vs[(i*3)+j].z = v.z;
-				center = center + v;
-				updateBoundingBox(v);
 			}
 
 			for(int j = 0; j < 3; j++) {
 				Vec3fa n = readVec3fa(data);
 				n.x = -n.x;
-				normals [(i*3)+j].x = n.x;
-				normals [(i*3)+j].y = n.y;
-				normals [(i*3)+j].z = n.z;
+				normals[((i*3)+j)*3 + 0] = n.x;
+				normals[((i*3)+j)*3 + 1] = n.y;
+				normals[((i*3)+j)*3 + 2] = n.z;
 			}
 
 			for(int j = 0; j < 3; j++) {
-				uvs[(i*3)+j].x = readFloat(data);
-				uvs[(i*3)+j].y = readFloat(data);
-				uvs[(i*3)+j].z = 0.0f;
+				uvs[((i*3)+j)*2 + 0] = readFloat(data);
+				uvs[((i*3)+j)*2 + 1] = readFloat(data);
 			}
 		}
+	}
+
+	void updateGeometryData() {
+		center = Vec3fa(0.0f);
+		minPoint = Vec3fa(999.0f);
+		maxPoint = Vec3fa(-999.0f);
+
+		for (int i = 0; i < numberOfVertices; i++) {
+			Vec3fa v = getVertex(i);
+			center = center + v;
+			updateBoundingBox(v);
+		}
 
-		rtcUnmapBuffer(rtcScene, id, RTC_VERTEX_BUFFER);
+		if(numberOfVertices > 0)
+			center = center / (sgrtreal)numberOfVertices;
 
-		Triangle *triangles = (Triangle*) rtcMapBuffer(rtcScene, id, RTC_INDEX_BUFFER);
-		for (unsigned int i = 0; i < numberOfTriangles; i++) {
-			triangles[i].v0 = i*3 + 0;
-			triangles[i].v1 = i*3 + 1;
-			triangles[i].v2 = i*3 + 2;
+		if(material.hasTexture)
+			buildTexelScale();
+		else
+			texelScale.clear();
+
+		if(material.emission > 0.0)
+			buildSurfaceDistribution();
+		else
+			clearSurfaceDistribution();
+	}
+
+	void buildSurfaceDistribution() {
+		triangleAreaCdf.resize(numberOfTriangles);
+		surfaceArea = 0.0;
+
+		for (int i = 0; i < numberOfTriangles; i++) {
+			Vec3fa e1 = getTriangleVertex(i, 1) - getTriangleVertex(i, 0);
+			Vec3fa e2 = getTriangleVertex(i, 2) - getTriangleVertex(i, 0);
+			Vec3fa c = e1.cross(e2);
+			surfaceArea += sqrt(c.dot(c)) * 0.5;
+			triangleAreaCdf[i] = surfaceArea;
+		}
+	}
+
+	/// Ratio between UV and world space edge length per triangle, used to turn
+	/// a ray cone width into a texture footprint for mip selection.
+	void buildTexelScale() {
+		texelScale.resize(numberOfTriangles);
+		for (int i = 0; i < numberOfTriangles; i++) {
+			Vec3fa e1 = getTriangleVertex(i, 1) - getTriangleVertex(i, 0);
+			Vec3fa e2 = getTriangleVertex(i, 2) - getTriangleVertex(i, 0);
+			Vec3fa c = e1.cross(e2);
+			sgrtreal worldArea = sqrt(c.dot(c));
+
+			Vec3fa t1 = getUV(indices[(i*3)+1]) - getUV(indices[(i*3)]);
+			Vec3fa t2 = getUV(indices[(i*3)+2]) - getUV(indices[(i*3)]);
+			sgrtreal uvArea = fabs(t1.x * t2.y - t1.y * t2.x);
+
+			texelScale[i] = (worldArea > 0.0) ? sqrt(uvArea / worldArea) : 0.0;
 		}
-		rtcUnmapBuffer(rtcScene, id, RTC_INDEX_BUFFER);
+	}
 
-		center = center / (double)(numberOfTriangles * 3.0f);
+	sgrtreal getTextureFootprint(int index, sgrtreal coneWidth, sgrtreal cosine) {
+		if(index < 0 || index >= texelScale.size())
+			return 0.0;
+		return coneWidth * texelScale[index] / max(cosine, (sgrtreal)0.1);
+	}
+
+	void clearSurfaceDistribution() {
+		triangleAreaCdf.clear();
+		surfaceArea = 0.0;
+	}
+
+	void updateMask(RTCScene rtcScene) {
+		if(material.emission > 0.0)
+			rtcSetMask(rtcScene, id, 0x0000FFFF);
+		else
+			rtcSetMask(rtcScene, id, 0xFFFF0000);
 	}
 
 	void updateBoundingBox(Vec3fa v) {
@@ -127,25 +346,49 @@ public:
 			maxPoint.z = v.z;
 	}
 
-	Vec3fa getRandomPointInMesh() {
-		Vec3fa v;
-		v.x = center.x + (GetRandomValue()-0.5) * (maxPoint.x - minPoint.x)/2.0;
-		v.y = center.y + (GetRandomValue()-0.5) * (maxPoint.y - minPoint.y)/2.0;
-		v.z = center.z + (GetRandomValue()-0.5) * (maxPoint.z - minPoint.z)/2.0;
+	Vec3fa getRandomPointOnSurface(sgrtreal r1, sgrtreal r2, sgrtreal r3) {
+		Vec3fa normal;
+		return getRandomPointOnSurface(r1, r2, r3, normal);
+	}
+
+	/// Area uniform point on the mesh, normal is the geometric normal of the
+	/// picked triangle (zero when the mesh has no area and center is returned).
+	Vec3fa getRandomPointOnSurface(sgrtreal r1, sgrtreal r2, sgrtreal r3, Vec3fa &normal) {
+		normal = Vec3fa(0.0f);
+		if(triangleAreaCdf.empty() || surfaceArea <= 0.0)
+			return center;
 
-		return v;
+		int tri = upper_bound(triangleAreaCdf.begin(), triangleAreaCdf.end(), r1 * surfaceArea) - triangleAreaCdf.begin();
+		tri = min(tri, numberOfTriangles - 1);
+
+		Vec3fa c = (getTriangleVertex(tri, 1) - getTriangleVertex(tri, 0)).cross(getTriangleVertex(tri, 2) - getTriangleVertex(tri, 0));
+		if(c.dot(c) > 0.0)
+			normal = c.normalize();
+
+		sgrtreal su = sqrt(r2);
+		sgrtreal b0 = 1.0 - su;
+		sgrtreal b1 = r3 * su;
+		return getTriangleVertex(tri, 0) * b0 + getTriangleVertex(tri, 1) * b1 + getTriangleVertex(tri, 2) * (1.0 - b0 - b1);
 	}
 
-	double getRadius() {
+	sgrtreal getRadius() {
 		return fabs(maxPoint.distance(minPoint)) / 2.0f;
 	}
 
+	Vec3fa getVertex(int index) {
+		return Vec3fa(vertices[index].x, vertices[index].y, vertices[index].z);
+	}
+
+	Vec3fa getTriangleVertex(int triangle, int corner) {
+		return getVertex(indices[(triangle*3)+corner]);
+	}
+
 	Vec3fa getUV(int index) {
 		Vec3fa uv;
 		uv.x = uv.y = uv.z = 0;
 
-		if(index >= 0 && index < numberOfTriangles * 3)
-			uv = uvs[index];
+		if(index >= 0 && index < numberOfVertices)
+			uv = Vec3fa(uvs[index*2], uvs[index*2+1], 0.0f);
 
 		return uv;
 	}
@@ -154,20 +397,32 @@ public:
 		Vec3fa n;
 		n.x = n.y = n.z = 0.0;
 
-		if(index >= 0 && index < numberOfTriangles * 3)
-			n = normals[index];
+		if(index >= 0 && index < numberOfVertices)
+			n = Vec3fa(normals[index*3], normals[index*3+1], normals[index*3+2]);
 
 		return n;
 	}
 
+	Vec3fa getTriangleUV(int triangle, int corner) {
+		if(triangle < 0 || triangle >= numberOfTriangles)
+			return Vec3fa(0.0f);
+		return getUV(indices[(triangle*3)+corner]);
+	}
+
+	Vec3fa getTriangleNormal(int triangle, int corner) {
+		if(triangle < 0 || triangle >= numberOfTriangles)
+			return Vec3fa(0.0f);
+		return getNormal(indices[(triangle*3)+corner]);
+	}
+
 	Vec3fa getEmissionColor() {
 		return material.emissionColor;
 	}
 
-	Vec3fa getColor(double u, double v) {
+	Vec3fa getColor(sgrtreal u, sgrtreal v, sgrtreal footprint = 0.0) {
 		Vec3fa color = Vec3fa(0.0f);
 		if(material.hasTexture)
-			color = texture->getColorAt(u, v, material.isSmoothTexture);
+			color = texture->getColorAt(u, v, footprint, material.isSmoothTexture);
 		else if(material.emission > 0.0)
 			color = material.emissionColor;
 		else
@@ -176,40 +431,47 @@ public:
 		return color;
 	}
 
-	double getAlpha(double u, double v) {
-		double a = 0.0;
+	sgrtreal getAlpha(sgrtreal u, sgrtreal v) {
+		sgrtreal a = 0.0;
 		if(material.hasTexture)
-			a = texture->getAlphaAt(u, v);
+			a = texture->getAlphaAt(u, v, material.isSmoothTexture);
 		else
 			a = 1.0;
 
 		return a;
 	}
 
-	Vec3fa getInterpolatedUV(int index, double u, double v) {
-		Vec3fa uva = getUV(index * 3 + 0);
-		Vec3fa uvb = getUV(index * 3 + 1);
-		Vec3fa uvc = getUV(index * 3 + 2);
+	Vec3fa getInterpolatedUV(int index, sgrtreal u, sgrtreal v) {
+		Vec3fa uva = getTriangleUV(index, 0);
+		Vec3fa uvb = getTriangleUV(index, 1);
+		Vec3fa uvc = getTriangleUV(index, 2);
 
 		Vec3fa uv = uva + (uvb - uva) * u + (uvc - uva) * v;
 		return uv;
 	}
 
-	Vec3fa getInterpolatedNormal(int index, double u, double v) {
-		Vec3fa na = getNormal(index * 3 + 0);
-		Vec3fa nb = getNormal(index * 3 + 1);
-		Vec3fa nc = getNormal(index * 3 + 2);
+	Vec3fa getInterpolatedNormal(int index, sgrtreal u, sgrtreal v) {
+		Vec3fa na = getTriangleNormal(index, 0);
+		Vec3fa nb = getTriangleNormal(index, 1);
+		Vec3fa nc = getTriangleNormal(index, 2);
 
 		return (na + (nb - na) * u + (nc - na) * v);
 	}
 
 	~SGRTMesh() {
-		if(uvs)
-			free(uvs);
-		if(normals)
-			free(normals);
-		if(material.hasTexture)
-			delete texture;
+		if(frameFile) {
+			frameFile->release();
+		} else {
+			if(vertices)
+				free(vertices);
+			if(indices)
+				free(indices);
+			if(uvs)
+				free(uvs);
+			if(normals)
+				free(normals);
+		}
+		clearSurfaceDistribution();
 	}
 };
 
@@ -0,0 +1,487 @@
+#ifndef ASSETCACHE_H_
+#define ASSETCACHE_H_
+
+#include "common.h"
+#include <map>
+#include <sys/file.h>
+
+#define ASSET_CACHE_PARALLEL_DOWNLOADS 8
+#define ASSET_CACHE_HOST_CONNECTIONS 4
+
+string assetCacheDir = "";
+size_t assetCacheBudget = (size_t)2048 * 1024 * 1024;
+
+struct SGRTAssetRequest
+{
+	string url;
+	string filePath;
+	bool succeeded;
+
+	SGRTAssetRequest(string url_, string filePath_) {
+		url = url_;
+		filePath = filePath_;
+		succeeded = false;
+	}
+};
+
+/// etag and lastModified are the validators the server sent with the
+/// object, empty for entries that did not come from a url.
+struct SGRTCachedAsset
+{
+	uint64_t hash;
+	size_t size;
+	long lastUsed;
+	string etag;
+	string lastModified;
+};
+
+/// Downloaded files are stored once under objects/<content hash> and the
+/// index maps every url to the hash it returned, so the same texture or
+/// model served under different names is kept only once. Cached urls are
+/// revalidated with a conditional request on every fetch and only the
+/// body of changed files is transferred again. Files reach the cache and
+/// the task directories through a temporary name and rename(), readers
+/// never see a partial file. Several renderer processes on a node can
+/// share one cache, index updates are serialized with flock.
+struct SGRTAssetCache
+{
+	string root;
+	size_t budget;
+	CURLM *multi;
+	vector<CURL*> idleHandles;
+	map<string, SGRTCachedAsset> entries;
+	int tempCounter;
+
+	struct Transfer
+	{
+		CURL *curl;
+		FILE *file;
+		struct curl_slist *headers;
+		string tempPath;
+		uint64_t hash;
+		size_t size;
+		int request;
+		string etag;
+		string lastModified;
+	};
+
+	SGRTAssetCache(string root_, size_t budget_) {
+		root = root_;
+		budget = budget_;
+		tempCounter = 0;
+		mkdir(root.c_str(), 0755);
+		mkdir((root + "/objects").c_str(), 0755);
+		mkdir((root + "/tmp").c_str(), 0755);
+
+		multi = curl_multi_init();
+		curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)ASSET_CACHE_HOST_CONNECTIONS);
+		curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+		int lock = lockIndex();
+		loadIndex(entries);
+		unlockIndex(lock);
+	}
+
+	~SGRTAssetCache() {
+		for (int i = 0; i < idleHandles.size(); i++)
+			curl_easy_cleanup(idleHandles[i]);
+		curl_multi_cleanup(multi);
+	}
+
+	static uint64_t hashContent(const void *data, size_t size, uint64_t hash) {
+		const unsigned char *bytes = (const unsigned char*)data;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	string getObjectPath(uint64_t hash) {
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+		return root + "/objects/" + name;
+	}
+
+	string getTempPath() {
+		return root + "/tmp/" + to_string(getpid()) + "_" + to_string(tempCounter++);
+	}
+
+	int lockIndex() {
+		int fd = open((root + "/index.lock").c_str(), O_RDWR | O_CREAT, 0644);
+		if(fd >= 0)
+			flock(fd, LOCK_EX);
+		return fd;
+	}
+
+	void unlockIndex(int fd) {
+		if(fd < 0)
+			return;
+		flock(fd, LOCK_UN);
+		close(fd);
+	}
+
+	/// One line per url: hash, size, last use and the url itself, followed
+	/// by the tab separated etag and last modified date when known.
+	void loadIndex(map<string, SGRTCachedAsset> &index) {
+		ifstream file((root + "/index").c_str());
+		string line;
+		while(getline(file, line)) {
+			unsigned long long hash;
+			unsigned long long size;
+			long lastUsed;
+			int urlStart = 0;
+			if(sscanf(line.c_str(), "%llx %llu %ld %n", &hash, &size, &lastUsed, &urlStart) < 3 || urlStart <= 0)
+				continue;
+			SGRTCachedAsset asset = { hash, (size_t)size, lastUsed };
+			string url = line.substr(urlStart);
+			size_t tab = url.find('\t');
+			if(tab != string::npos) {
+				string validators = url.substr(tab + 1);
+				url = url.substr(0, tab);
+				tab = validators.find('\t');
+				asset.etag = validators.substr(0, tab);
+				if(tab != string::npos)
+					asset.lastModified = validators.substr(tab + 1);
+			}
+			index[url] = asset;
+		}
+	}
+
+	/// Merges this process's view into the index on disk, evicts the least
+	/// recently used objects above budget and writes the result atomically.
+	void saveIndex() {
+		int lock = lockIndex();
+		map<string, SGRTCachedAsset> index;
+		loadIndex(index);
+		for (map<string, SGRTCachedAsset>::iterator it = entries.begin(); it != entries.end(); it++) {
+			map<string, SGRTCachedAsset>::iterator current = index.find(it->first);
+			if(current == index.end() || current->second.lastUsed <= it->second.lastUsed)
+				index[it->first] = it->second;
+		}
+		evict(index);
+
+		string tempPath = getTempPath();
+		FILE *file = fopen(tempPath.c_str(), "w");
+		if(file) {
+			for (map<string, SGRTCachedAsset>::iterator it = index.begin(); it != index.end(); it++) {
+				fprintf(file, "%016llx %llu %ld %s", (unsigned long long)it->second.hash, (unsigned long long)it->second.size, it->second.lastUsed, it->first.c_str());
+				if(!it->second.etag.empty() || !it->second.lastModified.empty())
+					fprintf(file, "\t%s\t%s", it->second.etag.c_str(), it->second.lastModified.c_str());
+				fprintf(file, "\n");
+			}
+			fclose(file);
+			rename(tempPath.c_str(), (root + "/index").c_str());
+		}
+		entries = index;
+		unlockIndex(lock);
+	}
+
+	static bool sortByLastUse(const pair<long, uint64_t> &lhs, const pair<long, uint64_t> &rhs) {
+		return lhs.first < rhs.first;
+	}
+
+	/// Objects are shared between urls, so an object is only as old as its
+	/// most recent use and is deleted together with all urls pointing to it.
+	void evict(map<string, SGRTCachedAsset> &index) {
+		map<uint64_t, pair<long, size_t> > objects;
+		size_t totalSize = 0;
+		for (map<string, SGRTCachedAsset>::iterator it = index.begin(); it != index.end(); it++) {
+			map<uint64_t, pair<long, size_t> >::iterator object = objects.find(it->second.hash);
+			if(object == objects.end()) {
+				objects[it->second.hash] = make_pair(it->second.lastUsed, it->second.size);
+				totalSize += it->second.size;
+			} else
+				object->second.first = max(object->second.first, it->second.lastUsed);
+		}
+		if(totalSize <= budget)
+			return;
+
+		vector<pair<long, uint64_t> > byAge;
+		for (map<uint64_t, pair<long, size_t> >::iterator it = objects.begin(); it != objects.end(); it++)
+			byAge.push_back(make_pair(it->second.first, it->first));
+		sort(byAge.begin(), byAge.end(), sortByLastUse);
+
+		for (int i = 0; i < byAge.size() && totalSize > budget; i++) {
+			uint64_t hash = byAge[i].second;
+			totalSize -= objects[hash].second;
+			// Task directories hold hard links, so files in use stay valid
+			remove(getObjectPath(hash).c_str());
+			for (map<string, SGRTCachedAsset>::iterator it = index.begin(); it != index.end(); ) {
+				if(it->second.hash == hash)
+					index.erase(it++);
+				else
+					++it;
+			}
+		}
+	}
+
+	/// Hard links the object to filePath, copying when the task directory
+	/// is on another file system.
+	static bool placeFile(string objectPath, string filePath) {
+		string tempPath = filePath + ".part";
+		remove(tempPath.c_str());
+		if(link(objectPath.c_str(), tempPath.c_str()) != 0 && !file_copy(objectPath, tempPath))
+			return false;
+		return rename(tempPath.c_str(), filePath.c_str()) == 0;
+	}
+
+	static bool filesEqual(string lhsPath, string rhsPath) {
+		FILE *lhs = fopen(lhsPath.c_str(), "rb");
+		FILE *rhs = fopen(rhsPath.c_str(), "rb");
+		bool equal = lhs && rhs;
+		char lhsBuffer[65536], rhsBuffer[65536];
+		while(equal) {
+			size_t lhsRead = fread(lhsBuffer, 1, sizeof(lhsBuffer), lhs);
+			size_t rhsRead = fread(rhsBuffer, 1, sizeof(rhsBuffer), rhs);
+			equal = lhsRead == rhsRead && memcmp(lhsBuffer, rhsBuffer, lhsRead) == 0;
+			if(lhsRead == 0)
+				break;
+		}
+		if(lhs)
+			fclose(lhs);
+		if(rhs)
+			fclose(rhs);
+		return equal;
+	}
+
+	/// The cached entry for key when its object is still intact, NULL
+	/// otherwise. Broken entries are dropped.
+	SGRTCachedAsset* getCachedAsset(string key) {
+		map<string, SGRTCachedAsset>::iterator it = entries.find(key);
+		if(it == entries.end())
+			return NULL;
+
+		struct stat buffer;
+		if(stat(getObjectPath(it->second.hash).c_str(), &buffer) != 0 || (size_t)buffer.st_size != it->second.size) {
+			entries.erase(it);
+			return NULL;
+		}
+		return &it->second;
+	}
+
+	/// Places the entry stored under request.url as it is, callers check
+	/// first that it is still current.
+	bool placeCachedFile(SGRTAssetRequest &request) {
+		SGRTCachedAsset *asset = getCachedAsset(request.url);
+		if(!asset)
+			return false;
+		asset->lastUsed = time(NULL);
+		return placeFile(getObjectPath(asset->hash), request.filePath);
+	}
+
+	/// Adds a file that is already in place under key, for files that do
+	/// not come from a url such as entries of task archives.
+	void store(string key, string filePath, uint64_t hash, size_t size) {
+		string objectPath = getObjectPath(hash);
+		if(!file_exists(objectPath)) {
+			string tempPath = getTempPath();
+			if(link(filePath.c_str(), tempPath.c_str()) != 0 && !file_copy(filePath, tempPath))
+				return;
+			rename(tempPath.c_str(), objectPath.c_str());
+		} else if(!filesEqual(objectPath, filePath)) {
+			printf("Warning: %s collides with cached object %016llx, not caching it\n", filePath.c_str(), (unsigned long long)hash);
+			return;
+		}
+		SGRTCachedAsset asset = { hash, size, time(NULL) };
+		entries[key] = asset;
+	}
+
+	static size_t writeTransfer(void *ptr, size_t size, size_t nmemb, void *data) {
+		Transfer *transfer = (Transfer*)data;
+		size_t written = fwrite(ptr, size, nmemb, transfer->file);
+		transfer->hash = hashContent(ptr, written * size, transfer->hash);
+		transfer->size += written * size;
+		return written * size;
+	}
+
+	/// Keeps the validators of the final response, earlier responses of a
+	/// redirect chain are discarded.
+	static size_t readTransferHeader(char *buffer, size_t size, size_t nitems, void *data) {
+		Transfer *transfer = (Transfer*)data;
+		string header(buffer, size * nitems);
+		while(!header.empty() && (header[header.size() - 1] == '\n' || header[header.size() - 1] == '\r'))
+			header.erase(header.size() - 1);
+
+		size_t colon = header.find(':');
+		string name = header.substr(0, colon);
+		transform(name.begin(), name.end(), name.begin(), ::tolower);
+		if(name.compare(0, 5, "http/") == 0) {
+			transfer->etag = "";
+			transfer->lastModified = "";
+		} else if(colon != string::npos) {
+			size_t start = header.find_first_not_of(' ', colon + 1);
+			string value = (start == string::npos) ? "" : header.substr(start);
+			if(name == "etag")
+				transfer->etag = value;
+			else if(name == "last-modified")
+				transfer->lastModified = value;
+		}
+		return size * nitems;
+	}
+
+	CURL* getHandle() {
+		if(idleHandles.empty())
+			return curl_easy_init();
+		CURL *curl = idleHandles.back();
+		idleHandles.pop_back();
+		curl_easy_reset(curl);
+		return curl;
+	}
+
+	bool startTransfer(Transfer &transfer, const SGRTAssetRequest &request, int index) {
+		transfer.tempPath = getTempPath();
+		transfer.file = fopen(transfer.tempPath.c_str(), "wb");
+		if(!transfer.file)
+			return false;
+		transfer.hash = 14695981039346656037ull;
+		transfer.size = 0;
+		transfer.request = index;
+		transfer.etag = "";
+		transfer.lastModified = "";
+		transfer.headers = NULL;
+		transfer.curl = getHandle();
+
+		SGRTCachedAsset *cached = getCachedAsset(request.url);
+		if(cached && !cached->etag.empty())
+			transfer.headers = curl_slist_append(transfer.headers, ("If-None-Match: " + cached->etag).c_str());
+		if(cached && !cached->lastModified.empty())
+			transfer.headers = curl_slist_append(transfer.headers, ("If-Modified-Since: " + cached->lastModified).c_str());
+		if(transfer.headers)
+			curl_easy_setopt(transfer.curl, CURLOPT_HTTPHEADER, transfer.headers);
+
+		curl_easy_setopt(transfer.curl, CURLOPT_URL, request.url.c_str());
+		curl_easy_setopt(transfer.curl, CURLOPT_FOLLOWLOCATION, 1L);
+		curl_easy_setopt(transfer.curl, CURLOPT_FAILONERROR, 1L);
+		curl_easy_setopt(transfer.curl, CURLOPT_WRITEFUNCTION, writeTransfer);
+		curl_easy_setopt(transfer.curl, CURLOPT_WRITEDATA, &transfer);
+		curl_easy_setopt(transfer.curl, CURLOPT_HEADERFUNCTION, readTransferHeader);
+		curl_easy_setopt(transfer.curl, CURLOPT_HEADERDATA, &transfer);
+		curl_easy_setopt(transfer.curl, CURLOPT_PRIVATE, &transfer);
+		curl_multi_add_handle(multi, transfer.curl);
+		return true;
+	}
+
+	void finishTransfer(Transfer &transfer, CURLcode result, vector<SGRTAssetRequest> &requests) {
+		long responseCode = 0;
+		curl_easy_getinfo(transfer.curl, CURLINFO_RESPONSE_CODE, &responseCode);
+		curl_multi_remove_handle(multi, transfer.curl);
+		idleHandles.push_back(transfer.curl);
+		curl_slist_free_all(transfer.headers);
+		fclose(transfer.file);
+
+		SGRTAssetRequest &request = requests[transfer.request];
+		if(result != CURLE_OK) {
+			printf("Failed to fetch %s: %s\n", request.url.c_str(), curl_easy_strerror(result));
+			remove(transfer.tempPath.c_str());
+			return;
+		}
+
+		if(responseCode == 304) {
+			remove(transfer.tempPath.c_str());
+			request.succeeded = placeCachedFile(request);
+			return;
+		}
+
+		// Another body may already be stored under the same hash, it is
+		// only shared when the bytes really match
+		string objectPath = getObjectPath(transfer.hash);
+		if(!file_exists(objectPath))
+			rename(transfer.tempPath.c_str(), objectPath.c_str());
+		else if(filesEqual(objectPath, transfer.tempPath))
+			remove(transfer.tempPath.c_str());
+		else {
+			printf("Warning: %s collides with cached object %016llx, not caching it\n", request.url.c_str(), (unsigned long long)transfer.hash);
+			entries.erase(request.url);
+			request.succeeded = placeFile(transfer.tempPath, request.filePath);
+			remove(transfer.tempPath.c_str());
+			return;
+		}
+
+		SGRTCachedAsset asset = { transfer.hash, transfer.size, time(NULL), transfer.etag, transfer.lastModified };
+		entries[request.url] = asset;
+		request.succeeded = placeFile(objectPath, request.filePath);
+	}
+
+	/// Places every requested url at its filePath with up to
+	/// ASSET_CACHE_PARALLEL_DOWNLOADS transfers at once over pooled
+	/// connections. Cached urls are requested conditionally and placed from
+	/// the cache when the server answers 304. Check succeeded on each
+	/// request, returns true when all of them did.
+	bool fetch(vector<SGRTAssetRequest> &requests) {
+		vector<int> pending;
+		for (int i = 0; i < requests.size(); i++) {
+			requests[i].succeeded = false;
+			pending.push_back(i);
+		}
+
+		vector<Transfer> transfers(min((int)pending.size(), ASSET_CACHE_PARALLEL_DOWNLOADS));
+		vector<Transfer*> freeTransfers;
+		for (int i = 0; i < transfers.size(); i++)
+			freeTransfers.push_back(&transfers[i]);
+
+		int next = 0, running = 0;
+		while(next < pending.size() || running > 0) {
+			while(next < pending.size() && !freeTransfers.empty()) {
+				SGRTAssetRequest &request = requests[pending[next]];
+				printf("Fetching Url: %s\n", request.url.c_str());
+				if(startTransfer(*freeTransfers.back(), request, pending[next])) {
+					freeTransfers.pop_back();
+					running++;
+				}
+				next++;
+			}
+
+			int active = 0;
+			curl_multi_perform(multi, &active);
+			CURLMsg *msg;
+			int queued;
+			while((msg = curl_multi_info_read(multi, &queued))) {
+				if(msg->msg != CURLMSG_DONE)
+					continue;
+				Transfer *transfer = NULL;
+				curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&transfer);
+				finishTransfer(*transfer, msg->data.result, requests);
+				freeTransfers.push_back(transfer);
+				running--;
+			}
+			if(running > 0)
+				curl_multi_wait(multi, NULL, 0, 100, NULL);
+		}
+		saveIndex();
+
+		bool status = true;
+		for (int i = 0; i < requests.size(); i++)
+			status = status && requests[i].succeeded;
+		return status;
+	}
+
+	bool fetch(string url, string filePath) {
+		vector<SGRTAssetRequest> requests(1, SGRTAssetRequest(url, filePath));
+		return fetch(requests);
+	}
+};
+
+SGRTAssetCache *assetCache = NULL;
+
+SGRTAssetCache& getAssetCache() {
+	if(!assetCache) {
+		initNetwork();
+		if(assetCacheDir.empty()) {
+			char cCurrentPath[FILENAME_MAX];
+			getcwd(cCurrentPath, sizeof(cCurrentPath));
+			cCurrentPath[sizeof(cCurrentPath) - 1] = '\0';
+			mkdir((string(cCurrentPath) + "/data").c_str(), 0755);
+			assetCacheDir = string(cCurrentPath) + "/data/cache";
+		}
+		assetCache = new SGRTAssetCache(assetCacheDir, assetCacheBudget);
+	}
+	return *assetCache;
+}
+
+void releaseAssetCache() {
+	delete assetCache;
+	assetCache = NULL;
+}
+
+#endif
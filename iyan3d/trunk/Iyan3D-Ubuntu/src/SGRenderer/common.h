@@ -30,14 +30,23 @@
 using namespace std;
 
 int TILE_SIZE = 64;
+int MIN_TILE_SIZE = 8;
 
 bool isRenderMachine = false;
+bool persistentRenderer = false;
 int taskFetchFrequency = 2;
 
 int MAX_RAY_DEPTH = 6;
 int samplesAO = 0;
 double minAOBrightness = 0.5f;
 int randomSamples = 0;
+int rayPacketSize = 0;
+int aoFilterType = 1;
+int aoFilterRadius = 3;
+bool pinRenderThreads = false;
+double adaptiveTargetError = 0.0;
+double renderTimeBudget = 0.0;
+int adaptiveMaxSamples = 256;
 
 long debug_ray_intersections = 0;
 long debug_ray_occlusions = 0;
@@ -49,6 +58,12 @@ enum ImageFormat {
     ImageFormat_PNG
 };
 
+enum AOFilterType {
+    AO_FILTER_NONE = 0,
+    AO_FILTER_GAUSSIAN,
+    AO_FILTER_EDGE_AWARE
+};
+
 #define ALIGN(...) __attribute__((aligned(__VA_ARGS__)))
 
 ALIGN(16) struct Vertex   { float x, y, z, a; };
@@ -63,6 +78,10 @@ struct TaskDetails {
     int frame;
     int startFrame;
     int endFrame;
+    int aoFilterType;
+    int aoFilterRadius;
+    double targetError;
+    double timeBudget;
     bool isRenderTask;
 };
 
@@ -143,10 +162,23 @@ int num_cores() {
     return sysconf(_SC_NPROCESSORS_ONLN);
 }
 
-double GetRandomValue() {
-    return (double)rand() / RAND_MAX;
+ThreadPool *renderThreadPool = NULL;
+
+/// One pool for the whole process, shared by tile rendering, the post
+/// filters and scene loading so threads are created once per session.
+ThreadPool& getThreadPool() {
+	if(!renderThreadPool)
+		renderThreadPool = new ThreadPool(num_cores(), pinRenderThreads);
+	return *renderThreadPool;
+}
+
+void releaseThreadPool() {
+	delete renderThreadPool;
+	renderThreadPool = NULL;
 }
 
+#include "sampler.h"
+
 RTCRay getIntersection(RTCScene scene, Vec3fa o, Vec3fa d, double depth = 5000.0f, int mask = 0xFFFFFFFF) {
 	debug_ray_intersections++;
     RTCRay ray;
@@ -195,6 +227,8 @@ Vec3fa getHitPoint(RTCRay ray) {
     return Vec3fa(ray.org[0], ray.org[1], ray.org[2]) + Vec3fa(ray.dir[0], ray.dir[1], ray.dir[2]) * ray.tfar;
 }
 
+#include "raypacket.h"
+
 #define MPI 3.14159265
 #define M2PI 6.28318531
 
@@ -242,9 +276,19 @@ Vec3fa sampleAroundNormal(Vec3fa n) {
 	return cosineSampleAroundNormal(GetRandomValue(), GetRandomValue(), n);
 }
 
-Vec3fa randomizeDirection(Vec3fa dir, double magnitude) {
+Vec3fa sampleAroundNormal(Vec3fa n, int dimension, uint32_t index) {
+	double r1, r2;
+	getSample2D(dimension, index, r1, r2);
+	return cosineSampleAroundNormal(r1, r2, n);
+}
+
+Vec3fa sampleAroundNormal(Vec3fa n, int dimension) {
+	return sampleAroundNormal(n, dimension, threadSampler.sampleIndex);
+}
+
+Vec3fa randomizeDirection(Vec3fa dir, double magnitude, double r1, double r2) {
 	SGRTMat4 camMatrix;
-    Vec3fa angle = Vec3fa(GetRandomValue() - 0.5, GetRandomValue() - 0.5, 0.0f) * magnitude * 60.0;
+    Vec3fa angle = Vec3fa(r1 - 0.5, r2 - 0.5, 0.0f) * magnitude * 60.0;
     camMatrix.setRotationRadians(angle * M_PI / 180.0f);
 
     Vec3fa d = dir;
@@ -252,6 +296,16 @@ Vec3fa randomizeDirection(Vec3fa dir, double magnitude) {
     return d;
 }
 
+Vec3fa randomizeDirection(Vec3fa dir, double magnitude) {
+	return randomizeDirection(dir, magnitude, GetRandomValue(), GetRandomValue());
+}
+
+Vec3fa randomizeDirection(Vec3fa dir, double magnitude, int dimension) {
+	double r1, r2;
+	getSample2D(dimension, r1, r2);
+	return randomizeDirection(dir, magnitude, r1, r2);
+}
+
 bool file_exists (const std::string& name) {
 	struct stat buffer;
 	return (stat (name.c_str(), &buffer) == 0);
@@ -281,121 +335,17 @@ string convert2String(int i) {
 	return r;
 }
 
-void gaussionBlur (double *sourceData, double *destData, int width, int height, int radius) {
-    double rs = ceil(radius * 2.57);
-    for(int i = 0; i < height; i++) {
-        for(int j = 0; j < width; j++) {
-            double val = 0, wsum = 0;
-            for(int iy = i - rs; iy < i + rs + 1; iy++) {
-                for(int ix = j - rs; ix < j + rs + 1; ix++) {
-                    int x = min(width - 1, max(0, ix));
-                    int y = min(height - 1, max(0, iy));
-                    int dsq = (ix - j) * (ix - j) + (iy - i) * (iy - i);
-                    double wght = exp( -dsq / (2 * radius * radius) ) / (M_PI * 2 * radius * radius);
-                    val += sourceData[y*width+x] * wght;
-                    wsum += wght;
-                }
-            }
-            destData[i*width+j] = val/wsum;
-        }
-    }
-}
-
-vector<int> boxesForGauss(double sigma, int n) {
-    double wIdeal = sqrt(( 12 * sigma * sigma / n) + 1);  // Ideal averaging filter width
-    int wl = floor(wIdeal);
-    if(wl % 2 == 0)
-    	wl--;
-
-    int wu = wl + 2;
-
-    double mIdeal = (12 * sigma * sigma - n * wl * wl - 4 * n * wl - 3 * n) / (-4 * wl - 4);
-    int m = round(mIdeal);
-
-    vector<int> sizes;
-    for(int i = 0; i < n; i++)
-    	sizes.push_back(i < m ? wl : wu);
-    return sizes;
-}
-
-void boxBlurH_4 (double *sourceData, double *destData, int width, int height, int radius) {
-    double iarr = 1.0 / (radius + radius + 1);
-    for(int i=0; i<height; i++) {
-        int ti = i * width, li = ti, ri = ti+radius;
-        double fv = sourceData[ti], lv = sourceData[ti+width-1], val = (radius+1)*fv;
-        for(int j=0; j<radius; j++)
-        	val += sourceData[ti+j];
-
-        for(int j=0; j<=radius; j++) {
-        	val += sourceData[ri++] - fv;
-        	destData[ti++] = round(val*iarr);
-        }
-
-        for(int j=radius+1; j<width-radius; j++) {
-        	val += sourceData[ri++] - sourceData[li++];
-        	destData[ti++] = round(val*iarr);
-        }
-
-        for(int j=width-radius; j<width  ; j++) {
-        	val += lv - sourceData[li++];
-        	destData[ti++] = round(val*iarr);
-        }
-    }
-}
-
-void boxBlurT_4 (double *sourceData, double *destData, int width, int height, int radius) {
-    double iarr = 1.0 / (radius + radius + 1);
-    for(int i = 0; i < width; i++) {
-        int ti = i, li = ti, ri = ti + radius * width;
-        double fv = sourceData[ti], lv = sourceData[ti+width*(height-1)], val = (radius+1)*fv;
-
-        for(int j=0; j<radius; j++)
-        	val += sourceData[ti+j*width];
-
-        for(int j=0; j<=radius; j++) {
-        	val += sourceData[ri] - fv;
-        	destData[ti] = round(val*iarr);
-        	ri+=width; ti+=width;
-        }
-
-        for(int j=radius+1; j<height-radius; j++) {
-        	val += sourceData[ri] - sourceData[li];
-        	destData[ti] = round(val*iarr);
-        	li += width;
-        	ri += width;
-        	ti += width;
-        }
-
-        for(int j=height-radius; j<height; j++) {
-        	val += lv - sourceData[li];
-        	destData[ti] = round(val*iarr);
-        	li+=width;
-        	ti+=width;
-        }
-    }
-}
-
-void boxBlur_4 (double *sourceData, double *destData, int width, int height, int radius) {
-    for(int i = 0; i < width*height; i++)
-    	destData[i] = sourceData[i];
-
-    boxBlurH_4(destData, sourceData, width, height, radius);
-    boxBlurT_4(sourceData, destData, width, height, radius);
-}
-
-void gaussionBlur_fast(double *sourceData, double *destData, int width, int height, int radius) {
-	vector<int> bxs = boxesForGauss(radius, 3);
-    boxBlur_4 (sourceData, destData, width, height, (bxs[0]-1)/2);
-    boxBlur_4 (destData, sourceData, width, height, (bxs[1]-1)/2);
-    boxBlur_4 (sourceData, destData, width, height, (bxs[2]-1)/2);
-}
+#include "postfilter.h"
 
 #include "texture.h"
 #include "camera.h"
 #include "material.h"
+#include "sgfd.h"
 
 void intersectFilterFunction(void* userPtr, RTCRay& ray);
 void occludeFilterFunction(void* userPtr, RTCRay& ray);
+template<typename RTCRayN, int N> void intersectFilterFunctionN(const void* valid, void* userPtr, RTCRayN& ray);
+template<typename RTCRayN, int N> void occludeFilterFunctionN(const void* valid, void* userPtr, RTCRayN& ray);
 
 #include "Mesh.h"
 
@@ -415,8 +365,39 @@ void occludeFilterFunction(void* userPtr, RTCRay& ray) {
 		ray.geomID = RTC_INVALID_GEOMETRY_ID;
 }
 
+template<typename RTCRayN, int N>
+void intersectFilterFunctionN(const void* valid, void* userPtr, RTCRayN& ray) {
+	const int* validLanes = (const int*)valid;
+	SGRTMesh *mesh = (SGRTMesh*)userPtr;
+	for (int i = 0; i < N; i++) {
+		if(validLanes[i] != -1)
+			continue;
+		Vec3fa uv = mesh->getInterpolatedUV(ray.primID[i], ray.u[i], ray.v[i]);
+		double alpha = mesh->getAlpha(uv.x, uv.y);
+		if(alpha == 0.0)
+			ray.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+	}
+}
+
+template<typename RTCRayN, int N>
+void occludeFilterFunctionN(const void* valid, void* userPtr, RTCRayN& ray) {
+	const int* validLanes = (const int*)valid;
+	SGRTMesh *mesh = (SGRTMesh*)userPtr;
+	for (int i = 0; i < N; i++) {
+		if(validLanes[i] != -1)
+			continue;
+		Vec3fa uv = mesh->getInterpolatedUV(ray.primID[i], ray.u[i], ray.v[i]);
+		double alpha = mesh->getAlpha(uv.x, uv.y);
+		if(alpha < 1.0)
+			ray.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+	}
+}
+
+#include "lights.h"
 #include "scene.h"
 
 #include "videoencoder.h"
+#include "assetcache.h"
+#include "taskpackage.h"
 
 #endif
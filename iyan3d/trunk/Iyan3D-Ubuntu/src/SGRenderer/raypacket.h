@@ -0,0 +1,112 @@
+#ifndef RAYPACKET_H_
+#define RAYPACKET_H_
+
+#include "common.h"
+
+#define MAX_RAY_PACKET_SIZE 16
+
+RTCAlgorithmFlags getSceneAlgorithmFlags() {
+	int flags = RTC_INTERSECT1;
+	if(rayPacketSize == 8)
+		flags |= RTC_INTERSECT8;
+	else if(rayPacketSize == 16)
+		flags |= RTC_INTERSECT16;
+	return (RTCAlgorithmFlags)flags;
+}
+
+void validateRayPacketSize(RTCDevice device) {
+	if(rayPacketSize != 0 && rayPacketSize != 8 && rayPacketSize != 16) {
+		printf("Unsupported rayPacketSize %d, using single rays\n", rayPacketSize);
+		rayPacketSize = 0;
+	}
+
+	if(rayPacketSize == 16 && !rtcDeviceGetParameter1i(device, RTC_CONFIG_INTERSECT16)) {
+		printf("Embree has no 16 wide ray packet support, falling back to 8 wide packets\n");
+		rayPacketSize = 8;
+	}
+
+	if(rayPacketSize == 8 && !rtcDeviceGetParameter1i(device, RTC_CONFIG_INTERSECT8)) {
+		printf("Embree has no 8 wide ray packet support, falling back to single rays\n");
+		rayPacketSize = 0;
+	}
+}
+
+void rtcIntersectN(const int* valid, RTCScene scene, RTCRay8 &ray) {
+	rtcIntersect8(valid, scene, ray);
+}
+
+void rtcIntersectN(const int* valid, RTCScene scene, RTCRay16 &ray) {
+	rtcIntersect16(valid, scene, ray);
+}
+
+void rtcOccludedN(const int* valid, RTCScene scene, RTCRay16 &ray) {
+	rtcOccluded16(valid, scene, ray);
+}
+
+void rtcOccludedN(const int* valid, RTCScene scene, RTCRay8 &ray) {
+	rtcOccluded8(valid, scene, ray);
+}
+
+template<typename RTCRayN>
+void setPacketRay(RTCRayN &ray, int i, Vec3fa o, Vec3fa d, double depth = 5000.0f, int mask = 0xFFFFFFFF) {
+	ray.orgx[i] = o.x;
+	ray.orgy[i] = o.y;
+	ray.orgz[i] = o.z;
+
+	ray.dirx[i] = d.x;
+	ray.diry[i] = d.y;
+	ray.dirz[i] = d.z;
+
+	ray.tnear[i] = 0.001f;
+	ray.tfar[i] = depth;
+	ray.geomID[i] = RTC_INVALID_GEOMETRY_ID;
+	ray.primID[i] = RTC_INVALID_GEOMETRY_ID;
+	ray.mask[i] = mask;
+	ray.time[i] = 0;
+}
+
+template<typename RTCRayN>
+RTCRay getPacketRay(const RTCRayN &rays, int i) {
+	RTCRay ray;
+	ray.org[0] = rays.orgx[i];
+	ray.org[1] = rays.orgy[i];
+	ray.org[2] = rays.orgz[i];
+
+	ray.dir[0] = rays.dirx[i];
+	ray.dir[1] = rays.diry[i];
+	ray.dir[2] = rays.dirz[i];
+
+	ray.tnear = rays.tnear[i];
+	ray.tfar = rays.tfar[i];
+	ray.mask = rays.mask[i];
+	ray.time = rays.time[i];
+
+	ray.Ng[0] = rays.Ngx[i];
+	ray.Ng[1] = rays.Ngy[i];
+	ray.Ng[2] = rays.Ngz[i];
+
+	ray.u = rays.u[i];
+	ray.v = rays.v[i];
+	ray.geomID = rays.geomID[i];
+	ray.primID = rays.primID[i];
+	ray.instID = rays.instID[i];
+	return ray;
+}
+
+template<typename RTCRayN, int N>
+void getIntersectionPacket(RTCScene scene, const int* valid, RTCRayN &ray) {
+	for (int i = 0; i < N; i++)
+		if(valid[i])
+			debug_ray_intersections++;
+	rtcIntersectN(valid, scene, ray);
+}
+
+template<typename RTCRayN, int N>
+void getOcclusionPacket(RTCScene scene, const int* valid, RTCRayN &ray) {
+	for (int i = 0; i < N; i++)
+		if(valid[i])
+			debug_ray_occlusions++;
+	rtcOccludedN(valid, scene, ray);
+}
+
+#endif
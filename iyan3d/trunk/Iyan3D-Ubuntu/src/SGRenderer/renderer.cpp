@@ -5,6 +5,16 @@
 #define TILE_SIZE_X 8
 #define TILE_SIZE_Y 8
 
+struct RenderSession {
+	int taskId;
+	SceneManager *smgr;
+	SGEditorScene *editorScene;
+	Scene *scene;
+};
+
+RTCDevice renderDevice = NULL;
+RenderSession session = { -1, NULL, NULL, NULL };
+
 void error_handler(const RTCError code, const char* str)
 {
 	printf("Embree: ");
@@ -39,30 +49,42 @@ string getFileContent(const char* file) {
 }
 
 TaskDetails getRenderTaskFromServer(string machineId) {
-	string url = "https://www.iyan3dapp.com/appapi/requesttask.php?machineid=" + machineId;
+	string url = serverUrl + "/requesttask.php?machineid=" + machineId;
 	if(!runInDeveloperMode)
 		downloadFile(url.c_str(), "taskid.txt");
 	string taskInfo = getFileContent("taskid.txt");
 	TaskDetails td;
 	td.taskId = -1;
 	td.isRenderTask = true;
+	td.aoFilterType = aoFilterType;
+	td.aoFilterRadius = aoFilterRadius;
+	td.targetError = adaptiveTargetError;
+	td.timeBudget = renderTimeBudget;
 	
 	if(taskInfo.size() > 0) {
 		std::vector<std::string> x = split(taskInfo, ',');
 		td.taskId = atoi(taskInfo.c_str());
-		if(x.size() == 4) {
+		if(x.size() == 4 || x.size() == 6 || x.size() == 8) {
 			td.taskId = atoi(x[0].c_str());
 			td.frame = atoi(x[1].c_str());
 			td.width = atoi(x[2].c_str());
 			td.height = atoi(x[3].c_str());
 		}
+		if(x.size() >= 6) {
+			td.aoFilterType = atoi(x[4].c_str());
+			td.aoFilterRadius = atoi(x[5].c_str());
+		}
+		if(x.size() == 8) {
+			td.targetError = atof(x[6].c_str());
+			td.timeBudget = atof(x[7].c_str());
+		}
 	}
 
 	return td;
 }
 
 TaskDetails getVideoTaskFromServer(string machineId) {
-	string url = "https://www.iyan3dapp.com/appapi/videotask.php?machineid=" + machineId;
+	string url = serverUrl + "/videotask.php?machineid=" + machineId;
 	if(!runInDeveloperMode)
 		downloadFile(url.c_str(), "taskid.txt");
 	string taskInfo = getFileContent("taskid.txt");
@@ -104,7 +126,7 @@ bool downloadTaskFiles(TaskDetails td) {
 	mkpath("data/" + to_string(td.taskId), 0755);
 	printf("Downloading Task Files\n");
 	string fileName = "data/" + to_string(td.taskId) + "/" + to_string(td.taskId) + ".zip";
-	string url = "https://www.iyan3dapp.com/appapi/renderFiles/" + to_string(td.taskId) + ".zip";
+	string url = serverUrl + "/renderFiles/" + to_string(td.taskId) + ".zip";
 
 	if(file_exists(fileName)) {
 		return true;
@@ -112,109 +134,152 @@ bool downloadTaskFiles(TaskDetails td) {
 		return downloadFile(url.c_str(), fileName.c_str());
 }
 
-bool unzipTaskFiles(TaskDetails td) {
+SGRTTaskPackage *taskPackage = NULL;
+
+/// Extracts index.sgb right away and starts extracting the rest of the
+/// archive in the background, call finish on the package before rendering.
+bool openTaskPackage(TaskDetails td, SGRTTaskPackage &package) {
 	chdir(("data/" + to_string(td.taskId)).c_str());
 	printf("Extracting Task Files\n");
 
-	string fileName = to_string(td.taskId) + ".zip";
-	int err;
-	struct zip *za = zip_open(fileName.c_str(), 0, &err);
-	if(za == NULL) {
-        printf("Can't open zip archive\n");
-        return false;
-	}
+	ThreadPool &pool = getThreadPool();
+	if(!package.open(to_string(td.taskId) + ".zip", pool.getThreadCount()))
+		return false;
 
-	for (int i = 0; i < zip_get_num_entries(za, 0); i++) {
-		struct zip_stat sb;
-        if (zip_stat_index(za, i, 0, &sb) == 0) {
-            int len = strlen(sb.name);
-            if (sb.name[len - 1] == '/') {
-                printf("Content is in Directory\n");
-            } else {
-                struct zip_file *zf = zip_fopen_index(za, i, 0);
- 
-                int fd = open(sb.name, O_RDWR | O_TRUNC | O_CREAT, 0644);
- 
-                int sum = 0;
-                while (sum != sb.size) {
-                	char buf[100];
-                    len = zip_fread(zf, buf, 100);
-                    write(fd, buf, len);
-                    sum += len;
-                }
-                close(fd);
-                zip_fclose(zf);
-            }
-        }
-    }   
- 
-    zip_close(za);
-    return true;
+	if(!package.extract(PACKAGE_SCENE_ENTRY)) {
+		printf("No %s in the Zip Archive\n", PACKAGE_SCENE_ENTRY);
+		return false;
+	}
+	// Baked physics is read while the scene loads, so it can't wait in the queue
+	package.extract(PACKAGE_PHYSICS_ENTRY);
+	package.extractAll(pool);
+	return true;
 }
 
-bool renderFile(TaskDetails td) {
-	RTCDevice device = rtcNewDevice(NULL);
-	rtcDeviceSetErrorFunction(device, error_handler);
+RTCDevice getRenderDevice() {
+	if(renderDevice)
+		return renderDevice;
+
+	renderDevice = rtcNewDevice(NULL);
+	rtcDeviceSetErrorFunction(renderDevice, error_handler);
 	_MM_SET_FLUSH_ZERO_MODE(_MM_FLUSH_ZERO_ON);
 	_MM_SET_DENORMALS_ZERO_MODE(_MM_DENORMALS_ZERO_ON);
-	rtcDeviceGetParameter1i(device, RTC_CONFIG_BACKFACE_CULLING);
+	rtcDeviceGetParameter1i(renderDevice, RTC_CONFIG_BACKFACE_CULLING);
+	validateRayPacketSize(renderDevice);
+	return renderDevice;
+}
+
+void releaseRenderDevice() {
+	if(renderDevice)
+		rtcDeleteDevice(renderDevice);
+	renderDevice = NULL;
+}
+
+void closeRenderSession() {
+	if(session.scene)
+		delete session.scene;
+	if(session.editorScene)
+		delete session.editorScene;
+	if(session.smgr)
+		delete session.smgr;
+	clearTextureCache();
+	session.taskId = -1;
+	session.smgr = NULL;
+	session.editorScene = NULL;
+	session.scene = NULL;
+}
+
+bool renderFile(TaskDetails td) {
+	string sgfdFile = to_string(td.frame) + ".sgfd";
+	bool status = false;
+
+	Scene *scene = session.scene;
+	if(scene) {
+		status = scene->updateScene(sgfdFile.c_str(), td.width, td.height);
+		if(!status) {
+			printf("Scene topology changed, rebuilding\n");
+			delete scene;
+			clearTextureCache();
+			scene = session.scene = NULL;
+		}
+	}
+
+	if(!scene) {
+		scene = new Scene(getRenderDevice());
+		status = scene->loadScene(sgfdFile.c_str(), td.width, td.height);
+	}
+	scene->frame = td.frame;
+	scene->aoFilterType = td.aoFilterType;
+	scene->aoFilterRadius = td.aoFilterRadius;
+	scene->targetError = td.targetError;
+	scene->timeBudget = td.timeBudget;
 
-	Scene *scene = new Scene(device);
-	bool status = scene->loadScene((to_string(td.frame) + ".sgfd").c_str(), td.width, td.height);
 	if(status) {
 		scene->render();
 		scene->SaveToFile((convert2String(td.taskId) + "t" + convert2String(td.frame) + "f_render.png").c_str(), ImageFormat_PNG);
 	}
-	delete scene;
-	rtcDeleteDevice(device);
+
+	if(persistentRenderer) {
+		session.scene = scene;
+		trimTextureCache();
+	} else {
+		delete scene;
+		clearTextureCache();
+		releaseRenderDevice();
+	}
 	return status;
 }
 
 bool uploadOutputToServer(TaskDetails td) {
 	string filename = convert2String(td.taskId) + "t" + convert2String(td.frame) + "f_render.png";
-	return uploadFile(("https://www.iyan3dapp.com/appapi/finishtask.php?taskid=" + to_string(td.taskId) + "&frame=" + to_string(td.frame)).c_str(), filename.c_str());
+	return uploadFile((serverUrl + "/finishtask.php?taskid=" + to_string(td.taskId) + "&frame=" + to_string(td.frame)).c_str(), filename.c_str());
+}
+
+SGRTAssetRequest getAssetRequest(std::string filePath, std::string serverPath, std::string folder) {
+	return SGRTAssetRequest(serverUrl + folder + "/" + serverPath, filePath);
+}
+
+bool waitForTaskFile(std::string filePath) {
+	return !taskPackage || taskPackage->waitForEntry(filePath);
 }
 
 bool checkAndDownloadFile(std::string filePath, std::string serverPath, std::string folder) {
+	waitForTaskFile(filePath);
 	if(file_exists(filePath))
 		return true;
+	return getAssetCache().fetch(serverUrl + folder + "/" + serverPath, filePath);
+}
 
-	string commonFilePath = "../" + filePath;
-	if(!file_exists(commonFilePath)) {
-		string url = "https://www.iyan3dapp.com/appapi" + folder + "/" + serverPath;
-		printf("Fetching Url: %s\n", url.c_str());
-		downloadFile(url.c_str(), commonFilePath.c_str());
-	}
-	file_copy(commonFilePath, filePath);
-
-	if(!file_exists(filePath))
+/// Fetches the model and the node's own -cm texture in one batch. The
+/// shared texture is only fetched when the node has no -cm texture.
+bool downloadMeshAssets(std::string filePath, std::string extension, std::string folder, bool hasTexture, std::string textureName) {
+	waitForTaskFile(filePath + extension);
+	waitForTaskFile(filePath + "-cm.png");
+	waitForTaskFile(textureName + ".png");
+
+	vector<SGRTAssetRequest> requests;
+	if(!file_exists(filePath + extension))
+		requests.push_back(getAssetRequest(filePath + extension, filePath + extension, folder));
+	if(hasTexture && !file_exists(filePath + "-cm.png"))
+		requests.push_back(getAssetRequest(filePath + "-cm.png", filePath + ".png", "/meshtexture"));
+	if(!requests.empty())
+		getAssetCache().fetch(requests);
+	if(!file_exists(filePath + extension))
 		return false;
 
-	return true;
+	if(!hasTexture || file_exists(filePath + "-cm.png") || file_exists(textureName + ".png"))
+		return true;
+	vector<SGRTAssetRequest> sharedTexture(1, getAssetRequest(textureName + ".png", textureName + ".png", "/meshtexture"));
+	return getAssetCache().fetch(sharedTexture);
 }
 
 bool downloadMissingAssetCallBack(std::string filePath, NODE_TYPE nodeType, bool hasTexture, std::string textureName) {
 	if(nodeType == NODE_SGM) {
-		if(!checkAndDownloadFile(filePath + ".sgm", filePath + ".sgm", "/mesh"))
-			return false;
-		if(hasTexture && !checkAndDownloadFile(filePath + "-cm.png", filePath + ".png", "/meshtexture")) {
-			if(!checkAndDownloadFile(textureName + ".png", textureName + ".png", "/meshtexture"))
-				return false;
-		}
+		return downloadMeshAssets(filePath, ".sgm", "/mesh", hasTexture, textureName);
 	} else if(nodeType == NODE_RIG) {
-		if(!checkAndDownloadFile(filePath + ".sgr", filePath + ".sgr", "/mesh"))
-			return false;
-		if(hasTexture && !checkAndDownloadFile(filePath + "-cm.png", filePath + ".png", "/meshtexture")) {
-			if(!checkAndDownloadFile(textureName + ".png", textureName + ".png", "/meshtexture"))
-				return false;
-		}
+		return downloadMeshAssets(filePath, ".sgr", "/mesh", hasTexture, textureName);
 	} else if(nodeType == NODE_OBJ) {
-		if(!checkAndDownloadFile(filePath + ".obj", filePath + ".obj", ""))
-			return false;
-		if(hasTexture && !checkAndDownloadFile(filePath + "-cm.png", filePath + ".png", "/meshtexture")) {
-			if(!checkAndDownloadFile(textureName + ".png", textureName + ".png", "/meshtexture"))
-				return false;
-		}
+		return downloadMeshAssets(filePath, ".obj", "", hasTexture, textureName);
 	} else if(nodeType == NODE_TEXT) {
 		string uefilename(url_encode(filePath.c_str()));
 		if(!checkAndDownloadFile(filePath, "findfont.php?name=" + uefilename, ""))
@@ -224,22 +289,19 @@ bool downloadMissingAssetCallBack(std::string filePath, NODE_TYPE nodeType, bool
 	return true;
 }
 
-bool downloadVideoTaskFiles(TaskDetails td) {
-	mkpath("data/", 0755);
-	mkpath("data/video/", 0755);
-	mkpath("data/video/" + to_string(td.taskId), 0755);
-	printf("Downloading Video Task Files\n");
-
-	printf("Start: %d End: %d\n", td.startFrame, td.endFrame);
-	for(int i = td.startFrame; i <= td.endFrame; i++) {
-		printf("Downloading Frame: %d\n", i);
-		string fileName = "data/video/" + to_string(td.taskId) + "/" + convert2String(td.taskId) + "t" + convert2String(i) + "f_render.png";
-		string url = "https://www.iyan3dapp.com/appapi/renderFiles/"  + to_string(td.taskId) + "/" + convert2String(td.taskId) + "t" + convert2String(i) + "f_render.png";
-		if(!file_exists(fileName))
-			if(!downloadFile(url.c_str(), fileName.c_str()))
-				return false;
-	}
-	return true;
+int videoTaskId = -1;
+
+string getVideoFramePath(int frame) {
+	return convert2String(videoTaskId) + "t" + convert2String(frame) + "f_render.png";
+}
+
+bool downloadVideoFrame(int frame) {
+	string fileName = getVideoFramePath(frame);
+	string url = serverUrl + "/renderFiles/"  + to_string(videoTaskId) + "/" + fileName;
+	printf("Downloading Frame: %d\n", frame);
+	if(file_exists(fileName))
+		return true;
+	return downloadFile(url.c_str(), fileName.c_str());
 }
 
 string exec(const char* cmd) {
@@ -256,44 +318,94 @@ string exec(const char* cmd) {
 
 bool uploadVideoToServer(TaskDetails td) {
 	string filename = to_string(td.taskId) + ".mp4";
-	return uploadFile(("https://www.iyan3dapp.com/appapi/finishtask.php?taskid=" + to_string(td.taskId) + "&frame=0").c_str(), filename.c_str());
+	return uploadFile((serverUrl + "/finishtask.php?taskid=" + to_string(td.taskId) + "&frame=0").c_str(), filename.c_str());
 }
 
 bool videoTask(TaskDetails td) {
-	if(!downloadVideoTaskFiles(td))
-		return false;
+	mkpath("data/", 0755);
+	mkpath("data/video/", 0755);
+	mkpath("data/video/" + to_string(td.taskId), 0755);
+	chdir(("data/video/" + to_string(td.taskId)).c_str());
 
-	printf("Creating Video File\n");
+	printf("Creating Video File\nStart: %d End: %d\n", td.startFrame, td.endFrame);
+	videoTaskId = td.taskId;
 
-	chdir(("data/video/" + to_string(td.taskId)).c_str());
+	SGRTVideoEncoder encoder;
+	if(!encoder.open((to_string(td.taskId) + ".mp4").c_str(), td.width, td.height))
+		return false;
 
-	string cmd = "convert -delay 1 " + convert2String(td.taskId) + "t*f_render.png " + to_string(td.taskId) + ".mp4";
-	exec(cmd.c_str());
+	// Frames are downloaded and decoded ahead on another thread and
+	// encoded in order as they arrive
+	SGRTFramePrefetcher prefetcher(td.startFrame, td.endFrame, &getVideoFramePath, &downloadVideoFrame);
+	int encodedFrames = 0;
+	while(SGRTVideoFrame *frame = prefetcher.nextFrame()) {
+		bool status = true;
+		if(frame->width < encoder.width || frame->height < encoder.height) {
+			printf("Frame %d is %dx%d, expected %dx%d\n", frame->index, frame->width, frame->height, encoder.width, encoder.height);
+			status = false;
+		} else {
+			printf("Encoding Frame: %d\n", frame->index);
+			status = encoder.encodeFrame(&frame->rgba[0], frame->width * 4);
+		}
+		delete frame;
+		if(!status)
+			return false;
+		encodedFrames++;
+	}
+
+	if(encodedFrames != td.endFrame - td.startFrame + 1 || !encoder.finish())
+		return false;
 
 	uploadVideoToServer(td);
 	return true;
 }
 
 bool renderTask(TaskDetails td) {
-	if(!downloadTaskFiles(td))
-		return false;
-
-	if(!unzipTaskFiles(td))
-		return false;
+	if(persistentRenderer && session.taskId == td.taskId) {
+		chdir(("data/" + to_string(td.taskId)).c_str());
+		printf("Reusing loaded scene for Task %d\n", td.taskId);
+		session.editorScene->updatePhysics(td.frame);
+		session.editorScene->generateSGFDFile(td.frame);
+	} else {
+		closeRenderSession();
 
-	printf("Creating SGFD Files\n");
-	constants::BundlePath = ".";
-	checkAndDownloadFile("camera.sgm", "camera.sgm", "/mesh");
-	checkAndDownloadFile("light.sgm", "light.sgm", "/mesh");
-	checkAndDownloadFile("sphere.sgm", "sphere.sgm", "/mesh");
+		if(!downloadTaskFiles(td))
+			return false;
 
-	SceneManager *smgr = new SceneManager(td.width, td.height, 1.0, OPENGLES2, "", NULL);
-	SGEditorScene *scene = new SGEditorScene(OPENGLES2, smgr, td.width, td.height);
-	scene->downloadMissingAssetCallBack = &downloadMissingAssetCallBack;
+		SGRTTaskPackage package;
+		if(!openTaskPackage(td, package))
+			return false;
+		taskPackage = &package;
+
+		printf("Creating SGFD Files\n");
+		constants::BundlePath = ".";
+		vector<SGRTAssetRequest> builtInMeshes;
+		builtInMeshes.push_back(getAssetRequest("camera.sgm", "camera.sgm", "/mesh"));
+		builtInMeshes.push_back(getAssetRequest("light.sgm", "light.sgm", "/mesh"));
+		builtInMeshes.push_back(getAssetRequest("sphere.sgm", "sphere.sgm", "/mesh"));
+		getAssetCache().fetch(builtInMeshes);
+
+		SceneManager *smgr = new SceneManager(td.width, td.height, 1.0, OPENGLES2, "", NULL);
+		SGEditorScene *scene = new SGEditorScene(OPENGLES2, smgr, td.width, td.height);
+		scene->downloadMissingAssetCallBack = &downloadMissingAssetCallBack;
+
+		std::string filename = "index.sgb";
+		scene->loadSceneData(&filename);
+
+		taskPackage = NULL;
+		if(!package.finish()) {
+			printf("Failed extracting Task Files\n");
+			delete scene;
+			delete smgr;
+			return false;
+		}
+		scene->updatePhysics(td.frame);
+		scene->generateSGFDFile(td.frame);
 
-	std::string filename = "index.sgb";
-	scene->loadSceneData(&filename);
-	scene->generateSGFDFile(td.frame);
+		session.taskId = td.taskId;
+		session.smgr = smgr;
+		session.editorScene = scene;
+	}
 
 	printf("Starting Render for Task %d\n", td.taskId);
 	struct stat buffer;
@@ -326,14 +438,34 @@ int main(int argc, char** argv)
     if(reader.parse(jsonFile, configData)) {
 		machineId = configData["machineId"].asString();
 		isRenderMachine = configData["isRenderMachine"].asBool();
+		persistentRenderer = configData["persistentRenderer"].asBool();
 		taskFetchFrequency = configData["taskFetchFrequency"].asInt();
 		MAX_RAY_DEPTH = configData["MAX_RAY_DEPTH"].asInt();
 		samplesAO = configData["samplesAO"].asInt();
 		minAOBrightness = configData["minAOBrightness"].asDouble();
 		randomSamples = configData["randomSamples"].asInt();
+		rayPacketSize = configData["rayPacketSize"].asInt();
+		aoFilterType = configData.get("aoFilterType", aoFilterType).asInt();
+		aoFilterRadius = configData.get("aoFilterRadius", aoFilterRadius).asInt();
+		pinRenderThreads = configData.get("pinRenderThreads", pinRenderThreads).asBool();
+		MIN_TILE_SIZE = configData.get("minTileSize", MIN_TILE_SIZE).asInt();
+		adaptiveTargetError = configData.get("adaptiveTargetError", adaptiveTargetError).asDouble();
+		renderTimeBudget = configData.get("renderTimeBudget", renderTimeBudget).asDouble();
+		adaptiveMaxSamples = configData.get("adaptiveMaxSamples", adaptiveMaxSamples).asInt();
+		videoCodec = configData.get("videoCodec", videoCodec).asString();
+		videoFrameRate = configData.get("videoFrameRate", videoFrameRate).asInt();
+		videoBitRate = configData.get("videoBitRate", videoBitRate).asInt();
+		serverUrl = configData.get("serverUrl", serverUrl).asString();
+		assetCacheDir = configData.get("assetCacheDir", assetCacheDir).asString();
+		if(configData.isMember("assetCacheMB"))
+			assetCacheBudget = (size_t)configData["assetCacheMB"].asInt() * 1024 * 1024;
+		if(configData.isMember("textureCacheMB"))
+			textureCacheBudget = (size_t)configData["textureCacheMB"].asInt() * 1024 * 1024;
 	}
 
-	printf("Working as Machine Id:%s\nisRenderMachine:%d\ntaskFetchFrequency:%d\nMAX_RAY_DEPTH:%d\nsamplesAO:%d\nminAOBrightness:%f\nrandomSamples:%d\n\n", machineId.c_str(), isRenderMachine, taskFetchFrequency, MAX_RAY_DEPTH, samplesAO, minAOBrightness, randomSamples);
+	printf("Working as Machine Id:%s\nisRenderMachine:%d\npersistentRenderer:%d\ntaskFetchFrequency:%d\nMAX_RAY_DEPTH:%d\nsamplesAO:%d\nminAOBrightness:%f\nrandomSamples:%d\nrayPacketSize:%d\naoFilterType:%d\naoFilterRadius:%d\ntextureCacheMB:%d\npinRenderThreads:%d\nminTileSize:%d\nadaptiveTargetError:%f\nrenderTimeBudget:%.1fs\nadaptiveMaxSamples:%d\n\n", machineId.c_str(), isRenderMachine, persistentRenderer, taskFetchFrequency, MAX_RAY_DEPTH, samplesAO, minAOBrightness, randomSamples, rayPacketSize, aoFilterType, aoFilterRadius, (int)(textureCacheBudget / (1024 * 1024)), pinRenderThreads, MIN_TILE_SIZE, adaptiveTargetError, renderTimeBudget, adaptiveMaxSamples);
+
+	getAssetCache();
 
 	do {
 		printf("Asking Server for new task\n");
@@ -363,6 +495,10 @@ int main(int argc, char** argv)
 		}
 	} while(!runInDeveloperMode);
 
+	closeRenderSession();
+	releaseThreadPool();
+	releaseAssetCache();
+	releaseRenderDevice();
 	return 0;
 }
 
@@ -0,0 +1,144 @@
+#ifndef SAMPLER_H_
+#define SAMPLER_H_
+
+#include <stdint.h>
+
+enum SampleDimension {
+	SAMPLE_DIM_PIXEL = 0,
+	SAMPLE_DIM_LENS,
+	SAMPLE_DIM_LENS_DEPTH,
+	SAMPLE_DIM_AO,
+	SAMPLE_DIM_BOUNCE
+};
+
+// Area lights sampled at one bounce each get their own dimensions
+#define BOUNCE_LIGHT_SAMPLES 4
+
+enum BounceSampleDimension {
+	BOUNCE_DIM_DIFFUSE = 0,
+	BOUNCE_DIM_REFLECTION,
+	BOUNCE_DIM_LIGHT_SELECT,
+	BOUNCE_DIM_LIGHT_POINT,
+	BOUNCE_DIM_COUNT = BOUNCE_DIM_LIGHT_POINT + 2 * BOUNCE_LIGHT_SAMPLES
+};
+
+int getBounceDimension(int depth, int offset) {
+	return SAMPLE_DIM_BOUNCE + depth * BOUNCE_DIM_COUNT + offset;
+}
+
+/// First of the two dimensions (surface point, triangle choice) used by the
+/// given light slot at this bounce.
+int getLightDimension(int depth, int light) {
+	return getBounceDimension(depth, BOUNCE_DIM_LIGHT_POINT + 2 * light);
+}
+
+struct SGRTSampler {
+	uint64_t state;
+	uint64_t inc;
+	uint32_t pixelSeed;
+	uint32_t sampleIndex;
+};
+
+__thread SGRTSampler threadSampler = { 0, 0, 0, 0 };
+
+uint32_t hashSeed(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+uint32_t hashSeed(uint32_t a, uint32_t b) {
+	return hashSeed(a ^ (hashSeed(b) + 0x9e3779b9 + (a << 6) + (a >> 2)));
+}
+
+uint32_t nextRandom(SGRTSampler &s) {
+	uint64_t oldState = s.state;
+	s.state = oldState * 6364136223846793005ULL + s.inc;
+	uint32_t xorShifted = (uint32_t)(((oldState >> 18u) ^ oldState) >> 27u);
+	uint32_t rot = (uint32_t)(oldState >> 59u);
+	return (xorShifted >> rot) | (xorShifted << ((-rot) & 31));
+}
+
+void seedSampler(SGRTSampler &s, uint32_t seed, uint32_t sequence) {
+	s.state = 0;
+	s.inc = ((uint64_t)sequence << 1u) | 1u;
+	nextRandom(s);
+	s.state += seed;
+	nextRandom(s);
+}
+
+/// Restarts the calling thread's sampler for one sample of one pixel, so the
+/// random stream only depends on (pixel, sample, frame) and not on which
+/// worker thread picked up the tile.
+void setSamplerPixel(int x, int y, int sample, int frame) {
+	threadSampler.pixelSeed = hashSeed(hashSeed((uint32_t)x, (uint32_t)y), (uint32_t)frame);
+	threadSampler.sampleIndex = sample;
+	seedSampler(threadSampler, hashSeed(threadSampler.pixelSeed, (uint32_t)sample), threadSampler.pixelSeed);
+}
+
+double GetRandomValue() {
+	if(!threadSampler.inc)
+		seedSampler(threadSampler, 0, 0);
+	return nextRandom(threadSampler) * (1.0 / 4294967296.0);
+}
+
+uint32_t sobolSample(uint32_t index, int dimension) {
+	uint32_t result = 0;
+	if(dimension == 0) {
+		for (uint32_t v = 1u << 31; index; index >>= 1, v >>= 1)
+			if(index & 1)
+				result ^= v;
+	} else {
+		for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1)
+			if(index & 1)
+				result ^= v;
+	}
+	return result;
+}
+
+uint32_t reverseBits(uint32_t x) {
+	x = (x << 16) | (x >> 16);
+	x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+	x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+	x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+	x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+	return x;
+}
+
+/// Hash based Owen scramble: every bit is flipped depending only on the bits
+/// above it, so a (0,2)-net stays a (0,2)-net after scrambling.
+uint32_t owenScramble(uint32_t x, uint32_t seed) {
+	x = reverseBits(x);
+	x += seed;
+	x ^= x * 0x6c50b47cu;
+	x ^= x * 0xb82f1e52u;
+	x ^= x * 0xc7afe638u;
+	x ^= x * 0x8d22f6e6u;
+	return reverseBits(x);
+}
+
+/// Two dimensional Sobol point for the given sample index. The index is
+/// shuffled per pixel and dimension before lookup, so two dimensions never
+/// walk the sequence in the same order, and each coordinate is Owen scrambled.
+/// Any power of two block of sample indices still covers every stratum.
+void getSample2D(int dimension, uint32_t index, double &u, double &v) {
+	uint32_t seed = hashSeed(threadSampler.pixelSeed, (uint32_t)dimension);
+	uint32_t shuffled = owenScramble(index, seed);
+	u = owenScramble(sobolSample(shuffled, 0), hashSeed(seed, 1u)) * (1.0 / 4294967296.0);
+	v = owenScramble(sobolSample(shuffled, 1), hashSeed(seed, 2u)) * (1.0 / 4294967296.0);
+}
+
+void getSample2D(int dimension, double &u, double &v) {
+	getSample2D(dimension, threadSampler.sampleIndex, u, v);
+}
+
+double getSample1D(int dimension) {
+	double u, v;
+	getSample2D(dimension, threadSampler.sampleIndex, u, v);
+	return u;
+}
+
+#endif
@@ -3,24 +3,60 @@
 
 #include "common.h"
 
+#define DIFFUSE_CONE_SPREAD 0.25
+#define PROGRESSIVE_MIN_SAMPLES 4
+#define PROGRESSIVE_ERROR_FLOOR 0.1
+
+/// Running sums of one pixel in progressive mode. Variance is tracked on
+/// the clipped luminance, the value that ends up in the 8 bit output.
+struct SGRTPixelStats
+{
+	double r, g, b;
+	double luminanceSum;
+	double luminanceSquaredSum;
+	double distance;
+	int samples;
+	bool converged;
+};
+
 struct Scene
 {
 	vector<SGRTMesh*> meshes;
+	SGRTLightList lights;
 	Camera *cam;
 	RTCScene sgScene;
 	int imgWidth;
 	int imgHeight;
 	vector<Tile> tiles;
 	double progress;
+	int renderedPixels;
 	unsigned char *pixels;
 	double *aoMap;
+	float *aoGuide;
 	double dofNear, dofFar;
+	int frame;
+	int aoFilterType;
+	int aoFilterRadius;
+	sgrtreal pixelSpreadAngle;
+	double targetError;
+	double timeBudget;
+	int passSamples;
+	vector<SGRTPixelStats> pixelStats;
+	timespec renderStart;
 
 	Scene(RTCDevice rtcDevice) {
-		srand(time(0));
+		cam = NULL;
+		frame = 0;
+		aoGuide = NULL;
+		aoFilterType = ::aoFilterType;
+		aoFilterRadius = ::aoFilterRadius;
+		pixelSpreadAngle = 0.0;
+		targetError = adaptiveTargetError;
+		timeBudget = renderTimeBudget;
+		passSamples = 0;
 		dofNear = 0.0;
 		dofFar = 5000.0;
-		sgScene = rtcDeviceNewScene(rtcDevice, RTC_SCENE_STATIC, RTC_INTERSECT1);
+		sgScene = rtcDeviceNewScene(rtcDevice, persistentRenderer ? RTC_SCENE_DYNAMIC : RTC_SCENE_STATIC, getSceneAlgorithmFlags());
 
 		if(!sgScene) {
 			printf("Error: Failed initializing RTCScene\n");
@@ -38,22 +74,26 @@ struct Scene
 
 	class ThreadWorker : public ThreadPoolWorker {
 	private:
-		int index;
+		Tile tile;
 		Scene *scene;
+		ThreadPool *pool;
 	public:
-		ThreadWorker(int i_, Scene* s_) : index(i_), scene(s_) { }
+		ThreadWorker(Tile t_, Scene* s_, ThreadPool* p_) : tile(t_), scene(s_), pool(p_) { }
 
 		void operator()() {
-			fprintf(stderr, "\rRendering (%d spp) %5.2f%%", randomSamples, 100. * index / (scene->tiles.size() - 1));
-			scene->renderTile(scene->tiles[index]);
+			scene->renderTileAdaptive(*pool, tile);
 		}
 	};
 
 	void render() {
 		progress = 0;
+		pixelSpreadAngle = cam->fovDist / imgHeight;
 		pixels = (unsigned char*)malloc(imgWidth * imgHeight * 4 * sizeof(unsigned char));
 		aoMap = (double*)malloc(imgWidth * imgHeight * sizeof(double));
+		if(samplesAO > 0 && aoFilterType == AO_FILTER_EDGE_AWARE)
+			aoGuide = (float*)malloc(imgWidth * imgHeight * AO_GUIDE_CHANNELS * sizeof(float));
 
+		tiles.clear();
 		for (int y = 0; y < imgHeight; y += TILE_SIZE) {
 			for (int x = 0; x < imgWidth; x += TILE_SIZE) {
 				double midx = imgWidth/2.0, midy = imgHeight/2.0;
@@ -75,30 +115,114 @@ struct Scene
 			}
 		}
 		sort(tiles.begin(), tiles.end(), sortByDisance);
-		ThreadPool pool = ThreadPool(num_cores());
+		clock_gettime(CLOCK_MONOTONIC, &renderStart);
+		ThreadPool &pool = getThreadPool();
+		if(targetError > 0.0 || timeBudget > 0.0)
+			renderProgressive(pool);
+		else
+			renderPass(pool);
+
+		if(samplesAO > 0) {
+			SGRTPostFilter filter(aoFilterType, aoFilterRadius, imgWidth, imgHeight, aoGuide);
+			filter.apply(pool, aoMap, pixels);
+		}
+
+		if(aoGuide)
+			free(aoGuide);
+		aoGuide = NULL;
+	}
+
+	void renderPass(ThreadPool &pool) {
+		renderedPixels = 0;
 		for (int i = 0; i < tiles.size(); ++i) {
-			pool.enqueueWork(new ThreadWorker(i, this));
+			pool.enqueueWork(new ThreadWorker(tiles[i], this, &pool));
 		}
 		pool.waitEnd();
 		fprintf(stderr, "\n");
 	}
 
-	void SaveToFile(const char* imagePath, ImageFormat imgFormat) {
-		double* tmpAOMap = (double*)malloc(imgWidth * imgHeight * sizeof(double));
-		memcpy(tmpAOMap, aoMap, imgWidth * imgHeight * sizeof(double));
-		gaussionBlur(tmpAOMap, aoMap, imgWidth, imgHeight, 3);
-		free(tmpAOMap);
-
-		for (size_t y = 0; y < imgHeight; y++) {
-			for (size_t x = 0; x < imgWidth; x++) {
-				int pi = ((y * imgWidth) + x) * 4;
-				double ao = aoMap[((y * imgWidth) + x)];
-				pixels[pi + 0] *= ao;
-				pixels[pi + 1] *= ao;
-				pixels[pi + 2] *= ao;
+	/// Renders the frame in passes of passSamples samples per pixel. The
+	/// first pass covers every pixel, later passes only the pixels whose
+	/// estimated error is still above targetError, until all converged,
+	/// adaptiveMaxSamples is reached or timeBudget seconds have passed.
+	/// A zero targetError refines every pixel until one of the budgets ends.
+	void renderProgressive(ThreadPool &pool) {
+		SGRTPixelStats empty = SGRTPixelStats();
+		pixelStats.assign(imgWidth * imgHeight, empty);
+
+		int initialSamples = max(randomSamples, PROGRESSIVE_MIN_SAMPLES);
+		int totalSamples = passSamples = initialSamples;
+		renderPass(pool);
+
+		for (int pass = 1; totalSamples < adaptiveMaxSamples && !isOverTimeBudget(); pass++) {
+			int activePixels = updateConvergence();
+			if(activePixels == 0)
+				break;
+
+			passSamples = min(initialSamples, adaptiveMaxSamples - totalSamples);
+			printf("Pass %d: %d pixels above target error, %d spp\n", pass, activePixels, totalSamples + passSamples);
+			renderPass(pool);
+			totalSamples += passSamples;
+		}
+		printf("Progressive render finished at %d spp in %.2fs\n", totalSamples, getElapsedTime());
+		passSamples = 0;
+		pixelStats.clear();
+	}
+
+	int updateConvergence() {
+		int activePixels = 0;
+		for (int i = 0; i < pixelStats.size(); i++) {
+			SGRTPixelStats &p = pixelStats[i];
+			if(!p.converged && targetError > 0.0 && p.samples > 1) {
+				double mean = p.luminanceSum / p.samples;
+				double variance = max(0.0, (p.luminanceSquaredSum - mean * p.luminanceSum) / (p.samples - 1));
+				p.converged = sqrt(variance / p.samples) / max(mean, PROGRESSIVE_ERROR_FLOOR) <= targetError;
 			}
+			if(!p.converged)
+				activePixels++;
 		}
+		return activePixels;
+	}
+
+	double getElapsedTime() {
+		timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		return (now.tv_sec - renderStart.tv_sec) + (now.tv_nsec - renderStart.tv_nsec) / 1000000000.0;
+	}
 
+	bool isOverTimeBudget() {
+		return timeBudget > 0.0 && getElapsedTime() >= timeBudget;
+	}
+
+	/// While other threads are out of work, halves the tile along its
+	/// longer side and hands the second half back to the pool, so the
+	/// expensive tiles at the end of a frame are shared by all threads.
+	void renderTileAdaptive(ThreadPool &pool, Tile t) {
+		while((t.width > MIN_TILE_SIZE || t.height > MIN_TILE_SIZE) && pool.isStarving()) {
+			Tile half = t;
+			if(t.width >= t.height) {
+				// Keep widths a multiple of the 4 pixel packet blocks
+				int w = ((t.width / 2 + 3) / 4) * 4;
+				half.x = t.x + w;
+				half.width = t.width - w;
+				t.width = w;
+			} else {
+				int h = ((t.height / 2 + 3) / 4) * 4;
+				half.y = t.y + h;
+				half.height = t.height - h;
+				t.height = h;
+			}
+			if(half.width <= 0 || half.height <= 0)
+				break;
+			pool.enqueueWork(new ThreadWorker(half, this, &pool));
+		}
+
+		renderTile(t);
+		int rendered = __sync_add_and_fetch(&renderedPixels, t.width * t.height);
+		fprintf(stderr, "\rRendering (%d spp) %5.2f%%", (passSamples > 0) ? passSamples : randomSamples, 100. * rendered / (imgWidth * imgHeight));
+	}
+
+	void SaveToFile(const char* imagePath, ImageFormat imgFormat) {
 		if(imgFormat == ImageFormat_PPM) {
 			FILE* file = fopen(imagePath, "wb");
 			if (!file) 
@@ -121,42 +245,105 @@ struct Scene
 				printf("error %u: %s\n", error, lodepng_error_text(error));
 		}
 		free(pixels);
+		free(aoMap);
 	}
 
 	void renderTile(Tile t) {
- 		for (int y = t.y; y < t.y + t.height; y++)
+		if(passSamples > 0)
+			renderTileProgressive(t);
+		else if(rayPacketSize == 8)
+			renderTilePacket<RTCRay8, 8>(t);
+		else if(rayPacketSize == 16)
+			renderTilePacket<RTCRay16, 16>(t);
+		else {
+			for (int y = t.y; y < t.y + t.height; y++)
+				for (int x = t.x; x < t.x + t.width; x++)
+					renderPixel(x, y);
+		}
+	}
+
+	void renderTileProgressive(Tile t) {
+		for (int y = t.y; y < t.y + t.height; y++) {
+			// Only the first pass has to finish, later ones give up on
+			// the remaining rows once the time budget is spent
+			if(pixelStats[y * imgWidth + t.x].samples > 0 && isOverTimeBudget())
+				return;
 			for (int x = t.x; x < t.x + t.width; x++)
-				renderPixel(x, y);
+				if(!pixelStats[y * imgWidth + x].converged)
+					renderPixelProgressive(x, y, passSamples);
+		}
 	}
-	
+
+	void renderPixelProgressive(int x, int y, int samples) {
+		SGRTPixelStats &p = pixelStats[y * imgWidth + x];
+
+		if(p.samples == 0 && samplesAO > 0) {
+			setSamplerPixel(x, y, 0, frame);
+			Vec3fa dir = cam->getRayDirection(x/(double)imgWidth, y/(double)imgHeight);
+			Vec3fa normal;
+			aoMap[(((imgHeight - y - 1) * imgWidth) + x)] = getAmbientOcclusion(cam->position, dir, p.distance, normal);
+			writeAOGuide(x, y, p.distance, normal);
+		}
+
+		for (int i = 0; i < samples; ++i) {
+			Vec3fa origin, dir;
+			setSamplerPixel(x, y, p.samples + i, frame);
+			getSampleRay(x, y, p.distance, origin, dir);
+			Vec3fa color = getRadiance(origin, dir, 0);
+			p.r += color.x;
+			p.g += color.y;
+			p.b += color.z;
+
+			double luminance = 0.2126 * clip(color.x, 0.0f, 1.0f) + 0.7152 * clip(color.y, 0.0f, 1.0f) + 0.0722 * clip(color.z, 0.0f, 1.0f);
+			p.luminanceSum += luminance;
+			p.luminanceSquaredSum += luminance * luminance;
+		}
+		p.samples += samples;
+
+		writePixel(x, y, Vec3fa(p.r, p.g, p.b) / (double)p.samples);
+	}
+
+	template<typename RTCRayN, int N>
+	void renderTilePacket(Tile t) {
+		int blockWidth = 4;
+		int blockHeight = N / blockWidth;
+		int px[N], py[N];
+
+		for (int by = t.y; by < t.y + t.height; by += blockHeight) {
+			for (int bx = t.x; bx < t.x + t.width; bx += blockWidth) {
+				int count = 0;
+				for (int y = by; y < by + blockHeight && y < t.y + t.height; y++) {
+					for (int x = bx; x < bx + blockWidth && x < t.x + t.width; x++) {
+						px[count] = x;
+						py[count] = y;
+						count++;
+					}
+				}
+				renderPixelPacket<RTCRayN, N>(px, py, count);
+			}
+		}
+	}
+
 	void renderPixel(int x, int y) {
 		Vec3fa color = Vec3fa(0.0f);
 		double distance = 0;
 
 		double ao = 1.0;
+		setSamplerPixel(x, y, 0, frame);
 		if(samplesAO > 0) {
 			Vec3fa dir = cam->getRayDirection(x/(double)imgWidth, y/(double)imgHeight);
-			ao = getAmbientOcclusion(cam->position, dir, distance);
+			Vec3fa normal;
+			ao = getAmbientOcclusion(cam->position, dir, distance, normal);
 			aoMap[(((imgHeight - y - 1) * imgWidth) + x)] = ao;
+			writeAOGuide(x, y, distance, normal);
 		}
 
 		if(randomSamples > 0) {
 			for (int i = 0; i < randomSamples; ++i) {
-				double r1 = 2 * GetRandomValue();
-				double r2 = 2 * GetRandomValue();
-				double dx = r1 < 1 ? sqrt(r1)-1 : 1-sqrt(2-r1);
-				double dy = r2 < 1 ? sqrt(r2)-1 : 1-sqrt(2-r2);
-				Vec3fa dir = cam->getRayDirection((x + dx)/(double)imgWidth, (y + dy)/(double)imgHeight);
-
-				double focalDist = dofNear + (dofFar - dofNear) / 2.0;
-				if(distance > dofNear && distance < dofFar) {
-					color = color + getRadiance(cam->position, dir, 0);
-				} else {
-					Vec3fa focalPoint = cam->position + dir * focalDist;
-					double blurMagnitude = (distance > focalDist ? distance - dofFar : dofNear - distance)/ focalDist;
-					Vec3fa camPosition = cam->position + Vec3fa(GetRandomValue(), GetRandomValue(), GetRandomValue()) * blurMagnitude;
-					color = color + getRadiance(camPosition, focalPoint - camPosition, 0);
-				}
+				Vec3fa origin, dir;
+				setSamplerPixel(x, y, i, frame);
+				getSampleRay(x, y, distance, origin, dir);
+				color = color + getRadiance(origin, dir, 0);
 			}
 			color = color / (double)randomSamples;
 		} else {
@@ -164,6 +351,91 @@ struct Scene
 			color = color + getRadiance(cam->position, dir, 0);
 		}
 
+		writePixel(x, y, color);
+	}
+
+	template<typename RTCRayN, int N>
+	void renderPixelPacket(const int* px, const int* py, int count) {
+		ALIGN(64) RTCRayN rays;
+		ALIGN(64) int valid[N];
+		Vec3fa origins[N], dirs[N], colors[N];
+		double distances[N], aos[N];
+		Vec3fa normals[N];
+		SGRTSampler samplers[N];
+
+		for (int i = 0; i < N; i++) {
+			valid[i] = (i < count) ? -1 : 0;
+			distances[i] = 0.0;
+			colors[i] = Vec3fa(0.0f);
+			origins[i] = cam->position;
+			if(i < count)
+				dirs[i] = cam->getRayDirection(px[i]/(double)imgWidth, py[i]/(double)imgHeight);
+			else
+				dirs[i] = cam->direction;
+			setPacketRay(rays, i, origins[i], dirs[i], 5000.0f, 0xFFFF0000);
+		}
+
+		if(samplesAO > 0 || randomSamples <= 0)
+			getIntersectionPacket<RTCRayN, N>(sgScene, valid, rays);
+
+		if(samplesAO > 0) {
+			getAmbientOcclusionPacket<RTCRayN, N>(rays, valid, px, py, aos, normals);
+			for (int i = 0; i < count; i++) {
+				distances[i] = rays.tfar[i];
+				aoMap[(((imgHeight - py[i] - 1) * imgWidth) + px[i])] = aos[i];
+				writeAOGuide(px[i], py[i], distances[i], normals[i]);
+			}
+		}
+
+		if(randomSamples > 0) {
+			for (int s = 0; s < randomSamples; ++s) {
+				for (int i = 0; i < count; i++) {
+					setSamplerPixel(px[i], py[i], s, frame);
+					getSampleRay(px[i], py[i], distances[i], origins[i], dirs[i]);
+					setPacketRay(rays, i, origins[i], dirs[i], 5000.0f, 0xFFFF0000);
+					samplers[i] = threadSampler;
+				}
+				getIntersectionPacket<RTCRayN, N>(sgScene, valid, rays);
+				for (int i = 0; i < count; i++) {
+					threadSampler = samplers[i];
+					colors[i] = colors[i] + shadeRay(getPacketRay(rays, i), origins[i], dirs[i], 0);
+				}
+			}
+			for (int i = 0; i < count; i++)
+				colors[i] = colors[i] / (double)randomSamples;
+		} else {
+			for (int i = 0; i < count; i++) {
+				setSamplerPixel(px[i], py[i], 0, frame);
+				colors[i] = shadeRay(getPacketRay(rays, i), origins[i], dirs[i], 0);
+			}
+		}
+
+		for (int i = 0; i < count; i++)
+			writePixel(px[i], py[i], colors[i]);
+	}
+
+	void getSampleRay(int x, int y, double distance, Vec3fa &origin, Vec3fa &dir) {
+		double r1, r2;
+		getSample2D(SAMPLE_DIM_PIXEL, r1, r2);
+		r1 *= 2;
+		r2 *= 2;
+		double dx = r1 < 1 ? sqrt(r1)-1 : 1-sqrt(2-r1);
+		double dy = r2 < 1 ? sqrt(r2)-1 : 1-sqrt(2-r2);
+		dir = cam->getRayDirection((x + dx)/(double)imgWidth, (y + dy)/(double)imgHeight);
+		origin = cam->position;
+
+		double focalDist = dofNear + (dofFar - dofNear) / 2.0;
+		if(!(distance > dofNear && distance < dofFar)) {
+			Vec3fa focalPoint = cam->position + dir * focalDist;
+			double blurMagnitude = (distance > focalDist ? distance - dofFar : dofNear - distance)/ focalDist;
+			double lensU, lensV;
+			getSample2D(SAMPLE_DIM_LENS, lensU, lensV);
+			origin = cam->position + Vec3fa(lensU, lensV, getSample1D(SAMPLE_DIM_LENS_DEPTH)) * blurMagnitude;
+			dir = focalPoint - origin;
+		}
+	}
+
+	void writePixel(int x, int y, Vec3fa color) {
 		int pi = (((imgHeight - y - 1) * imgWidth) + x) * 4;
 		pixels[pi + 0] = 255.0f * clip(color.x, 0.0f, 1.0f);
 		pixels[pi + 1] = 255.0f * clip(color.y, 0.0f, 1.0f);
@@ -173,43 +445,123 @@ struct Scene
 		progress = (y * imgWidth + x) / (1.0f * imgWidth * imgHeight);
 	}
 
-	double getAmbientOcclusion(Vec3fa point, Vec3fa dir, double &distance) {
+	void writeAOGuide(int x, int y, double distance, Vec3fa normal) {
+		if(!aoGuide)
+			return;
+		float *g = aoGuide + (((imgHeight - y - 1) * imgWidth) + x) * AO_GUIDE_CHANNELS;
+		g[0] = distance;
+		g[1] = normal.x;
+		g[2] = normal.y;
+		g[3] = normal.z;
+	}
+
+	double getAmbientOcclusion(Vec3fa point, Vec3fa dir, double &distance, Vec3fa &normal) {
 		RTCRay ray = getIntersection(sgScene, point, dir, 5000.0, 0xFFFF0000);
 		distance = ray.tfar;
+		normal = Vec3fa(0.0f);
 
 		if (ray.geomID != RTC_INVALID_GEOMETRY_ID && (int)ray.geomID < (int)meshes.size()) {
 			Vec3fa n = meshes[ray.geomID]->getInterpolatedNormal(ray.primID, ray.u, ray.v);
 			n = n.normalize();
+			normal = n;
 			Vec3fa hitPoint = getHitPoint(ray);
 			if(!meshes[ray.geomID]->material.hasLighting)
 				return 1.0;
 
 			int hitCount = 0;
 			for (int i = 0; i < samplesAO; ++i) {
-				Vec3fa nd = sampleAroundNormal(n);
+				Vec3fa nd = sampleAroundNormal(n, SAMPLE_DIM_AO, i);
 				RTCRay ray = getOcclusion(sgScene, hitPoint, nd, 7.5f);
 				if(ray.geomID == 0)
 					hitCount++;
 			}
 
-			double ambience = 1.0f - (hitCount/(double)samplesAO);
-			return (minAOBrightness + ambience * (1.0f - minAOBrightness));
+			return getAmbientOcclusionFromHits(hitCount);
 		}
 
 		return 0;
 	}
 
+	double getAmbientOcclusionFromHits(int hitCount) {
+		double ambience = 1.0f - (hitCount/(double)samplesAO);
+		return (minAOBrightness + ambience * (1.0f - minAOBrightness));
+	}
+
+	template<typename RTCRayN, int N>
+	void getAmbientOcclusionPacket(const RTCRayN &primary, const int* valid, const int* px, const int* py, double* ao, Vec3fa* normals) {
+		ALIGN(64) RTCRayN occlusionRays;
+		ALIGN(64) int occlusionValid[N];
+		int owner[N], hitCount[N];
+		bool hasSamples[N];
+		int lanes = 0;
+
+		for (int i = 0; i < N; i++) {
+			ao[i] = 0.0;
+			normals[i] = Vec3fa(0.0f);
+			hitCount[i] = 0;
+			hasSamples[i] = false;
+		}
+
+		for (int i = 0; i < N; i++) {
+			RTCRay ray = getPacketRay(primary, i);
+			if(!valid[i] || ray.geomID == RTC_INVALID_GEOMETRY_ID || (int)ray.geomID >= (int)meshes.size())
+				continue;
+
+			Vec3fa n = meshes[ray.geomID]->getInterpolatedNormal(ray.primID, ray.u, ray.v);
+			n = n.normalize();
+			normals[i] = n;
+			if(!meshes[ray.geomID]->material.hasLighting) {
+				ao[i] = 1.0;
+				continue;
+			}
+
+			Vec3fa hitPoint = getHitPoint(ray);
+			hasSamples[i] = true;
+			setSamplerPixel(px[i], py[i], 0, frame);
+
+			for (int s = 0; s < samplesAO; ++s) {
+				setPacketRay(occlusionRays, lanes, hitPoint, sampleAroundNormal(n, SAMPLE_DIM_AO, s), 7.5f);
+				owner[lanes++] = i;
+				if(lanes == N) {
+					traceAmbientOcclusionPacket<RTCRayN, N>(occlusionRays, occlusionValid, owner, lanes, hitCount);
+					lanes = 0;
+				}
+			}
+		}
+		if(lanes > 0)
+			traceAmbientOcclusionPacket<RTCRayN, N>(occlusionRays, occlusionValid, owner, lanes, hitCount);
+
+		for (int i = 0; i < N; i++)
+			if(hasSamples[i])
+				ao[i] = getAmbientOcclusionFromHits(hitCount[i]);
+	}
+
+	template<typename RTCRayN, int N>
+	void traceAmbientOcclusionPacket(RTCRayN &rays, int* valid, const int* owner, int count, int* hitCount) {
+		for (int i = 0; i < N; i++)
+			valid[i] = (i < count) ? -1 : 0;
+
+		getOcclusionPacket<RTCRayN, N>(sgScene, valid, rays);
+		for (int i = 0; i < count; i++)
+			if(rays.geomID[i] == 0)
+				hitCount[owner[i]]++;
+	}
+
 	Vec3fa getRadiance(Vec3fa point, Vec3fa dir, int depth, int E = 1) {
 		RTCRay ray = getIntersection(sgScene, point, dir, 5000.0f, 0xFFFF0000);
+		return shadeRay(ray, point, dir, depth, E);
+	}
+
+	Vec3fa shadeRay(RTCRay ray, Vec3fa point, Vec3fa dir, int depth, int E = 1) {
 		Vec3fa color = Vec3fa(0.0f);
 
 		if (ray.geomID != RTC_INVALID_GEOMETRY_ID && (int)ray.geomID < (int)meshes.size()) {
 			Vec3fa uv = meshes[ray.geomID]->getInterpolatedUV(ray.primID, ray.u, ray.v);
-			Vec3fa faceColor = meshes[ray.geomID]->getColor(uv.x, uv.y);
+			Vec3fa faceColor = meshes[ray.geomID]->getColor(uv.x, uv.y, getTextureFootprint(ray, dir, E));
 			color = faceColor;
 
 			Vec3fa backColor = Vec3fa(0.0);
-			double alpha = meshes[ray.geomID]->getAlpha(uv.x, uv.y);
+			sgrtreal alpha = meshes[ray.geomID]->getAlpha(uv.x, uv.y);
 			if(alpha < 1.0) {
 				backColor = getRadiance(getHitPoint(ray), dir, depth);
 				faceColor = faceColor * alpha + backColor * (1.0 - alpha);
@@ -226,10 +578,10 @@ struct Scene
 				}
 			}
 
-			double refraction = meshes[ray.geomID]->material.refraction;
-			double reflection = meshes[ray.geomID]->material.reflection;
+			sgrtreal refraction = meshes[ray.geomID]->material.refraction;
+			sgrtreal reflection = meshes[ray.geomID]->material.reflection;
 
-			double p = (faceColor.x > faceColor.y && faceColor.x > faceColor.z) ? faceColor.x : (faceColor.y > faceColor.z ? faceColor.y : faceColor.z);
+			sgrtreal p = (faceColor.x > faceColor.y && faceColor.x > faceColor.z) ? faceColor.x : (faceColor.y > faceColor.z ? faceColor.y : faceColor.z);
 			if(reflection > 0.0 || refraction > 0.0)
 				p = 1.0;
 
@@ -241,14 +593,15 @@ struct Scene
 
 			if(meshes[ray.geomID]->material.emission == 0.0 && reflection != 1.0 && refraction != 1.0) {
 				Vec3fa nl = n.dot(dir) < 0.0 ? n : n * -1.0;
-				Vec3fa nd = sampleAroundNormal(nl);
+				Vec3fa nd = sampleAroundNormal(nl, getBounceDimension(depth, BOUNCE_DIM_DIFFUSE));
 
 				Vec3fa recursiveRadiance = Vec3fa(0.0f);
-				if(depth <= 3 || reflection > 0 || refraction > 0)
-					recursiveRadiance = getRadiance(point, nd, depth+1, 0);
-
 				Vec3fa lightsContrib = Vec3fa(0.0f);
-				lightsContrib = getLightContribution(ray, nl);
+				bool hasBsdfSample = (depth <= 3 || reflection > 0 || refraction > 0);
+				if(hasBsdfSample)
+					recursiveRadiance = getBounceRadiance(getHitPoint(ray), nl, nd, depth+1);
+
+				lightsContrib = getLightContribution(ray, nl, depth, hasBsdfSample);
 
 				color = meshes[ray.geomID]->getEmissionColor() * E + faceColor * (lightsContrib + recursiveRadiance);
 			}
@@ -264,52 +617,131 @@ struct Scene
 		return color;
 	}
 
-	Vec3fa getLightContribution(RTCRay preRay, Vec3fa normal) {
+	/// Ray cone width at the hit converted to UV units. Rays that come from
+	/// a diffuse bounce (E == 0) get a wide cone and read coarse mip levels.
+	sgrtreal getTextureFootprint(RTCRay ray, Vec3fa dir, int E) {
+		SGRTMesh *mesh = meshes[ray.geomID];
+		if(!mesh->material.hasTexture)
+			return 0.0;
+
+		sgrtreal coneWidth = ray.tfar * sqrt(dir.dot(dir)) * ((E == 0) ? DIFFUSE_CONE_SPREAD : pixelSpreadAngle);
+		Vec3fa ng = Vec3fa(ray.Ng[0], ray.Ng[1], ray.Ng[2]);
+		sgrtreal cosine = fabs(ng.normalize().dot(dir.normalize()));
+		return mesh->getTextureFootprint(ray.primID, coneWidth, cosine);
+	}
+
+	/// Direct light at the hit. Area lights are sampled by surface point and,
+	/// when the caller also traced a diffuse bounce, weighted against that
+	/// bounce hitting the light with the power heuristic.
+	Vec3fa getLightContribution(RTCRay preRay, Vec3fa normal, int depth, bool hasBsdfSample) {
 		Vec3fa point = getHitPoint(preRay);
 		Vec3fa lightsContrib = Vec3fa(0.0);
 
-		for (int i = 0; i < meshes.size(); i++) {
-			if(meshes[i]->material.emission > 0.0) {
-				if(meshes[i]->material.lightType < 1) {
-					Vec3fa lightPoint = meshes[i]->getRandomPointInMesh();
-					Vec3fa rayDir = (lightPoint - point).normalize();
-					double dist = lightPoint.distance(point);
-					RTCRay ray = getOcclusion(sgScene, point, rayDir, dist, 0xFFFF0000);
-
-					double distanceEffect = 1.0 - ray.tfar / (meshes[i]->material.emission * 999.0);
-
-					if(ray.geomID != 0)
-						lightsContrib = lightsContrib + meshes[i]->getEmissionColor() * rayDir.dot(normal) * distanceEffect;
-				} else if(meshes[i]->material.lightType == 1) {
-					Vec3fa rayDir = ((meshes[i]->material.lightDirection * 5000.0) - point).normalize();
-					RTCRay ray = getOcclusion(sgScene, point, rayDir, 5000, 0xFFFF0000);
-					if(ray.geomID != 0)
-						lightsContrib = lightsContrib + meshes[i]->getEmissionColor() * rayDir.dot(normal);
-				}
-			}
+		for (int i = 0; i < lights.directionalLights.size(); i++) {
+			SGRTMesh *light = meshes[lights.directionalLights[i]];
+			Vec3fa rayDir = ((light->material.lightDirection * 5000.0) - point).normalize();
+			RTCRay ray = getOcclusion(sgScene, point, rayDir, 5000, 0xFFFF0000);
+			if(ray.geomID != 0)
+				lightsContrib = lightsContrib + light->getEmissionColor() * rayDir.dot(normal);
+		}
+
+		if(lights.areaLights.empty())
+			return lightsContrib;
+
+		if(lights.sampleAllAreaLights()) {
+			for (int i = 0; i < lights.areaLights.size(); i++)
+				lightsContrib = lightsContrib + getAreaLightContribution(i, point, normal, getLightDimension(depth, i), hasBsdfSample);
+		} else {
+			double selection, unused;
+			getSample2D(getBounceDimension(depth, BOUNCE_DIM_LIGHT_SELECT), selection, unused);
+
+			sgrtreal probability;
+			int i = lights.sampleAreaLight(selection, probability);
+			if(probability > 0.0)
+				lightsContrib = lightsContrib + getAreaLightContribution(i, point, normal, getLightDimension(depth, 0), hasBsdfSample) * (1.0 / probability);
 		}
 
 		return lightsContrib;
 	}
 
-	Vec3fa getReflection(Vec3fa point, Vec3fa normal, Vec3fa dir, double reflectionSharpness, int depth) {
+	Vec3fa getAreaLightContribution(int lightIndex, Vec3fa point, Vec3fa normal, int dimension, bool hasBsdfSample) {
+		double r1, r2, r3, unused;
+		getSample2D(dimension, r2, r3);
+		getSample2D(dimension + 1, r1, unused);
+
+		SGRTMesh *light = meshes[lights.areaLights[lightIndex]];
+		Vec3fa lightNormal;
+		Vec3fa lightPoint = light->getRandomPointOnSurface(r1, r2, r3, lightNormal);
+		Vec3fa rayDir = (lightPoint - point).normalize();
+		sgrtreal dist = lightPoint.distance(point);
+		RTCRay ray = getOcclusion(sgScene, point, rayDir, dist, 0xFFFF0000);
+
+		sgrtreal distanceEffect = 1.0 - ray.tfar / (light->material.emission * 999.0);
+
+		if(ray.geomID == 0)
+			return Vec3fa(0.0);
+
+		// Lights without area can only be reached this way and keep their full weight
+		sgrtreal weight = 1.0;
+		sgrtreal lightPdf = lights.getAreaLightPdf(meshes, lightIndex, point, lightPoint, lightNormal);
+		if(hasBsdfSample && lightPdf > 0.0)
+			weight = powerHeuristic(lightPdf, getCosinePdf(normal, rayDir));
+
+		return light->getEmissionColor() * rayDir.dot(normal) * distanceEffect * weight;
+	}
+
+	/// Traces the diffuse bounce from the hit once with emitters visible. An
+	/// area light hit is the counterpart of the light sample in
+	/// getAreaLightContribution and ends the path, any other hit is shaded
+	/// as bounce light.
+	Vec3fa getBounceRadiance(Vec3fa point, Vec3fa normal, Vec3fa dir, int depth) {
+		RTCRay ray = getIntersection(sgScene, point, dir, 5000.0f, lights.areaLights.empty() ? 0xFFFF0000 : 0xFFFFFFFF);
+		if(ray.geomID != RTC_INVALID_GEOMETRY_ID && (int)ray.geomID < (int)meshes.size() && meshes[ray.geomID]->material.emission > 0.0) {
+			int lightIndex = lights.getAreaLightIndex(ray.geomID);
+			if(lightIndex >= 0)
+				return getBsdfLightContribution(lightIndex, ray, point, normal, dir);
+
+			// Directional light meshes are never seen by bounce rays
+			ray = getIntersection(sgScene, point, dir, 5000.0f, 0xFFFF0000);
+		}
+		return shadeRay(ray, point, dir, depth, 0);
+	}
+
+	/// Emission of an area light hit by the diffuse bounce, weighted against
+	/// the light sample with the power heuristic.
+	Vec3fa getBsdfLightContribution(int lightIndex, RTCRay ray, Vec3fa point, Vec3fa normal, Vec3fa dir) {
+		SGRTMesh *light = meshes[ray.geomID];
+		Vec3fa lightPoint = point + dir * ray.tfar;
+		Vec3fa lightNormal = Vec3fa(ray.Ng[0], ray.Ng[1], ray.Ng[2]).normalize();
+		sgrtreal bsdfPdf = getCosinePdf(normal, dir);
+		sgrtreal lightPdf = lights.getAreaLightPdf(meshes, lightIndex, point, lightPoint, lightNormal);
+		if(bsdfPdf <= 0.0 || lightPdf <= 0.0)
+			return Vec3fa(0.0);
+
+		// Same integrand as the light sample, which returns it divided by lightPdf
+		sgrtreal distanceEffect = 1.0 - ray.tfar / (light->material.emission * 999.0);
+		sgrtreal solidAnglePdf = lightPdf / lights.getSelectionProbability(lightIndex);
+		return light->getEmissionColor() * normal.dot(dir) * distanceEffect * (solidAnglePdf / bsdfPdf) * powerHeuristic(bsdfPdf, lightPdf);
+	}
+
+	Vec3fa getReflection(Vec3fa point, Vec3fa normal, Vec3fa dir, sgrtreal reflectionSharpness, int depth) {
 		Vec3fa rayDir = dir - normal * 2.0f * normal.dot(dir);
-		rayDir = randomizeDirection(rayDir, (1.0 - reflectionSharpness));
+		rayDir = randomizeDirection(rayDir, (1.0 - reflectionSharpness), getBounceDimension(depth, BOUNCE_DIM_REFLECTION));
 		Vec3fa reflectionColor = Vec3fa(0.0f);
 
 		reflectionColor = getRadiance(point, rayDir, depth);
 	    return reflectionColor;
 	}
 
-	Vec3fa getRefraction(Vec3fa point, Vec3fa normal, Vec3fa dir, double reflectionSharpnes, int depth) {
+	Vec3fa getRefraction(Vec3fa point, Vec3fa normal, Vec3fa dir, sgrtreal reflectionSharpnes, int depth) {
 		Vec3fa nl = normal.dot(dir) < 0 ? normal : normal * -1.0;
-		double into = normal.dot(nl);
+		sgrtreal into = normal.dot(nl);
 
-		double refractiveIndexAir = 1;
-		double refractiveIndexGlass = 1.5;
-		double refractiveIndexRatio = into? refractiveIndexAir / refractiveIndexGlass : refractiveIndexGlass / refractiveIndexAir;
-		double cosI = dir.dot(nl);
-		double cos2t = 1 - refractiveIndexRatio * refractiveIndexRatio * (1 - cosI * cosI);
+		sgrtreal refractiveIndexAir = 1;
+		sgrtreal refractiveIndexGlass = 1.5;
+		sgrtreal refractiveIndexRatio = into? refractiveIndexAir / refractiveIndexGlass : refractiveIndexGlass / refractiveIndexAir;
+		sgrtreal cosI = dir.dot(nl);
+		sgrtreal cos2t = 1 - refractiveIndexRatio * refractiveIndexRatio * (1 - cosI * cosI);
 
 		if (cos2t < 0)
 			return getReflection(point, normal, dir, reflectionSharpnes, depth);
@@ -317,15 +749,15 @@ struct Scene
 		Vec3fa refractedDirection = dir * refractiveIndexRatio - normal * (into ? 1 : -1) * (cosI * refractiveIndexRatio + sqrt(cos2t));
 		refractedDirection = refractedDirection.normalize();
 
-		double a = refractiveIndexGlass - refractiveIndexAir;
-		double b = refractiveIndexGlass + refractiveIndexAir;
-		double R0 = a * a / (b * b);
-		double c = 1 - (into ? -cosI : refractedDirection.dot(normal));
-		double Re = R0 + (1 - R0) * c * c * c * c * c;
-		double Tr = 1 - Re;
-		double P =.25 + .5 * Re;
-		double RP = Re / P;
-		double TP = Tr / (1 - P);
+		sgrtreal a = refractiveIndexGlass - refractiveIndexAir;
+		sgrtreal b = refractiveIndexGlass + refractiveIndexAir;
+		sgrtreal R0 = a * a / (b * b);
+		sgrtreal c = 1 - (into ? -cosI : refractedDirection.dot(normal));
+		sgrtreal Re = R0 + (1 - R0) * c * c * c * c * c;
+		sgrtreal Tr = 1 - Re;
+		sgrtreal P =.25 + .5 * Re;
+		sgrtreal RP = Re / P;
+		sgrtreal TP = Tr / (1 - P);
 
 //		Vec3fa reflectionColor = getReflection(point, normal, dir, reflectionSharpnes, depth);
 		Vec3fa refractionColor = getRadiance(point, refractedDirection, depth);
@@ -346,24 +778,81 @@ struct Scene
 		imgWidth = width;
 		imgHeight = height;
 
-		ifstream data(fileName, ios::binary);
+		SGFDFile *frameFile = SGFDFile::mapFile(fileName);
+		if(frameFile) {
+			readCamera(frameFile->getHeader());
+			for (int i = 0; i < frameFile->getNodeCount(); i++)
+				meshes.push_back(new SGRTMesh(sgScene, frameFile, i));
+			frameFile->release();
+		} else {
+			ifstream data(fileName, ios::binary);
+			int nodeCount = readCamera(data);
+
+			for (int i = 0; i < nodeCount; i++) {
+				SGRTMesh* m = new SGRTMesh(sgScene, data);
+				meshes.push_back(m);
+			}
+			data.close();
+		}
+		lights.build(meshes);
+		rtcCommit(sgScene);
+		return true;
+	}
+
+	bool updateScene(const char* fileName, int width, int height) {
+		imgWidth = width;
+		imgHeight = height;
+		delete cam;
+		cam = NULL;
+
+		SGFDFile *frameFile = SGFDFile::mapFile(fileName);
+		if(frameFile) {
+			readCamera(frameFile->getHeader());
+			bool status = frameFile->getNodeCount() == (int)meshes.size();
+			for (int i = 0; i < meshes.size() && status; i++)
+				status = meshes[i]->updateMesh(sgScene, frameFile, i);
+			frameFile->release();
+			if(!status)
+				return false;
+		} else {
+			ifstream data(fileName, ios::binary);
+			int nodeCount = readCamera(data);
+			if(nodeCount != (int)meshes.size())
+				return false;
+
+			for (int i = 0; i < nodeCount; i++)
+				if(!meshes[i]->updateMesh(sgScene, data))
+					return false;
+			data.close();
+		}
+
+		lights.build(meshes);
+		rtcCommit(sgScene);
+		return true;
+	}
 
+	int readCamera(ifstream &data) {
 		Vec3fa cpos = readVec3fa(data);
-		cpos.x = -cpos.x;
-		Vec3fa cDir = (readVec3fa(data) - cpos).normalize();
+		Vec3fa target = readVec3fa(data);
 		Vec3fa camRot = readVec3fa(data);
 
 		double fov = readFloat(data);
-		// fov = 360;
-		cam = new Camera(cpos, camRot, cDir, fov, width, height);
-		int nodeCount = readShort(data);
+		createCamera(cpos, target, camRot, fov);
+		return readShort(data);
+	}
 
-		for (int i = 0; i < nodeCount; i++) {
-			SGRTMesh* m = new SGRTMesh(sgScene, data);
-			meshes.push_back(m);
-		}
-		rtcCommit(sgScene);
-		data.close();
+	void readCamera(const SGFDHeader *header) {
+		Vec3fa cpos = Vec3fa(header->cameraPosition[0], header->cameraPosition[1], header->cameraPosition[2]);
+		Vec3fa target = Vec3fa(header->cameraTarget[0], header->cameraTarget[1], header->cameraTarget[2]);
+		Vec3fa camRot = Vec3fa(header->cameraRotation[0], header->cameraRotation[1], header->cameraRotation[2]);
+		createCamera(cpos, target, camRot, header->cameraFov);
+	}
+
+	void createCamera(Vec3fa cpos, Vec3fa target, Vec3fa camRot, double fov) {
+		cpos.x = -cpos.x;
+		Vec3fa cDir = (target - cpos).normalize();
+		// fov = 360;
+		cam = new Camera(cpos, camRot, cDir, fov, imgWidth, imgHeight);
 	}
 
 };
@@ -4,17 +4,34 @@
 
 #include "common.h"
 #include <cstring>
+#include <pthread.h>
+
+std::string serverUrl = "https://www.iyan3dapp.com/appapi";
+
+pthread_once_t networkInitOnce = PTHREAD_ONCE_INIT;
+
+void initNetworkOnce() {
+	curl_global_init(CURL_GLOBAL_ALL);
+}
+
+/// curl_global_init is not thread safe and only has to run once per process.
+void initNetwork() {
+	pthread_once(&networkInitOnce, initNetworkOnce);
+}
 
 static size_t write_data(void *ptr, size_t size, size_t nmemb, void *stream) {
 	size_t written = fwrite(ptr, size, nmemb, (FILE *)stream);
 	return written;
 }
 
+/// Downloads into filePath.part and renames it, so a file that exists
+/// at filePath is always complete.
 bool downloadFile(const char* url, const char* filePath) {
-	curl_global_init(CURL_GLOBAL_ALL);
+	initNetwork();
 	CURL *curl = curl_easy_init();
 	if(curl) {
-		FILE *file = fopen(filePath, "wb");
+		std::string tempPath = std::string(filePath) + ".part";
+		FILE *file = fopen(tempPath.c_str(), "wb");
 		if(file) {
 			CURLcode res;
 			curl_easy_setopt(curl, CURLOPT_URL, url);
@@ -24,16 +41,15 @@ bool downloadFile(const char* url, const char* filePath) {
 	        curl_easy_setopt(curl, CURLOPT_FAILONERROR, true);
 			res = curl_easy_perform(curl);
 			fclose(file);
+			curl_easy_cleanup(curl);
 
-			if(res != CURLE_OK) {
-				remove(filePath);
+			if(res != CURLE_OK || rename(tempPath.c_str(), filePath) != 0) {
+				remove(tempPath.c_str());
 				return false;
 			}
-
-			curl_easy_strerror(res);
-			curl_easy_cleanup(curl);
 			return true;
 		}
+		curl_easy_cleanup(curl);
 		return false;
 	}
 
@@ -41,7 +57,7 @@ bool downloadFile(const char* url, const char* filePath) {
 }
 
 char* url_encode(const char* data) {
-	curl_global_init(CURL_GLOBAL_ALL);
+	initNetwork();
 	CURL *curl = curl_easy_init();
 	return curl_easy_escape(curl, data, strlen(data));
 }
@@ -52,7 +68,7 @@ bool uploadFile(const char* url, const char* filePath) {
 	struct curl_slist *headerlist = NULL;
 	static const char buf[] = "Expect:";
 
-	curl_global_init(CURL_GLOBAL_ALL);
+	initNetwork();
 
 	curl_formadd(&formpost, &lastptr, CURLFORM_COPYNAME, "video", CURLFORM_FILE, filePath, CURLFORM_END);
 	curl_formadd(&formpost, &lastptr, CURLFORM_COPYNAME, "filename", CURLFORM_COPYCONTENTS, filePath, CURLFORM_END);
@@ -0,0 +1,117 @@
+#ifndef SGFD_H_
+#define SGFD_H_
+
+#include "common.h"
+#include <sys/mman.h>
+#include "HeaderFiles/SGFrameData.h"
+
+/// Read only mapping of an indexed SGFD frame file. Meshes point their vertex,
+/// index, normal and uv arrays straight into the mapping and retain it for
+/// as long as they use it, so a static mesh can keep reading from the frame
+/// it was first loaded from.
+struct SGFDFile
+{
+	int references;
+	size_t size;
+	unsigned char *data;
+
+	SGFDFile(unsigned char *data_, size_t size_) {
+		references = 1;
+		data = data_;
+		size = size_;
+	}
+
+	~SGFDFile() {
+		munmap(data, size);
+	}
+
+	/// Returns NULL when the file is missing, not the current SGFD version,
+	/// truncated or indexes past a node's vertices, callers fall back to the
+	/// v1 stream reader in that case.
+	static SGFDFile* mapFile(const char* path) {
+		int fd = open(path, O_RDONLY);
+		if(fd < 0)
+			return NULL;
+
+		struct stat st;
+		if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SGFDHeader)) {
+			close(fd);
+			return NULL;
+		}
+
+		void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if(mapping == MAP_FAILED)
+			return NULL;
+
+		SGFDFile *file = new SGFDFile((unsigned char*)mapping, st.st_size);
+		if(!file->isValid()) {
+			delete file;
+			return NULL;
+		}
+		madvise(mapping, st.st_size, MADV_WILLNEED);
+		return file;
+	}
+
+	bool isValid() {
+		const SGFDHeader *header = getHeader();
+		if(header->magic != SGFD_MAGIC)
+			return false;
+
+		if(header->version != SGFD_VERSION) {
+			printf("Unsupported SGFD version %d\n", header->version);
+			return false;
+		}
+
+		if(header->nodeCount < 0 || getSGFDNodeTableEnd(header->nodeCount) > size) {
+			printf("Error: Truncated SGFD node table\n");
+			return false;
+		}
+
+		for (int i = 0; i < header->nodeCount; i++) {
+			const SGFDNodeEntry *node = getNode(i);
+			if(node->vertexCount < 0 || node->indexCount < 0 || node->indexCount % 3 != 0 || node->offset % SGFD_ALIGNMENT != 0 ||
+			   node->offset + getSGFDNodeLayout(node->vertexCount, node->indexCount).size > size) {
+				printf("Error: Invalid SGFD node %d\n", i);
+				return false;
+			}
+
+			// Embree and getTriangleVertex index the mapped vertices directly
+			const uint32_t *indices = (const uint32_t*)getNodeData(i, getSGFDNodeLayout(node->vertexCount, node->indexCount).indices);
+			for (int j = 0; j < node->indexCount; j++) {
+				if(indices[j] >= (uint32_t)node->vertexCount) {
+					printf("Error: SGFD node %d index %d out of range\n", i, j);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	const SGFDHeader* getHeader() {
+		return (const SGFDHeader*)data;
+	}
+
+	int getNodeCount() {
+		return getHeader()->nodeCount;
+	}
+
+	const SGFDNodeEntry* getNode(int index) {
+		return (const SGFDNodeEntry*)(data + sizeof(SGFDHeader)) + index;
+	}
+
+	const void* getNodeData(int index, uint64_t offset) {
+		return data + getNode(index)->offset + offset;
+	}
+
+	void retain() {
+		references++;
+	}
+
+	void release() {
+		if(--references == 0)
+			delete this;
+	}
+};
+
+#endif
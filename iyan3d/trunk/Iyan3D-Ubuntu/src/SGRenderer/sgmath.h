@@ -1,7 +1,16 @@
 
 #include <math.h>
 #include <vector>
+#include <xmmintrin.h>
+#include <pmmintrin.h>
 
+// The ray tracer uses 16 byte aligned single precision SSE vectors by
+// default. Build with -DSGRT_DOUBLE_PRECISION to get the scalar double
+// path back for reference comparisons.
+
+#ifdef SGRT_DOUBLE_PRECISION
+
+typedef double sgrtreal;
 
 struct Vec3fa
 {
@@ -105,15 +114,129 @@ struct Vec3fa
     }
 };
 
+#else
+
+typedef float sgrtreal;
+
+struct __attribute__((aligned(16))) Vec3fa
+{
+	union {
+		__m128 m128;
+		struct { float x, y, z, a; };
+	};
+
+	Vec3fa()
+	{
+		m128 = _mm_setzero_ps();
+	}
+
+	Vec3fa(__m128 m)
+	{
+		m128 = m;
+	}
+
+	Vec3fa(float a, float b, float c)
+	{
+		m128 = _mm_set_ps(0.0f, c, b, a);
+	}
+
+	Vec3fa(float a)
+	{
+		m128 = _mm_set_ps(0.0f, a, a, a);
+	}
+
+	Vec3fa normalize()
+	{
+		const float d = dot(*this);
+
+		if (d != 0.0f)
+			m128 = _mm_mul_ps(m128, _mm_set1_ps(1.0f / sqrtf(d)));
+
+		return *this;
+	}
+
+    float dot(const Vec3fa &b) const
+    {
+        __m128 p = _mm_mul_ps(m128, b.m128);
+        return _mm_cvtss_f32(p) + _mm_cvtss_f32(_mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1))) + _mm_cvtss_f32(_mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)));
+    }
+
+    float distance(const Vec3fa &b) const
+    {
+        Vec3fa d = *this - b;
+        return sqrtf(d.dot(d));
+    }
+
+    Vec3fa cross(const Vec3fa &b) const
+    {
+        __m128 a_yzx = _mm_shuffle_ps(m128, m128, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 b_yzx = _mm_shuffle_ps(b.m128, b.m128, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 c = _mm_sub_ps(_mm_mul_ps(m128, b_yzx), _mm_mul_ps(a_yzx, b.m128));
+        return Vec3fa(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+    }
+
+    Vec3fa operator+(const Vec3fa &b) const
+    {
+        return Vec3fa(_mm_add_ps(m128, b.m128));
+    }
+
+    Vec3fa operator-(const Vec3fa &b) const
+    {
+        return Vec3fa(_mm_sub_ps(m128, b.m128));
+    }
+
+    Vec3fa operator*(float b) const
+    {
+        return Vec3fa(_mm_mul_ps(m128, _mm_set1_ps(b)));
+    }
+
+    Vec3fa operator/(float b) const
+    {
+        return Vec3fa(_mm_mul_ps(m128, _mm_set1_ps(1.0f / b)));
+    }
+
+    Vec3fa operator*(const Vec3fa &b) const
+    {
+        return Vec3fa(_mm_mul_ps(m128, b.m128));
+    }
+
+    float& operator [] ( const size_t index )
+    {
+    	return (&x)[index];
+    }
+
+    Vec3fa neg() const
+    {
+    	return Vec3fa(_mm_sub_ps(_mm_setzero_ps(), m128));
+    }
+
+    float& Get(int i)
+    {
+        return (&x)[i];
+    }
+
+    Vec3fa getDirection()
+    {
+        float d2r = M_PI / 180.0f;
+        Vec3fa dir;
+        dir.x = cosf(x * d2r) * sinf(y * d2r);
+        dir.y = sinf(x * d2r) * sinf(y * d2r);
+        dir.z =                 cosf(y * d2r);
+        return dir;
+    }
+};
+
+#endif
+
 Vec3fa face_forward(const Vec3fa& N, const Vec3fa& I, const Vec3fa& _Ng) 
 {
 	const Vec3fa Ng = _Ng;
 	return I.dot(Ng) < 0.0f ? N : N.neg();
 }
 
-double getAngle(Vec3fa a, Vec3fa b) {
-    double dotValue = a.dot(b);
-    double modA = sqrtf(a.dot(a));
-    double modB = sqrtf(b.dot(b));
+sgrtreal getAngle(Vec3fa a, Vec3fa b) {
+    sgrtreal dotValue = a.dot(b);
+    sgrtreal modA = sqrtf(a.dot(a));
+    sgrtreal modB = sqrtf(b.dot(b));
     return (dotValue/(modA * modB));
 }
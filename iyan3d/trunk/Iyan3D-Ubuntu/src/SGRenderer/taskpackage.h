@@ -0,0 +1,296 @@
+#ifndef TASKPACKAGE_H_
+#define TASKPACKAGE_H_
+
+#include "common.h"
+#include <map>
+#include <sys/mman.h>
+
+#define PACKAGE_READ_CHUNK (4 * 1024 * 1024)
+#define PACKAGE_SCENE_ENTRY "index.sgb"
+#define PACKAGE_PHYSICS_ENTRY "index.sgp"
+
+struct SGRTPackageEntry
+{
+	string name;
+	zip_uint64_t index;
+	zip_uint64_t size;
+	uint32_t crc;
+	bool hasCrc;
+	bool done;
+	bool failed;
+	bool extracted;
+	uint64_t hash;
+	string cachedObject;
+};
+
+/// Extracts a task archive into the current directory. index.sgb is
+/// extracted first so scene loading can start, the other entries are
+/// extracted in parallel on the shared ThreadPool, every pool thread
+/// reading through its own libzip handle. Entries are decompressed
+/// straight into a mapping of the output file. CRC and size only find a
+/// candidate in the asset cache, the entry is decompressed and compared
+/// with the cached object and linked from it when the bytes match, which
+/// saves writing the file.
+struct SGRTTaskPackage
+{
+	string archivePath;
+	vector<SGRTPackageEntry> entries;
+	map<string, int> entryIndex;
+	vector<struct zip*> archives;
+	pthread_mutex_t mutex;
+	pthread_cond_t entryDone;
+	bool isExtracting;
+
+	SGRTTaskPackage() {
+		isExtracting = false;
+		pthread_mutex_init(&mutex, NULL);
+		pthread_cond_init(&entryDone, NULL);
+	}
+
+	~SGRTTaskPackage() {
+		finish();
+		pthread_mutex_destroy(&mutex);
+		pthread_cond_destroy(&entryDone);
+	}
+
+	bool open(string path, int threadCount) {
+		archivePath = path;
+		int err;
+		// One handle per pool thread and one for the calling thread
+		for (int i = 0; i <= threadCount; i++) {
+			struct zip *za = zip_open(path.c_str(), ZIP_RDONLY, &err);
+			if(za == NULL) {
+				printf("Can't open zip archive\n");
+				closeArchives();
+				return false;
+			}
+			archives.push_back(za);
+		}
+
+		struct zip *za = archives.back();
+		for (zip_int64_t i = 0; i < zip_get_num_entries(za, 0); i++) {
+			struct zip_stat sb;
+			if(zip_stat_index(za, i, 0, &sb) != 0)
+				continue;
+
+			int len = strlen(sb.name);
+			if(len == 0)
+				continue;
+			makeParentDirectories(sb.name);
+			if(sb.name[len - 1] == '/') {
+				mkdir(sb.name, 0755);
+				continue;
+			}
+
+			SGRTPackageEntry entry;
+			entry.name = sb.name;
+			entry.index = i;
+			entry.size = sb.size;
+			entry.crc = sb.crc;
+			entry.hasCrc = (sb.valid & ZIP_STAT_CRC) != 0;
+			entry.done = entry.failed = entry.extracted = false;
+			entry.hash = 0;
+			entryIndex[entry.name] = entries.size();
+			entries.push_back(entry);
+		}
+		return true;
+	}
+
+	/// Archives may list nested files without entries for their directories.
+	static void makeParentDirectories(string name) {
+		for (size_t slash = name.find('/'); slash != string::npos; slash = name.find('/', slash + 1))
+			mkdir(name.substr(0, slash).c_str(), 0755);
+	}
+
+	void closeArchives() {
+		for (int i = 0; i < archives.size(); i++)
+			zip_discard(archives[i]);
+		archives.clear();
+	}
+
+	string getCacheKey(const SGRTPackageEntry &entry) {
+		char key[64];
+		snprintf(key, sizeof(key), "zip:%08x:%llu", entry.crc, (unsigned long long)entry.size);
+		return key;
+	}
+
+	bool extractEntry(struct zip *za, SGRTPackageEntry &entry) {
+		string tempPath = entry.name + ".part";
+		int fd = ::open(tempPath.c_str(), O_RDWR | O_TRUNC | O_CREAT, 0644);
+		if(fd < 0)
+			return false;
+
+		bool status = true;
+		entry.hash = 14695981039346656037ull;
+		if(entry.size > 0) {
+			struct zip_file *zf = zip_fopen_index(za, entry.index, 0);
+			unsigned char *data = NULL;
+			if(zf && ftruncate(fd, entry.size) == 0)
+				data = (unsigned char*)mmap(NULL, entry.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+			if(!zf || !data || data == MAP_FAILED) {
+				status = false;
+			} else {
+				zip_uint64_t offset = 0;
+				while(offset < entry.size) {
+					zip_int64_t len = zip_fread(zf, data + offset, min((zip_uint64_t)PACKAGE_READ_CHUNK, entry.size - offset));
+					if(len <= 0)
+						break;
+					entry.hash = SGRTAssetCache::hashContent(data + offset, len, entry.hash);
+					offset += len;
+				}
+				status = (offset == entry.size);
+				munmap(data, entry.size);
+			}
+			if(zf)
+				zip_fclose(zf);
+		}
+		close(fd);
+
+		if(!status || rename(tempPath.c_str(), entry.name.c_str()) != 0) {
+			printf("Failed to extract %s\n", entry.name.c_str());
+			remove(tempPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	/// True when the entry decompresses to exactly the bytes of objectPath.
+	bool matchesObject(struct zip *za, SGRTPackageEntry &entry, string objectPath) {
+		int fd = ::open(objectPath.c_str(), O_RDONLY);
+		if(fd < 0)
+			return false;
+		struct stat buffer;
+		if(fstat(fd, &buffer) != 0 || (zip_uint64_t)buffer.st_size != entry.size) {
+			close(fd);
+			return false;
+		}
+		if(entry.size == 0) {
+			close(fd);
+			return true;
+		}
+
+		unsigned char *object = (unsigned char*)mmap(NULL, entry.size, PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if(object == MAP_FAILED)
+			return false;
+
+		bool equal = false;
+		struct zip_file *zf = zip_fopen_index(za, entry.index, 0);
+		if(zf) {
+			vector<unsigned char> chunk(min((zip_uint64_t)PACKAGE_READ_CHUNK, entry.size));
+			zip_uint64_t offset = 0;
+			equal = true;
+			while(equal && offset < entry.size) {
+				zip_int64_t len = zip_fread(zf, &chunk[0], min((zip_uint64_t)chunk.size(), entry.size - offset));
+				if(len <= 0)
+					break;
+				equal = memcmp(&chunk[0], object + offset, len) == 0;
+				offset += len;
+			}
+			equal = equal && offset == entry.size;
+			zip_fclose(zf);
+		}
+		munmap(object, entry.size);
+		return equal;
+	}
+
+	void markDone(SGRTPackageEntry &entry, bool extracted, bool failed) {
+		pthread_mutex_lock(&mutex);
+		entry.extracted = extracted;
+		entry.failed = failed;
+		entry.done = true;
+		pthread_cond_broadcast(&entryDone);
+		pthread_mutex_unlock(&mutex);
+	}
+
+	class ExtractWorker : public ThreadPoolWorker {
+	private:
+		SGRTTaskPackage *package;
+		ThreadPool *pool;
+		int entry;
+	public:
+		ExtractWorker(SGRTTaskPackage* p_, ThreadPool* pool_, int e_) : package(p_), pool(pool_), entry(e_) { }
+
+		void operator()() {
+			SGRTPackageEntry &e = package->entries[entry];
+			struct zip *za = package->archives[pool->getCurrentThreadIndex()];
+			if(!e.cachedObject.empty() && package->matchesObject(za, e, e.cachedObject) && SGRTAssetCache::placeFile(e.cachedObject, e.name)) {
+				package->markDone(e, false, false);
+				return;
+			}
+			bool status = package->extractEntry(za, e);
+			package->markDone(e, status, !status);
+		}
+	};
+
+	/// Extracts name on the calling thread, false if it is not in the
+	/// archive or could not be written.
+	bool extract(string name) {
+		map<string, int>::iterator it = entryIndex.find(name);
+		if(it == entryIndex.end())
+			return false;
+		SGRTPackageEntry &entry = entries[it->second];
+		if(!entry.done) {
+			bool status = extractEntry(archives.back(), entry);
+			markDone(entry, status, !status);
+		}
+		return !entry.failed;
+	}
+
+	/// Looks up cache candidates and queues every entry on pool. Returns at
+	/// once, use waitForEntry or finish before reading the files.
+	void extractAll(ThreadPool &pool) {
+		SGRTAssetCache &cache = getAssetCache();
+		isExtracting = true;
+		for (int i = 0; i < entries.size(); i++) {
+			SGRTPackageEntry &entry = entries[i];
+			if(entry.done)
+				continue;
+
+			SGRTCachedAsset *asset = entry.hasCrc ? cache.getCachedAsset(getCacheKey(entry)) : NULL;
+			if(asset) {
+				asset->lastUsed = time(NULL);
+				entry.cachedObject = cache.getObjectPath(asset->hash);
+			}
+			pool.enqueueWork(new ExtractWorker(this, &pool, i));
+		}
+	}
+
+	/// Blocks until name is extracted when it is part of the archive.
+	/// Returns false only when the archive has it and extraction failed.
+	bool waitForEntry(string name) {
+		map<string, int>::iterator it = entryIndex.find(name);
+		if(it == entryIndex.end() || !isExtracting)
+			return true;
+
+		SGRTPackageEntry &entry = entries[it->second];
+		pthread_mutex_lock(&mutex);
+		while(!entry.done)
+			pthread_cond_wait(&entryDone, &mutex);
+		pthread_mutex_unlock(&mutex);
+		return !entry.failed;
+	}
+
+	/// Waits for the remaining entries and adds the extracted ones to the
+	/// asset cache. False if any entry failed.
+	bool finish() {
+		if(archives.empty())
+			return true;
+
+		bool status = true;
+		SGRTAssetCache &cache = getAssetCache();
+		for (int i = 0; i < entries.size(); i++) {
+			waitForEntry(entries[i].name);
+			status = status && !entries[i].failed;
+			if(entries[i].extracted && entries[i].hasCrc && entries[i].name != PACKAGE_SCENE_ENTRY)
+				cache.store(getCacheKey(entries[i]), entries[i].name, entries[i].hash, entries[i].size);
+		}
+		cache.saveIndex();
+		closeArchives();
+		isExtracting = false;
+		return status;
+	}
+};
+
+#endif
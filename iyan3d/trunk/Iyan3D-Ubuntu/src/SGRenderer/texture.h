@@ -3,110 +3,491 @@
 #define TEXTURE_H_
 
 #include "common.h"
+#include <map>
+#include <pthread.h>
 
 using namespace std;
 
+#define TEXTURE_TILE_SHIFT 4
+#define TEXTURE_TILE_SIZE (1 << TEXTURE_TILE_SHIFT)
+#define TEXTURE_TILE_MASK (TEXTURE_TILE_SIZE - 1)
+
+#define TEXTURE_CACHE_LOW_WATER 0.85
+
+size_t textureCacheBudget = 1024 * 1024 * 1024;
+size_t textureCacheResidentBytes = 0;
+int textureCacheFrame = 0;
+
+struct SGRTTextureLevel
+{
+	int width, height;
+	int tilesX, tilesY;
+	unsigned char *texels;
+
+	/// Texels are stored in TEXTURE_TILE_SIZE square RGBA8 tiles so a
+	/// bilinear lookup touches one or two cache lines instead of two rows.
+	void allocate(int width_, int height_) {
+		width = width_;
+		height = height_;
+		tilesX = (width + TEXTURE_TILE_MASK) >> TEXTURE_TILE_SHIFT;
+		tilesY = (height + TEXTURE_TILE_MASK) >> TEXTURE_TILE_SHIFT;
+		texels = new unsigned char[getMemorySize()];
+	}
+
+	size_t getMemorySize() const {
+		return (size_t)tilesX * tilesY * TEXTURE_TILE_SIZE * TEXTURE_TILE_SIZE * 4;
+	}
+
+	unsigned char* getTexel(int x, int y) const {
+		int tile = (y >> TEXTURE_TILE_SHIFT) * tilesX + (x >> TEXTURE_TILE_SHIFT);
+		int offset = ((y & TEXTURE_TILE_MASK) << TEXTURE_TILE_SHIFT) + (x & TEXTURE_TILE_MASK);
+		return texels + (((size_t)tile << (TEXTURE_TILE_SHIFT * 2)) + offset) * 4;
+	}
+
+	unsigned char* getWrappedTexel(int x, int y) const {
+		x %= width;
+		y %= height;
+		if(x < 0)
+			x += width;
+		if(y < 0)
+			y += height;
+		return getTexel(x, y);
+	}
+};
+
+/// A texture's resident levels, levels[0] is mip level firstLevel. Lookups
+/// read one snapshot, eviction swaps in a new one and retires the old.
+struct SGRTTextureMips
+{
+	int firstLevel;
+	vector<SGRTTextureLevel> levels;
+};
+
+/// Mips swapped out of a texture, freedLevels of its levels own texels no
+/// newer snapshot shares.
+struct SGRTRetiredMips
+{
+	unsigned long epoch;
+	SGRTTextureMips *mips;
+	int freedLevels;
+};
+
+/// The epoch a render thread's running texture lookup started in, 0 while
+/// the thread is not inside a lookup.
+struct SGRTTextureReader
+{
+	volatile unsigned long epoch;
+};
+
+pthread_mutex_t textureCacheMutex = PTHREAD_MUTEX_INITIALIZER;
+volatile unsigned long textureCacheEpoch = 1;
+vector<SGRTTextureReader*> textureReaders;
+vector<SGRTRetiredMips> retiredTextureMips;
+__thread SGRTTextureReader* textureReader = NULL;
+
+/// One record per thread for the life of the process, like the render
+/// pool's threads.
+SGRTTextureReader* getTextureReader() {
+	if(!textureReader) {
+		textureReader = new SGRTTextureReader();
+		textureReader->epoch = 0;
+		pthread_mutex_lock(&textureCacheMutex);
+		textureReaders.push_back(textureReader);
+		pthread_mutex_unlock(&textureCacheMutex);
+	}
+	return textureReader;
+}
+
+/// Texture levels are only read inside a scope, levels evicted meanwhile
+/// stay allocated until every scope that could still see them has ended.
+struct SGRTTextureReadScope
+{
+	SGRTTextureReader *reader;
+
+	SGRTTextureReadScope() {
+		reader = getTextureReader();
+		reader->epoch = textureCacheEpoch;
+		__sync_synchronize();
+	}
+
+	~SGRTTextureReadScope() {
+		__sync_synchronize();
+		reader->epoch = 0;
+	}
+};
+
+/// Frees retired mips no running lookup can still read, call with
+/// textureCacheMutex held.
+void freeRetiredTextureMips() {
+	unsigned long oldestEpoch = textureCacheEpoch;
+	for (int i = 0; i < textureReaders.size(); i++) {
+		unsigned long epoch = textureReaders[i]->epoch;
+		if(epoch && epoch < oldestEpoch)
+			oldestEpoch = epoch;
+	}
+
+	int kept = 0;
+	for (int i = 0; i < retiredTextureMips.size(); i++) {
+		SGRTRetiredMips &retired = retiredTextureMips[i];
+		if(retired.epoch >= oldestEpoch) {
+			retiredTextureMips[kept++] = retired;
+			continue;
+		}
+		for (int level = 0; level < retired.freedLevels; level++)
+			delete[] retired.mips->levels[level].texels;
+		delete retired.mips;
+	}
+	retiredTextureMips.resize(kept);
+}
+
+/// Call with textureCacheMutex held, after mips was swapped out.
+void retireTextureMips(SGRTTextureMips *mips, int freedLevels) {
+	SGRTRetiredMips retired = { textureCacheEpoch, mips, freedLevels };
+	retiredTextureMips.push_back(retired);
+	__sync_fetch_and_add(&textureCacheEpoch, 1);
+}
+
+struct SGRTTexture;
+void enforceTextureCacheBudget(SGRTTexture *loaded);
+
 struct SGRTTexture
 {
-	unsigned char *pngData;
+	string path;
 	unsigned int width, height;
+	int levelCount;
 	bool hasLoadedData;
+	SGRTTextureMips* volatile mips;
+	volatile int lastUsedFrame;
+	volatile int finestUsedLevel;
+	pthread_mutex_t loadMutex;
 
-	SGRTTexture(const char* path) {
-		hasLoadedData = false;
-		vector<unsigned char> image;
-		unsigned error = lodepng::decode(image, width, height, path);
-		if(!error) {
-			hasLoadedData = true;
-			pngData = new unsigned char[width * height * 4];
-			copy(image.begin(), image.end(), pngData);
+	SGRTTexture(const char* path_) {
+		path = path_;
+		width = height = 0;
+		levelCount = 0;
+		hasLoadedData = true;
+		mips = NULL;
+		lastUsedFrame = textureCacheFrame;
+		finestUsedLevel = INT_MAX;
+		pthread_mutex_init(&loadMutex, NULL);
+	}
+
+	~SGRTTexture() {
+		SGRTTextureMips *resident = mips;
+		if(resident) {
+			__sync_fetch_and_sub(&textureCacheResidentBytes, getMemorySize(resident));
+			for (int i = 0; i < resident->levels.size(); i++)
+				delete[] resident->levels[i].texels;
+			delete resident;
 		}
+		pthread_mutex_destroy(&loadMutex);
 	}
 
-	Vec3fa getColorAt(double u, double v, bool isSmoothTexture) {
-		if(!hasLoadedData) {
-			return Vec3fa(1.0, 1.0, 1.0);
+	/// The acquire keeps the reads of width, height and levelCount after the
+	/// load that found the texture resident.
+	SGRTTextureMips* getMips() {
+		return __atomic_load_n(&mips, __ATOMIC_ACQUIRE);
+	}
+
+	/// Returns mips holding level finestLevel, decoding the PNG and building
+	/// the mip chain when the texture was never hit or that level was
+	/// evicted. Call inside a SGRTTextureReadScope, NULL if the PNG is bad.
+	SGRTTextureMips* makeResident(int finestLevel) {
+		SGRTTextureMips *resident = getMips();
+		if(resident && resident->firstLevel <= finestLevel)
+			return resident;
+		if(!hasLoadedData)
+			return NULL;
+
+		bool hasLoaded = false;
+		pthread_mutex_lock(&loadMutex);
+		resident = mips;
+		if(hasLoadedData && !(resident && resident->firstLevel <= finestLevel)) {
+			vector<unsigned char> image;
+			unsigned decodedWidth, decodedHeight;
+			unsigned error = lodepng::decode(image, decodedWidth, decodedHeight, path.c_str());
+			hasLoadedData = !error && decodedWidth > 0 && decodedHeight > 0;
+			SGRTTextureMips *previous = resident;
+			resident = NULL;
+			if(hasLoadedData) {
+				width = decodedWidth;
+				height = decodedHeight;
+				resident = buildLevels(image);
+				levelCount = resident->levels.size();
+				__sync_fetch_and_add(&textureCacheResidentBytes, getMemorySize(resident));
+				hasLoaded = true;
+			}
+			__sync_synchronize();
+			mips = resident;
+			if(previous) {
+				__sync_fetch_and_sub(&textureCacheResidentBytes, getMemorySize(previous));
+				pthread_mutex_lock(&textureCacheMutex);
+				retireTextureMips(previous, previous->levels.size());
+				pthread_mutex_unlock(&textureCacheMutex);
+			}
 		}
-		while(u < 0.0 || u > 1.0) {
-			if(u < 0.0)
-				u = -u;
-			if(u > 1.0)
-				u = 1.0 - u;
+		pthread_mutex_unlock(&loadMutex);
+
+		if(hasLoaded)
+			enforceTextureCacheBudget(this);
+		return resident;
+	}
+
+	SGRTTextureMips* buildLevels(const vector<unsigned char> &image) {
+		SGRTTextureMips *built = new SGRTTextureMips();
+		built->firstLevel = 0;
+		vector<SGRTTextureLevel> &levels = built->levels;
+		levels.push_back(SGRTTextureLevel());
+		levels[0].allocate(width, height);
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				memcpy(levels[0].getTexel(x, y), &image[(y * width + x) * 4], 4);
+
+		while(levels.back().width > 1 || levels.back().height > 1) {
+			const SGRTTextureLevel &src = levels.back();
+			SGRTTextureLevel dst;
+			dst.allocate(max(1, src.width / 2), max(1, src.height / 2));
+			for (int y = 0; y < dst.height; y++) {
+				for (int x = 0; x < dst.width; x++) {
+					int x0 = min(x * 2, src.width - 1), x1 = min(x * 2 + 1, src.width - 1);
+					int y0 = min(y * 2, src.height - 1), y1 = min(y * 2 + 1, src.height - 1);
+					const unsigned char *a = src.getTexel(x0, y0), *b = src.getTexel(x1, y0);
+					const unsigned char *c = src.getTexel(x0, y1), *d = src.getTexel(x1, y1);
+					unsigned char *t = dst.getTexel(x, y);
+					for (int i = 0; i < 4; i++)
+						t[i] = (a[i] + b[i] + c[i] + d[i] + 2) >> 2;
+				}
+			}
+			levels.push_back(dst);
 		}
+		return built;
+	}
+
+	static size_t getMemorySize(const SGRTTextureMips *resident) {
+		size_t size = 0;
+		for (int i = 0; i < resident->levels.size(); i++)
+			size += resident->levels[i].getMemorySize();
+		return size;
+	}
+
+	size_t getMemorySize() const {
+		SGRTTextureMips *resident = mips;
+		return resident ? getMemorySize(resident) : 0;
+	}
 
-		while(v < 0.0 || v > 1.0) {
-			if(v < 0.0)
-				v = -v;
-			if(v > 1.0)
-				v = 1.0 - v;
+	/// Evicts every level finer than finestKept, the whole texture when no
+	/// level is kept. Call with textureCacheMutex held. A texture busy loading
+	/// is skipped.
+	void dropLevels(int finestKept) {
+		if(pthread_mutex_trylock(&loadMutex) != 0)
+			return;
+		SGRTTextureMips *resident = mips;
+		if(resident && resident->firstLevel < finestKept) {
+			int freedLevels = min(finestKept - resident->firstLevel, (int)resident->levels.size());
+			SGRTTextureMips *kept = NULL;
+			if(freedLevels < resident->levels.size()) {
+				kept = new SGRTTextureMips();
+				kept->firstLevel = finestKept;
+				kept->levels.assign(resident->levels.begin() + freedLevels, resident->levels.end());
+			}
+			size_t freedSize = 0;
+			for (int i = 0; i < freedLevels; i++)
+				freedSize += resident->levels[i].getMemorySize();
+
+			__sync_synchronize();
+			mips = kept;
+			__sync_fetch_and_sub(&textureCacheResidentBytes, freedSize);
+			retireTextureMips(resident, freedLevels);
 		}
+		pthread_mutex_unlock(&loadMutex);
+	}
 
-		u = u * width - 0.5;
-		v = v * height - 0.5;
+	void release() {
+		dropLevels(INT_MAX);
+	}
+
+	/// Races between render threads only cost a reload of a level evicted
+	/// too early, never a read of a freed one.
+	void markUsed(int level) {
+		if(lastUsedFrame != textureCacheFrame) {
+			finestUsedLevel = level;
+			lastUsedFrame = textureCacheFrame;
+		} else if(level < finestUsedLevel)
+			finestUsedLevel = level;
+	}
+
+	sgrtreal wrapCoordinate(sgrtreal t) {
+		t = fabs(t);
+		if(t > 1.0)
+			t -= floor(t);
+		return t;
+	}
+
+	/// footprint is the width of the ray cone at the hit point in UV units,
+	/// zero samples the base level.
+	Vec3fa getColorAt(sgrtreal u, sgrtreal v, sgrtreal footprint, bool isSmoothTexture) {
+		SGRTTextureReadScope scope;
+		SGRTTextureMips *resident = getMips();
+		if(!resident && !(resident = makeResident(0))) {
+			return Vec3fa(1.0, 1.0, 1.0);
+		}
+		u = wrapCoordinate(u);
+		v = wrapCoordinate(v);
+
+		sgrtreal lod = (footprint > 0.0) ? log2(footprint * max(width, height)) : 0.0;
+		lod = clip(lod, 0.0, levelCount - 1);
+		int level = isSmoothTexture ? (int)lod : (int)(lod + 0.5);
+		markUsed(level);
+		if(level < resident->firstLevel && !(resident = makeResident(level))) {
+			return Vec3fa(1.0, 1.0, 1.0);
+		}
+
+		const vector<SGRTTextureLevel> &levels = resident->levels;
+		int index = level - resident->firstLevel;
+		if(!isSmoothTexture)
+			return readLevelColor(levels[index], u, v, false);
+
+		Vec3fa result = readLevelColor(levels[index], u, v, true);
+		sgrtreal levelBlend = lod - level;
+		if(levelBlend > 0.0 && index + 1 < levels.size())
+			result = result * (1.0 - levelBlend) + readLevelColor(levels[index + 1], u, v, true) * levelBlend;
+		return result;
+	}
+
+	/// Nearest or bilinear lookup shared by color and alpha, so both channels
+	/// of a hit read the same texels with the same weights.
+	template<typename T, T (SGRTTexture::*readTexel)(const SGRTTextureLevel&, int, int)>
+	T readLevel(const SGRTTextureLevel &level, sgrtreal u, sgrtreal v, bool isSmoothTexture) {
+		u = u * level.width - 0.5;
+		v = v * level.height - 0.5;
 
 		int x = floor(u);
 		int y = floor(v);
 
 		if(!isSmoothTexture)
-			return readImageColor(x, y);
+			return (this->*readTexel)(level, x, y);
 		else {
-			double u_ratio = u - x;
-			double v_ratio = v - y;
+			sgrtreal u_ratio = u - x;
+			sgrtreal v_ratio = v - y;
 
-			double u_opposite = 1 - u_ratio;
-			double v_opposite = 1 - v_ratio;
+			sgrtreal u_opposite = 1 - u_ratio;
+			sgrtreal v_opposite = 1 - v_ratio;
 
-			Vec3fa result = (readImageColor(x, y)   * u_opposite  + readImageColor(x+1, y)   * u_ratio) * v_opposite +
-							(readImageColor(x, y+1) * u_opposite  + readImageColor(x+1, y+1) * u_ratio) * v_ratio;
+			T result = ((this->*readTexel)(level, x, y)   * u_opposite  + (this->*readTexel)(level, x+1, y)   * u_ratio) * v_opposite +
+					   ((this->*readTexel)(level, x, y+1) * u_opposite  + (this->*readTexel)(level, x+1, y+1) * u_ratio) * v_ratio;
 			return result;
 		}
 	}
 
-	Vec3fa readImageColor(int x, int y) {
-		int cSize = 4;
-		int index = y * width * cSize + x * cSize;
-		double r = 0.0, g = 0.0, b = 0.0;
-		if(index > 0 && index + 3 < width * height * 4)
-        {
-			r = (double)pngData[index + 0] / 255.0;
-			g = (double)pngData[index + 1] / 255.0;
-			b = (double)pngData[index + 2] / 255.0;
-        }
-		return Vec3fa(r, g, b);
+	Vec3fa readLevelColor(const SGRTTextureLevel &level, sgrtreal u, sgrtreal v, bool isSmoothTexture) {
+		return readLevel<Vec3fa, &SGRTTexture::readImageColor>(level, u, v, isSmoothTexture);
 	}
 
-	double getAlphaAt(double u, double v) {
-		if(!hasLoadedData) {
-			return 0.0;
-		}
-		while(u < 0.0 || u > 1.0) {
-			if(u < 0.0)
-				u = -u;
-			if(u > 1.0)
-				u = 1.0 - u;
-		}
+	Vec3fa readImageColor(const SGRTTextureLevel &level, int x, int y) {
+		const unsigned char *texel = level.getWrappedTexel(x, y);
+		return Vec3fa(texel[0] / 255.0, texel[1] / 255.0, texel[2] / 255.0);
+	}
 
-		while(v < 0.0 || v > 1.0) {
-			if(v < 0.0)
-				v = -v;
-			if(v > 1.0)
-				v = 1.0 - v;
+	/// Alpha is tested against the base level, filtered like the color of the
+	/// same material.
+	sgrtreal getAlphaAt(sgrtreal u, sgrtreal v, bool isSmoothTexture) {
+		SGRTTextureReadScope scope;
+		markUsed(0);
+		SGRTTextureMips *resident = makeResident(0);
+		if(!resident) {
+			return 0.0;
 		}
+		u = wrapCoordinate(u);
+		v = wrapCoordinate(v);
 
-		u = u * width - 0.5;
-		v = v * height - 0.5;
-
-		return readImageAlpha(u, v);
+		return readLevel<sgrtreal, &SGRTTexture::readImageAlpha>(resident->levels[0], u, v, isSmoothTexture);
 	}
 
-	double readImageAlpha(int x, int y) {
-		int cSize = 4;
-		int index = y * width * cSize + x * cSize;
-		double a = 0.0;
-		if(index > 0 && index + 3 < width * height * 4)
-			a = (double)pngData[index + 3] / 255.0;
-		return a;
+	sgrtreal readImageAlpha(const SGRTTextureLevel &level, int x, int y) {
+		return level.getWrappedTexel(x, y)[3] / 255.0;
 	}
 };
 
+map<string, SGRTTexture*> textureCache;
+
+SGRTTexture* getCachedTexture(string path) {
+	map<string, SGRTTexture*>::iterator it = textureCache.find(path);
+	if(it != textureCache.end())
+		return it->second;
+
+	SGRTTexture* texture = new SGRTTexture(path.c_str());
+	textureCache[path] = texture;
+	return texture;
+}
+
+bool sortByLastUse(const SGRTTexture* lhs, const SGRTTexture* rhs) {
+	return lhs->lastUsedFrame < rhs->lastUsedFrame;
+}
+
+vector<SGRTTexture*> getResidentTextures(SGRTTexture *except) {
+	vector<SGRTTexture*> resident;
+	for (map<string, SGRTTexture*>::iterator it = textureCache.begin(); it != textureCache.end(); it++)
+		if(it->second != except && it->second->mips)
+			resident.push_back(it->second);
+	sort(resident.begin(), resident.end(), sortByLastUse);
+	return resident;
+}
+
+/// Runs after every load that takes the cache past textureCacheBudget, so a
+/// single frame's textures are held to the budget too. Whole textures the
+/// current frame has not touched go first, least recently used first, then
+/// levels finer than anything the frame sampled from a texture, which drops
+/// the base level of textures only seen through coarse mips. Levels the
+/// frame still reads stay resident, a working set larger than the budget is
+/// reported by trimTextureCache.
+void enforceTextureCacheBudget(SGRTTexture *loaded) {
+	if(textureCacheResidentBytes <= textureCacheBudget)
+		return;
+
+	pthread_mutex_lock(&textureCacheMutex);
+	vector<SGRTTexture*> resident = getResidentTextures(loaded);
+	size_t target = (size_t)(textureCacheBudget * TEXTURE_CACHE_LOW_WATER);
+	for (int i = 0; i < resident.size() && textureCacheResidentBytes > target; i++)
+		if(resident[i]->lastUsedFrame != textureCacheFrame)
+			resident[i]->release();
+	for (int i = 0; i < resident.size() && textureCacheResidentBytes > target; i++)
+		if(resident[i]->lastUsedFrame == textureCacheFrame)
+			resident[i]->dropLevels(resident[i]->finestUsedLevel);
+	freeRetiredTextureMips();
+	pthread_mutex_unlock(&textureCacheMutex);
+}
+
+/// Starts a new frame for the LRU order and releases the least recently
+/// used textures until the cache is back under TEXTURE_CACHE_LOW_WATER of
+/// textureCacheBudget, so a cache sitting at the budget is not trimmed again
+/// every frame. Call between frames: no lookup is running, so every retired
+/// level is freed here.
+void trimTextureCache() {
+	int finishedFrame = textureCacheFrame++;
+	pthread_mutex_lock(&textureCacheMutex);
+	if(textureCacheResidentBytes > textureCacheBudget) {
+		vector<SGRTTexture*> resident = getResidentTextures(NULL);
+		size_t target = (size_t)(textureCacheBudget * TEXTURE_CACHE_LOW_WATER);
+		for (int i = 0; i < resident.size() && textureCacheResidentBytes > target; i++) {
+			if(resident[i]->lastUsedFrame >= finishedFrame)
+				break;
+			resident[i]->release();
+		}
+	}
+	freeRetiredTextureMips();
+	pthread_mutex_unlock(&textureCacheMutex);
+
+	if(textureCacheResidentBytes > textureCacheBudget)
+		printf("Texture working set of %zu bytes exceeds the cache budget of %zu bytes\n", textureCacheResidentBytes, textureCacheBudget);
+}
+
+void clearTextureCache() {
+	for (map<string, SGRTTexture*>::iterator it = textureCache.begin(); it != textureCache.end(); it++)
+		delete it->second;
+	textureCache.clear();
+	pthread_mutex_lock(&textureCacheMutex);
+	freeRetiredTextureMips();
+	pthread_mutex_unlock(&textureCacheMutex);
+}
+
 #endif
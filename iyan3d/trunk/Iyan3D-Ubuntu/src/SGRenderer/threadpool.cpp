@@ -28,19 +28,23 @@ SOFTWARE.
 #include <stdio.h>
 #include <unistd.h>
 #include <assert.h>
+#include <sched.h>
 
 #include "threadpool.h"
 
-ThreadPool::ThreadPool(int _maxThreads)
+static __thread ThreadPool* currentPool = NULL;
+static __thread int currentThreadIndex = -1;
+
+ThreadPool::ThreadPool(int _maxThreads, bool _pinThreads)
 {
 	maxThreads = _maxThreads;
 	if (maxThreads < 1) maxThreads=1;
+	pinThreads = _pinThreads;
 
 	incompleteWork = 0;
 	requestThreadEnd = false;
-
-	if (pthread_mutex_init(&mutexQueue, NULL))
-		printf("ERROR: Error initializing mutexQueue\n");
+	idleThreads = 0;
+	nextDeque = 0;
 
 	if (pthread_mutex_init(&mutexWorkCompletion, NULL))
 		printf("ERROR: Error initializing mutexWorkCompletion\n");
@@ -51,6 +55,14 @@ ThreadPool::ThreadPool(int _maxThreads)
 	if (sem_init(&availableWork, 0, 0))
 		printf("ERROR: Error initializing availableWork\n");
 
+	deques.reserve(maxThreads);
+	for (int i = 0; i < maxThreads; ++i) {
+		WorkerDeque* workerDeque = new WorkerDeque();
+		if (pthread_mutex_init(&workerDeque->mutex, NULL))
+			printf("ERROR: Error initializing deque mutex\n");
+		deques.push_back(workerDeque);
+	}
+
 	initializeThreads();
 }
 
@@ -73,14 +85,18 @@ ThreadPool::~ThreadPool()
 	}
 	threads.clear();
 
-	// Delete remaining workers in the queue
-	while(!workerQueue.empty()) {
-		ThreadPoolWorker* worker = workerQueue.front();
-		workerQueue.pop();
-		delete worker;
+	// Delete remaining workers in the deques
+	for (size_t i = 0; i < deques.size(); ++i) {
+		while(!deques[i]->workers.empty()) {
+			ThreadPoolWorker* worker = deques[i]->workers.front();
+			deques[i]->workers.pop_front();
+			delete worker;
+		}
+		pthread_mutex_destroy(&deques[i]->mutex);
+		delete deques[i];
 	}
+	deques.clear();
 
-	pthread_mutex_destroy(&mutexQueue);
 	pthread_mutex_destroy(&mutexWorkCompletion);
 	pthread_cond_destroy(&incompleteWorkCond);
 
@@ -90,21 +106,53 @@ ThreadPool::~ThreadPool()
 void ThreadPool::initializeThreads()
 {
 	threads.reserve(maxThreads);
+	threadInfos.resize(maxThreads);
 	for (int i = 0; i < maxThreads; ++i) {
+		threadInfos[i].pool = this;
+		threadInfos[i].index = i;
+
 		pthread_t* thread = static_cast<pthread_t*>(::operator new(sizeof(pthread_t)));
 		int ret =  pthread_create(thread, NULL,
 					&ThreadPool::threadExecute,
-					static_cast<void*>(this) );
+					static_cast<void*>(&threadInfos[i]) );
 		if (ret) {
 			printf("ERROR: cannot create thread\n");
+			::operator delete(thread);
 			continue;
 		}
+		if (pinThreads)
+			pinThread(*thread, i);
 		threads.push_back(thread);
 	}
 }
 
+void ThreadPool::pinThread(pthread_t thread, int index)
+  /// Pin thread to the index-th CPU of the process affinity mask, wrapping
+  /// around when there are more threads than CPUs
+{
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) || CPU_COUNT(&allowed) == 0)
+		return;
+
+	int target = index % CPU_COUNT(&allowed);
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+		if (!CPU_ISSET(cpu, &allowed))
+			continue;
+		if (target-- == 0) {
+			cpu_set_t cpuSet;
+			CPU_ZERO(&cpuSet);
+			CPU_SET(cpu, &cpuSet);
+			if (pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet))
+				printf("WARNING: cannot pin thread %d to cpu %d\n", index, cpu);
+			return;
+		}
+	}
+}
+
 void ThreadPool::waitEnd()
 {
+	assert(currentPool != this);
 	pthread_mutex_lock(&mutexWorkCompletion);
 		while (incompleteWork > 0) {
 			pthread_cond_wait(&incompleteWorkCond, &mutexWorkCompletion);
@@ -114,54 +162,119 @@ void ThreadPool::waitEnd()
 
 bool ThreadPool::enqueueWork(ThreadPoolWorker* workerThread)
 {
-	pthread_mutex_lock(&mutexQueue);
-		assert(workerThread);
-		workerQueue.push(workerThread);
-		pthread_mutex_lock(&mutexWorkCompletion);
-			incompleteWork++;
-		pthread_mutex_unlock(&mutexWorkCompletion);
-	pthread_mutex_unlock(&mutexQueue);
+	assert(workerThread);
+	pthread_mutex_lock(&mutexWorkCompletion);
+		incompleteWork++;
+	pthread_mutex_unlock(&mutexWorkCompletion);
+
+	if (currentPool == this) {
+		// Split work stays with the thread that made it, others steal it
+		// from the front
+		WorkerDeque* workerDeque = deques[currentThreadIndex];
+		pthread_mutex_lock(&workerDeque->mutex);
+			workerDeque->workers.push_back(workerThread);
+		pthread_mutex_unlock(&workerDeque->mutex);
+	} else {
+		// The owner pops from the back, so pushing to the front keeps the
+		// enqueue order for every thread
+		WorkerDeque* workerDeque = deques[__sync_fetch_and_add(&nextDeque, 1) % maxThreads];
+		pthread_mutex_lock(&workerDeque->mutex);
+			workerDeque->workers.push_front(workerThread);
+		pthread_mutex_unlock(&workerDeque->mutex);
+	}
 
 	sem_post(&availableWork);
 
 	return true;
 }
 
-bool ThreadPool::fetchWork(ThreadPoolWorker** workerArg)
+bool ThreadPool::isStarving()
+{
+	int available = 0;
+	sem_getvalue(&availableWork, &available);
+	return idleThreads > available;
+}
+
+int ThreadPool::getCurrentThreadIndex() const
+{
+	return (currentPool == this) ? currentThreadIndex : -1;
+}
+
+bool ThreadPool::popWork(int index, ThreadPoolWorker** workerArg)
+{
+	WorkerDeque* workerDeque = deques[index];
+	bool found = false;
+	pthread_mutex_lock(&workerDeque->mutex);
+		if (!workerDeque->workers.empty()) {
+			*workerArg = workerDeque->workers.back();
+			workerDeque->workers.pop_back();
+			found = true;
+		}
+	pthread_mutex_unlock(&workerDeque->mutex);
+	return found;
+}
+
+bool ThreadPool::stealWork(int index, ThreadPoolWorker** workerArg)
+{
+	WorkerDeque* workerDeque = deques[index];
+	bool found = false;
+	pthread_mutex_lock(&workerDeque->mutex);
+		if (!workerDeque->workers.empty()) {
+			*workerArg = workerDeque->workers.front();
+			workerDeque->workers.pop_front();
+			found = true;
+		}
+	pthread_mutex_unlock(&workerDeque->mutex);
+	return found;
+}
+
+bool ThreadPool::fetchWork(int index, ThreadPoolWorker** workerArg)
   /// Block the current thread (on availableWork) until some work is available
   /// Writes the worker to workerArg and returns true
   /// If requestThreadEnd is true returns false
 {
+	__sync_fetch_and_add(&idleThreads, 1);
 	sem_wait(&availableWork);
+	__sync_fetch_and_sub(&idleThreads, 1);
 
 	if (requestThreadEnd) return false;
 
-	pthread_mutex_lock(&mutexQueue);
-		*workerArg = workerQueue.front();
-		workerQueue.pop();
-	pthread_mutex_unlock(&mutexQueue);
-
-	return true;
+	// Every successful sem_wait reserves one worker somewhere in the deques,
+	// so this only spins while another thread is between its own sem_wait
+	// and taking the worker it reserved
+	while (true) {
+		if (popWork(index, workerArg))
+			return true;
+
+		for (int i = 1; i < maxThreads; ++i) {
+			int victim = (index + i) % maxThreads;
+			if (stealWork(victim, workerArg))
+				return true;
+		}
+		sched_yield();
+	}
 }
 
-void* ThreadPool::threadExecute(void* _pool)
+void* ThreadPool::threadExecute(void* _info)
 {
 	ThreadPoolWorker* worker = NULL;
-	ThreadPool* pool = static_cast<ThreadPool*>(_pool);
+	ThreadInfo* info = static_cast<ThreadInfo*>(_info);
+	ThreadPool* pool = info->pool;
+	currentPool = pool;
+	currentThreadIndex = info->index;
 
-	while (pool->fetchWork(&worker)) {
+	while (pool->fetchWork(info->index, &worker)) {
 		assert(worker);
 		(*worker)();
 		delete worker;
 
 		pthread_mutex_lock(&(pool->mutexWorkCompletion));
 			pool->incompleteWork--; // This work unit is complete
+			if (pool->incompleteWork == 0) {
+				// incompleteWork reached 0: Signal waitEnd cond_wait
+				pthread_cond_broadcast(&(pool->incompleteWorkCond));
+			}
 		pthread_mutex_unlock(&(pool->mutexWorkCompletion));
-
-		if (pool->incompleteWork == 0) {
-			// incompleteWork reached 0: Signal waitEnd cond_wait
-			pthread_cond_signal(&(pool->incompleteWorkCond));
-		}
 	}
 
 	pthread_exit(NULL);
@@ -83,6 +83,20 @@ than the real number of cores is not necessarily a bad thing: if one of those
 threads blocks (by an I/O operation for example) another thread will take its
 CPU time to progress doing its work.
 
+== Scheduling
+
+Every OS thread owns a deque of workers. A thread takes work from the back of
+its own deque and, when that is empty, steals from the front of the other
+threads' deques, starting with its neighbours. Work enqueued from outside the
+pool is spread round robin over the deques, work enqueued from inside a
+worker goes to the deque of the thread running it. A worker can therefore
+split itself when `isStarving()` reports idle threads and keep the smaller
+part, so the tail of a batch is shared instead of left to a single thread.
+
+Threads can optionally be pinned to the CPUs the process is allowed to run
+on, thread i to the i-th allowed CPU. Neighbouring threads usually share a
+NUMA node, which is why stealing starts with the neighbours.
+
 == Thread Local Storage
 
 It is a common problem to need of a local variable to the thread this is usually
@@ -135,7 +149,7 @@ SOFTWARE.
 
 #include <pthread.h>
 #include <semaphore.h>
-#include <queue>
+#include <deque>
 #include <vector>
 
 class ThreadPoolWorker
@@ -152,61 +166,98 @@ public:
 
 
 class ThreadPool
-  /// ThreadPool class: holds a list of threads and a queue of workers
+  /// ThreadPool class: holds a list of threads, each with its own deque of
+  /// workers
   /// It provides two main operations:
   ///   enqueueWork(ThreadPoolWorker* worker)
   ///   waitEnd()
 {
 public:
-	explicit ThreadPool(int _maxThreads = 2);
+	explicit ThreadPool(int _maxThreads = 2, bool _pinThreads = false);
 	  /// Create the pool and all the synchronization primitives with 
-	  /// _maxTreads OS threads
+	  /// _maxTreads OS threads, pinned to one CPU each if _pinThreads
 
 	~ThreadPool();
 	  /// Delete all the associated resources
 
 	bool enqueueWork(ThreadPoolWorker* worker);
-	  /// Add worker to the queue, and start processing it
+	  /// Add worker to a deque, and start processing it
 	  /// ThreadPool takes ownership of the worker and will destroy it when
-	  /// finished
+	  /// finished. Can be called from inside a worker of this pool
 
 	void waitEnd();
-	  /// Wait until all workers have finished
+	  /// Wait until all workers have finished, including the ones enqueued
+	  /// by other workers. Must not be called from inside a worker
+
+	bool isStarving();
+	  /// True when more threads are waiting for work than there are workers
+	  /// queued, a hint for workers to split themselves
 
-	static void* threadExecute(void* _pool);
+	int getThreadCount() const { return maxThreads; }
+	  /// Number of OS threads
+
+	int getCurrentThreadIndex() const;
+	  /// Index of the calling pool thread or -1 when called from another
+	  /// thread
+
+	static void* threadExecute(void* _info);
 	  /// Static entry for threads (thread entry point)
 
 private:
+	struct WorkerDeque
+	{
+		pthread_mutex_t mutex;
+		std::deque<ThreadPoolWorker*> workers;
+	};
+
+	struct ThreadInfo
+	{
+		ThreadPool* pool;
+		int index;
+	};
+
 	int maxThreads;
 	  /// Number of OS threads
 
+	bool pinThreads;
+	  /// Pin every thread to one CPU
+
 	int incompleteWork;
 	  /// Number of UNFINISHED work units: this is NOT the number of items in
-	  /// the workerQueue
+	  /// the deques
 
-	bool requestThreadEnd;
+	volatile bool requestThreadEnd;
 	  /// Request thead workers to finish
 
+	volatile int idleThreads;
+	  /// Number of threads waiting on availableWork
+
+	unsigned int nextDeque;
+	  /// Round robin counter for work enqueued from outside the pool
+
 	std::vector<pthread_t*> threads;
 	  /// Collection of threads
 
-	std::queue<ThreadPoolWorker*> workerQueue;
-	  /// Job queue
+	std::vector<ThreadInfo> threadInfos;
+	  /// Start arguments of the threads
+
+	std::vector<WorkerDeque*> deques;
+	  /// One job deque per thread
 
 	pthread_mutex_t mutexWorkCompletion;
 	  /// Protects: incompleteWork
 
-	pthread_mutex_t mutexQueue;
-	  /// Protects: workerQueue
-
 	pthread_cond_t incompleteWorkCond;
 	  /// Signals: changes in incompleteWork
 
 	sem_t availableWork;
-	  /// Semaphore holding the number of work units available
+	  /// Semaphore holding the number of work units available in all deques
 
 	void initializeThreads();
-	bool fetchWork(ThreadPoolWorker** worker);
+	void pinThread(pthread_t thread, int index);
+	bool fetchWork(int index, ThreadPoolWorker** worker);
+	bool popWork(int index, ThreadPoolWorker** worker);
+	bool stealWork(int index, ThreadPoolWorker** worker);
 };
 
 #endif // __THREADPOOL_H_
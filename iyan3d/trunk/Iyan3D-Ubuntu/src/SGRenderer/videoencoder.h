@@ -1,4 +1,3 @@
-
 #ifndef VIDEO_H_
 #define VIDEO_H_
 
@@ -7,6 +6,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <deque>
 
 #ifdef HAVE_AV_CONFIG_H
 #undef HAVE_AV_CONFIG_H
@@ -14,147 +15,339 @@
 
 extern "C" {
 	#include "libavcodec/avcodec.h"
-	#include "libavutil/channel_layout.h"
-	#include "libavutil/common.h"
+	#include "libavformat/avformat.h"
 	#include "libavutil/imgutils.h"
-	#include "libavutil/mathematics.h"
-	#include "libavutil/samplefmt.h"
+	#include "libavutil/opt.h"
 	#include <libswscale/swscale.h>
 }
 
-bool video_encode(unsigned width, unsigned height, const char *fileName) {
-    printf("Video encoding\n");
-	avcodec_register_all();
-    AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_MPEG1VIDEO);
-    // AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_H264);
-    if (!codec) {
-        fprintf(stderr, "codec not found\n");
-        return false;
-    }
-
-    AVCodecContext *c = avcodec_alloc_context3(codec);
-    /* put sample parameters */
-    c->bit_rate = 400000;
-    c->width = width;
-    c->height = height;
-    c->time_base= (AVRational){1,24};
-    c->gop_size = 10; /* emit one intra frame every ten frames */
-    c->max_b_frames=1;
-    c->pix_fmt = AV_PIX_FMT_YUV420P;
-
-    // c = avcodec_alloc_context3(codec);
-    // c->bit_rate = 400000;
-    // c->width = width;                                        // resolution must be a multiple of two (1280x720),(1900x1080),(720x480)
-    // c->height = height;
-    // c->time_base.num = 1;                                   // framerate numerator
-    // c->time_base.den = 24;                                  // framerate denominator
-    // c->gop_size = 10;                                       // emit one intra frame every ten frames
-    // c->max_b_frames = 1;                                    // maximum number of b-frames between non b-frames
-    // c->keyint_min = 1;                                      // minimum GOP size
-    // c->i_quant_factor = (float)0.71;                        // qscale factor between P and I frames
-    // c->b_frame_strategy = 20;                               ///// find out exactly what this does
-    // c->qcompress = (float)0.6;                              ///// find out exactly what this does
-    // c->qmin = 20;                                           // minimum quantizer
-    // c->qmax = 51;                                           // maximum quantizer
-    // c->max_qdiff = 4;                                       // maximum quantizer difference between frames
-    // c->refs = 4;                                            // number of reference frames
-    // c->trellis = 1;                                         // trellis RD Quantization
-    // c->pix_fmt = PIX_FMT_YUV420P;                           // universal pixel format for video encoding
-    // c->codec_id = AV_CODEC_ID_H264;
-    // c->codec_type = AVMEDIA_TYPE_VIDEO;
-
-    if (avcodec_open2(c, codec, NULL) < 0) {
-        fprintf(stderr, "could not open codec\n");
-        return false;
-    }
-
-    FILE *f = fopen(fileName, "wb");
-    if (!f) {
-        fprintf(stderr, "could not open %s\n", fileName);
-        return false;
-    }
-
-    AVFrame *picture = av_frame_alloc();
-    int ret = av_image_alloc(picture->data, picture->linesize, c->width, c->height, c->pix_fmt, 32);
-    if (ret < 0) {
-        fprintf(stderr, "could not alloc raw picture buffer\n");
-        return false;
-    }
-
-	SwsContext *context = sws_getContext(c->width, c->height, AV_PIX_FMT_RGBA, c->width, c->height, AV_PIX_FMT_YUV420P, 0, 0, 0, 0);
-
-    picture->format = c->pix_fmt;
-    picture->width  = c->width;
-    picture->height = c->height;
-
-    AVPacket pkt;
-	int frame = 1;
-	string fn = to_string(frame);
-	struct stat buffer;   
-	int got_output;
-
-	while(stat((fn + "_render.png").c_str(), &buffer) == 0) {
-		printf("Encoding Frame: %d\n", frame-1);
-
-        av_init_packet(&pkt);
-        pkt.data = NULL;
-        pkt.size = 0;
-        fflush(stdout);
-
-		vector<unsigned char> image;
-		const char* path = (fn + "_render.png").c_str();
-		unsigned error = lodepng::decode(image, width, height, path);
-		if(error)
-			printf("decoder error %d : %s : %s\n", error, lodepng_error_text(error), path);
-		unsigned char *pngData = new unsigned char[width * height * 4];
-		copy(image.begin(), image.end(), pngData);
-		image.clear();
-
-
-		uint8_t *inData[1]     = { pngData };
-		int      inLinesize[1] = { 4 * (int)width };
-		sws_scale(context, inData, inLinesize, 0, c->height, picture->data, picture->linesize);
-
-        picture->pts = frame-1;
-        
-        ret = avcodec_encode_video2(c, &pkt, picture, &got_output);
-        if (ret < 0) {
-            fprintf(stderr, "error encoding frame\n");
-            return false;
-        }
-
-        if (got_output) {
-            printf("encoding frame %3d (size=%5d)\n", frame-1, pkt.size);
-            fwrite(pkt.data, 1, pkt.size, f);
-            av_packet_unref(&pkt);
-        }
-
-		frame++;
-		fn = to_string(frame);
+#define VIDEO_CONVERT_ROWS 64
+#define VIDEO_PREFETCH_FRAMES 4
+
+string videoCodec = "h264";
+int videoFrameRate = 24;
+int videoBitRate = 4000000;
+
+/// Streaming encoder: frames are handed over one at a time as RGBA rows
+/// (top row first, the layout of Scene::pixels and of decoded PNGs) and
+/// muxed into the container picked from the file extension. RGBA to
+/// YUV420P conversion runs in bands of VIDEO_CONVERT_ROWS rows on the
+/// shared ThreadPool, the codec itself runs with its own frame threads.
+struct SGRTVideoEncoder
+{
+	int width, height;
+	int64_t frameCount;
+	AVFormatContext *format;
+	AVCodecContext *codecContext;
+	AVStream *stream;
+	AVFrame *picture;
+	vector<SwsContext*> converters;
+
+	SGRTVideoEncoder() {
+		width = height = 0;
+		frameCount = 0;
+		format = NULL;
+		codecContext = NULL;
+		stream = NULL;
+		picture = NULL;
 	}
 
-	fflush(stdout);
-	ret = avcodec_encode_video2(c, &pkt, NULL, &got_output);
-	if (ret < 0) {
-		fprintf(stderr, "error encoding frame\n");
-		return false;
+	~SGRTVideoEncoder() {
+		release();
 	}
 
-	if (got_output) {
-		printf("encoding frame %3d (size=%5d)\n", frame, pkt.size);
-		fwrite(pkt.data, 1, pkt.size, f);
-		av_packet_unref(&pkt);
+	/// Tries videoCodec first and falls back to H.264 and MPEG-4 Part 2,
+	/// so a farm machine without x265 still produces a video.
+	static AVCodec* findEncoder() {
+		AVCodec *codec = NULL;
+		if(videoCodec == "hevc" || videoCodec == "h265")
+			codec = avcodec_find_encoder(AV_CODEC_ID_HEVC);
+		if(!codec)
+			codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+		if(!codec)
+			codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+		return codec;
 	}
 
-	uint8_t endcode[] = { 0, 0, 1, 0xb7 };
-    fwrite(endcode, 1, sizeof(endcode), f);
-    fclose(f);
+	bool open(const char *fileName, int width_, int height_) {
+		// YUV420P needs even dimensions
+		width = width_ & ~1;
+		height = height_ & ~1;
+		frameCount = 0;
 
-    avcodec_close(c);
-    av_free(c);
-    av_freep(&picture->data[0]);
-    av_frame_free(&picture);
-    return true;
-}
+		av_register_all();
+		avcodec_register_all();
+
+		AVCodec *codec = findEncoder();
+		if(!codec) {
+			fprintf(stderr, "No video encoder available\n");
+			return false;
+		}
+		printf("Encoding %dx%d video with %s\n", width, height, codec->name);
+
+		if(avformat_alloc_output_context2(&format, NULL, NULL, fileName) < 0 || !format) {
+			fprintf(stderr, "Could not create container for %s\n", fileName);
+			return false;
+		}
+
+		stream = avformat_new_stream(format, NULL);
+		codecContext = avcodec_alloc_context3(codec);
+		if(!stream || !codecContext) {
+			fprintf(stderr, "Could not allocate video stream\n");
+			return false;
+		}
+
+		codecContext->width = width;
+		codecContext->height = height;
+		codecContext->bit_rate = videoBitRate;
+		codecContext->time_base = (AVRational){1, videoFrameRate};
+		codecContext->framerate = (AVRational){videoFrameRate, 1};
+		codecContext->gop_size = videoFrameRate;
+		codecContext->max_b_frames = 2;
+		codecContext->pix_fmt = AV_PIX_FMT_YUV420P;
+		codecContext->thread_count = num_cores();
+		codecContext->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+		if(format->oformat->flags & AVFMT_GLOBALHEADER)
+			codecContext->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+		av_opt_set(codecContext->priv_data, "preset", "medium", 0);
+
+		if(avcodec_open2(codecContext, codec, NULL) < 0) {
+			fprintf(stderr, "Could not open codec %s\n", codec->name);
+			return false;
+		}
+
+		stream->time_base = codecContext->time_base;
+		avcodec_parameters_from_context(stream->codecpar, codecContext);
+
+		if(!(format->oformat->flags & AVFMT_NOFILE) && avio_open(&format->pb, fileName, AVIO_FLAG_WRITE) < 0) {
+			fprintf(stderr, "Could not open %s\n", fileName);
+			return false;
+		}
+
+		if(avformat_write_header(format, NULL) < 0) {
+			fprintf(stderr, "Could not write header of %s\n", fileName);
+			return false;
+		}
+
+		picture = av_frame_alloc();
+		picture->format = codecContext->pix_fmt;
+		picture->width = width;
+		picture->height = height;
+		if(av_frame_get_buffer(picture, 32) < 0) {
+			fprintf(stderr, "Could not allocate picture buffer\n");
+			return false;
+		}
+
+		for (int y = 0; y < height; y += VIDEO_CONVERT_ROWS) {
+			int rows = min(VIDEO_CONVERT_ROWS, height - y);
+			converters.push_back(sws_getContext(width, rows, AV_PIX_FMT_RGBA, width, rows, AV_PIX_FMT_YUV420P, SWS_BILINEAR, NULL, NULL, NULL));
+		}
+		return true;
+	}
+
+	class ConvertWorker : public ThreadPoolWorker {
+	private:
+		SGRTVideoEncoder *encoder;
+		const unsigned char *rgba;
+		int stride;
+		int band;
+	public:
+		ConvertWorker(SGRTVideoEncoder* e_, const unsigned char* rgba_, int stride_, int band_) : encoder(e_), rgba(rgba_), stride(stride_), band(band_) { }
+
+		void operator()() {
+			encoder->convertBand(rgba, stride, band);
+		}
+	};
+
+	/// Bands start on even rows, so every band owns whole chroma rows and
+	/// can be converted independently of its neighbours.
+	void convertBand(const unsigned char *rgba, int stride, int band) {
+		int y = band * VIDEO_CONVERT_ROWS;
+		const uint8_t *src[1] = { rgba + (size_t)y * stride };
+		int srcStride[1] = { stride };
+		uint8_t *dst[3] = {
+			picture->data[0] + y * picture->linesize[0],
+			picture->data[1] + (y / 2) * picture->linesize[1],
+			picture->data[2] + (y / 2) * picture->linesize[2]
+		};
+		sws_scale(converters[band], src, srcStride, 0, min(VIDEO_CONVERT_ROWS, height - y), dst, picture->linesize);
+	}
+
+	/// rgba must hold at least the encoder's width x height pixels with
+	/// rows stride bytes apart.
+	bool encodeFrame(const unsigned char *rgba, int stride) {
+		if(av_frame_make_writable(picture) < 0)
+			return false;
+
+		ThreadPool &pool = getThreadPool();
+		for (int band = 0; band < converters.size(); band++)
+			pool.enqueueWork(new ConvertWorker(this, rgba, stride, band));
+		pool.waitEnd();
+
+		picture->pts = frameCount++;
+		return writeFrame(picture);
+	}
+
+	bool writeFrame(AVFrame *frame) {
+		int gotOutput = 0;
+		do {
+			AVPacket pkt;
+			av_init_packet(&pkt);
+			pkt.data = NULL;
+			pkt.size = 0;
+
+			if(avcodec_encode_video2(codecContext, &pkt, frame, &gotOutput) < 0) {
+				fprintf(stderr, "Error encoding frame\n");
+				return false;
+			}
+
+			if(gotOutput) {
+				av_packet_rescale_ts(&pkt, codecContext->time_base, stream->time_base);
+				pkt.stream_index = stream->index;
+				int ret = av_interleaved_write_frame(format, &pkt);
+				av_packet_unref(&pkt);
+				if(ret < 0) {
+					fprintf(stderr, "Error writing frame\n");
+					return false;
+				}
+			}
+		} while(!frame && gotOutput);
+		return true;
+	}
+
+	/// Drains the delayed frames and writes the container trailer.
+	bool finish() {
+		if(!codecContext || !format)
+			return false;
+		bool status = writeFrame(NULL);
+		av_write_trailer(format);
+		printf("Encoded %d frames\n", (int)frameCount);
+		release();
+		return status;
+	}
+
+	void release() {
+		for (int i = 0; i < converters.size(); i++)
+			sws_freeContext(converters[i]);
+		converters.clear();
+		if(picture)
+			av_frame_free(&picture);
+		if(codecContext)
+			avcodec_free_context(&codecContext);
+		if(format) {
+			if(!(format->oformat->flags & AVFMT_NOFILE) && format->pb)
+				avio_closep(&format->pb);
+			avformat_free_context(format);
+		}
+		format = NULL;
+		stream = NULL;
+	}
+};
+
+struct SGRTVideoFrame
+{
+	int index;
+	unsigned width, height;
+	vector<unsigned char> rgba;
+};
+
+/// Fetches and decodes the frames of a video task on a separate thread
+/// and hands them to the encoder in order, at most VIDEO_PREFETCH_FRAMES
+/// ahead, so downloads and PNG decoding overlap with encoding.
+struct SGRTFramePrefetcher
+{
+	int startFrame, endFrame;
+	string (*getFramePath)(int frame);
+	bool (*fetchFrame)(int frame);
+	bool failed;
+	bool finished;
+	std::deque<SGRTVideoFrame*> frames;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t frameReady;
+	pthread_cond_t frameTaken;
+
+	SGRTFramePrefetcher(int start, int end, string (*path)(int), bool (*fetch)(int)) {
+		startFrame = start;
+		endFrame = end;
+		getFramePath = path;
+		fetchFrame = fetch;
+		failed = false;
+		finished = false;
+		pthread_mutex_init(&mutex, NULL);
+		pthread_cond_init(&frameReady, NULL);
+		pthread_cond_init(&frameTaken, NULL);
+		pthread_create(&thread, NULL, &SGRTFramePrefetcher::run, this);
+	}
+
+	~SGRTFramePrefetcher() {
+		pthread_mutex_lock(&mutex);
+		failed = true;
+		pthread_cond_broadcast(&frameTaken);
+		pthread_mutex_unlock(&mutex);
+		pthread_join(thread, NULL);
+
+		for (int i = 0; i < frames.size(); i++)
+			delete frames[i];
+		pthread_mutex_destroy(&mutex);
+		pthread_cond_destroy(&frameReady);
+		pthread_cond_destroy(&frameTaken);
+	}
+
+	static void* run(void *data) {
+		SGRTFramePrefetcher *prefetcher = (SGRTFramePrefetcher*)data;
+		for (int i = prefetcher->startFrame; i <= prefetcher->endFrame; i++) {
+			SGRTVideoFrame *frame = new SGRTVideoFrame();
+			frame->index = i;
+			bool loaded = prefetcher->fetchFrame(i);
+			if(loaded) {
+				string path = prefetcher->getFramePath(i);
+				unsigned error = lodepng::decode(frame->rgba, frame->width, frame->height, path.c_str());
+				if(error) {
+					printf("decoder error %d : %s : %s\n", error, lodepng_error_text(error), path.c_str());
+					loaded = false;
+				}
+			}
+
+			pthread_mutex_lock(&prefetcher->mutex);
+			while(prefetcher->frames.size() >= VIDEO_PREFETCH_FRAMES && !prefetcher->failed)
+				pthread_cond_wait(&prefetcher->frameTaken, &prefetcher->mutex);
+			bool stop = prefetcher->failed || !loaded;
+			if(!loaded)
+				prefetcher->failed = true;
+			if(stop)
+				delete frame;
+			else
+				prefetcher->frames.push_back(frame);
+			pthread_cond_broadcast(&prefetcher->frameReady);
+			pthread_mutex_unlock(&prefetcher->mutex);
+
+			if(stop)
+				break;
+		}
+
+		pthread_mutex_lock(&prefetcher->mutex);
+		prefetcher->finished = true;
+		pthread_cond_broadcast(&prefetcher->frameReady);
+		pthread_mutex_unlock(&prefetcher->mutex);
+		return NULL;
+	}
+
+	/// Returns frames in order, NULL after the last frame or once a frame
+	/// failed to download or decode. The caller owns the returned frame.
+	SGRTVideoFrame* nextFrame() {
+		pthread_mutex_lock(&mutex);
+		while(frames.empty() && !failed && !finished)
+			pthread_cond_wait(&frameReady, &mutex);
+		SGRTVideoFrame *frame = NULL;
+		if(!frames.empty()) {
+			frame = frames.front();
+			frames.pop_front();
+			pthread_cond_broadcast(&frameTaken);
+		}
+		pthread_mutex_unlock(&mutex);
+		return frame;
+	}
+};
 
 #endif
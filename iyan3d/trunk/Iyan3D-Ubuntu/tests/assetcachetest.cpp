@@ -0,0 +1,178 @@
+#include "common.h"
+#include <thread>
+#include <mutex>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) if(!(cond)) { printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; }
+
+struct TestResource {
+	string body;
+	string etag;
+};
+
+/// Minimal HTTP/1.1 server on a loopback port, one request per connection.
+/// Answers 304 when If-None-Match matches the resource's etag.
+struct TestServer {
+	int listenSocket;
+	int port;
+	std::thread thread;
+	std::mutex mutex;
+	map<string, TestResource> resources;
+	int fullResponses;
+	int notModifiedResponses;
+
+	TestServer() {
+		fullResponses = notModifiedResponses = 0;
+		listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+		sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = 0;
+		bind(listenSocket, (sockaddr*)&address, sizeof(address));
+		listen(listenSocket, 16);
+		socklen_t length = sizeof(address);
+		getsockname(listenSocket, (sockaddr*)&address, &length);
+		port = ntohs(address.sin_port);
+		thread = std::thread(&TestServer::run, this);
+	}
+
+	~TestServer() {
+		shutdown(listenSocket, SHUT_RDWR);
+		close(listenSocket);
+		thread.join();
+	}
+
+	void set(string path, string body, string etag) {
+		std::lock_guard<std::mutex> lock(mutex);
+		TestResource resource = { body, etag };
+		resources[path] = resource;
+	}
+
+	string getUrl(string path) {
+		return "http://127.0.0.1:" + to_string(port) + path;
+	}
+
+	void run() {
+		while(true) {
+			int client = accept(listenSocket, NULL, NULL);
+			if(client < 0)
+				return;
+			string request;
+			char buffer[1024];
+			while(request.find("\r\n\r\n") == string::npos) {
+				ssize_t received = recv(client, buffer, sizeof(buffer), 0);
+				if(received <= 0)
+					break;
+				request.append(buffer, received);
+			}
+			string response = respond(request);
+			send(client, response.data(), response.size(), MSG_NOSIGNAL);
+			close(client);
+		}
+	}
+
+	string respond(const string &request) {
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t pathStart = request.find(' ') + 1;
+		string path = request.substr(pathStart, request.find(' ', pathStart) - pathStart);
+		map<string, TestResource>::iterator it = resources.find(path);
+		if(it == resources.end())
+			return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+		string etag = "ETag: " + it->second.etag + "\r\n";
+		if(request.find("If-None-Match: " + it->second.etag + "\r\n") != string::npos) {
+			notModifiedResponses++;
+			return "HTTP/1.1 304 Not Modified\r\n" + etag + "Connection: close\r\n\r\n";
+		}
+		fullResponses++;
+		return "HTTP/1.1 200 OK\r\n" + etag + "Content-Length: " + to_string(it->second.body.size()) + "\r\nConnection: close\r\n\r\n" + it->second.body;
+	}
+};
+
+string readFile(string path) {
+	ifstream file(path.c_str(), ios::binary);
+	stringstream content;
+	content << file.rdbuf();
+	return content.str();
+}
+
+void writeFile(string path, string content) {
+	ofstream file(path.c_str(), ios::binary);
+	file << content;
+}
+
+bool fetchFresh(SGRTAssetCache &cache, string url, string filePath) {
+	remove(filePath.c_str());
+	return cache.fetch(url, filePath);
+}
+
+int main() {
+	curl_global_init(CURL_GLOBAL_ALL);
+	string root = "assetcachetest.cache";
+	string target = "assetcachetest.out";
+	system(("rm -rf " + root).c_str());
+
+	TestServer server;
+	server.set("/a", "alpha", "\"1\"");
+	server.set("/b", "bravo", "\"1\"");
+	server.set("/c", "shared", "\"1\"");
+	server.set("/d", "shared", "\"2\"");
+
+	{
+		SGRTAssetCache cache(root, 1024 * 1024);
+
+		CHECK(fetchFresh(cache, server.getUrl("/a"), target), "first fetch failed");
+		CHECK(readFile(target) == "alpha", "first fetch placed '%s'", readFile(target).c_str());
+		CHECK(server.fullResponses == 1, "%d full responses", server.fullResponses);
+
+		// A cached url is revalidated, an unchanged file is not sent again
+		CHECK(fetchFresh(cache, server.getUrl("/a"), target), "revalidated fetch failed");
+		CHECK(readFile(target) == "alpha", "revalidated fetch placed '%s'", readFile(target).c_str());
+		CHECK(server.notModifiedResponses == 1, "%d not modified responses", server.notModifiedResponses);
+		CHECK(server.fullResponses == 1, "%d full responses", server.fullResponses);
+
+		// A file changed on the server replaces the cached copy
+		server.set("/a", "alpha changed", "\"2\"");
+		CHECK(fetchFresh(cache, server.getUrl("/a"), target), "stale fetch failed");
+		CHECK(readFile(target) == "alpha changed", "stale fetch placed '%s'", readFile(target).c_str());
+		CHECK(cache.entries[server.getUrl("/a")].etag == "\"2\"", "etag '%s' not updated", cache.entries[server.getUrl("/a")].etag.c_str());
+
+		// An object with the same hash but other bytes is neither served nor overwritten
+		uint64_t hash = SGRTAssetCache::hashContent("bravo", 5, 14695981039346656037ull);
+		writeFile(cache.getObjectPath(hash), "other");
+		CHECK(fetchFresh(cache, server.getUrl("/b"), target), "colliding fetch failed");
+		CHECK(readFile(target) == "bravo", "colliding fetch placed '%s'", readFile(target).c_str());
+		CHECK(readFile(cache.getObjectPath(hash)) == "other", "colliding object overwritten");
+		CHECK(cache.entries.find(server.getUrl("/b")) == cache.entries.end(), "colliding url cached");
+
+		// Identical content under two urls is stored once
+		CHECK(fetchFresh(cache, server.getUrl("/c"), target), "fetch of /c failed");
+		CHECK(fetchFresh(cache, server.getUrl("/d"), target + "2"), "fetch of /d failed");
+		CHECK(cache.entries[server.getUrl("/c")].hash == cache.entries[server.getUrl("/d")].hash, "identical content stored twice");
+		remove((target + "2").c_str());
+
+		CHECK(!fetchFresh(cache, server.getUrl("/missing"), target), "missing url reported as fetched");
+		CHECK(!file_exists(target), "missing url left a file");
+	}
+
+	{
+		// Validators survive in the index for the next process
+		SGRTAssetCache cache(root, 1024 * 1024);
+		int notModified = server.notModifiedResponses;
+		CHECK(fetchFresh(cache, server.getUrl("/a"), target), "fetch after reload failed");
+		CHECK(readFile(target) == "alpha changed", "fetch after reload placed '%s'", readFile(target).c_str());
+		CHECK(server.notModifiedResponses == notModified + 1, "validators not reloaded from the index");
+	}
+
+	remove(target.c_str());
+	system(("rm -rf " + root).c_str());
+	curl_global_cleanup();
+
+	printf(failures ? "FAILED\n" : "OK\n");
+	return failures ? 1 : 0;
+}
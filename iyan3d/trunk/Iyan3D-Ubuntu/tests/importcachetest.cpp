@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <fstream>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Loaders/SceneImportCache.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...) if(!(cond)) { printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; }
+
+void writeFile(std::string path, std::string content) {
+	std::ofstream file(path.c_str(), std::ios::binary);
+	file << content;
+}
+
+/// One mesh with a single face of faceSize corners over four vertices.
+aiScene* makeScene(unsigned int faceSize) {
+	aiScene* scene = new aiScene();
+	scene->mRootNode = new aiNode();
+	scene->mMaterials = new aiMaterial*[1]();
+	scene->mMaterials[0] = new aiMaterial();
+	scene->mNumMaterials = 1;
+
+	aiMesh* mesh = new aiMesh();
+	mesh->mNumVertices = 4;
+	mesh->mVertices = new aiVector3D[4];
+	mesh->mNumFaces = 1;
+	mesh->mFaces = new aiFace[1];
+	mesh->mFaces[0].mNumIndices = faceSize;
+	mesh->mFaces[0].mIndices = new unsigned int[faceSize];
+	for (unsigned int i = 0; i < faceSize; i++)
+		mesh->mFaces[0].mIndices[i] = i;
+	scene->mMeshes = new aiMesh*[1];
+	scene->mMeshes[0] = mesh;
+	scene->mNumMeshes = 1;
+	return scene;
+}
+
+int main() {
+	std::string root = "importcachetest.dir";
+	system(("rm -rf " + root).c_str());
+	mkdir(root.c_str(), 0755);
+
+	std::string obj = root + "/box.obj";
+	writeFile(obj, "mtllib box.mtl\nv 0 0 0\nv 1 0 0\nv 0 1 0\nusemtl wood\nf 1 2 3\n");
+	writeFile(root + "/box.mtl", "newmtl wood\nKd 1 0 0\n");
+
+	// The same file and settings give the same key, other settings another one
+	uint64_t key = SceneImportCache::getImportKey(obj, 1, 1000, 4);
+	CHECK(key != 0, "no key for an existing file");
+	CHECK(SceneImportCache::getImportKey(obj, 1, 1000, 4) == key, "key not stable");
+	CHECK(SceneImportCache::getImportKey(obj, 2, 1000, 4) != key, "flags not in the key");
+
+	// Editing the material library alone invalidates the cache
+	writeFile(root + "/box.mtl", "newmtl wood\nKd 0 0 1\n");
+	uint64_t editedKey = SceneImportCache::getImportKey(obj, 1, 1000, 4);
+	CHECK(editedKey != key, "material library edit kept the key");
+
+	// A missing library falls back to <name>.mtl like assimp does
+	writeFile(obj, "mtllib other.mtl\nv 0 0 0\nv 1 0 0\nv 0 1 0\nusemtl wood\nf 1 2 3\n");
+	uint64_t fallbackKey = SceneImportCache::getImportKey(obj, 1, 1000, 4);
+	writeFile(root + "/box.mtl", "newmtl wood\nKd 0 1 0\n");
+	CHECK(SceneImportCache::getImportKey(obj, 1, 1000, 4) != fallbackKey, "fallback material library edit kept the key");
+	writeFile(root + "/other.mtl", "newmtl wood\nKd 0 1 0\n");
+	CHECK(SceneImportCache::getImportKey(obj, 1, 1000, 4) != fallbackKey, "created material library kept the key");
+
+	// Triangles round trip, other faces are never cached
+	aiScene* triangles = makeScene(3);
+	CHECK(SceneImportCache::write(obj, key, triangles), "triangle scene not written");
+	aiScene* cached = SceneImportCache::read(obj, key);
+	CHECK(cached && cached->mNumMeshes == 1 && cached->mMeshes[0]->mFaces[0].mNumIndices == 3, "triangle scene not read back");
+	CHECK(!SceneImportCache::read(obj, editedKey), "cache read with another key");
+	delete cached;
+	delete triangles;
+
+	remove(SceneImportCache::getCachePath(obj).c_str());
+	aiScene* quads = makeScene(4);
+	CHECK(!SceneImportCache::write(obj, key, quads), "quad scene written");
+	CHECK(access(SceneImportCache::getCachePath(obj).c_str(), F_OK) != 0, "quad scene left a cache");
+	CHECK(!SceneImportCache::read(obj, key), "quad scene read from cache");
+	delete quads;
+
+	system(("rm -rf " + root).c_str());
+
+	printf(failures ? "FAILED\n" : "OK\n");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+#include <stdio.h>
+
+#include "Core/Meshes/Mesh.h"
+
+bool common::supportsIndex32 = true;
+
+static int failures = 0;
+
+#define CHECK(cond, ...) if(!(cond)) { printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; }
+
+struct TestMesh : public Mesh {
+	using Mesh::loadedMeshBuffers;
+};
+
+/// A size x size vertex grid, two triangles per cell.
+void makeGrid(int size, vector<vertexData> &vertices, vector<unsigned int> &indices) {
+	vertices.resize(size * size);
+	for (int i = 0; i < size * size; i++)
+		vertices[i].vertPosition = Vector3(i % size, i / size, 0.0);
+	for (int y = 0; y + 1 < size; y++) {
+		for (int x = 0; x + 1 < size; x++) {
+			unsigned int corner = y * size + x;
+			unsigned int cell[] = { corner, corner + 1, corner + size, corner + 1, corner + size + 1, corner + size };
+			indices.insert(indices.end(), cell, cell + 6);
+		}
+	}
+}
+
+int main() {
+	vector<vertexData> vertices;
+	vector<unsigned int> indices;
+	makeGrid(300, vertices, indices);
+
+	TestMesh whole;
+	whole.addMeshBuffer(vertices, indices, 0);
+	CHECK(whole.getMeshBufferCount() == 1 && whole.isIndex32(0), "buffer not kept whole with 32 bit indices");
+
+	// Without 32 bit indices every triangle lands in a 16 bit buffer in the same order
+	common::supportsIndex32 = false;
+	TestMesh split;
+	split.addMeshBuffer(vertices, indices, 3);
+	CHECK(split.getMeshBufferCount() > 1, "%d buffers after split", split.getMeshBufferCount());
+	unsigned int indicesCount = 0;
+	int wrongBuffers = 0, wrongCorners = 0;
+	for (int mb = 0; mb < split.getMeshBufferCount(); mb++) {
+		if(split.isIndex32(mb) || split.getVerticesCountInMeshBuffer(mb) > MAX_VERTICES_COUNT || split.getMeshBufferMaterialIndices(mb) != 3)
+			wrongBuffers++;
+		for (unsigned int i = 0; i < split.getIndicesCount(mb); i++, indicesCount++) {
+			Vector3 position = split.getLiteVerticesForMeshBuffer(mb, split.getIndex(mb, i))->vertPosition;
+			if(indicesCount >= indices.size() || !(position == vertices[indices[indicesCount]].vertPosition))
+				wrongCorners++;
+		}
+	}
+	CHECK(wrongBuffers == 0, "%d buffers not 16 bit or too large", wrongBuffers);
+	CHECK(indicesCount == indices.size(), "%u of %u indices kept", indicesCount, (unsigned int)indices.size());
+	CHECK(wrongCorners == 0, "%d corners moved", wrongCorners);
+
+	// Every loaded vertex can be followed to its copies
+	CHECK(split.loadedMeshBuffers.size() == 1 && split.loadedMeshBuffers[0].vertexCopies.size() == vertices.size(), "split not recorded");
+	int wrongCopies = 0;
+	for (size_t v = 0; v < vertices.size(); v++) {
+		const vector<SplitVertex> &copies = split.loadedMeshBuffers[0].vertexCopies[v];
+		if(copies.empty())
+			wrongCopies++;
+		for (size_t c = 0; c < copies.size(); c++)
+			if(!(split.getLiteVerticesForMeshBuffer(copies[c].meshBufferIndex, copies[c].vertexIndex)->vertPosition == vertices[v].vertPosition))
+				wrongCopies++;
+	}
+	CHECK(wrongCopies == 0, "%d vertex copies wrong", wrongCopies);
+
+	// Buffers that fit 16 bits are left alone
+	TestMesh small;
+	vector<vertexData> smallVertices;
+	vector<unsigned int> smallIndices;
+	makeGrid(10, smallVertices, smallIndices);
+	small.addMeshBuffer(smallVertices, smallIndices, 0);
+	CHECK(small.getMeshBufferCount() == 1 && !small.isIndex32(0) && small.getIndicesCount(0) == smallIndices.size(), "small buffer changed");
+	CHECK(small.loadedMeshBuffers.size() == 1 && small.loadedMeshBuffers[0].vertexCopies.empty(), "small buffer recorded as split");
+
+	printf(failures ? "FAILED\n" : "OK\n");
+	return failures ? 1 : 0;
+}
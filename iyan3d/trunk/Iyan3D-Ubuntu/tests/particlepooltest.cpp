@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <set>
+
+#include "Core/Nodes/ParticlePool.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...) if(!(cond)) { printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; }
+
+void spawn(ParticlePool &pool, int index, float age) {
+	pool.live[index] = 1.0f;
+	pool.ages[index] = age;
+}
+
+int main() {
+	ParticlePool empty(0);
+	CHECK(empty.emit() == NOT_EXISTS, "empty pool emitted");
+	empty.step(0.0f, 10);
+
+	// Every slot is handed out once, a full pool refuses to emit
+	ParticlePool pool(4);
+	std::set<int> emitted;
+	for (int i = 0; i < 4; i++) {
+		int index = pool.emit();
+		CHECK(index >= 0 && index < 4, "emit returned %d", index);
+		emitted.insert(index);
+		spawn(pool, index, 0.0f);
+	}
+	CHECK(emitted.size() == 4, "%d distinct slots emitted", (int)emitted.size());
+	CHECK(pool.emit() == NOT_EXISTS, "full pool emitted");
+
+	// A particle dying out of ring order is reused while the ring head is still alive
+	pool.ages[2] = 10.0f;
+	pool.step(0.0f, 10);
+	CHECK(pool.live[2] == 0.0f, "expired particle still alive");
+	CHECK(pool.live[0] != 0.0f && pool.live[1] != 0.0f && pool.live[3] != 0.0f, "live particle killed");
+	CHECK(pool.emit() == 2, "dead slot not reused");
+	spawn(pool, 2, 0.0f);
+	CHECK(pool.emit() == NOT_EXISTS, "full pool emitted after reuse");
+
+	pool.killAll();
+	emitted.clear();
+	for (int i = 0; i < 4; i++)
+		emitted.insert(pool.emit());
+	CHECK(emitted.size() == 4 && !emitted.count(NOT_EXISTS), "slots not reused after killAll");
+
+	// Pools over several chunks step every particle once
+	int count = PARTICLE_CHUNK_SIZE * 3 + 17;
+	ParticlePool large(count);
+	for (int i = 0; i < count; i++) {
+		spawn(large, i, (i % 2) ? 0.0f : 5.0f);
+		large.velocityX[i] = 1.0f;
+	}
+	large.step(-0.5f, 5);
+	int wrong = 0;
+	for (int i = 0; i < count; i++) {
+		bool odd = i % 2;
+		if(large.positionX[i] != 1.0f || large.velocityY[i] != -0.5f || large.ages[i] != (odd ? 1.0f : 6.0f) || (large.live[i] != 0.0f) != odd)
+			wrong++;
+	}
+	CHECK(wrong == 0, "%d of %d particles stepped wrong", wrong, count);
+
+	printf(failures ? "FAILED\n" : "OK\n");
+	return failures ? 1 : 0;
+}
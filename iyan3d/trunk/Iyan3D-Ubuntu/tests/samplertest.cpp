@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+#include "sampler.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...) if(!(cond)) { printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; }
+
+/// Every elementary box of area 1 / 2^m must hold exactly one of the first
+/// 2^m points, for every split of m between u and v.
+bool isStratified(int dimension, int m) {
+	int count = 1 << m;
+	for (int uBits = 0; uBits <= m; uBits++) {
+		int vBits = m - uBits;
+		std::vector<int> cells(count, 0);
+		for (int i = 0; i < count; i++) {
+			double u, v;
+			getSample2D(dimension, i, u, v);
+			int cu = (int)(u * (1 << uBits));
+			int cv = (int)(v * (1 << vBits));
+			cells[(cu << vBits) | cv]++;
+		}
+		for (int c = 0; c < count; c++)
+			if(cells[c] != 1)
+				return false;
+	}
+	return true;
+}
+
+double correlation(const std::vector<double> &a, const std::vector<double> &b) {
+	double ma = 0, mb = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		ma += a[i];
+		mb += b[i];
+	}
+	ma /= a.size();
+	mb /= b.size();
+
+	double cov = 0, va = 0, vb = 0;
+	for (size_t i = 0; i < a.size(); i++) {
+		cov += (a[i] - ma) * (b[i] - mb);
+		va += (a[i] - ma) * (a[i] - ma);
+		vb += (b[i] - mb) * (b[i] - mb);
+	}
+	return cov / sqrt(va * vb);
+}
+
+int main() {
+	for (int pixel = 0; pixel < 4; pixel++) {
+		setSamplerPixel(pixel * 7, pixel * 3, 0, 0);
+		for (int dimension = 0; dimension < getBounceDimension(3, BOUNCE_DIM_COUNT); dimension++)
+			for (int m = 0; m <= 10; m++)
+				CHECK(isStratified(dimension, m), "pixel %d dimension %d not stratified at 2^%d", pixel, dimension, m);
+	}
+
+	// Light position and light selection are drawn for the same sample, their values must not move together
+	setSamplerPixel(11, 5, 0, 0);
+	int count = 1024;
+	std::vector<double> pointU(count), pointV(count), selectU(count), selectV(count);
+	for (int i = 0; i < count; i++) {
+		getSample2D(getBounceDimension(0, BOUNCE_DIM_LIGHT_POINT), i, pointU[i], pointV[i]);
+		getSample2D(getBounceDimension(0, BOUNCE_DIM_LIGHT_SELECT), i, selectU[i], selectV[i]);
+	}
+	CHECK(fabs(correlation(pointU, selectU)) < 0.1, "light point and select u correlated %f", correlation(pointU, selectU));
+	CHECK(fabs(correlation(pointV, selectV)) < 0.1, "light point and select v correlated %f", correlation(pointV, selectV));
+	CHECK(fabs(correlation(pointU, selectV)) < 0.1, "light point u and select v correlated %f", correlation(pointU, selectV));
+
+	// Each light sampled at a bounce draws its surface point from its own dimensions
+	std::vector<double> firstU(count), firstV(count), secondU(count), secondV(count);
+	for (int i = 0; i < count; i++) {
+		getSample2D(getLightDimension(0, 0), i, firstU[i], firstV[i]);
+		getSample2D(getLightDimension(0, 1), i, secondU[i], secondV[i]);
+	}
+	CHECK(fabs(correlation(firstU, secondU)) < 0.1, "light slots 0 and 1 correlated %f", correlation(firstU, secondU));
+	CHECK(fabs(correlation(firstV, secondV)) < 0.1, "light slots 0 and 1 correlated %f", correlation(firstV, secondV));
+	CHECK(getLightDimension(0, BOUNCE_LIGHT_SAMPLES - 1) + 1 < getBounceDimension(1, 0), "light dimensions overlap the next bounce");
+
+	// The order in which the two dimensions visit strata must differ, not only the offsets
+	int sameOrder = 0;
+	for (int i = 1; i < count; i++)
+		if((pointU[i] > pointU[i - 1]) == (selectU[i] > selectU[i - 1]))
+			sameOrder++;
+	CHECK(sameOrder > count / 4 && sameOrder < count * 3 / 4, "dimensions share their visiting order (%d of %d steps)", sameOrder, count);
+
+	// Streams depend on the pixel, not on the thread that renders it
+	double u1, v1, u2, v2;
+	setSamplerPixel(3, 4, 2, 1);
+	getSample2D(SAMPLE_DIM_LENS, u1, v1);
+	setSamplerPixel(3, 4, 2, 1);
+	getSample2D(SAMPLE_DIM_LENS, u2, v2);
+	CHECK(u1 == u2 && v1 == v2, "same pixel and sample gave different points");
+	setSamplerPixel(4, 4, 2, 1);
+	getSample2D(SAMPLE_DIM_LENS, u2, v2);
+	CHECK(u1 != u2 || v1 != v2, "neighbouring pixels share their points");
+
+	printf("%s\n", failures ? "FAILED" : "OK");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+#include "common.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...) if(!(cond)) { printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; }
+
+struct TestNode {
+	int vertexCount;
+	vector<uint32_t> indices;
+};
+
+/// Writes a frame with the given nodes, positions are filled with the node
+/// number so the reader's pointers can be checked.
+void writeFrame(const char* path, const vector<TestNode> &nodes, uint32_t version = SGFD_VERSION, uint64_t truncateBy = 0) {
+	SGFDHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = SGFD_MAGIC;
+	header.version = version;
+	header.nodeCount = nodes.size();
+
+	vector<SGFDNodeEntry> entries(nodes.size());
+	uint64_t offset = getSGFDNodeTableEnd(nodes.size());
+	for (size_t i = 0; i < nodes.size(); i++) {
+		memset(&entries[i], 0, sizeof(SGFDNodeEntry));
+		entries[i].vertexCount = nodes[i].vertexCount;
+		entries[i].indexCount = nodes[i].indices.size();
+		entries[i].offset = offset;
+		offset += getSGFDNodeLayout(entries[i].vertexCount, entries[i].indexCount).size;
+	}
+
+	vector<unsigned char> file(offset, 0);
+	memcpy(&file[0], &header, sizeof(header));
+	memcpy(&file[sizeof(header)], entries.data(), entries.size() * sizeof(SGFDNodeEntry));
+	for (size_t i = 0; i < nodes.size(); i++) {
+		SGFDNodeLayout layout = getSGFDNodeLayout(entries[i].vertexCount, entries[i].indexCount);
+		vector<float> positions(nodes[i].vertexCount * 4, (float)i);
+		if(!positions.empty())
+			memcpy(&file[entries[i].offset + layout.positions], positions.data(), positions.size() * sizeof(float));
+		if(!nodes[i].indices.empty())
+			memcpy(&file[entries[i].offset + layout.indices], nodes[i].indices.data(), nodes[i].indices.size() * sizeof(uint32_t));
+	}
+
+	ofstream out(path, ios::binary);
+	out.write((const char*)file.data(), file.size() - truncateBy);
+}
+
+TestNode makeNode(int vertexCount, int triangles) {
+	TestNode node;
+	node.vertexCount = vertexCount;
+	for (int i = 0; i < triangles * 3; i++)
+		node.indices.push_back(i % vertexCount);
+	return node;
+}
+
+int main() {
+	const char* path = "sgfdtest.sgfd";
+
+	vector<TestNode> nodes;
+	nodes.push_back(makeNode(3, 1));
+	nodes.push_back(makeNode(4, 2));
+	writeFrame(path, nodes);
+	SGFDFile *file = SGFDFile::mapFile(path);
+	CHECK(file && file->getNodeCount() == 2, "valid frame rejected");
+	if(file) {
+		SGFDNodeLayout layout = getSGFDNodeLayout(4, 6);
+		const float *positions = (const float*)file->getNodeData(1, layout.positions);
+		const uint32_t *indices = (const uint32_t*)file->getNodeData(1, layout.indices);
+		CHECK(positions[5] == 1.0f && indices[4] == 0 && indices[5] == 1, "node data not mapped in place");
+		CHECK(((uintptr_t)positions) % SGFD_ALIGNMENT == 0, "positions not aligned");
+		file->release();
+	}
+
+	// An index equal to the vertex count reads one vertex past the node
+	vector<TestNode> bad = nodes;
+	bad[1].indices[5] = bad[1].vertexCount;
+	writeFrame(path, bad);
+	CHECK(SGFDFile::mapFile(path) == NULL, "index equal to vertex count accepted");
+
+	bad = nodes;
+	bad[0].indices[0] = 0xFFFFFFFFu;
+	writeFrame(path, bad);
+	CHECK(SGFDFile::mapFile(path) == NULL, "huge index accepted");
+
+	bad = nodes;
+	bad[0].vertexCount = 0;
+	writeFrame(path, bad);
+	CHECK(SGFDFile::mapFile(path) == NULL, "indices into a node without vertices accepted");
+
+	writeFrame(path, nodes, SGFD_VERSION, 16);
+	CHECK(SGFDFile::mapFile(path) == NULL, "truncated frame accepted");
+
+	writeFrame(path, nodes, SGFD_VERSION - 1);
+	CHECK(SGFDFile::mapFile(path) == NULL, "previous SGFD version accepted");
+
+	bad = nodes;
+	bad[1].indices.pop_back();
+	writeFrame(path, bad);
+	CHECK(SGFDFile::mapFile(path) == NULL, "index count that is not a multiple of 3 accepted");
+
+	// The hash is the only change test for a node whose counts stay the same
+	float a[4] = { 1.0f, 2.0f, 3.0f, 0.0f }, b[4] = { 1.0f, 2.0f, 3.0f, 0.0f };
+	CHECK(getSGFDHash(a, sizeof(a)) == getSGFDHash(b, sizeof(b)), "hash not deterministic");
+	b[2] = nextafterf(b[2], 4.0f);
+	CHECK(getSGFDHash(a, sizeof(a)) != getSGFDHash(b, sizeof(b)), "one ulp change not detected");
+	CHECK((getSGFDHash(a, sizeof(a)) >> 32) != 0, "hash is not 64 bit");
+
+	unlink(path);
+	printf("%s\n", failures ? "FAILED" : "OK");
+	return failures ? 1 : 0;
+}
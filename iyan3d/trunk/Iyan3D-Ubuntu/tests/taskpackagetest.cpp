@@ -0,0 +1,164 @@
+#include "common.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...) if(!(cond)) { printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; }
+
+struct TestEntry {
+	string name;
+	string content;
+};
+
+uint32_t getCrc32(const string &data) {
+	uint32_t crc = 0xFFFFFFFF;
+	for (size_t i = 0; i < data.size(); i++) {
+		crc ^= (unsigned char)data[i];
+		for (int bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+	return ~crc;
+}
+
+void put16(string &out, uint16_t value) {
+	out.push_back(value & 0xFF);
+	out.push_back(value >> 8);
+}
+
+void put32(string &out, uint32_t value) {
+	put16(out, value & 0xFFFF);
+	put16(out, value >> 16);
+}
+
+/// Writes an archive of stored entries, directory entries are left out on
+/// purpose like some zip tools do.
+void writeArchive(string path, const vector<TestEntry> &entries) {
+	string file, directory;
+	for (size_t i = 0; i < entries.size(); i++) {
+		uint32_t crc = getCrc32(entries[i].content);
+		uint32_t offset = file.size();
+		put32(file, 0x04034b50);
+		put16(file, 20);
+		put16(file, 0);
+		put16(file, 0);
+		put32(file, 0);
+		put32(file, crc);
+		put32(file, entries[i].content.size());
+		put32(file, entries[i].content.size());
+		put16(file, entries[i].name.size());
+		put16(file, 0);
+		file += entries[i].name + entries[i].content;
+
+		put32(directory, 0x02014b50);
+		put16(directory, 20);
+		put16(directory, 20);
+		put16(directory, 0);
+		put16(directory, 0);
+		put32(directory, 0);
+		put32(directory, crc);
+		put32(directory, entries[i].content.size());
+		put32(directory, entries[i].content.size());
+		put16(directory, entries[i].name.size());
+		put16(directory, 0);
+		put16(directory, 0);
+		put16(directory, 0);
+		put16(directory, 0);
+		put32(directory, 0);
+		put32(directory, offset);
+		directory += entries[i].name;
+	}
+	uint32_t directoryOffset = file.size();
+	file += directory;
+	put32(file, 0x06054b50);
+	put16(file, 0);
+	put16(file, 0);
+	put16(file, entries.size());
+	put16(file, entries.size());
+	put32(file, directory.size());
+	put32(file, directoryOffset);
+	put16(file, 0);
+
+	ofstream out(path.c_str(), ios::binary);
+	out << file;
+}
+
+string readFile(string path) {
+	ifstream file(path.c_str(), ios::binary);
+	stringstream content;
+	content << file.rdbuf();
+	return content.str();
+}
+
+nlink_t getLinkCount(string path) {
+	struct stat buffer;
+	return stat(path.c_str(), &buffer) == 0 ? buffer.st_nlink : 0;
+}
+
+/// Extracts archive into directory the way openTaskPackage does.
+bool extractInto(string directory, string archive, ThreadPool &pool) {
+	mkdir(directory.c_str(), 0755);
+	chdir(directory.c_str());
+	SGRTTaskPackage package;
+	bool status = package.open("../" + archive, pool.getThreadCount()) && package.extract(PACKAGE_SCENE_ENTRY);
+	if(status) {
+		package.extractAll(pool);
+		status = package.finish();
+	}
+	chdir("..");
+	return status;
+}
+
+int main() {
+	string root = "taskpackagetest.dir";
+	system(("rm -rf " + root).c_str());
+	mkdir(root.c_str(), 0755);
+	chdir(root.c_str());
+
+	char cwd[FILENAME_MAX];
+	getcwd(cwd, sizeof(cwd));
+	assetCacheDir = string(cwd) + "/cache";
+	ThreadPool pool(2);
+
+	vector<TestEntry> entries;
+	TestEntry scene = { PACKAGE_SCENE_ENTRY, "scene" };
+	TestEntry texture = { "textures/wood.png", "wood texture" };
+	TestEntry mesh = { "models/deep/box.sgm", "box mesh" };
+	TestEntry empty = { "empty.txt", "" };
+	entries.push_back(scene);
+	entries.push_back(texture);
+	entries.push_back(mesh);
+	entries.push_back(empty);
+	writeArchive("task.zip", entries);
+
+	// Nested entries extract without directory entries in the archive
+	CHECK(extractInto("first", "task.zip", pool), "first extraction failed");
+	CHECK(readFile("first/" PACKAGE_SCENE_ENTRY) == "scene", "scene entry wrong");
+	CHECK(readFile("first/textures/wood.png") == "wood texture", "nested entry wrong");
+	CHECK(readFile("first/models/deep/box.sgm") == "box mesh", "deeply nested entry wrong");
+	CHECK(file_exists("first/empty.txt") && readFile("first/empty.txt").empty(), "empty entry wrong");
+
+	// The same archive again is linked from the cache once the content matches
+	SGRTAssetCache &cache = getAssetCache();
+	uint64_t textureHash = SGRTAssetCache::hashContent(texture.content.data(), texture.content.size(), 14695981039346656037ull);
+	string textureObject = cache.getObjectPath(textureHash);
+	CHECK(file_exists(textureObject), "extracted entry not stored in the cache");
+	CHECK(extractInto("second", "task.zip", pool), "second extraction failed");
+	CHECK(readFile("second/textures/wood.png") == "wood texture", "cached entry wrong");
+	CHECK(getLinkCount(textureObject) >= 3, "cached entry not linked, %d links", (int)getLinkCount(textureObject));
+
+	// A cached object with the same CRC key but other bytes is not used
+	string tempPath = textureObject + ".tmp";
+	ofstream tampered(tempPath.c_str(), ios::binary);
+	tampered << "WOOD TEXTURE";
+	tampered.close();
+	rename(tempPath.c_str(), textureObject.c_str());
+	CHECK(extractInto("third", "task.zip", pool), "third extraction failed");
+	CHECK(readFile("third/textures/wood.png") == "wood texture", "mismatching cached entry used: '%s'", readFile("third/textures/wood.png").c_str());
+	CHECK(readFile("third/models/deep/box.sgm") == "box mesh", "matching cached entry wrong");
+
+	releaseAssetCache();
+	chdir("..");
+	system(("rm -rf " + root).c_str());
+
+	printf(failures ? "FAILED\n" : "OK\n");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,102 @@
+#include "common.h"
+#include <thread>
+
+static int failures = 0;
+
+#define CHECK(cond, ...) if(!(cond)) { printf("FAIL %s:%d ", __FILE__, __LINE__); printf(__VA_ARGS__); printf("\n"); failures++; }
+
+#define TEST_TEXTURE_SIZE 64
+// A 64x64 texture with its tiled mip chain
+#define TEST_TEXTURE_BYTES 25600
+#define TEST_TEXTURE_COUNT 8
+
+Vec3fa getTestColor(int index) {
+	return Vec3fa((index * 20) / 255.0, (255 - index * 20) / 255.0, 7 / 255.0);
+}
+
+/// Solid textures, so every mip level and filter returns the same color.
+string writeTestTexture(int index) {
+	string path = "texturecachetest" + to_string(index) + ".png";
+	vector<unsigned char> image(TEST_TEXTURE_SIZE * TEST_TEXTURE_SIZE * 4);
+	for (int i = 0; i < TEST_TEXTURE_SIZE * TEST_TEXTURE_SIZE; i++) {
+		image[i * 4] = index * 20;
+		image[i * 4 + 1] = 255 - index * 20;
+		image[i * 4 + 2] = 7;
+		image[i * 4 + 3] = 255;
+	}
+	lodepng::encode(path, image, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE);
+	return path;
+}
+
+bool hasTestColor(SGRTTexture *texture, int index, sgrtreal footprint, bool isSmoothTexture) {
+	Vec3fa color = texture->getColorAt(0.3, 0.6, footprint, isSmoothTexture);
+	Vec3fa expected = getTestColor(index);
+	return fabs(color.x - expected.x) < 1e-4 && fabs(color.y - expected.y) < 1e-4 && fabs(color.z - expected.z) < 1e-4;
+}
+
+int main() {
+	vector<string> paths;
+	for (int i = 0; i < TEST_TEXTURE_COUNT; i++)
+		paths.push_back(writeTestTexture(i));
+	sgrtreal baseLevel = 0.0, coarseLevel = 4.0 / TEST_TEXTURE_SIZE;
+
+	// Textures the frame has not touched are evicted while the frame loads
+	textureCacheBudget = TEST_TEXTURE_BYTES * 3;
+	for (int i = 0; i < 3; i++)
+		CHECK(hasTestColor(getCachedTexture(paths[i]), i, baseLevel, true), "texture %d wrong", i);
+	CHECK(textureCacheResidentBytes == TEST_TEXTURE_BYTES * 3, "%zu bytes resident", textureCacheResidentBytes);
+	trimTextureCache();
+	for (int i = 3; i < 6; i++) {
+		CHECK(hasTestColor(getCachedTexture(paths[i]), i, baseLevel, true), "texture %d wrong", i);
+		CHECK(textureCacheResidentBytes <= textureCacheBudget, "%zu bytes resident after loading texture %d", textureCacheResidentBytes, i);
+	}
+	CHECK(!getCachedTexture(paths[0])->mips, "least recently used texture kept");
+	CHECK(hasTestColor(getCachedTexture(paths[0]), 0, baseLevel, false), "evicted texture not reloaded");
+	clearTextureCache();
+	CHECK(textureCacheResidentBytes == 0, "%zu bytes resident after clear", textureCacheResidentBytes);
+
+	// Within one frame, levels finer than any lookup asked for are dropped
+	for (int i = 0; i < 4; i++) {
+		CHECK(hasTestColor(getCachedTexture(paths[i]), i, coarseLevel, false), "coarse texture %d wrong", i);
+		CHECK(textureCacheResidentBytes <= textureCacheBudget, "%zu bytes resident after loading coarse texture %d", textureCacheResidentBytes, i);
+	}
+	SGRTTexture *coarse = getCachedTexture(paths[0]);
+	CHECK(coarse->mips && coarse->mips->firstLevel == 2, "base levels of a coarse texture kept");
+	CHECK(hasTestColor(coarse, 0, baseLevel, true), "dropped base level not reloaded");
+	CHECK(coarse->mips && coarse->mips->firstLevel == 0, "base level missing after reload");
+	clearTextureCache();
+
+	// Lookups racing with eviction always read live levels
+	textureCacheBudget = TEST_TEXTURE_BYTES * 2;
+	vector<SGRTTexture*> textures;
+	for (int i = 0; i < paths.size(); i++)
+		textures.push_back(getCachedTexture(paths[i]));
+	vector<std::thread> threads;
+	volatile int wrongColors = 0;
+	for (int t = 0; t < 4; t++) {
+		threads.push_back(std::thread([&, t]() {
+			unsigned int state = t * 7919 + 1;
+			for (int i = 0; i < 20000; i++) {
+				state = state * 1103515245 + 12345;
+				int index = (state >> 16) % TEST_TEXTURE_COUNT;
+				sgrtreal footprint = ((state >> 8) & 1) ? coarseLevel : baseLevel;
+				if(!hasTestColor(textures[index], index, footprint, (state >> 9) & 1))
+					__sync_fetch_and_add(&wrongColors, 1);
+				if(i % 5000 == 0)
+					textures[index]->getAlphaAt(0.5, 0.5, true);
+			}
+		}));
+	}
+	for (int t = 0; t < threads.size(); t++)
+		threads[t].join();
+	CHECK(wrongColors == 0, "%d lookups wrong under eviction", wrongColors);
+	trimTextureCache();
+	CHECK(retiredTextureMips.empty(), "%d retired mips left between frames", (int)retiredTextureMips.size());
+	clearTextureCache();
+
+	for (int i = 0; i < paths.size(); i++)
+		remove(paths[i].c_str());
+
+	printf(failures ? "FAILED\n" : "OK\n");
+	return failures ? 1 : 0;
+}
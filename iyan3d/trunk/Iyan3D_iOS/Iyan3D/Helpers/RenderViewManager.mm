@@ -659,6 +659,10 @@ bool isTransparentCallBack(int nodeId, string callbackFuncName)
     if([[NSFileManager defaultManager] fileExistsAtPath:sgbFilePath])
         ret = [zip addFileToZip:sgbFilePath newname:[sgbFilePath lastPathComponent]];
     
+    NSString* physicsFilePath = [[sgbFilePath stringByDeletingPathExtension] stringByAppendingPathExtension:@"sgp"];
+    if([[NSFileManager defaultManager] fileExistsAtPath:physicsFilePath])
+        ret = [zip addFileToZip:physicsFilePath newname:[physicsFilePath lastPathComponent]];
+    
     for(int i = 0; i < [userFiles count]; i++)
         ret = [zip addFileToZip:[userFiles objectAtIndex:i] newname:[[userFiles objectAtIndex:i] lastPathComponent]];
     
@@ -152,9 +152,13 @@
             NSString* newsgbPath = [NSString stringWithFormat:@"%@/%@.sgb", projectsDir, sceneFile];
             NSString* oldThumbPath = [NSString stringWithFormat:@"%@/%@.png", unzipPath, oldSgbName];
             NSString* newThumbPath = [NSString stringWithFormat:@"%@/%@.png", projectsDir, sceneFile];
+            NSString* oldPhysicsPath = [NSString stringWithFormat:@"%@/%@.sgp", unzipPath, oldSgbName];
+            NSString* newPhysicsPath = [NSString stringWithFormat:@"%@/%@.sgp", projectsDir, sceneFile];
             
             [fm moveItemAtPath:oldSgbPath toPath:newsgbPath error:nil];
             [fm moveItemAtPath:oldThumbPath toPath:newThumbPath error:nil];
+            if([fm fileExistsAtPath:oldPhysicsPath])
+                [fm moveItemAtPath:oldPhysicsPath toPath:newPhysicsPath error:nil];
             
             filesArr = [fm contentsOfDirectoryAtPath:unzipPath error:nil];
             [self moveFilesToRespectiveDirs:filesArr];
@@ -517,6 +521,9 @@
         originalFilePath = [NSString stringWithFormat:@"%@/Projects/%@.png", documentsDirectory, originalScene.sceneFile];
         newFilePath = [NSString stringWithFormat:@"%@/Projects/%@.png", documentsDirectory, scene.sceneFile];
         [[NSFileManager defaultManager] copyItemAtPath:originalFilePath toPath:newFilePath error:nil];
+        originalFilePath = [NSString stringWithFormat:@"%@/Projects/%@.sgp", documentsDirectory, originalScene.sceneFile];
+        newFilePath = [NSString stringWithFormat:@"%@/Projects/%@.sgp", documentsDirectory, scene.sceneFile];
+        [[NSFileManager defaultManager] copyItemAtPath:originalFilePath toPath:newFilePath error:nil];
         
         scenesArray = [cache GetSceneList];
         [self.scenesCollectionView reloadData];
@@ -547,6 +554,8 @@
     [[NSFileManager defaultManager] removeItemAtPath:filePath error:nil];
     filePath = [NSString stringWithFormat:@"%@/Projects/%@.png", documentsDirectory, scene.sceneFile];
     [[NSFileManager defaultManager] removeItemAtPath:filePath error:nil];
+    filePath = [NSString stringWithFormat:@"%@/Projects/%@.sgp", documentsDirectory, scene.sceneFile];
+    [[NSFileManager defaultManager] removeItemAtPath:filePath error:nil];
     
     [cache DeleteScene:scene];
     [scenesArray removeObjectAtIndex:indexValue];
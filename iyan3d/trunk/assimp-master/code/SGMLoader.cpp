@@ -54,10 +54,109 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <assimp/DefaultLogger.hpp>
 #include <assimp/scene.h>
 
-#include <fstream>
+#include <memory>
+#include <string.h>
+#include <unordered_map>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 using namespace Assimp;
 
+namespace {
+
+// ------------------------------------------------------------------------------------------------
+// Read only view of a whole SGM/SGR file. The file is memory mapped where the platform allows it,
+// otherwise it is read through the IOSystem in one call. Reads are bounds checked and blocks of
+// records are copied out in one go.
+class SGMFileView
+{
+public:
+    SGMFileView(const std::string& pFile, IOSystem* pIOHandler)
+        :   data    (NULL)
+        ,   size    (0)
+        ,   offset  (0)
+        ,   mapped  (false)
+    {
+#ifndef _WIN32
+        int fd = open(pFile.c_str(), O_RDONLY);
+        struct stat fileStat;
+        if (fd >= 0 && fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+            void* mapping = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                data = (const uint8_t*)mapping;
+                size = fileStat.st_size;
+                mapped = true;
+            }
+        }
+        if (fd >= 0)
+            close(fd);
+#endif
+        if (!mapped) {
+            std::unique_ptr<IOStream> stream(pIOHandler->Open(pFile, "rb"));
+            if (stream) {
+                buffer.resize(stream->FileSize());
+                if (!buffer.empty() && stream->Read(&buffer[0], 1, buffer.size()) != buffer.size())
+                    buffer.clear();
+            }
+            data = buffer.empty() ? NULL : &buffer[0];
+            size = buffer.size();
+        }
+
+        if (size == 0)
+            throw DeadlyImportError("File is either empty or corrupt: " + pFile);
+    }
+
+    ~SGMFileView()
+    {
+#ifndef _WIN32
+        if (mapped)
+            munmap((void*)data, size);
+#endif
+    }
+
+    const uint8_t* Take(size_t length)
+    {
+        if (length > size - offset)
+            throw DeadlyImportError("SGM: Unexpected end of file");
+
+        const uint8_t* p = data + offset;
+        offset += length;
+        return p;
+    }
+
+    template <typename T>
+    T Get()
+    {
+        T value;
+        memcpy(&value, Take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void GetArray(std::vector<T>& values, size_t count)
+    {
+        if (count > (size - offset) / sizeof(T))
+            throw DeadlyImportError("SGM: Unexpected end of file");
+
+        values.resize(count);
+        if (count)
+            memcpy(&values[0], Take(count * sizeof(T)), count * sizeof(T));
+    }
+
+private:
+    const uint8_t* data;
+    size_t size, offset;
+    bool mapped;
+    std::vector<uint8_t> buffer;
+};
+
+} // end of anonymous namespace
+
 static const aiImporterDesc desc = {
     "SGM Importer",
     "",
@@ -130,27 +229,83 @@ void SGMImporter::InternReadFile( const std::string& pFile,
     const std::string extension = GetExtension(pFile);
 
     if(extension == "sgm") {
-        loadSGM(pFile, pScene);
+        loadSGM(pFile, pScene, pIOHandler);
     } else if(extension == "sgr") {
-        loadSGR(pFile, pScene);
+        loadSGR(pFile, pScene, pIOHandler);
     }
 }
 
-void SGMImporter::loadSGM(const std::string& pFile, aiScene* pScene)
+void SGMImporter::loadSGM(const std::string& pFile, aiScene* pScene, IOSystem* pIOHandler)
 {
-    std::ifstream f(pFile, std::ios::in | std::ios::binary);
-    if (!f)
-        throw DeadlyImportError("File is either empty or corrupt: " + pFile);
+    SGMFileView f(pFile, pIOHandler);
     
     unsigned char versionIdentifier, hasUV;
-    f.read((char*)&versionIdentifier, sizeof(unsigned char));
+    versionIdentifier = f.Get<unsigned char>();
     
-    if (versionIdentifier == 0 || versionIdentifier == 3) { // newer version
-        f.read((char*)&hasUV, sizeof(unsigned char));
+    bool highPoly = (versionIdentifier == 0 || versionIdentifier == 3); // newer version
+    if (highPoly) {
+        hasUV = f.Get<unsigned char>();
     } else {
         hasUV = versionIdentifier;
     }
     
+    unsigned int vertCount, indCount, colCount;
+    if (highPoly) {
+        SSGMCountHeaderHighPoly counts = f.Get<SSGMCountHeaderHighPoly>();
+        vertCount = counts.vertCount;
+        indCount = counts.indCount;
+        colCount = counts.colCount;
+    } else {
+        SSGMCountHeaderLowPoly counts = f.Get<SSGMCountHeaderLowPoly>();
+        vertCount = counts.vertCount;
+        indCount = counts.indCount;
+        colCount = counts.colCount;
+    }
+    
+    std::vector<SSGMVectHeader> verts;
+    f.GetArray(verts, vertCount);
+    
+    std::vector<SSGMUVHeader> texs;
+    std::vector<SSGMColHeader> col;
+    if (hasUV == UV_MAPPED)
+        f.GetArray(texs, colCount);
+    else if (hasUV == VERTEX_COLORED)
+        f.GetArray(col, colCount);
+    
+    // Index pairs are widened to 32 bits so both versions share the expansion below
+    std::vector<SSGMIndexHeaderHighPoly> inds;
+    if (highPoly) {
+        f.GetArray(inds, indCount);
+    } else {
+        std::vector<SSGMIndexHeaderLowPoly> lowInds;
+        f.GetArray(lowInds, indCount);
+        inds.resize(indCount);
+        for (unsigned int i = 0; i < indCount; i++) {
+            inds[i].vtInd = lowInds[i].vtInd;
+            inds[i].colInd = lowInds[i].colInd;
+        }
+    }
+    
+    for (unsigned int i = 0; i < indCount; i++) {
+        if (inds[i].vtInd >= vertCount || ((hasUV == UV_MAPPED || hasUV == VERTEX_COLORED) && inds[i].colInd >= colCount))
+            throw DeadlyImportError("SGM: Index out of range in " + pFile);
+    }
+    
+    // Corners sharing both a vertex and a uv/color index become one indexed vertex, so
+    // seams are the only duplicates and the mesh is not split earlier than it has to be
+    const bool hasColIndex = (hasUV == UV_MAPPED || hasUV == VERTEX_COLORED);
+    std::vector<unsigned int> cornerVertex(indCount), vertexCorner;
+    std::unordered_map<uint64_t, unsigned int> uniqueCorners;
+    uniqueCorners.reserve(indCount);
+    for (unsigned int i = 0; i < indCount; i++) {
+        uint64_t key = ((uint64_t)inds[i].vtInd << 32) | (hasColIndex ? inds[i].colInd : 0);
+        std::pair<std::unordered_map<uint64_t, unsigned int>::iterator, bool> it = uniqueCorners.insert(std::make_pair(key, (unsigned int)vertexCorner.size()));
+        if (it.second)
+            vertexCorner.push_back(i);
+        cornerVertex[i] = it.first->second;
+    }
+    const unsigned int meshVertCount = (unsigned int)vertexCorner.size();
+    
     pScene->mRootNode = new aiNode();
     pScene->mRootNode->mName.Set("sgm mesh");
     pScene->mRootNode->mNumChildren = 1;
@@ -172,140 +327,47 @@ void SGMImporter::loadSGM(const std::string& pFile, aiScene* pScene)
     pScene->mMaterials = new aiMaterial*[pScene->mNumMaterials];
     pScene->mMaterials[0] = new aiMaterial();
     
-    if (versionIdentifier == 0 || versionIdentifier == 3) {
-        SSGMCountHeaderHighPoly counts;
-        f.read((char*)&counts, sizeof(SSGMCountHeaderHighPoly));
-        
-        SSGMVectHeader* verts = new SSGMVectHeader[counts.vertCount];
-        for (int i = 0; i < counts.vertCount; i++)
-            f.read((char*)&verts[i], sizeof(SSGMVectHeader));
-        
-        SSGMUVHeader* texs = new SSGMUVHeader[counts.colCount];
-        SSGMColHeader* col = new SSGMColHeader[counts.colCount];
-        
-        if (hasUV == UV_MAPPED) {
-            for (int i = 0; i < counts.colCount; i++)
-                f.read((char*)&texs[i], sizeof(SSGMUVHeader));
-        } else if (hasUV == VERTEX_COLORED) {
-            for (int i = 0; i < counts.colCount; i++)
-                f.read((char*)&col[i], sizeof(SSGMColHeader));
-        }
-        
-        pScene->mMeshes[0]->mNumVertices = counts.indCount;
-        pScene->mMeshes[0]->mVertices = new aiVector3D[counts.indCount];
-        pScene->mMeshes[0]->mNormals = new aiVector3D[counts.indCount];
-        
-        if (hasUV == UV_MAPPED) {
-            pScene->mMeshes[0]->mTextureCoords[0] = new aiVector3D[counts.indCount];
-        } else if (hasUV == VERTEX_COLORED) {
-            pScene->mMeshes[0]->mColors[0] = new aiColor4D[counts.indCount];
-        }
-        
-        for (int i = 0; i < counts.indCount; i++) {
-            SSGMIndexHeaderHighPoly ind;
-            f.read((char*)&ind, sizeof(SSGMIndexHeaderHighPoly));
-            
-            pScene->mMeshes[0]->mVertices[i].x = verts[ind.vtInd].vx;
-            pScene->mMeshes[0]->mVertices[i].y = verts[ind.vtInd].vy;
-            pScene->mMeshes[0]->mVertices[i].z = verts[ind.vtInd].vz;
-            
-            pScene->mMeshes[0]->mNormals[i].x = verts[ind.vtInd].nx;
-            pScene->mMeshes[0]->mNormals[i].y = verts[ind.vtInd].ny;
-            pScene->mMeshes[0]->mNormals[i].z = verts[ind.vtInd].nz;
-            
-            if (hasUV == UV_MAPPED) {
-                pScene->mMeshes[0]->mTextureCoords[0][i].x = texs[ind.colInd].s;
-                pScene->mMeshes[0]->mTextureCoords[0][i].y = texs[ind.colInd].t;
-            } else if (hasUV == VERTEX_COLORED) {
-                pScene->mMeshes[0]->mColors[0][i].r = col[ind.colInd].r / 255.0;
-                pScene->mMeshes[0]->mColors[0][i].g = col[ind.colInd].g / 255.0;
-                pScene->mMeshes[0]->mColors[0][i].b = col[ind.colInd].b / 255.0;
-                pScene->mMeshes[0]->mColors[0][i].a = 0.0;
-            }
-        }
-        
-        pScene->mMeshes[0]->mNumFaces = counts.indCount / 3;
-        pScene->mMeshes[0]->mFaces = new aiFace[counts.indCount / 3];
-        
-        int inds = 0;
-        for (int i = 0; i < counts.indCount / 3; i++) {
-            pScene->mMeshes[0]->mFaces[i].mNumIndices = 3;
-            pScene->mMeshes[0]->mFaces[i].mIndices = new unsigned int[3];
-            
-            for (int j = 0; j < 3; j++)
-                pScene->mMeshes[0]->mFaces[i].mIndices[j] = inds++;
-        }
-        
-        delete[] verts;
-        delete[] texs;
-        delete[] col;
-    } else {
-        SSGMCountHeaderLowPoly counts;
-        f.read((char*)&counts, sizeof(SSGMCountHeaderLowPoly));
-        
-        SSGMVectHeader* verts = new SSGMVectHeader[counts.vertCount];
-        for (int i = 0; i < counts.vertCount; i++)
-            f.read((char*)&verts[i], sizeof(SSGMVectHeader));
-        
-        SSGMUVHeader* texs = new SSGMUVHeader[counts.colCount];
-        SSGMColHeader* col = new SSGMColHeader[counts.colCount];
+    pScene->mMeshes[0]->mNumVertices = meshVertCount;
+    pScene->mMeshes[0]->mVertices = new aiVector3D[meshVertCount];
+    pScene->mMeshes[0]->mNormals = new aiVector3D[meshVertCount];
+    
+    if (hasUV == UV_MAPPED) {
+        pScene->mMeshes[0]->mTextureCoords[0] = new aiVector3D[meshVertCount];
+    } else if (hasUV == VERTEX_COLORED) {
+        pScene->mMeshes[0]->mColors[0] = new aiColor4D[meshVertCount];
+    }
+    
+    for (unsigned int i = 0; i < meshVertCount; i++) {
+        const SSGMIndexHeaderHighPoly& ind = inds[vertexCorner[i]];
         
-        if (hasUV == UV_MAPPED) {
-            for (int i = 0; i < counts.colCount; i++)
-                f.read((char*)&texs[i], sizeof(SSGMUVHeader));
-        } else if (hasUV == VERTEX_COLORED) {
-            for (int i = 0; i < counts.colCount; i++)
-                f.read((char*)&col[i], sizeof(SSGMColHeader));
-        }
+        pScene->mMeshes[0]->mVertices[i].x = verts[ind.vtInd].vx;
+        pScene->mMeshes[0]->mVertices[i].y = verts[ind.vtInd].vy;
+        pScene->mMeshes[0]->mVertices[i].z = verts[ind.vtInd].vz;
         
-        pScene->mMeshes[0]->mNumVertices = counts.indCount;
-        pScene->mMeshes[0]->mVertices = new aiVector3D[counts.indCount];
-        pScene->mMeshes[0]->mNormals = new aiVector3D[counts.indCount];
+        pScene->mMeshes[0]->mNormals[i].x = verts[ind.vtInd].nx;
+        pScene->mMeshes[0]->mNormals[i].y = verts[ind.vtInd].ny;
+        pScene->mMeshes[0]->mNormals[i].z = verts[ind.vtInd].nz;
         
         if (hasUV == UV_MAPPED) {
-            pScene->mMeshes[0]->mTextureCoords[0] = new aiVector3D[counts.indCount];
+            pScene->mMeshes[0]->mTextureCoords[0][i].x = texs[ind.colInd].s;
+            pScene->mMeshes[0]->mTextureCoords[0][i].y = texs[ind.colInd].t;
         } else if (hasUV == VERTEX_COLORED) {
-            pScene->mMeshes[0]->mColors[0] = new aiColor4D[counts.indCount];
-        }
-        
-        for (int i = 0; i < counts.indCount; i++) {
-            SSGMIndexHeaderLowPoly ind;
-            f.read((char*)&ind, sizeof(SSGMIndexHeaderLowPoly));
-            
-            pScene->mMeshes[0]->mVertices[i].x = verts[ind.vtInd].vx;
-            pScene->mMeshes[0]->mVertices[i].y = verts[ind.vtInd].vy;
-            pScene->mMeshes[0]->mVertices[i].z = verts[ind.vtInd].vz;
-            
-            pScene->mMeshes[0]->mNormals[i].x = verts[ind.vtInd].nx;
-            pScene->mMeshes[0]->mNormals[i].y = verts[ind.vtInd].ny;
-            pScene->mMeshes[0]->mNormals[i].z = verts[ind.vtInd].nz;
-            
-            if (hasUV == UV_MAPPED) {
-                pScene->mMeshes[0]->mTextureCoords[0][i].x = texs[ind.colInd].s;
-                pScene->mMeshes[0]->mTextureCoords[0][i].y = texs[ind.colInd].t;
-            } else if (hasUV == VERTEX_COLORED) {
-                pScene->mMeshes[0]->mColors[0][i].r = col[ind.colInd].r / 255.0;
-                pScene->mMeshes[0]->mColors[0][i].g = col[ind.colInd].g / 255.0;
-                pScene->mMeshes[0]->mColors[0][i].b = col[ind.colInd].b / 255.0;
-                pScene->mMeshes[0]->mColors[0][i].a = 0.0;
-            }
-        }
-        
-        pScene->mMeshes[0]->mNumFaces = counts.indCount / 3;
-        pScene->mMeshes[0]->mFaces = new aiFace[counts.indCount / 3];
-        
-        int inds = 0;
-        for (int i = 0; i < counts.indCount / 3; i++) {
-            pScene->mMeshes[0]->mFaces[i].mNumIndices = 3;
-            pScene->mMeshes[0]->mFaces[i].mIndices = new unsigned int[3];
-            
-            for (int j = 0; j < 3; j++)
-                pScene->mMeshes[0]->mFaces[i].mIndices[j] = inds++;
+            pScene->mMeshes[0]->mColors[0][i].r = col[ind.colInd].r / 255.0;
+            pScene->mMeshes[0]->mColors[0][i].g = col[ind.colInd].g / 255.0;
+            pScene->mMeshes[0]->mColors[0][i].b = col[ind.colInd].b / 255.0;
+            pScene->mMeshes[0]->mColors[0][i].a = 0.0;
         }
+    }
+    
+    pScene->mMeshes[0]->mNumFaces = indCount / 3;
+    pScene->mMeshes[0]->mFaces = new aiFace[indCount / 3];
+    
+    for (unsigned int i = 0; i < indCount / 3; i++) {
+        pScene->mMeshes[0]->mFaces[i].mNumIndices = 3;
+        pScene->mMeshes[0]->mFaces[i].mIndices = new unsigned int[3];
         
-        delete[] verts;
-        delete[] texs;
-        delete[] col;
+        for (int j = 0; j < 3; j++)
+            pScene->mMeshes[0]->mFaces[i].mIndices[j] = cornerVertex[i * 3 + j];
     }
     
     std::string textureFileName = getFileName(pFile);
@@ -380,21 +442,22 @@ void addChildren(aiNode* parent, std::vector <BoneStruct> boneList)
     }
 }
 
-void SGMImporter::loadSGR(const std::string& pFile, aiScene* pScene)
+void SGMImporter::loadSGR(const std::string& pFile, aiScene* pScene, IOSystem* pIOHandler)
 {
-    std::ifstream f(pFile, std::ios::in | std::ios::binary);
-    if (!f)
-        throw DeadlyImportError("File is either empty or corrupt: " + pFile);
+    SGMFileView f(pFile, pIOHandler);
     
     unsigned short versionIdentifier;
     unsigned int vertCount = 0;
-    f.read((char*)&versionIdentifier, sizeof(unsigned short));
+    versionIdentifier = f.Get<unsigned short>();
     
     if (versionIdentifier == 0 || versionIdentifier == 1) // for large Mesh identification
-        f.read((char*)&vertCount, sizeof(unsigned int));
+        vertCount = f.Get<unsigned int>();
     else
         vertCount = versionIdentifier;
     
+    std::vector<SSGRVectHeader> verts;
+    f.GetArray(verts, vertCount);
+    
     pScene->mRootNode = new aiNode();
     pScene->mRootNode->mName.Set("Scene");
     pScene->mRootNode->mNumChildren = 2;
@@ -422,9 +485,8 @@ void SGMImporter::loadSGR(const std::string& pFile, aiScene* pScene)
     pScene->mMeshes[0]->mNormals = new aiVector3D[vertCount];
     pScene->mMeshes[0]->mTextureCoords[0] = new aiVector3D[vertCount];
 
-    for (int i = 0; i < vertCount; i++) {
-        SSGRVectHeader vert;
-        f.read((char*)&vert, sizeof(SSGRVectHeader));
+    for (unsigned int i = 0; i < vertCount; i++) {
+        const SSGRVectHeader& vert = verts[i];
         
         pScene->mMeshes[0]->mVertices[i].x = vert.vx;
         pScene->mMeshes[0]->mVertices[i].y = vert.vy;
@@ -439,36 +501,31 @@ void SGMImporter::loadSGR(const std::string& pFile, aiScene* pScene)
     }
     
     unsigned int indicesCount = 0;
+    std::vector<unsigned int> indices;
     if (versionIdentifier > 1) {
-        unsigned short indCount;
-        f.read((char*)&indCount, sizeof(unsigned short));
-        indicesCount = (unsigned int)indCount;
+        indicesCount = f.Get<unsigned short>();
+        std::vector<unsigned short> shortIndices;
+        f.GetArray(shortIndices, indicesCount);
+        indices.assign(shortIndices.begin(), shortIndices.end());
     } else {
-        unsigned int indCount;
-        f.read((char*)&indCount, sizeof(unsigned int));
-        indicesCount = indCount;
+        indicesCount = f.Get<unsigned int>();
+        f.GetArray(indices, indicesCount);
+    }
+    
+    for (unsigned int i = 0; i < indicesCount; i++) {
+        if (indices[i] >= vertCount)
+            throw DeadlyImportError("SGR: Index out of range in " + pFile);
     }
     
     pScene->mMeshes[0]->mNumFaces = indicesCount / 3;
     pScene->mMeshes[0]->mFaces = new aiFace[indicesCount / 3];
     
-    for (int i = 0; i < indicesCount / 3; i++) {
+    for (unsigned int i = 0; i < indicesCount / 3; i++) {
         pScene->mMeshes[0]->mFaces[i].mNumIndices = 3;
         pScene->mMeshes[0]->mFaces[i].mIndices = new unsigned int[3];
         
-        for (int j = 0; j < 3; j++) {
-            unsigned int vertexIndex = 0;
-            if (versionIdentifier > 1) {
-                unsigned short ind;
-                f.read((char*)&ind, sizeof(unsigned short));
-                vertexIndex = (unsigned int)ind;
-            } else {
-                unsigned int ind;
-                f.read((char*)&ind, sizeof(unsigned int));
-                vertexIndex = ind;
-            }
-            pScene->mMeshes[0]->mFaces[i].mIndices[j] = vertexIndex;
-        }
+        for (int j = 0; j < 3; j++)
+            pScene->mMeshes[0]->mFaces[i].mIndices[j] = indices[i * 3 + j];
     }
 
     std::string textureFileName = getFileName(pFile);
@@ -481,14 +538,12 @@ void SGMImporter::loadSGR(const std::string& pFile, aiScene* pScene)
     std::vector <BoneStruct> boneList;
     std::vector <aiBone*> aiBoneList;
     
-    unsigned short boneCount;
-    f.read((char*)&boneCount, sizeof(unsigned short));
+    unsigned short boneCount = f.Get<unsigned short>();
     for (int i = 0; i < boneCount; i++) {
-        short boneParentInd;
-        f.read((char*)&boneParentInd, sizeof(short));
+        short boneParentInd = f.Get<short>();
         
         float* boneMatrix = new float[16];
-        f.read((char*)boneMatrix, sizeof(float) * 16);
+        memcpy(boneMatrix, f.Take(sizeof(float) * 16), sizeof(float) * 16);
         
         BoneStruct b;
         b.name = "sg00" + std::to_string(i);
@@ -504,8 +559,7 @@ void SGMImporter::loadSGR(const std::string& pFile, aiScene* pScene)
         
         delete[] boneMatrix;
         
-        unsigned short boneWeightCount;
-        f.read((char*)&boneWeightCount, sizeof(unsigned short));
+        unsigned short boneWeightCount = f.Get<unsigned short>();
         
         aiBone *bone = NULL;
         
@@ -519,18 +573,11 @@ void SGMImporter::loadSGR(const std::string& pFile, aiScene* pScene)
         
         for (int j = 0; j < boneWeightCount; ++j) {
             unsigned int vertexIndex = 0;
-            if (versionIdentifier > 1) {
-                unsigned short ind;
-                f.read((char*)&ind, sizeof(unsigned short));
-                vertexIndex = (unsigned int)ind;
-            }
-            else {
-                unsigned int ind;
-                f.read((char*)&ind, sizeof(unsigned int));
-                vertexIndex = ind;
-            }
-            unsigned short vertWeight;
-            f.read((char*)&vertWeight, sizeof(unsigned short));
+            if (versionIdentifier > 1)
+                vertexIndex = f.Get<unsigned short>();
+            else
+                vertexIndex = f.Get<unsigned int>();
+            unsigned short vertWeight = f.Get<unsigned short>();
             
             bone->mWeights[j].mVertexId = vertexIndex;
             bone->mWeights[j].mWeight = ((float)vertWeight) / 255.0f;
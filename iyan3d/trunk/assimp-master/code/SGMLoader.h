@@ -87,8 +87,8 @@ protected:
 private:
     std::string getFileName(const std::string& s);
     void replace(std::string& str, const std::string& from, const std::string& to);
-    void loadSGM(const std::string& pFile, aiScene* pScene);
-    void loadSGR(const std::string& pFile, aiScene* pScene);
+    void loadSGM(const std::string& pFile, aiScene* pScene, IOSystem* pIOHandler);
+    void loadSGR(const std::string& pFile, aiScene* pScene, IOSystem* pIOHandler);
     
     struct SSGRVectHeader {
         float vx, vy, vz, nx, ny, nz, s, t;
@@ -72,25 +72,36 @@ static const aiImporterDesc desc = {
     "ttf otf"
 };
 
-vector < aiVector3D > vertices;
-vector < aiVector3D > textCoords;
+#define TEXT3D_CHAR_SIZE 16.0
+#define TEXT3D_GLYPH_CACHE_LIMIT 1024
 
 typedef GLvoid (*GLUTesselatorFunction) ();
 
-void sgBeginCallback(GLenum which)
+// Per tessellation state handed to GLU as polygon data, no globals so imports can run on several threads
+struct TessVertex {
+    GLdouble coords[3];
+};
+
+struct TessContext {
+    vector<aiVector3D>* vertices;
+    deque<TessVertex> points; // deque keeps addresses stable while GLU holds on to them
+};
+
+static void sgBeginCallback(GLenum which)
 {
 }
 
-void sgEndCallback(void)
+static void sgEndCallback(void)
 {
 }
 
-void sgFlagCallback( GLboolean )
+// Registering an edge flag callback makes GLU emit plain triangles instead of fans and strips
+static void sgFlagCallback( GLboolean )
 {
     
 }
 
-void sgErrorCallback(GLenum errorCode)
+static void sgErrorCallback(GLenum errorCode)
 {
     const GLubyte *estring;
     
@@ -98,24 +109,28 @@ void sgErrorCallback(GLenum errorCode)
     fprintf (stderr, "Tessellation Error: %s\n", estring);
 }
 
-void sgVertexCallback(GLvoid *vertex)
+static void sgVertexCallback(GLvoid *vertex, GLvoid *polygonData)
 {
     const GLdouble *d;
     d = (GLdouble *) vertex;
-    vertices.push_back(aiVector3D(-d[0], d[1], d[2]));
+    ((TessContext*)polygonData)->vertices->push_back(aiVector3D(-d[0], d[1], d[2]));
 }
 
-void sgCombineCallback(GLdouble coords[3], GLdouble *vertex_data[4], GLfloat weight[4], GLdouble **dataOut)
+static void sgCombineCallback(GLdouble coords[3], GLdouble *vertex_data[4], GLfloat weight[4], GLdouble **dataOut, GLvoid *polygonData)
 {
-    GLdouble *vertex;
+    TessContext *context = (TessContext*)polygonData;
+    context->points.push_back(TessVertex());
     
-    vertex = (GLdouble *) malloc(6 * sizeof(GLdouble));
+    GLdouble *vertex = context->points.back().coords;
     vertex[0] = coords[0];
     vertex[1] = coords[1];
     vertex[2] = coords[2];
     *dataOut = vertex;
 }
 
+std::map< Text3DImporter::GlyphKey, std::shared_ptr<const Text3DImporter::Glyph> > Text3DImporter::glyphCache;
+std::mutex Text3DImporter::glyphCacheMutex;
+
 // ------------------------------------------------------------------------------------------------
 // Constructor to be privately used by Importer
 Text3DImporter::Text3DImporter()
@@ -159,9 +174,8 @@ const aiImporterDesc* Text3DImporter::GetInfo () const
     return &desc;
 }
 
-Vectoriser* Text3DImporter::generateVertices(FT_Face face, wchar_t ch, double strength)
+Vectoriser* Text3DImporter::generateVertices(FT_Face face, FT_UInt charIndex, double strength)
 {
-    FT_UInt charIndex = FT_Get_Char_Index(face, ch);
     if(FT_Load_Glyph(face, charIndex, FT_LOAD_DEFAULT)) {
         printf("Error Loading Char from Font");
         return NULL;
@@ -175,6 +189,7 @@ Vectoriser* Text3DImporter::generateVertices(FT_Face face, wchar_t ch, double st
     
     if(glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
         printf("Error Loading Char from Font");
+        FT_Done_Glyph(glyph);
         return NULL;
     }
     
@@ -190,151 +205,93 @@ Vectoriser* Text3DImporter::generateVertices(FT_Face face, wchar_t ch, double st
     return v;
 }
 
-double Text3DImporter::AddCharacter(FT_Face face, wchar_t ch, double offset)
+void Text3DImporter::AddCharacter(FT_Face face, FT_UInt charIndex, vector<aiVector3D>& vertices)
 {
-    static FT_UInt prevCharIndex = 0, curCharIndex = 0;
-    static FT_Pos  prev_rsb_delta = 0;
-    
-    curCharIndex = FT_Get_Char_Index( face, ch );
-    if(FT_Load_Glyph( face, curCharIndex, FT_LOAD_DEFAULT )){
-        printf("Error Loading Char from Font");
-        return -10000.0;
-    }
-    
-    FT_Glyph glyph;
-    if(FT_Get_Glyph( face->glyph, &glyph )){
-        printf("Error Loading Char from Font");
-        return -10000.0;
-    }
-    
-    if(glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
-        printf("Error Loading Char from Font");
-        return -10000.0;
-    }
-    
-    short nCountour = 0;
-    nCountour = face->glyph->outline.n_contours;
-    
-    if(FT_HAS_KERNING( face ) && prevCharIndex) {
-        FT_Vector  kerning;
-        FT_Get_Kerning( face, prevCharIndex, curCharIndex, FT_KERNING_DEFAULT, &kerning );
-        offset += kerning.x >> 6;
-    }
-    
-    if ( prev_rsb_delta - face->glyph->lsb_delta >= 32 )
-        offset -= 1.0;
-    else if ( prev_rsb_delta - face->glyph->lsb_delta < -32 )
-        offset += 1.0;
+    Vectoriser* vectoriser = generateVertices(face, charIndex);
+    if(!vectoriser)
+        return;
     
-    prev_rsb_delta = face->glyph->rsb_delta;
+    // Every contour goes into one polygon, the odd winding rule cuts the holes
+    bool hasOuterContour = false;
+    for(size_t c = 0; c < vectoriser->ContourCount(); c++)
+        hasOuterContour = hasOuterContour || vectoriser->GetContour(c)->GetDirection();
     
-    Vectoriser* vectoriser = generateVertices(face, ch);
-    for(size_t c = 0; c < vectoriser->ContourCount(); c++) {
-        const Contour* contour = vectoriser->GetContour(c);
+    if(hasOuterContour) {
+        TessContext context;
+        context.vertices = &vertices;
         
-        if(contour->GetDirection()) {
-            GLUtesselator* tobj = gluNewTess();
-            
-            gluTessCallback(tobj, GLU_TESS_VERTEX, (GLUTesselatorFunction) sgVertexCallback);
-            gluTessCallback(tobj, GLU_TESS_BEGIN, (GLUTesselatorFunction) sgBeginCallback);
-            gluTessCallback(tobj, GLU_TESS_END, (GLUTesselatorFunction) sgEndCallback);
-            gluTessCallback(tobj, GLU_TESS_ERROR, (GLUTesselatorFunction) sgErrorCallback);
-            gluTessCallback(tobj, GLU_TESS_COMBINE, (GLUTesselatorFunction) sgCombineCallback);
-            gluTessCallback(tobj, GLU_TESS_EDGE_FLAG, (GLUTesselatorFunction) sgFlagCallback);
-            
-            gluTessProperty(tobj, GLU_TESS_WINDING_RULE, GLU_TESS_WINDING_ODD);
-            gluTessNormal(tobj, 0.0, 0.0, 0.0);
-            
-            gluTessBeginPolygon(tobj, NULL);
-            for(size_t c = 0; c < vectoriser->ContourCount(); ++c) {
-                const Contour* contour = vectoriser->GetContour(c);
-                gluTessBeginContour(tobj);
-                for(size_t p = 0; p < contour->PointCount(); ++p) {
-                    const double* d1 = contour->GetPoint(p);
-                    double *d = new double[3];
-                    d[0] = d1[0]/64.0 + offset;
-                    d[1] = d1[1]/64.0;
-                    d[2] = bevelRadius;
-                    gluTessVertex(tobj, (GLdouble *)d, (GLvoid *)d);
-                }
-                
-                gluTessEndContour(tobj);
+        GLUtesselator* tobj = gluNewTess();
+        
+        gluTessCallback(tobj, GLU_TESS_VERTEX_DATA, (GLUTesselatorFunction) sgVertexCallback);
+        gluTessCallback(tobj, GLU_TESS_BEGIN, (GLUTesselatorFunction) sgBeginCallback);
+        gluTessCallback(tobj, GLU_TESS_END, (GLUTesselatorFunction) sgEndCallback);
+        gluTessCallback(tobj, GLU_TESS_ERROR, (GLUTesselatorFunction) sgErrorCallback);
+        gluTessCallback(tobj, GLU_TESS_COMBINE_DATA, (GLUTesselatorFunction) sgCombineCallback);
+        gluTessCallback(tobj, GLU_TESS_EDGE_FLAG, (GLUTesselatorFunction) sgFlagCallback);
+        
+        gluTessProperty(tobj, GLU_TESS_WINDING_RULE, GLU_TESS_WINDING_ODD);
+        gluTessNormal(tobj, 0.0, 0.0, 0.0);
+        
+        gluTessBeginPolygon(tobj, &context);
+        for(size_t c = 0; c < vectoriser->ContourCount(); ++c) {
+            const Contour* contour = vectoriser->GetContour(c);
+            gluTessBeginContour(tobj);
+            for(size_t p = 0; p < contour->PointCount(); ++p) {
+                const double* d1 = contour->GetPoint(p);
+                context.points.push_back(TessVertex());
+                GLdouble *d = context.points.back().coords;
+                d[0] = d1[0]/64.0;
+                d[1] = d1[1]/64.0;
+                d[2] = bevelRadius;
+                gluTessVertex(tobj, d, d);
             }
-            gluTessEndPolygon(tobj);
             
-            gluTessBeginPolygon(tobj, NULL);
-            for(size_t c = 0; c < vectoriser->ContourCount(); ++c) {
-                const Contour* contour = vectoriser->GetContour(c);
-                gluTessBeginContour(tobj);
-                for(int p = (int)contour->PointCount() - 1; p >= 0; --p) {
-                    const double* d1 = contour->GetPoint(p);
-                    double *d = new double[3];
-                    d[0] = d1[0]/64.0 + offset;
-                    d[1] = d1[1]/64.0;
-                    d[2] = extrude - bevelRadius;
-                    gluTessVertex(tobj, (GLdouble *)d, (GLvoid *)d);
-                }
-                
-                gluTessEndContour(tobj);
+            gluTessEndContour(tobj);
+        }
+        gluTessEndPolygon(tobj);
+        
+        gluTessBeginPolygon(tobj, &context);
+        for(size_t c = 0; c < vectoriser->ContourCount(); ++c) {
+            const Contour* contour = vectoriser->GetContour(c);
+            gluTessBeginContour(tobj);
+            for(int p = (int)contour->PointCount() - 1; p >= 0; --p) {
+                const double* d1 = contour->GetPoint(p);
+                context.points.push_back(TessVertex());
+                GLdouble *d = context.points.back().coords;
+                d[0] = d1[0]/64.0;
+                d[1] = d1[1]/64.0;
+                d[2] = extrude - bevelRadius;
+                gluTessVertex(tobj, d, d);
             }
-            gluTessEndPolygon(tobj);
-            gluDeleteTess(tobj);
+            
+            gluTessEndContour(tobj);
         }
+        gluTessEndPolygon(tobj);
+        gluDeleteTess(tobj);
     }
     
-    FT_Done_Glyph(glyph);
     delete vectoriser;
-    vectoriser = NULL;
-    
-    prevCharIndex = curCharIndex;
-    double chSize = face->glyph->advance.x >> 6;
-    return offset + chSize;
 }
 
-void Text3DImporter::AddBevel(FT_Face face, wchar_t ch, double offset)
+void Text3DImporter::AddBevel(FT_Face face, FT_UInt charIndex, vector<aiVector3D>& vertices)
 {
-    static FT_UInt prevCharIndex = 0, curCharIndex = 0;
-    static FT_Pos  prev_rsb_delta = 0;
-    
-    curCharIndex = FT_Get_Char_Index( face, ch );
-    if(FT_Load_Glyph( face, curCharIndex, FT_LOAD_DEFAULT )){
-        printf("Error Loading Char from Font");
-        return;
-    }
-    
-    FT_Glyph glyph;
-    if(FT_Get_Glyph( face->glyph, &glyph )){
-        printf("Error Loading Char from Font");
-        return;
-    }
-    
-    if(glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
-        printf("Error Loading Char from Font");
-        return;
-    }
-    
-    short nCountour = 0;
-    nCountour = face->glyph->outline.n_contours;
-    
-    if(FT_HAS_KERNING( face ) && prevCharIndex) {
-        FT_Vector  kerning;
-        FT_Get_Kerning( face, prevCharIndex, curCharIndex, FT_KERNING_DEFAULT, &kerning );
-        offset += kerning.x >> 6;
-    }
-    
-    if ( prev_rsb_delta - face->glyph->lsb_delta >= 32 )
-        offset -= 1.0;
-    else if ( prev_rsb_delta - face->glyph->lsb_delta < -32 )
-        offset += 1.0;
-    
-    prev_rsb_delta = face->glyph->rsb_delta;
-    
     for (int i = 0; i < bevelSegments; i++) {
         double bevelX = bevelRadius * 1.5 * sinf(M_PI * 0.5 * i / (double)bevelSegments);
         double nextBevelX = bevelRadius * 1.5  * sinf(M_PI * 0.5 * (i+1) / (double)bevelSegments);
         
-        Vectoriser* vectoriser1 = generateVertices(face, ch, bevelX);
-        Vectoriser* vectoriser2 = generateVertices(face, ch, nextBevelX);
+        Vectoriser* vectoriser1 = generateVertices(face, charIndex, bevelX);
+        Vectoriser* vectoriser2 = generateVertices(face, charIndex, nextBevelX);
+        
+        if(!vectoriser1 || !vectoriser2) {
+            delete vectoriser1;
+            delete vectoriser2;
+            return;
+        }
+        
+        double bevelY = bevelRadius * cosf(M_PI * 0.5 * i / (double)bevelSegments);
+        double nextBevelY = bevelRadius * cosf(M_PI * 0.5 * (i+1) / (double)bevelSegments);
+        double eBevelY = extrude - bevelY;
+        double eNextBevelY = extrude - nextBevelY;
         
         for(size_t c = 0; c < vectoriser1->ContourCount(); c++) {
             const Contour* contour1 = vectoriser1->GetContour(c);
@@ -359,104 +316,109 @@ void Text3DImporter::AddBevel(FT_Face face, wchar_t ch, double offset)
                 aiVector3D v3 = aiVector3D(d3[0]/64.0, d3[1]/64.0, 0.0);
                 aiVector3D v4 = aiVector3D(d4[0]/64.0, d4[1]/64.0, 0.0);
                 
-                double bevelY = bevelRadius * cosf(M_PI * 0.5 * i / (double)bevelSegments);
-                double nextBevelY = bevelRadius * cosf(M_PI * 0.5 * (i+1) / (double)bevelSegments);
-                
-                vertices.push_back(aiVector3D(-(v1.x + offset), v1.y, bevelY));
-                vertices.push_back(aiVector3D(-(v3.x + offset), v3.y, nextBevelY));
-                vertices.push_back(aiVector3D(-(v2.x + offset), v2.y, bevelY));
-                vertices.push_back(aiVector3D(-(v3.x + offset), v3.y, nextBevelY));
-                vertices.push_back(aiVector3D(-(v4.x + offset), v4.y, nextBevelY));
-                vertices.push_back(aiVector3D(-(v2.x + offset), v2.y, bevelY));
-
-                double eBevelY = extrude - (bevelRadius * cosf(M_PI * 0.5 * i / (double)bevelSegments));
-                double eNextBevelY = extrude - (bevelRadius * cosf(M_PI * 0.5 * (i+1) / (double)bevelSegments));
-                
-                vertices.push_back(aiVector3D(-(v1.x + offset), v1.y, eBevelY));
-                vertices.push_back(aiVector3D(-(v2.x + offset), v2.y, eBevelY));
-                vertices.push_back(aiVector3D(-(v3.x + offset), v3.y, eNextBevelY));
-                vertices.push_back(aiVector3D(-(v3.x + offset), v3.y, eNextBevelY));
-                vertices.push_back(aiVector3D(-(v2.x + offset), v2.y, eBevelY));
-                vertices.push_back(aiVector3D(-(v4.x + offset), v4.y, eNextBevelY));
+                vertices.push_back(aiVector3D(-v1.x, v1.y, bevelY));
+                vertices.push_back(aiVector3D(-v3.x, v3.y, nextBevelY));
+                vertices.push_back(aiVector3D(-v2.x, v2.y, bevelY));
+                vertices.push_back(aiVector3D(-v3.x, v3.y, nextBevelY));
+                vertices.push_back(aiVector3D(-v4.x, v4.y, nextBevelY));
+                vertices.push_back(aiVector3D(-v2.x, v2.y, bevelY));
+
+                vertices.push_back(aiVector3D(-v1.x, v1.y, eBevelY));
+                vertices.push_back(aiVector3D(-v2.x, v2.y, eBevelY));
+                vertices.push_back(aiVector3D(-v3.x, v3.y, eNextBevelY));
+                vertices.push_back(aiVector3D(-v3.x, v3.y, eNextBevelY));
+                vertices.push_back(aiVector3D(-v2.x, v2.y, eBevelY));
+                vertices.push_back(aiVector3D(-v4.x, v4.y, eNextBevelY));
             }
         }
         delete vectoriser1;
         delete vectoriser2;
-        vectoriser1 = NULL;
-        vectoriser2 = NULL;
     }
-    
-    FT_Done_Glyph(glyph);
-    
-    prevCharIndex = curCharIndex;
 }
 
-void Text3DImporter::AddCharacterSideFace(FT_Face face, wchar_t ch, double offset)
+void Text3DImporter::AddCharacterSideFace(FT_Face face, FT_UInt charIndex, vector<aiVector3D>& vertices)
 {
-    static FT_UInt prevCharIndex = 0, curCharIndex = 0;
-    static FT_Pos  prev_rsb_delta = 0;
-    
-    curCharIndex = FT_Get_Char_Index( face, ch );
-    if(FT_Load_Glyph( face, curCharIndex, FT_LOAD_DEFAULT )){
-        printf("Error Loading Char from Font");
-        return;
-    }
-    
-    FT_Glyph glyph;
-    if(FT_Get_Glyph( face->glyph, &glyph )){
-        printf("Error Loading Char from Font");
-        return;
-    }
-    
-    if(glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
-        printf("Error Loading Char from Font");
+    Vectoriser* vectoriser = generateVertices(face, charIndex, bevelRadius * 1.5);
+    if(!vectoriser)
         return;
-    }
-    
-    short nCountour = 0;
-    nCountour = face->glyph->outline.n_contours;
-    
-    if(FT_HAS_KERNING( face ) && prevCharIndex) {
-        FT_Vector  kerning;
-        FT_Get_Kerning( face, prevCharIndex, curCharIndex, FT_KERNING_DEFAULT, &kerning );
-        offset += kerning.x >> 6;
-    }
-    
-    if ( prev_rsb_delta - face->glyph->lsb_delta >= 32 )
-        offset -= 1.0;
-    else if ( prev_rsb_delta - face->glyph->lsb_delta < -32 )
-        offset += 1.0;
     
-    prev_rsb_delta = face->glyph->rsb_delta;
-    
-    Vectoriser* vectoriser = generateVertices(face, ch, bevelRadius * 1.5);
     for(size_t c = 0; c < vectoriser->ContourCount(); c++) {
         const Contour* contour = vectoriser->GetContour(c);
         
         for(size_t p = 0; p < contour->PointCount(); p++) {
             const double* d1 = contour->GetPoint(p);
-            const double* d2 = contour->GetPoint(p + 1);
+            const double* d2;
             
             if(p != contour->PointCount() - 1)
                 d2 = contour->GetPoint(p + 1);
             else
                 d2 = contour->GetPoint(0);
             
-            vertices.push_back(aiVector3D(-(d1[0]/64.0 + offset), d1[1]/64.0, 0.0));
-            vertices.push_back(aiVector3D(-(d1[0]/64.0 + offset), d1[1]/64.0, extrude));
-            vertices.push_back(aiVector3D(-(d2[0]/64.0 + offset), d2[1]/64.0, 0.0));
-            vertices.push_back(aiVector3D(-(d1[0]/64.0 + offset), d1[1]/64.0, extrude));
-            vertices.push_back(aiVector3D(-(d2[0]/64.0 + offset), d2[1]/64.0, extrude));
-            vertices.push_back(aiVector3D(-(d2[0]/64.0 + offset), d2[1]/64.0, 0.0));
+            vertices.push_back(aiVector3D(-d1[0]/64.0, d1[1]/64.0, 0.0));
+            vertices.push_back(aiVector3D(-d1[0]/64.0, d1[1]/64.0, extrude));
+            vertices.push_back(aiVector3D(-d2[0]/64.0, d2[1]/64.0, 0.0));
+            vertices.push_back(aiVector3D(-d1[0]/64.0, d1[1]/64.0, extrude));
+            vertices.push_back(aiVector3D(-d2[0]/64.0, d2[1]/64.0, extrude));
+            vertices.push_back(aiVector3D(-d2[0]/64.0, d2[1]/64.0, 0.0));
         }
     }
     
     delete vectoriser;
-    vectoriser = NULL;
+}
+
+bool Text3DImporter::BuildGlyph(FT_Face face, FT_UInt charIndex, Glyph& glyph)
+{
+    if(FT_Load_Glyph(face, charIndex, FT_LOAD_DEFAULT) || face->glyph->format != FT_GLYPH_FORMAT_OUTLINE) {
+        printf("Error Loading Char from Font");
+        return false;
+    }
     
-    FT_Done_Glyph(glyph);
+    glyph.advance = face->glyph->advance.x >> 6;
+    glyph.lsbDelta = face->glyph->lsb_delta;
+    glyph.rsbDelta = face->glyph->rsb_delta;
+    
+    AddCharacterSideFace(face, charIndex, glyph.vertices);
+    AddBevel(face, charIndex, glyph.vertices);
+    AddCharacter(face, charIndex, glyph.vertices);
+    
+    if(glyph.vertices.empty())
+        return true;
     
-    prevCharIndex = curCharIndex;
+    // Spherical mapping around the glyph center, unchanged by moving the glyph along the line
+    aiVector3D center;
+    for (size_t j = 0; j < glyph.vertices.size(); j++)
+        center += glyph.vertices[j];
+    center /= glyph.vertices.size();
+    
+    glyph.textCoords.resize(glyph.vertices.size());
+    for (size_t j = 0; j < glyph.vertices.size(); j++) {
+        const aiVector3D diff = (glyph.vertices[j]-center).Normalize();
+        glyph.textCoords[j] = aiVector3D((atan2(diff.x, diff.z) + AI_MATH_PI_F) / AI_MATH_TWO_PI_F, (asin(diff.y) + AI_MATH_HALF_PI_F) / AI_MATH_PI_F, 0.0);
+    }
+    
+    return true;
+}
+
+std::shared_ptr<const Text3DImporter::Glyph> Text3DImporter::GetGlyph(FT_Face face, FT_UInt charIndex)
+{
+    GlyphKey key = { fontPath, charIndex, bezierSteps, extrude, bevelRadius, bevelSegments };
+    {
+        std::lock_guard<std::mutex> lock(glyphCacheMutex);
+        std::map< GlyphKey, std::shared_ptr<const Glyph> >::iterator it = glyphCache.find(key);
+        if(it != glyphCache.end())
+            return it->second;
+    }
+    
+    std::shared_ptr<Glyph> glyph = std::make_shared<Glyph>();
+    if(!BuildGlyph(face, charIndex, *glyph))
+        return std::shared_ptr<const Glyph>();
+    
+    std::lock_guard<std::mutex> lock(glyphCacheMutex);
+    // Edits with new bevel or extrude settings keep adding keys, start over instead of growing forever
+    if(glyphCache.size() >= TEXT3D_GLYPH_CACHE_LIMIT)
+        glyphCache.clear();
+    glyphCache[key] = glyph;
+    return glyph;
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -466,57 +428,65 @@ void Text3DImporter::InternReadFile( const string& pFile, aiScene* pScene, IOSys
     const string extension = GetExtension(pFile);
     
     FT_Library library;
-    if (FT_Init_FreeType(&library)) {
-        printf("FT_Init_FreeType failed\n");
-        return;
-    }
+    if (FT_Init_FreeType(&library))
+        throw DeadlyImportError("FT_Init_FreeType failed");
     
     FT_Face face;
     if (FT_New_Face(library, fontPath.c_str(), 0, &face)) {
-        printf("FT_New_Face failed (there is probably a problem with your font file\n");
-        return;
+        FT_Done_FreeType(library);
+        throw DeadlyImportError("FT_New_Face failed (there is probably a problem with your font file)");
     }
-    FT_Set_Char_Size(face, 16 * 64.0, 16 * 64.0, 96, 96);
-
-    pScene->mRootNode = new aiNode();
-    pScene->mRootNode->mName.Set("sgm mesh");
-    pScene->mRootNode->mNumChildren = shouldHaveBones ? 2 : 1;
-    pScene->mRootNode->mChildren = new aiNode*[shouldHaveBones ? 2 : 1];
-    
-    aiNode* meshNode = pScene->mRootNode->mChildren[0] = new aiNode();
-    meshNode->mName.Set("Mesh Node");
-    meshNode->mParent = pScene->mRootNode;
-    meshNode->mNumMeshes = 1;
-    meshNode->mMeshes = new unsigned int[1];
-    meshNode->mMeshes[0] = 0;
-    
-    pScene->mNumMeshes = 1;
-    pScene->mMeshes = new aiMesh*[1];
-    pScene->mMeshes[0] = new aiMesh();
-    pScene->mMeshes[0]->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
-    
-    pScene->mNumMaterials = pScene->mNumMeshes;
-    pScene->mMaterials = new aiMaterial*[pScene->mNumMaterials];
-    pScene->mMaterials[0] = new aiMaterial();
+    FT_Set_Char_Size(face, TEXT3D_CHAR_SIZE * 64.0, TEXT3D_CHAR_SIZE * 64.0, 96, 96);
 
+    vector < aiVector3D > vertices;
+    vector < aiVector3D > textCoords;
     vector < aiBone* > boneList;
     vector < aiMatrix4x4 > matrixList;
     
+    // Glyphs come from the cache and are shifted into place, only glyphs not seen before are tessellated
     double offset = 0, prevOffset = 0;
     int prevVertCount = 0;
+    FT_UInt prevCharIndex = 0;
+    FT_Pos prevRsbDelta = 0;
     for(int i = 0; i < text2Convert.length(); i++){
-       	AddCharacterSideFace(face, text2Convert[i], offset);
-       	AddBevel(face, text2Convert[i], offset);
-        offset = AddCharacter(face, text2Convert[i], offset);
+        FT_UInt charIndex = FT_Get_Char_Index(face, text2Convert[i]);
+        std::shared_ptr<const Glyph> glyph = GetGlyph(face, charIndex);
         
-        if(offset == -10000.0)
-            return;
+        if(!glyph) {
+            for (int j = 0; j < boneList.size(); j++)
+                delete boneList[j];
+            FT_Done_Face(face);
+            FT_Done_FreeType(library);
+            throw DeadlyImportError("Error Loading Char from Font");
+        }
+        
+        if(FT_HAS_KERNING( face ) && prevCharIndex) {
+            FT_Vector  kerning;
+            FT_Get_Kerning( face, prevCharIndex, charIndex, FT_KERNING_DEFAULT, &kerning );
+            offset += kerning.x >> 6;
+        }
+        
+        if ( prevRsbDelta - glyph->lsbDelta >= 32 )
+            offset -= 1.0;
+        else if ( prevRsbDelta - glyph->lsbDelta < -32 )
+            offset += 1.0;
+        
+        prevRsbDelta = glyph->rsbDelta;
+        prevCharIndex = charIndex;
+        
+        for (size_t j = 0; j < glyph->vertices.size(); j++) {
+            aiVector3D vertex = glyph->vertices[j];
+            vertex.x -= offset;
+            vertices.push_back(vertex);
+        }
+        textCoords.insert(textCoords.end(), glyph->textCoords.begin(), glyph->textCoords.end());
+        offset += glyph->advance;
         
         if(shouldHaveBones && text2Convert[i] != L' ') {
             double diff = prevOffset - offset;
             aiMatrix4x4 mat;
             mat.a4 = -offset - diff/2.0;
-            mat.b4 = 16.0 / 2.0;
+            mat.b4 = TEXT3D_CHAR_SIZE / 2.0;
             mat.c4 = extrude / 2.0;
             matrixList.push_back(mat);
 
@@ -534,20 +504,6 @@ void Text3DImporter::InternReadFile( const string& pFile, aiScene* pScene, IOSys
             boneList.push_back(bone);
         }
 
-        aiVector3D center;
-        for (int j = prevVertCount; j < vertices.size(); j++)
-            center += vertices[j];
-        
-        center /= (vertices.size() - prevVertCount);
-        for (int j = prevVertCount; j < vertices.size(); j++) {
-            aiVector3D textCoord;
-            
-            const aiVector3D diff = (vertices[j]-center).Normalize();
-            textCoord = aiVector3D((atan2(diff.x, diff.z) + AI_MATH_PI_F) / AI_MATH_TWO_PI_F, (asin(diff.y) + AI_MATH_HALF_PI_F) / AI_MATH_PI_F, 0.0);
-            
-            textCoords.push_back(textCoord);
-        }
-
         prevVertCount = vertices.size();
         prevOffset = offset;
     }
@@ -555,6 +511,23 @@ void Text3DImporter::InternReadFile( const string& pFile, aiScene* pScene, IOSys
     FT_Done_Face(face);
     FT_Done_FreeType(library);
     
+    pScene->mRootNode = new aiNode();
+    pScene->mRootNode->mName.Set("sgm mesh");
+    pScene->mRootNode->mNumChildren = shouldHaveBones ? 2 : 1;
+    pScene->mRootNode->mChildren = new aiNode*[shouldHaveBones ? 2 : 1];
+    
+    aiNode* meshNode = pScene->mRootNode->mChildren[0] = new aiNode();
+    meshNode->mName.Set("Mesh Node");
+    meshNode->mParent = pScene->mRootNode;
+    meshNode->mNumMeshes = 1;
+    meshNode->mMeshes = new unsigned int[1];
+    meshNode->mMeshes[0] = 0;
+    
+    pScene->mNumMeshes = 1;
+    pScene->mMeshes = new aiMesh*[1];
+    pScene->mMeshes[0] = new aiMesh();
+    pScene->mMeshes[0]->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    
     pScene->mMeshes[0]->mNumVertices = vertices.size();
     pScene->mMeshes[0]->mVertices = new aiVector3D[vertices.size()];
     pScene->mMeshes[0]->mTextureCoords[0] = new aiVector3D[vertices.size()];
@@ -562,7 +535,7 @@ void Text3DImporter::InternReadFile( const string& pFile, aiScene* pScene, IOSys
     for (int i = 0; i < vertices.size(); i++) {
         pScene->mMeshes[0]->mVertices[i] = vertices[i];
         pScene->mMeshes[0]->mVertices[i].x += offset / 2.0;
-        pScene->mMeshes[0]->mVertices[i].y -= 16.0 / 2.0;
+        pScene->mMeshes[0]->mVertices[i].y -= TEXT3D_CHAR_SIZE / 2.0;
         pScene->mMeshes[0]->mVertices[i].z -= extrude / 2.0;
         
         pScene->mMeshes[0]->mTextureCoords[0][i] = textCoords[i];
@@ -591,7 +564,7 @@ void Text3DImporter::InternReadFile( const string& pFile, aiScene* pScene, IOSys
         rootBone->mName.Set("Armature");
         rootBone->mParent = pScene->mRootNode;
         rootBone->mTransformation.a4 = offset / 2.0;
-        rootBone->mTransformation.b4 = -16.0 / 2.0;
+        rootBone->mTransformation.b4 = -TEXT3D_CHAR_SIZE / 2.0;
         rootBone->mTransformation.c4 = -extrude / 2.0;
         
         rootBone->mNumChildren = boneList.size();
@@ -609,9 +582,6 @@ void Text3DImporter::InternReadFile( const string& pFile, aiScene* pScene, IOSys
             rootBone->mChildren[i]->mParent = rootBone;
         }
     }
-    
-    vertices.clear();
-    textCoords.clear();
 }
 
 #endif // !! ASSIMP_BUILD_NO_SGM_IMPORTER
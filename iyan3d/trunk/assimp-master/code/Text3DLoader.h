@@ -60,6 +60,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <fstream>
 #include <string>
 #include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <tuple>
 #include "glu.h"
 
 #include "ftgl/FtglPoint.h"
@@ -112,10 +116,39 @@ private:
     double bevelRadius;
     int bevelSegments;
 
-    double AddCharacter(FT_Face face, wchar_t ch, double offset);
-    void AddBevel(FT_Face face, wchar_t ch, double offset);
-    void AddCharacterSideFace(FT_Face face, wchar_t ch, double offset);
-    Vectoriser* generateVertices(FT_Face face, wchar_t ch, double strength = 0);
+    // Triangles of one extruded glyph placed at offset 0, texture coordinates are
+    // relative to the glyph so the same data is reused wherever it lands in a string
+    struct Glyph {
+        std::vector<aiVector3D> vertices;
+        std::vector<aiVector3D> textCoords;
+        double advance;
+        FT_Pos lsbDelta, rsbDelta;
+    };
+
+    struct GlyphKey {
+        std::string fontPath;
+        FT_UInt charIndex;
+        unsigned short bezierSteps;
+        float extrude;
+        double bevelRadius;
+        int bevelSegments;
+
+        bool operator<(const GlyphKey& rhs) const {
+            return std::tie(fontPath, charIndex, bezierSteps, extrude, bevelRadius, bevelSegments) <
+                std::tie(rhs.fontPath, rhs.charIndex, rhs.bezierSteps, rhs.extrude, rhs.bevelRadius, rhs.bevelSegments);
+        }
+    };
+
+    // Shared by every importer instance, glyphs are built outside the lock
+    static std::map< GlyphKey, std::shared_ptr<const Glyph> > glyphCache;
+    static std::mutex glyphCacheMutex;
+
+    std::shared_ptr<const Glyph> GetGlyph(FT_Face face, FT_UInt charIndex);
+    bool BuildGlyph(FT_Face face, FT_UInt charIndex, Glyph& glyph);
+    void AddCharacter(FT_Face face, FT_UInt charIndex, std::vector<aiVector3D>& vertices);
+    void AddBevel(FT_Face face, FT_UInt charIndex, std::vector<aiVector3D>& vertices);
+    void AddCharacterSideFace(FT_Face face, FT_UInt charIndex, std::vector<aiVector3D>& vertices);
+    Vectoriser* generateVertices(FT_Face face, FT_UInt charIndex, double strength = 0);
 
     struct SSGRVectHeader {
         float vx, vy, vz, nx, ny, nz, s, t;